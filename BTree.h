@@ -0,0 +1,1392 @@
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <initializer_list>
+#include <iterator>
+#include <memory>
+#include <optional>
+#include <span>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+#include "RedBlackTree.h"
+#include "SimdSearch.h"
+
+// B+-дерево для Set: ключи лежат в листах по несколько десятков подряд, листы связаны в список,
+// во внутренних узлах — только разделители и ссылки на детей. Узел занимает около NodeBytes байт,
+// так что спуск на каждом уровне читает пару соседних кэш-линий вместо одного узла на ключ.
+// Ключ должен конструироваться по умолчанию и присваиваться: слоты листа — обычный массив.
+// В отличие от RedBlackTree вставка и удаление делают итераторы недействительными
+template<typename Key, typename Compare = std::less<Key>, typename Allocator = std::allocator<Key>, std::size_t NodeBytes = 256>
+class BTree
+{
+public:
+    using key_type = Key;
+    using value_type = KeyValuePair<Key, EmptyStruct>;
+    using reference = const value_type&;
+    using const_reference = const value_type&;
+    using pointer = const value_type*;
+    using const_pointer = const value_type*;
+    using size_type = std::size_t;
+    using difference_type = std::ptrdiff_t;
+    using key_compare = Compare;
+    using allocator_type = Allocator;
+
+private:
+    using count_type = std::uint32_t;
+
+    static constexpr std::size_t leaf_header = 2 * sizeof(void*) + sizeof(count_type);
+    static constexpr std::size_t internal_header = sizeof(count_type) + sizeof(void*);
+
+    static constexpr count_type leaf_capacity = static_cast<count_type>(std::max<std::size_t>(4,
+        NodeBytes > leaf_header ? (NodeBytes - leaf_header) / sizeof(value_type) : 0));
+    static constexpr count_type internal_capacity = static_cast<count_type>(std::max<std::size_t>(4,
+        NodeBytes > internal_header ? (NodeBytes - internal_header) / (sizeof(Key) + sizeof(void*)) : 0));
+
+    // Минимальное заполнение некорневых узлов; при слиянии двух соседей всё помещается в один узел
+    static constexpr count_type leaf_min = leaf_capacity / 2;
+    static constexpr count_type internal_min = (internal_capacity - 1) / 2;
+
+    // С минимальным ветвлением 2 дерево из size_t элементов не выше 64 уровней
+    static constexpr std::size_t max_height = 64;
+
+    struct Leaf
+    {
+        Leaf* prev = nullptr;
+        Leaf* next = nullptr;
+        count_type count = 0;
+        value_type values[leaf_capacity];
+    };
+
+    // children[i] содержит ключи меньше keys[i], children[i + 1] — не меньше keys[i]
+    struct Internal
+    {
+        count_type count = 0;
+        Key keys[internal_capacity];
+        void* children[internal_capacity + 1] = {};
+    };
+
+    // Путь спуска: внутренний узел и индекс ребёнка на каждом уровне, уровень 1 — прямо над листьями
+    struct Path
+    {
+        Internal* nodes[max_height + 1];
+        count_type index[max_height + 1];
+    };
+
+    using leaf_allocator_type = typename std::allocator_traits<Allocator>::template rebind_alloc<Leaf>;
+    using leaf_traits = std::allocator_traits<leaf_allocator_type>;
+    using internal_allocator_type = typename std::allocator_traits<Allocator>::template rebind_alloc<Internal>;
+    using internal_traits = std::allocator_traits<internal_allocator_type>;
+
+    template<bool Const>
+    class IteratorBase
+    {
+    private:
+        Leaf* _leaf;
+        count_type _pos;
+
+        friend class BTree;
+        template<bool>
+        friend class IteratorBase;
+
+        IteratorBase(Leaf* leaf, count_type pos);
+
+    public:
+        using iterator_category = std::bidirectional_iterator_tag;
+        using value_type = KeyValuePair<Key, EmptyStruct>;
+        using difference_type = std::ptrdiff_t;
+        using pointer = const value_type*;
+        using reference = const value_type&;
+
+        IteratorBase();
+
+        template<bool C = Const, typename = std::enable_if_t<C>>
+        IteratorBase(const IteratorBase<false>& other);
+
+        reference operator*() const;
+        pointer operator->() const;
+
+        IteratorBase& operator++();
+        IteratorBase operator++(int);
+        IteratorBase& operator--();
+        IteratorBase operator--(int);
+
+        template<bool C>
+        bool operator==(const IteratorBase<C>& other) const;
+        template<bool C>
+        bool operator!=(const IteratorBase<C>& other) const;
+    };
+
+public:
+    using iterator = IteratorBase<false>;
+    using const_iterator = IteratorBase<true>;
+    using reverse_iterator = std::reverse_iterator<iterator>;
+    using const_reverse_iterator = std::reverse_iterator<const_iterator>;
+
+    BTree();
+    explicit BTree(const Compare& comp, const Allocator& alloc = Allocator());
+    explicit BTree(const Allocator& alloc);
+    BTree(std::initializer_list<key_type> init);
+    BTree(const BTree& other);
+    BTree(BTree&& other) noexcept;
+    ~BTree();
+
+    // Диапазон уже упорядочен и не содержит повторов: листы заполняются подряд за O(n)
+    template<typename InputIt>
+    BTree(sorted_unique_t, InputIt first, InputIt last, const Compare& comp = Compare(), const Allocator& alloc = Allocator());
+
+    BTree& operator=(const BTree& other);
+    BTree& operator=(BTree&& other);
+
+    allocator_type get_allocator() const;
+    key_compare key_comp() const;
+
+    size_type size() const;
+    size_type height() const;
+    bool empty() const;
+
+    // Байты, занятые узлами дерева
+    size_type memory_usage() const;
+
+    // Проверка инвариантов: порядок ключей, разделители, заполнение узлов, связи листов
+    bool is_valid() const;
+
+    void clear();
+
+    iterator find(const Key& key);
+    const_iterator find(const Key& key) const;
+    bool contains(const Key& key) const;
+    // result[i] = contains(keys[i]); result не короче keys. Пока ключи попадают в диапазон
+    // последнего найденного листа, спуска от корня нет — упорядоченные пакеты проходят почти по листам
+    void contains_many(std::span<const Key> keys, std::span<bool> result) const;
+
+    iterator lower_bound(const Key& key);
+    const_iterator lower_bound(const Key& key) const;
+    iterator upper_bound(const Key& key);
+    const_iterator upper_bound(const Key& key) const;
+    std::pair<iterator, iterator> equal_range(const Key& key);
+    std::pair<const_iterator, const_iterator> equal_range(const Key& key) const;
+
+    template<typename K>
+    std::pair<iterator, bool> try_emplace(K&& key);
+    template<typename... Args>
+    std::pair<iterator, bool> emplace(Args&&... args);
+    template<typename... Args>
+    iterator emplace_hint(const_iterator hint, Args&&... args);
+
+    template<typename InputIt>
+    void insert(InputIt first, InputIt last);
+
+    template<typename InputIt>
+    void assign(InputIt first, InputIt last);
+    template<typename InputIt>
+    void assign(sorted_unique_t, InputIt first, InputIt last);
+
+    size_type erase(const Key& key);
+    iterator erase(const_iterator pos);
+    iterator erase(const_iterator first, const_iterator last);
+
+    iterator begin();
+    iterator end();
+    const_iterator begin() const;
+    const_iterator end() const;
+    const_iterator cbegin() const;
+    const_iterator cend() const;
+
+    reverse_iterator rbegin();
+    reverse_iterator rend();
+    const_reverse_iterator rbegin() const;
+    const_reverse_iterator rend() const;
+    const_reverse_iterator crbegin() const;
+    const_reverse_iterator crend() const;
+
+private:
+    void* _root;
+    Leaf* _first;
+    Leaf* _last;
+    size_type _height;
+    size_type _size;
+    size_type _leaf_count;
+    size_type _internal_count;
+    Compare _comp;
+    leaf_allocator_type _leaf_alloc;
+    internal_allocator_type _internal_alloc;
+
+    Leaf* create_leaf();
+    Internal* create_internal();
+    void destroy_leaf(Leaf* leaf);
+    void destroy_internal(Internal* node);
+    void destroy_subtree(void* node, size_type level);
+
+    void steal(BTree& other) noexcept;
+
+    count_type child_index(const Internal* node, const Key& key) const;
+    count_type leaf_lower_bound(const Leaf* leaf, const Key& key) const;
+    Leaf* descend(const Key& key, Path* path) const;
+    iterator make_iterator(Leaf* leaf, count_type pos) const;
+
+    template<typename K>
+    std::pair<iterator, bool> insert_unique(K&& key);
+    void insert_into_parent(Path& path, Key separator, void* child, Internal** spare);
+    static void insert_key_child(Internal* node, count_type i, Key&& key, void* child);
+
+    void erase_at(Path& path, Leaf* leaf, count_type pos);
+    void merge_leaves(Leaf* left, Leaf* right);
+    void merge_internal(Internal* left, Key& separator, Internal* right);
+    static void remove_key_child(Internal* node, count_type i);
+    void fix_internal(Path& path, size_type level);
+
+    template<typename FwdIt>
+    bool is_sorted_unique(FwdIt first, FwdIt last) const;
+    template<typename InputIt>
+    void build_sorted(InputIt first, size_type n);
+
+    bool validate_helper(const void* node, size_type level, const Key* lo, const Key* hi, const Leaf*& expected) const;
+};
+
+// Бэкенд Set на B+-дереве, см. RedBlackTreeBackend в Set.h
+template<std::size_t NodeBytes = 256>
+struct BTreeBackend
+{
+    template<typename Key, typename Compare, typename Allocator>
+    using tree = BTree<Key, Compare, Allocator, NodeBytes>;
+};
+
+
+template<typename Key, typename Compare, typename Allocator, std::size_t NodeBytes>
+template<bool Const>
+inline BTree<Key, Compare, Allocator, NodeBytes>::IteratorBase<Const>::IteratorBase()
+    : _leaf(nullptr)
+    , _pos(0)
+{
+}
+
+template<typename Key, typename Compare, typename Allocator, std::size_t NodeBytes>
+template<bool Const>
+inline BTree<Key, Compare, Allocator, NodeBytes>::IteratorBase<Const>::IteratorBase(Leaf* leaf, count_type pos)
+    : _leaf(leaf)
+    , _pos(pos)
+{
+}
+
+template<typename Key, typename Compare, typename Allocator, std::size_t NodeBytes>
+template<bool Const>
+template<bool C, typename>
+inline BTree<Key, Compare, Allocator, NodeBytes>::IteratorBase<Const>::IteratorBase(const IteratorBase<false>& other)
+    : _leaf(other._leaf)
+    , _pos(other._pos)
+{
+}
+
+template<typename Key, typename Compare, typename Allocator, std::size_t NodeBytes>
+template<bool Const>
+inline typename BTree<Key, Compare, Allocator, NodeBytes>::template IteratorBase<Const>::reference
+            BTree<Key, Compare, Allocator, NodeBytes>::IteratorBase<Const>::operator*() const
+{
+    return _leaf->values[_pos];
+}
+
+template<typename Key, typename Compare, typename Allocator, std::size_t NodeBytes>
+template<bool Const>
+inline typename BTree<Key, Compare, Allocator, NodeBytes>::template IteratorBase<Const>::pointer
+            BTree<Key, Compare, Allocator, NodeBytes>::IteratorBase<Const>::operator->() const
+{
+    return &_leaf->values[_pos];
+}
+
+template<typename Key, typename Compare, typename Allocator, std::size_t NodeBytes>
+template<bool Const>
+inline typename BTree<Key, Compare, Allocator, NodeBytes>::template IteratorBase<Const>&
+            BTree<Key, Compare, Allocator, NodeBytes>::IteratorBase<Const>::operator++()
+{
+    // Конец — позиция за последним ключом последнего листа
+    if (++_pos == _leaf->count && _leaf->next)
+    {
+        _leaf = _leaf->next;
+        _pos = 0;
+    }
+    return *this;
+}
+
+template<typename Key, typename Compare, typename Allocator, std::size_t NodeBytes>
+template<bool Const>
+inline typename BTree<Key, Compare, Allocator, NodeBytes>::template IteratorBase<Const>
+            BTree<Key, Compare, Allocator, NodeBytes>::IteratorBase<Const>::operator++(int)
+{
+    IteratorBase temp = *this;
+    ++*this;
+    return temp;
+}
+
+template<typename Key, typename Compare, typename Allocator, std::size_t NodeBytes>
+template<bool Const>
+inline typename BTree<Key, Compare, Allocator, NodeBytes>::template IteratorBase<Const>&
+            BTree<Key, Compare, Allocator, NodeBytes>::IteratorBase<Const>::operator--()
+{
+    if (_pos == 0)
+    {
+        _leaf = _leaf->prev;
+        _pos = _leaf->count;
+    }
+    --_pos;
+    return *this;
+}
+
+template<typename Key, typename Compare, typename Allocator, std::size_t NodeBytes>
+template<bool Const>
+inline typename BTree<Key, Compare, Allocator, NodeBytes>::template IteratorBase<Const>
+            BTree<Key, Compare, Allocator, NodeBytes>::IteratorBase<Const>::operator--(int)
+{
+    IteratorBase temp = *this;
+    --*this;
+    return temp;
+}
+
+template<typename Key, typename Compare, typename Allocator, std::size_t NodeBytes>
+template<bool Const>
+template<bool C>
+inline bool BTree<Key, Compare, Allocator, NodeBytes>::IteratorBase<Const>::operator==(const IteratorBase<C>& other) const
+{
+    return _leaf == other._leaf && _pos == other._pos;
+}
+
+template<typename Key, typename Compare, typename Allocator, std::size_t NodeBytes>
+template<bool Const>
+template<bool C>
+inline bool BTree<Key, Compare, Allocator, NodeBytes>::IteratorBase<Const>::operator!=(const IteratorBase<C>& other) const
+{
+    return !(*this == other);
+}
+
+
+template<typename Key, typename Compare, typename Allocator, std::size_t NodeBytes>
+inline BTree<Key, Compare, Allocator, NodeBytes>::BTree()
+    : BTree(Compare(), Allocator())
+{
+}
+
+template<typename Key, typename Compare, typename Allocator, std::size_t NodeBytes>
+inline BTree<Key, Compare, Allocator, NodeBytes>::BTree(const Compare& comp, const Allocator& alloc)
+    : _root(nullptr)
+    , _first(nullptr)
+    , _last(nullptr)
+    , _height(0)
+    , _size(0)
+    , _leaf_count(0)
+    , _internal_count(0)
+    , _comp(comp)
+    , _leaf_alloc(alloc)
+    , _internal_alloc(alloc)
+{
+}
+
+template<typename Key, typename Compare, typename Allocator, std::size_t NodeBytes>
+inline BTree<Key, Compare, Allocator, NodeBytes>::BTree(const Allocator& alloc)
+    : BTree(Compare(), alloc)
+{
+}
+
+template<typename Key, typename Compare, typename Allocator, std::size_t NodeBytes>
+inline BTree<Key, Compare, Allocator, NodeBytes>::BTree(std::initializer_list<key_type> init)
+    : BTree()
+{
+    insert(init.begin(), init.end());
+}
+
+template<typename Key, typename Compare, typename Allocator, std::size_t NodeBytes>
+inline BTree<Key, Compare, Allocator, NodeBytes>::BTree(const BTree& other)
+    : BTree(other._comp, std::allocator_traits<Allocator>::select_on_container_copy_construction(other.get_allocator()))
+{
+    build_sorted(other.begin(), other._size);
+}
+
+template<typename Key, typename Compare, typename Allocator, std::size_t NodeBytes>
+inline BTree<Key, Compare, Allocator, NodeBytes>::BTree(BTree&& other) noexcept
+    : BTree(other._comp, other.get_allocator())
+{
+    steal(other);
+}
+
+template<typename Key, typename Compare, typename Allocator, std::size_t NodeBytes>
+inline BTree<Key, Compare, Allocator, NodeBytes>::~BTree()
+{
+    clear();
+}
+
+template<typename Key, typename Compare, typename Allocator, std::size_t NodeBytes>
+template<typename InputIt>
+inline BTree<Key, Compare, Allocator, NodeBytes>::BTree(sorted_unique_t, InputIt first, InputIt last, const Compare& comp, const Allocator& alloc)
+    : BTree(comp, alloc)
+{
+    assign(sorted_unique, first, last);
+}
+
+template<typename Key, typename Compare, typename Allocator, std::size_t NodeBytes>
+inline BTree<Key, Compare, Allocator, NodeBytes>& BTree<Key, Compare, Allocator, NodeBytes>::operator=(const BTree& other)
+{
+    if (this == &other)
+        return *this;
+
+    clear();
+    if constexpr (std::allocator_traits<Allocator>::propagate_on_container_copy_assignment::value)
+    {
+        _leaf_alloc = other._leaf_alloc;
+        _internal_alloc = other._internal_alloc;
+    }
+    _comp = other._comp;
+    build_sorted(other.begin(), other._size);
+    return *this;
+}
+
+template<typename Key, typename Compare, typename Allocator, std::size_t NodeBytes>
+inline BTree<Key, Compare, Allocator, NodeBytes>& BTree<Key, Compare, Allocator, NodeBytes>::operator=(BTree&& other)
+{
+    if (this == &other)
+        return *this;
+
+    clear();
+    _comp = other._comp;
+    if constexpr (std::allocator_traits<Allocator>::propagate_on_container_move_assignment::value)
+    {
+        _leaf_alloc = other._leaf_alloc;
+        _internal_alloc = other._internal_alloc;
+    }
+    else if (_leaf_alloc != other._leaf_alloc)
+    {
+        // Чужой аллокатор: узлы забрать нельзя, ключи переносятся в свои листы
+        build_sorted(std::make_move_iterator(other.begin()), other._size);
+        other.clear();
+        return *this;
+    }
+    steal(other);
+    return *this;
+}
+
+template<typename Key, typename Compare, typename Allocator, std::size_t NodeBytes>
+inline typename BTree<Key, Compare, Allocator, NodeBytes>::allocator_type BTree<Key, Compare, Allocator, NodeBytes>::get_allocator() const
+{
+    return allocator_type(_leaf_alloc);
+}
+
+template<typename Key, typename Compare, typename Allocator, std::size_t NodeBytes>
+inline typename BTree<Key, Compare, Allocator, NodeBytes>::key_compare BTree<Key, Compare, Allocator, NodeBytes>::key_comp() const
+{
+    return _comp;
+}
+
+template<typename Key, typename Compare, typename Allocator, std::size_t NodeBytes>
+inline typename BTree<Key, Compare, Allocator, NodeBytes>::size_type BTree<Key, Compare, Allocator, NodeBytes>::size() const
+{
+    return _size;
+}
+
+template<typename Key, typename Compare, typename Allocator, std::size_t NodeBytes>
+inline typename BTree<Key, Compare, Allocator, NodeBytes>::size_type BTree<Key, Compare, Allocator, NodeBytes>::height() const
+{
+    return _root ? _height + 1 : 0;
+}
+
+template<typename Key, typename Compare, typename Allocator, std::size_t NodeBytes>
+inline bool BTree<Key, Compare, Allocator, NodeBytes>::empty() const
+{
+    return _size == 0;
+}
+
+template<typename Key, typename Compare, typename Allocator, std::size_t NodeBytes>
+inline typename BTree<Key, Compare, Allocator, NodeBytes>::size_type BTree<Key, Compare, Allocator, NodeBytes>::memory_usage() const
+{
+    return _leaf_count * sizeof(Leaf) + _internal_count * sizeof(Internal);
+}
+
+template<typename Key, typename Compare, typename Allocator, std::size_t NodeBytes>
+inline bool BTree<Key, Compare, Allocator, NodeBytes>::is_valid() const
+{
+    if (!_root)
+        return _size == 0 && !_first && !_last && _height == 0;
+
+    const Leaf* expected = _first;
+    if (!validate_helper(_root, _height, nullptr, nullptr, expected) || expected != nullptr)
+        return false;
+
+    size_type count = 0;
+    for (const Leaf* leaf = _first; leaf; leaf = leaf->next)
+    {
+        if (leaf->next ? leaf->next->prev != leaf : leaf != _last)
+            return false;
+        if (leaf->next && !_comp(leaf->values[leaf->count - 1].first, leaf->next->values[0].first))
+            return false;
+        count += leaf->count;
+    }
+    return count == _size && _first->prev == nullptr;
+}
+
+template<typename Key, typename Compare, typename Allocator, std::size_t NodeBytes>
+inline bool BTree<Key, Compare, Allocator, NodeBytes>::validate_helper(const void* node, size_type level,
+                const Key* lo, const Key* hi, const Leaf*& expected) const
+{
+    // lo <= ключи поддерева < hi; листы в порядке обхода должны совпадать со списком листов
+    bool is_root = node == _root;
+    if (level == 0)
+    {
+        const Leaf* leaf = static_cast<const Leaf*>(node);
+        if (leaf != expected || leaf->count == 0 || leaf->count > leaf_capacity || (!is_root && leaf->count < leaf_min))
+            return false;
+        expected = leaf->next;
+        for (count_type i = 0; i < leaf->count; ++i)
+        {
+            const Key& key = leaf->values[i].first;
+            if ((lo && _comp(key, *lo)) || (hi && !_comp(key, *hi)) || (i > 0 && !_comp(leaf->values[i - 1].first, key)))
+                return false;
+        }
+        return true;
+    }
+
+    const Internal* in = static_cast<const Internal*>(node);
+    if (in->count == 0 || in->count > internal_capacity || (!is_root && in->count < internal_min))
+        return false;
+    for (count_type i = 0; i <= in->count; ++i)
+    {
+        const Key* child_lo = (i == 0) ? lo : &in->keys[i - 1];
+        const Key* child_hi = (i == in->count) ? hi : &in->keys[i];
+        if (child_lo && child_hi && !_comp(*child_lo, *child_hi))
+            return false;
+        if (!validate_helper(in->children[i], level - 1, child_lo, child_hi, expected))
+            return false;
+    }
+    return true;
+}
+
+template<typename Key, typename Compare, typename Allocator, std::size_t NodeBytes>
+inline void BTree<Key, Compare, Allocator, NodeBytes>::clear()
+{
+    if (_root)
+        destroy_subtree(_root, _height);
+    _root = nullptr;
+    _first = _last = nullptr;
+    _height = 0;
+    _size = 0;
+}
+
+template<typename Key, typename Compare, typename Allocator, std::size_t NodeBytes>
+inline typename BTree<Key, Compare, Allocator, NodeBytes>::iterator BTree<Key, Compare, Allocator, NodeBytes>::find(const Key& key)
+{
+    iterator it = lower_bound(key);
+    return (it == end() || _comp(key, it->first)) ? end() : it;
+}
+
+template<typename Key, typename Compare, typename Allocator, std::size_t NodeBytes>
+inline typename BTree<Key, Compare, Allocator, NodeBytes>::const_iterator BTree<Key, Compare, Allocator, NodeBytes>::find(const Key& key) const
+{
+    return const_cast<BTree*>(this)->find(key);
+}
+
+template<typename Key, typename Compare, typename Allocator, std::size_t NodeBytes>
+inline bool BTree<Key, Compare, Allocator, NodeBytes>::contains(const Key& key) const
+{
+    if (!_root)
+        return false;
+    Leaf* leaf = descend(key, nullptr);
+    count_type pos = leaf_lower_bound(leaf, key);
+    return pos < leaf->count && !_comp(key, leaf->values[pos].first);
+}
+
+template<typename Key, typename Compare, typename Allocator, std::size_t NodeBytes>
+inline void BTree<Key, Compare, Allocator, NodeBytes>::contains_many(std::span<const Key> keys, std::span<bool> result) const
+{
+    const Leaf* leaf = nullptr;
+    for (std::size_t i = 0; i < keys.size(); ++i)
+    {
+        const Key& key = keys[i];
+        if (!_root)
+        {
+            result[i] = false;
+            continue;
+        }
+        // Лист отвечает за ключи между своим первым и последним значением
+        if (!leaf || _comp(key, leaf->values[0].first) || _comp(leaf->values[leaf->count - 1].first, key))
+            leaf = descend(key, nullptr);
+        count_type pos = leaf_lower_bound(leaf, key);
+        result[i] = pos < leaf->count && !_comp(key, leaf->values[pos].first);
+    }
+}
+
+template<typename Key, typename Compare, typename Allocator, std::size_t NodeBytes>
+inline typename BTree<Key, Compare, Allocator, NodeBytes>::iterator BTree<Key, Compare, Allocator, NodeBytes>::lower_bound(const Key& key)
+{
+    if (!_root)
+        return end();
+    Leaf* leaf = descend(key, nullptr);
+    return make_iterator(leaf, leaf_lower_bound(leaf, key));
+}
+
+template<typename Key, typename Compare, typename Allocator, std::size_t NodeBytes>
+inline typename BTree<Key, Compare, Allocator, NodeBytes>::const_iterator BTree<Key, Compare, Allocator, NodeBytes>::lower_bound(const Key& key) const
+{
+    return const_cast<BTree*>(this)->lower_bound(key);
+}
+
+template<typename Key, typename Compare, typename Allocator, std::size_t NodeBytes>
+inline typename BTree<Key, Compare, Allocator, NodeBytes>::iterator BTree<Key, Compare, Allocator, NodeBytes>::upper_bound(const Key& key)
+{
+    iterator it = lower_bound(key);
+    if (it != end() && !_comp(key, it->first))
+        ++it;
+    return it;
+}
+
+template<typename Key, typename Compare, typename Allocator, std::size_t NodeBytes>
+inline typename BTree<Key, Compare, Allocator, NodeBytes>::const_iterator BTree<Key, Compare, Allocator, NodeBytes>::upper_bound(const Key& key) const
+{
+    return const_cast<BTree*>(this)->upper_bound(key);
+}
+
+template<typename Key, typename Compare, typename Allocator, std::size_t NodeBytes>
+inline std::pair<typename BTree<Key, Compare, Allocator, NodeBytes>::iterator, typename BTree<Key, Compare, Allocator, NodeBytes>::iterator>
+            BTree<Key, Compare, Allocator, NodeBytes>::equal_range(const Key& key)
+{
+    iterator first = lower_bound(key);
+    iterator last = first;
+    if (last != end() && !_comp(key, last->first))
+        ++last;
+    return { first, last };
+}
+
+template<typename Key, typename Compare, typename Allocator, std::size_t NodeBytes>
+inline std::pair<typename BTree<Key, Compare, Allocator, NodeBytes>::const_iterator, typename BTree<Key, Compare, Allocator, NodeBytes>::const_iterator>
+            BTree<Key, Compare, Allocator, NodeBytes>::equal_range(const Key& key) const
+{
+    auto range = const_cast<BTree*>(this)->equal_range(key);
+    return { range.first, range.second };
+}
+
+template<typename Key, typename Compare, typename Allocator, std::size_t NodeBytes>
+template<typename K>
+inline std::pair<typename BTree<Key, Compare, Allocator, NodeBytes>::iterator, bool> BTree<Key, Compare, Allocator, NodeBytes>::try_emplace(K&& key)
+{
+    if constexpr (std::is_same<std::decay_t<K>, Key>::value)
+        return insert_unique(std::forward<K>(key));
+    else
+        return insert_unique(Key(std::forward<K>(key)));
+}
+
+template<typename Key, typename Compare, typename Allocator, std::size_t NodeBytes>
+template<typename... Args>
+inline std::pair<typename BTree<Key, Compare, Allocator, NodeBytes>::iterator, bool> BTree<Key, Compare, Allocator, NodeBytes>::emplace(Args&&... args)
+{
+    return insert_unique(Key(std::forward<Args>(args)...));
+}
+
+template<typename Key, typename Compare, typename Allocator, std::size_t NodeBytes>
+template<typename... Args>
+inline typename BTree<Key, Compare, Allocator, NodeBytes>::iterator BTree<Key, Compare, Allocator, NodeBytes>::emplace_hint(const_iterator, Args&&... args)
+{
+    // Спуск по B-дереву и так занимает несколько узлов, подсказка не используется
+    return emplace(std::forward<Args>(args)...).first;
+}
+
+template<typename Key, typename Compare, typename Allocator, std::size_t NodeBytes>
+template<typename InputIt>
+inline void BTree<Key, Compare, Allocator, NodeBytes>::insert(InputIt first, InputIt last)
+{
+    using category = typename std::iterator_traits<InputIt>::iterator_category;
+    if constexpr (std::is_base_of<std::forward_iterator_tag, category>::value)
+    {
+        // Упорядоченный диапазон в пустое дерево — листы заполняются подряд
+        if (empty() && is_sorted_unique(first, last))
+        {
+            build_sorted(first, static_cast<size_type>(std::distance(first, last)));
+            return;
+        }
+    }
+    for (; first != last; ++first)
+        try_emplace(element_key<Key>(*first));
+}
+
+template<typename Key, typename Compare, typename Allocator, std::size_t NodeBytes>
+template<typename InputIt>
+inline void BTree<Key, Compare, Allocator, NodeBytes>::assign(InputIt first, InputIt last)
+{
+    clear();
+    insert(first, last);
+}
+
+template<typename Key, typename Compare, typename Allocator, std::size_t NodeBytes>
+template<typename InputIt>
+inline void BTree<Key, Compare, Allocator, NodeBytes>::assign(sorted_unique_t, InputIt first, InputIt last)
+{
+    clear();
+    using category = typename std::iterator_traits<InputIt>::iterator_category;
+    if constexpr (std::is_base_of<std::forward_iterator_tag, category>::value)
+        build_sorted(first, static_cast<size_type>(std::distance(first, last)));
+    else
+        insert(first, last);
+}
+
+template<typename Key, typename Compare, typename Allocator, std::size_t NodeBytes>
+inline typename BTree<Key, Compare, Allocator, NodeBytes>::size_type BTree<Key, Compare, Allocator, NodeBytes>::erase(const Key& key)
+{
+    if (!_root)
+        return 0;
+    Path path;
+    Leaf* leaf = descend(key, &path);
+    count_type pos = leaf_lower_bound(leaf, key);
+    if (pos == leaf->count || _comp(key, leaf->values[pos].first))
+        return 0;
+    erase_at(path, leaf, pos);
+    return 1;
+}
+
+template<typename Key, typename Compare, typename Allocator, std::size_t NodeBytes>
+inline typename BTree<Key, Compare, Allocator, NodeBytes>::iterator BTree<Key, Compare, Allocator, NodeBytes>::erase(const_iterator pos)
+{
+    if (pos == end())
+        return end();
+
+    Leaf* leaf = pos._leaf;
+    count_type i = pos._pos;
+    Path path;
+    descend(leaf->values[i].first, &path);
+
+    // Лист без перебалансировки: следующий ключ сдвигается на место удалённого
+    if (leaf == _root || leaf->count > leaf_min)
+    {
+        erase_at(path, leaf, i);
+        return _root ? make_iterator(leaf, i) : end();
+    }
+
+    // Иначе ключи переезжают между соседями — запоминаем следующий и ищем его заново
+    std::optional<Key> next;
+    if (i + 1 < leaf->count)
+        next.emplace(leaf->values[i + 1].first);
+    else if (leaf->next)
+        next.emplace(leaf->next->values[0].first);
+    erase_at(path, leaf, i);
+    return next ? lower_bound(*next) : end();
+}
+
+template<typename Key, typename Compare, typename Allocator, std::size_t NodeBytes>
+inline typename BTree<Key, Compare, Allocator, NodeBytes>::iterator BTree<Key, Compare, Allocator, NodeBytes>::erase(const_iterator first, const_iterator last)
+{
+    if (first == begin() && last == end())
+    {
+        clear();
+        return end();
+    }
+
+    // Удаление может переносить ключи между листами, поэтому last не переживает его — считаем шаги
+    size_type count = static_cast<size_type>(std::distance(first, last));
+    iterator it(first._leaf, first._pos);
+    while (count-- > 0)
+        it = erase(it);
+    return it;
+}
+
+template<typename Key, typename Compare, typename Allocator, std::size_t NodeBytes>
+inline typename BTree<Key, Compare, Allocator, NodeBytes>::iterator BTree<Key, Compare, Allocator, NodeBytes>::begin()
+{
+    return iterator(_first, 0);
+}
+
+template<typename Key, typename Compare, typename Allocator, std::size_t NodeBytes>
+inline typename BTree<Key, Compare, Allocator, NodeBytes>::iterator BTree<Key, Compare, Allocator, NodeBytes>::end()
+{
+    return iterator(_last, _last ? _last->count : 0);
+}
+
+template<typename Key, typename Compare, typename Allocator, std::size_t NodeBytes>
+inline typename BTree<Key, Compare, Allocator, NodeBytes>::const_iterator BTree<Key, Compare, Allocator, NodeBytes>::begin() const
+{
+    return const_iterator(_first, 0);
+}
+
+template<typename Key, typename Compare, typename Allocator, std::size_t NodeBytes>
+inline typename BTree<Key, Compare, Allocator, NodeBytes>::const_iterator BTree<Key, Compare, Allocator, NodeBytes>::end() const
+{
+    return const_iterator(_last, _last ? _last->count : 0);
+}
+
+template<typename Key, typename Compare, typename Allocator, std::size_t NodeBytes>
+inline typename BTree<Key, Compare, Allocator, NodeBytes>::const_iterator BTree<Key, Compare, Allocator, NodeBytes>::cbegin() const
+{
+    return begin();
+}
+
+template<typename Key, typename Compare, typename Allocator, std::size_t NodeBytes>
+inline typename BTree<Key, Compare, Allocator, NodeBytes>::const_iterator BTree<Key, Compare, Allocator, NodeBytes>::cend() const
+{
+    return end();
+}
+
+template<typename Key, typename Compare, typename Allocator, std::size_t NodeBytes>
+inline typename BTree<Key, Compare, Allocator, NodeBytes>::reverse_iterator BTree<Key, Compare, Allocator, NodeBytes>::rbegin()
+{
+    return reverse_iterator(end());
+}
+
+template<typename Key, typename Compare, typename Allocator, std::size_t NodeBytes>
+inline typename BTree<Key, Compare, Allocator, NodeBytes>::reverse_iterator BTree<Key, Compare, Allocator, NodeBytes>::rend()
+{
+    return reverse_iterator(begin());
+}
+
+template<typename Key, typename Compare, typename Allocator, std::size_t NodeBytes>
+inline typename BTree<Key, Compare, Allocator, NodeBytes>::const_reverse_iterator BTree<Key, Compare, Allocator, NodeBytes>::rbegin() const
+{
+    return const_reverse_iterator(end());
+}
+
+template<typename Key, typename Compare, typename Allocator, std::size_t NodeBytes>
+inline typename BTree<Key, Compare, Allocator, NodeBytes>::const_reverse_iterator BTree<Key, Compare, Allocator, NodeBytes>::rend() const
+{
+    return const_reverse_iterator(begin());
+}
+
+template<typename Key, typename Compare, typename Allocator, std::size_t NodeBytes>
+inline typename BTree<Key, Compare, Allocator, NodeBytes>::const_reverse_iterator BTree<Key, Compare, Allocator, NodeBytes>::crbegin() const
+{
+    return rbegin();
+}
+
+template<typename Key, typename Compare, typename Allocator, std::size_t NodeBytes>
+inline typename BTree<Key, Compare, Allocator, NodeBytes>::const_reverse_iterator BTree<Key, Compare, Allocator, NodeBytes>::crend() const
+{
+    return rend();
+}
+
+template<typename Key, typename Compare, typename Allocator, std::size_t NodeBytes>
+inline typename BTree<Key, Compare, Allocator, NodeBytes>::Leaf* BTree<Key, Compare, Allocator, NodeBytes>::create_leaf()
+{
+    Leaf* leaf = leaf_traits::allocate(_leaf_alloc, 1);
+    try
+    {
+        leaf_traits::construct(_leaf_alloc, leaf);
+    }
+    catch (...)
+    {
+        leaf_traits::deallocate(_leaf_alloc, leaf, 1);
+        throw;
+    }
+    ++_leaf_count;
+    return leaf;
+}
+
+template<typename Key, typename Compare, typename Allocator, std::size_t NodeBytes>
+inline typename BTree<Key, Compare, Allocator, NodeBytes>::Internal* BTree<Key, Compare, Allocator, NodeBytes>::create_internal()
+{
+    Internal* node = internal_traits::allocate(_internal_alloc, 1);
+    try
+    {
+        internal_traits::construct(_internal_alloc, node);
+    }
+    catch (...)
+    {
+        internal_traits::deallocate(_internal_alloc, node, 1);
+        throw;
+    }
+    ++_internal_count;
+    return node;
+}
+
+template<typename Key, typename Compare, typename Allocator, std::size_t NodeBytes>
+inline void BTree<Key, Compare, Allocator, NodeBytes>::destroy_leaf(Leaf* leaf)
+{
+    leaf_traits::destroy(_leaf_alloc, leaf);
+    leaf_traits::deallocate(_leaf_alloc, leaf, 1);
+    --_leaf_count;
+}
+
+template<typename Key, typename Compare, typename Allocator, std::size_t NodeBytes>
+inline void BTree<Key, Compare, Allocator, NodeBytes>::destroy_internal(Internal* node)
+{
+    internal_traits::destroy(_internal_alloc, node);
+    internal_traits::deallocate(_internal_alloc, node, 1);
+    --_internal_count;
+}
+
+template<typename Key, typename Compare, typename Allocator, std::size_t NodeBytes>
+inline void BTree<Key, Compare, Allocator, NodeBytes>::destroy_subtree(void* node, size_type level)
+{
+    // Глубина рекурсии — высота дерева, единицы уровней
+    if (level == 0)
+    {
+        destroy_leaf(static_cast<Leaf*>(node));
+        return;
+    }
+    Internal* in = static_cast<Internal*>(node);
+    for (count_type i = 0; i <= in->count; ++i)
+        destroy_subtree(in->children[i], level - 1);
+    destroy_internal(in);
+}
+
+template<typename Key, typename Compare, typename Allocator, std::size_t NodeBytes>
+inline void BTree<Key, Compare, Allocator, NodeBytes>::steal(BTree& other) noexcept
+{
+    _root = std::exchange(other._root, nullptr);
+    _first = std::exchange(other._first, nullptr);
+    _last = std::exchange(other._last, nullptr);
+    _height = std::exchange(other._height, 0);
+    _size = std::exchange(other._size, 0);
+    _leaf_count = std::exchange(other._leaf_count, 0);
+    _internal_count = std::exchange(other._internal_count, 0);
+}
+
+template<typename Key, typename Compare, typename Allocator, std::size_t NodeBytes>
+inline typename BTree<Key, Compare, Allocator, NodeBytes>::count_type
+            BTree<Key, Compare, Allocator, NodeBytes>::child_index(const Internal* node, const Key& key) const
+{
+    // Первый разделитель, больший ключа
+    if constexpr (simd_search::enabled<Key, Compare>)
+        return static_cast<count_type>(simd_search::count_not_after<Key, Compare>(node->keys, node->count, key));
+
+    count_type lo = 0;
+    count_type hi = node->count;
+    while (lo < hi)
+    {
+        count_type mid = (lo + hi) / 2;
+        if (_comp(key, node->keys[mid]))
+            hi = mid;
+        else
+            lo = mid + 1;
+    }
+    return lo;
+}
+
+template<typename Key, typename Compare, typename Allocator, std::size_t NodeBytes>
+inline typename BTree<Key, Compare, Allocator, NodeBytes>::count_type
+            BTree<Key, Compare, Allocator, NodeBytes>::leaf_lower_bound(const Leaf* leaf, const Key& key) const
+{
+    // Ключи листа лежат подряд: у пары с пустым вторым полем нет заполнения
+    if constexpr (simd_search::enabled<Key, Compare> && sizeof(value_type) == sizeof(Key))
+        return static_cast<count_type>(simd_search::count_before<Key, Compare>(&leaf->values[0].first, leaf->count, key));
+
+    count_type lo = 0;
+    count_type hi = leaf->count;
+    while (lo < hi)
+    {
+        count_type mid = (lo + hi) / 2;
+        if (_comp(leaf->values[mid].first, key))
+            lo = mid + 1;
+        else
+            hi = mid;
+    }
+    return lo;
+}
+
+template<typename Key, typename Compare, typename Allocator, std::size_t NodeBytes>
+inline typename BTree<Key, Compare, Allocator, NodeBytes>::Leaf*
+            BTree<Key, Compare, Allocator, NodeBytes>::descend(const Key& key, Path* path) const
+{
+    void* node = _root;
+    for (size_type level = _height; level > 0; --level)
+    {
+        Internal* in = static_cast<Internal*>(node);
+        count_type i = child_index(in, key);
+        if (path)
+        {
+            path->nodes[level] = in;
+            path->index[level] = i;
+        }
+        node = in->children[i];
+    }
+    return static_cast<Leaf*>(node);
+}
+
+template<typename Key, typename Compare, typename Allocator, std::size_t NodeBytes>
+inline typename BTree<Key, Compare, Allocator, NodeBytes>::iterator
+            BTree<Key, Compare, Allocator, NodeBytes>::make_iterator(Leaf* leaf, count_type pos) const
+{
+    // Позиция за концом листа — это начало следующего
+    if (pos == leaf->count && leaf->next)
+        return iterator(leaf->next, 0);
+    return iterator(leaf, pos);
+}
+
+template<typename Key, typename Compare, typename Allocator, std::size_t NodeBytes>
+template<typename K>
+inline std::pair<typename BTree<Key, Compare, Allocator, NodeBytes>::iterator, bool> BTree<Key, Compare, Allocator, NodeBytes>::insert_unique(K&& key)
+{
+    if (!_root)
+    {
+        Leaf* leaf = create_leaf();
+        leaf->values[0].first = std::forward<K>(key);
+        leaf->count = 1;
+        _root = _first = _last = leaf;
+        _height = 0;
+        _size = 1;
+        return { iterator(leaf, 0), true };
+    }
+
+    Path path;
+    Leaf* leaf = descend(key, &path);
+    count_type pos = leaf_lower_bound(leaf, key);
+    if (pos < leaf->count && !_comp(key, leaf->values[pos].first))
+        return { iterator(leaf, pos), false };
+
+    if (leaf->count < leaf_capacity)
+    {
+        std::move_backward(leaf->values + pos, leaf->values + leaf->count, leaf->values + leaf->count + 1);
+        leaf->values[pos].first = std::forward<K>(key);
+        ++leaf->count;
+        ++_size;
+        return { iterator(leaf, pos), true };
+    }
+
+    // Лист полон: все узлы, которые понадобятся для расщеплений вверх по пути, выделяются заранее,
+    // чтобы нехватка памяти не оставила дерево наполовину перестроенным
+    size_type splits = 0;
+    while (splits < _height && path.nodes[splits + 1]->count == internal_capacity)
+        ++splits;
+    size_type needed = splits + (splits == _height ? 1 : 0);
+
+    Internal* spare[max_height + 1];
+    Leaf* right = nullptr;
+    size_type allocated = 0;
+    try
+    {
+        for (; allocated < needed; ++allocated)
+            spare[allocated] = create_internal();
+        right = create_leaf();
+    }
+    catch (...)
+    {
+        while (allocated > 0)
+            destroy_internal(spare[--allocated]);
+        throw;
+    }
+
+    count_type mid = leaf_capacity / 2;
+    std::move(leaf->values + mid, leaf->values + leaf->count, right->values);
+    right->count = leaf->count - mid;
+    leaf->count = mid;
+
+    right->prev = leaf;
+    right->next = leaf->next;
+    if (leaf->next)
+        leaf->next->prev = right;
+    else
+        _last = right;
+    leaf->next = right;
+
+    Leaf* target = leaf;
+    if (pos > mid)
+    {
+        target = right;
+        pos -= mid;
+    }
+    std::move_backward(target->values + pos, target->values + target->count, target->values + target->count + 1);
+    target->values[pos].first = std::forward<K>(key);
+    ++target->count;
+    ++_size;
+
+    insert_into_parent(path, right->values[0].first, right, spare);
+    return { iterator(target, pos), true };
+}
+
+template<typename Key, typename Compare, typename Allocator, std::size_t NodeBytes>
+inline void BTree<Key, Compare, Allocator, NodeBytes>::insert_into_parent(Path& path, Key separator, void* child, Internal** spare)
+{
+    // Ребёнок path.index[level] расщепился: справа от него встаёт child с разделителем separator
+    for (size_type level = 1; ; ++level)
+    {
+        if (level > _height)
+        {
+            Internal* root = *spare++;
+            root->keys[0] = std::move(separator);
+            root->children[0] = _root;
+            root->children[1] = child;
+            root->count = 1;
+            _root = root;
+            ++_height;
+            return;
+        }
+
+        Internal* node = path.nodes[level];
+        count_type i = path.index[level];
+        if (node->count < internal_capacity)
+        {
+            insert_key_child(node, i, std::move(separator), child);
+            return;
+        }
+
+        // Средний ключ уходит наверх, правая половина — в новый узел
+        Internal* right = *spare++;
+        count_type mid = internal_capacity / 2;
+        Key promoted = std::move(node->keys[mid]);
+        std::move(node->keys + mid + 1, node->keys + node->count, right->keys);
+        std::copy(node->children + mid + 1, node->children + node->count + 1, right->children);
+        right->count = node->count - mid - 1;
+        node->count = mid;
+
+        if (i <= mid)
+            insert_key_child(node, i, std::move(separator), child);
+        else
+            insert_key_child(right, i - mid - 1, std::move(separator), child);
+
+        separator = std::move(promoted);
+        child = right;
+    }
+}
+
+template<typename Key, typename Compare, typename Allocator, std::size_t NodeBytes>
+inline void BTree<Key, Compare, Allocator, NodeBytes>::insert_key_child(Internal* node, count_type i, Key&& key, void* child)
+{
+    std::move_backward(node->keys + i, node->keys + node->count, node->keys + node->count + 1);
+    std::copy_backward(node->children + i + 1, node->children + node->count + 1, node->children + node->count + 2);
+    node->keys[i] = std::move(key);
+    node->children[i + 1] = child;
+    ++node->count;
+}
+
+template<typename Key, typename Compare, typename Allocator, std::size_t NodeBytes>
+inline void BTree<Key, Compare, Allocator, NodeBytes>::erase_at(Path& path, Leaf* leaf, count_type pos)
+{
+    std::move(leaf->values + pos + 1, leaf->values + leaf->count, leaf->values + pos);
+    --leaf->count;
+    --_size;
+
+    if (_height == 0)
+    {
+        if (leaf->count == 0)
+        {
+            destroy_leaf(leaf);
+            _root = _first = _last = nullptr;
+        }
+        return;
+    }
+    if (leaf->count >= leaf_min)
+        return;
+
+    // Разделители при удалении не обновляются: удалённый ключ по-прежнему корректно делит детей
+    Internal* parent = path.nodes[1];
+    count_type i = path.index[1];
+    Leaf* left = (i > 0) ? static_cast<Leaf*>(parent->children[i - 1]) : nullptr;
+    Leaf* right = (i < parent->count) ? static_cast<Leaf*>(parent->children[i + 1]) : nullptr;
+
+    if (left && left->count > leaf_min)
+    {
+        std::move_backward(leaf->values, leaf->values + leaf->count, leaf->values + leaf->count + 1);
+        leaf->values[0] = std::move(left->values[left->count - 1]);
+        --left->count;
+        ++leaf->count;
+        parent->keys[i - 1] = leaf->values[0].first;
+        return;
+    }
+    if (right && right->count > leaf_min)
+    {
+        leaf->values[leaf->count] = std::move(right->values[0]);
+        ++leaf->count;
+        std::move(right->values + 1, right->values + right->count, right->values);
+        --right->count;
+        parent->keys[i] = right->values[0].first;
+        return;
+    }
+
+    if (left)
+    {
+        merge_leaves(left, leaf);
+        remove_key_child(parent, i - 1);
+    }
+    else
+    {
+        merge_leaves(leaf, right);
+        remove_key_child(parent, i);
+    }
+    fix_internal(path, 1);
+}
+
+template<typename Key, typename Compare, typename Allocator, std::size_t NodeBytes>
+inline void BTree<Key, Compare, Allocator, NodeBytes>::merge_leaves(Leaf* left, Leaf* right)
+{
+    std::move(right->values, right->values + right->count, left->values + left->count);
+    left->count += right->count;
+    left->next = right->next;
+    if (right->next)
+        right->next->prev = left;
+    else
+        _last = left;
+    destroy_leaf(right);
+}
+
+template<typename Key, typename Compare, typename Allocator, std::size_t NodeBytes>
+inline void BTree<Key, Compare, Allocator, NodeBytes>::merge_internal(Internal* left, Key& separator, Internal* right)
+{
+    left->keys[left->count] = std::move(separator);
+    std::move(right->keys, right->keys + right->count, left->keys + left->count + 1);
+    std::copy(right->children, right->children + right->count + 1, left->children + left->count + 1);
+    left->count += right->count + 1;
+    destroy_internal(right);
+}
+
+template<typename Key, typename Compare, typename Allocator, std::size_t NodeBytes>
+inline void BTree<Key, Compare, Allocator, NodeBytes>::remove_key_child(Internal* node, count_type i)
+{
+    // Убирает разделитель keys[i] и ребёнка справа от него
+    std::move(node->keys + i + 1, node->keys + node->count, node->keys + i);
+    std::copy(node->children + i + 2, node->children + node->count + 1, node->children + i + 1);
+    --node->count;
+}
+
+template<typename Key, typename Compare, typename Allocator, std::size_t NodeBytes>
+inline void BTree<Key, Compare, Allocator, NodeBytes>::fix_internal(Path& path, size_type level)
+{
+    for (; ; ++level)
+    {
+        Internal* node = path.nodes[level];
+        if (level == _height)
+        {
+            // Корень без разделителей уступает место единственному ребёнку
+            if (node->count == 0)
+            {
+                _root = node->children[0];
+                destroy_internal(node);
+                --_height;
+            }
+            return;
+        }
+        if (node->count >= internal_min)
+            return;
+
+        Internal* parent = path.nodes[level + 1];
+        count_type j = path.index[level + 1];
+        Internal* left = (j > 0) ? static_cast<Internal*>(parent->children[j - 1]) : nullptr;
+        Internal* right = (j < parent->count) ? static_cast<Internal*>(parent->children[j + 1]) : nullptr;
+
+        if (left && left->count > internal_min)
+        {
+            // Поворот через родителя: последний ребёнок левого соседа переходит к нам
+            std::move_backward(node->keys, node->keys + node->count, node->keys + node->count + 1);
+            std::copy_backward(node->children, node->children + node->count + 1, node->children + node->count + 2);
+            node->keys[0] = std::move(parent->keys[j - 1]);
+            node->children[0] = left->children[left->count];
+            parent->keys[j - 1] = std::move(left->keys[left->count - 1]);
+            --left->count;
+            ++node->count;
+            return;
+        }
+        if (right && right->count > internal_min)
+        {
+            node->keys[node->count] = std::move(parent->keys[j]);
+            node->children[node->count + 1] = right->children[0];
+            ++node->count;
+            parent->keys[j] = std::move(right->keys[0]);
+            std::move(right->keys + 1, right->keys + right->count, right->keys);
+            std::copy(right->children + 1, right->children + right->count + 1, right->children);
+            --right->count;
+            return;
+        }
+
+        if (left)
+        {
+            merge_internal(left, parent->keys[j - 1], node);
+            remove_key_child(parent, j - 1);
+        }
+        else
+        {
+            merge_internal(node, parent->keys[j], right);
+            remove_key_child(parent, j);
+        }
+    }
+}
+
+template<typename Key, typename Compare, typename Allocator, std::size_t NodeBytes>
+template<typename FwdIt>
+inline bool BTree<Key, Compare, Allocator, NodeBytes>::is_sorted_unique(FwdIt first, FwdIt last) const
+{
+    if (first == last)
+        return true;
+    for (FwdIt next = std::next(first); next != last; ++first, ++next)
+    {
+        if (!_comp(element_key<Key>(*first), element_key<Key>(*next)))
+            return false;
+    }
+    return true;
+}
+
+template<typename Key, typename Compare, typename Allocator, std::size_t NodeBytes>
+template<typename InputIt>
+inline void BTree<Key, Compare, Allocator, NodeBytes>::build_sorted(InputIt first, size_type n)
+{
+    // Листы заполняются поровну подряд, затем уровни внутренних узлов строятся снизу вверх.
+    // Разделитель перед поддеревом — его минимальный ключ, то есть первый ключ самого левого листа
+    if (n == 0)
+        return;
+
+    std::vector<void*> level;
+    std::vector<const Key*> mins;
+    try
+    {
+        size_type leaves = (n + leaf_capacity - 1) / leaf_capacity;
+        level.reserve(leaves);
+        mins.reserve(leaves);
+        Leaf* prev = nullptr;
+        for (size_type i = 0; i < leaves; ++i)
+        {
+            Leaf* leaf = create_leaf();
+            leaf->prev = prev;
+            if (prev)
+                prev->next = leaf;
+            else
+                _first = leaf;
+            prev = leaf;
+            _last = leaf;
+            level.push_back(leaf);
+
+            count_type take = static_cast<count_type>(n / leaves + (i < n % leaves ? 1 : 0));
+            for (; leaf->count < take; ++leaf->count, ++first)
+                leaf->values[leaf->count].first = element_key<Key>(*first);
+            mins.push_back(&leaf->values[0].first);
+            _size += take;
+        }
+        _root = level[0];
+        _height = 0;
+
+        while (level.size() > 1)
+        {
+            size_type m = level.size();
+            size_type groups = (m + internal_capacity) / (internal_capacity + 1);
+            std::vector<void*> up;
+            std::vector<const Key*> up_mins;
+            up.reserve(groups);
+            up_mins.reserve(groups);
+
+            size_type index = 0;
+            for (size_type g = 0; g < groups; ++g)
+            {
+                size_type take = m / groups + (g < m % groups ? 1 : 0);
+                Internal* node = create_internal();
+                up.push_back(node);
+                up_mins.push_back(mins[index]);
+                node->children[0] = level[index];
+                for (size_type k = 1; k < take; ++k)
+                {
+                    node->keys[k - 1] = *mins[index + k];
+                    node->children[k] = level[index + k];
+                }
+                node->count = static_cast<count_type>(take - 1);
+                index += take;
+            }
+            level.swap(up);
+            mins.swap(up_mins);
+            _root = level[0];
+            ++_height;
+        }
+    }
+    catch (...)
+    {
+        // Недостроенные уровни: листы связаны списком, внутренние узлы верхнего уровня — в level
+        if (_height > 0)
+            for (void* node : level)
+                destroy_subtree(node, _height);
+        else
+            while (_first)
+                destroy_leaf(std::exchange(_first, _first->next));
+        _root = _first = _last = nullptr;
+        _height = 0;
+        _size = 0;
+        throw;
+    }
+}
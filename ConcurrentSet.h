@@ -0,0 +1,373 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <bit>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <initializer_list>
+#include <mutex>
+#include <new>
+#include <optional>
+#include <utility>
+
+#include "Epoch.h"
+
+// Упорядоченное множество для многопоточного доступа: contains, find, lower_bound и upper_bound
+// не берут блокировок и не ждут писателей, insert и erase упорядочены одним мьютексом.
+// Внутри — список с пропусками: в отличие от поворотов красно-чёрного дерева, вставка и удаление
+// меняют по одной ссылке на уровень, и читатель на любом шаге видит корректный упорядоченный список.
+// Новый узел публикуется снизу вверх, удаляемый отцепляется сверху вниз; ссылки удалённого узла
+// не меняются, поэтому читатель, стоящий на нём, продолжает путь. Удалённые узлы освобождаются по эпохам
+// (Epoch.h), когда их уже не может видеть ни один читатель.
+// Итераторов нет: узел может быть удалён сразу после поиска, поэтому поиск возвращает копию ключа
+template<typename Key, typename Compare = std::less<Key>>
+class ConcurrentSet
+{
+public:
+	using key_type = Key;
+	using value_type = Key;
+	using size_type = std::size_t;
+	using key_compare = Compare;
+
+	ConcurrentSet();
+	explicit ConcurrentSet(const Compare& comp);
+	ConcurrentSet(std::initializer_list<Key> init, const Compare& comp = Compare());
+	// Разрушение — без конкурентных обращений к множеству
+	~ConcurrentSet();
+
+	ConcurrentSet(const ConcurrentSet&) = delete;
+	ConcurrentSet& operator=(const ConcurrentSet&) = delete;
+
+	key_compare key_comp() const;
+
+	// Число элементов на момент вызова; при конкурентной записи — приблизительное
+	size_type size() const noexcept;
+	bool empty() const noexcept;
+
+	bool contains(const Key& key) const;
+	std::optional<Key> find(const Key& key) const;
+	std::optional<Key> lower_bound(const Key& key) const;
+	std::optional<Key> upper_bound(const Key& key) const;
+
+	bool insert(const Key& key);
+	bool insert(Key&& key);
+	bool erase(const Key& key);
+	void clear();
+
+	// Обход по возрастанию без блокировок. Вставленные во время обхода элементы могут не попасть
+	// в него, удалённые — попасть; элементы, присутствующие всё время обхода, посещаются ровно один раз
+	template<typename Visitor>
+	void for_each(Visitor&& visit) const;
+
+	// Удалённые, но ещё не освобождённые узлы
+	size_type pending_reclamation() const;
+
+private:
+	static constexpr unsigned max_height = 24;
+
+	struct alignas(std::atomic<void*>) Node
+	{
+		Key key;
+		unsigned height;
+
+		template<typename K>
+		Node(K&& k, unsigned h)
+			: key(std::forward<K>(k))
+			, height(h)
+		{
+		}
+
+		// Ссылки уровней 0..height-1 лежат сразу за узлом
+		std::atomic<Node*>* next()
+		{
+			return reinterpret_cast<std::atomic<Node*>*>(this + 1);
+		}
+	};
+
+	struct NodeDeleter
+	{
+		void operator()(Node* node) const
+		{
+			destroy_node(node);
+		}
+	};
+
+	// Ссылки предшественника: массив next() узла или _head
+	using Links = std::atomic<Node*>*;
+
+	template<typename K>
+	static Node* create_node(K&& key, unsigned height);
+	static void destroy_node(Node* node);
+
+	unsigned random_height();
+
+	// Первый узел, не меньший key (strict == false) или больший key (strict == true), либо nullptr
+	Node* search(const Key& key, bool strict) const;
+	// То же, с предшественниками на каждом уровне для писателя
+	Node* search(const Key& key, Links* preds) const;
+
+	template<typename K>
+	bool insert_key(K&& key);
+
+	std::atomic<Node*> _head[max_height];
+	std::atomic<unsigned> _height;
+	std::atomic<size_type> _size;
+	Compare _comp;
+
+	mutable std::mutex _write_mutex;
+	std::uint64_t _random_state;
+	epoch::RetireList<Node, NodeDeleter> _retired;
+};
+
+template<typename Key, typename Compare>
+inline ConcurrentSet<Key, Compare>::ConcurrentSet()
+	: ConcurrentSet(Compare())
+{
+}
+
+template<typename Key, typename Compare>
+inline ConcurrentSet<Key, Compare>::ConcurrentSet(const Compare& comp)
+	: _height(1)
+	, _size(0)
+	, _comp(comp)
+	, _random_state(0x9E3779B97F4A7C15ull)
+{
+	for (auto& link : _head)
+		link.store(nullptr, std::memory_order_relaxed);
+}
+
+template<typename Key, typename Compare>
+inline ConcurrentSet<Key, Compare>::ConcurrentSet(std::initializer_list<Key> init, const Compare& comp)
+	: ConcurrentSet(comp)
+{
+	for (const Key& key : init)
+		insert(key);
+}
+
+template<typename Key, typename Compare>
+inline ConcurrentSet<Key, Compare>::~ConcurrentSet()
+{
+	Node* node = _head[0].load(std::memory_order_relaxed);
+	while (node)
+	{
+		Node* next = node->next()[0].load(std::memory_order_relaxed);
+		destroy_node(node);
+		node = next;
+	}
+}
+
+template<typename Key, typename Compare>
+inline typename ConcurrentSet<Key, Compare>::key_compare ConcurrentSet<Key, Compare>::key_comp() const
+{
+	return _comp;
+}
+
+template<typename Key, typename Compare>
+inline typename ConcurrentSet<Key, Compare>::size_type ConcurrentSet<Key, Compare>::size() const noexcept
+{
+	return _size.load(std::memory_order_relaxed);
+}
+
+template<typename Key, typename Compare>
+inline bool ConcurrentSet<Key, Compare>::empty() const noexcept
+{
+	return _head[0].load(std::memory_order_acquire) == nullptr;
+}
+
+template<typename Key, typename Compare>
+inline bool ConcurrentSet<Key, Compare>::contains(const Key& key) const
+{
+	epoch::Guard guard;
+	Node* node = search(key, false);
+	return node && !_comp(key, node->key);
+}
+
+template<typename Key, typename Compare>
+inline std::optional<Key> ConcurrentSet<Key, Compare>::find(const Key& key) const
+{
+	epoch::Guard guard;
+	Node* node = search(key, false);
+	if (node && !_comp(key, node->key))
+		return node->key;
+	return std::nullopt;
+}
+
+template<typename Key, typename Compare>
+inline std::optional<Key> ConcurrentSet<Key, Compare>::lower_bound(const Key& key) const
+{
+	epoch::Guard guard;
+	Node* node = search(key, false);
+	if (node)
+		return node->key;
+	return std::nullopt;
+}
+
+template<typename Key, typename Compare>
+inline std::optional<Key> ConcurrentSet<Key, Compare>::upper_bound(const Key& key) const
+{
+	epoch::Guard guard;
+	Node* node = search(key, true);
+	if (node)
+		return node->key;
+	return std::nullopt;
+}
+
+template<typename Key, typename Compare>
+inline bool ConcurrentSet<Key, Compare>::insert(const Key& key)
+{
+	return insert_key(key);
+}
+
+template<typename Key, typename Compare>
+inline bool ConcurrentSet<Key, Compare>::insert(Key&& key)
+{
+	return insert_key(std::move(key));
+}
+
+template<typename Key, typename Compare>
+template<typename K>
+bool ConcurrentSet<Key, Compare>::insert_key(K&& key)
+{
+	std::lock_guard<std::mutex> lock(_write_mutex);
+	Links preds[max_height];
+	Node* found = search(key, preds);
+	if (found && !_comp(key, found->key))
+		return false;
+
+	unsigned height = random_height();
+	Node* node = create_node(std::forward<K>(key), height);
+	for (unsigned level = 0; level < height; ++level)
+		node->next()[level].store(preds[level][level].load(std::memory_order_relaxed), std::memory_order_relaxed);
+
+	// Снизу вверх: как только узел виден на нулевом уровне, он в множестве; верхние уровни лишь ускоряют поиск
+	for (unsigned level = 0; level < height; ++level)
+		preds[level][level].store(node, std::memory_order_release);
+	if (height > _height.load(std::memory_order_relaxed))
+		_height.store(height, std::memory_order_release);
+	_size.fetch_add(1, std::memory_order_relaxed);
+	return true;
+}
+
+template<typename Key, typename Compare>
+bool ConcurrentSet<Key, Compare>::erase(const Key& key)
+{
+	std::lock_guard<std::mutex> lock(_write_mutex);
+	Links preds[max_height];
+	Node* node = search(key, preds);
+	if (!node || _comp(key, node->key))
+		return false;
+
+	// Сверху вниз: отцепление на нулевом уровне последним — момент удаления
+	for (unsigned level = node->height; level-- > 0; )
+		preds[level][level].store(node->next()[level].load(std::memory_order_relaxed), std::memory_order_release);
+	_size.fetch_sub(1, std::memory_order_relaxed);
+	_retired.retire(node);
+	return true;
+}
+
+template<typename Key, typename Compare>
+void ConcurrentSet<Key, Compare>::clear()
+{
+	std::lock_guard<std::mutex> lock(_write_mutex);
+	Node* node = _head[0].load(std::memory_order_relaxed);
+	for (auto& link : _head)
+		link.store(nullptr, std::memory_order_release);
+	_size.store(0, std::memory_order_relaxed);
+	while (node)
+	{
+		Node* next = node->next()[0].load(std::memory_order_relaxed);
+		_retired.retire(node);
+		node = next;
+	}
+}
+
+template<typename Key, typename Compare>
+template<typename Visitor>
+void ConcurrentSet<Key, Compare>::for_each(Visitor&& visit) const
+{
+	epoch::Guard guard;
+	for (Node* node = _head[0].load(std::memory_order_acquire); node; node = node->next()[0].load(std::memory_order_acquire))
+		visit(static_cast<const Key&>(node->key));
+}
+
+template<typename Key, typename Compare>
+typename ConcurrentSet<Key, Compare>::size_type ConcurrentSet<Key, Compare>::pending_reclamation() const
+{
+	std::lock_guard<std::mutex> lock(_write_mutex);
+	return _retired.pending();
+}
+
+template<typename Key, typename Compare>
+template<typename K>
+typename ConcurrentSet<Key, Compare>::Node* ConcurrentSet<Key, Compare>::create_node(K&& key, unsigned height)
+{
+	void* memory = ::operator new(sizeof(Node) + height * sizeof(std::atomic<Node*>), std::align_val_t(alignof(Node)));
+	Node* node;
+	try
+	{
+		node = ::new (memory) Node(std::forward<K>(key), height);
+	}
+	catch (...)
+	{
+		::operator delete(memory, std::align_val_t(alignof(Node)));
+		throw;
+	}
+	for (unsigned level = 0; level < height; ++level)
+		::new (static_cast<void*>(node->next() + level)) std::atomic<Node*>(nullptr);
+	return node;
+}
+
+template<typename Key, typename Compare>
+void ConcurrentSet<Key, Compare>::destroy_node(Node* node)
+{
+	node->~Node();
+	::operator delete(static_cast<void*>(node), std::align_val_t(alignof(Node)));
+}
+
+template<typename Key, typename Compare>
+inline unsigned ConcurrentSet<Key, Compare>::random_height()
+{
+	// xorshift под мьютексом писателя; каждый следующий уровень — с вероятностью 1/4
+	_random_state ^= _random_state << 13;
+	_random_state ^= _random_state >> 7;
+	_random_state ^= _random_state << 17;
+	unsigned height = 1 + static_cast<unsigned>(std::countr_zero(_random_state | (std::uint64_t(1) << 62))) / 2;
+	return std::min(height, max_height);
+}
+
+template<typename Key, typename Compare>
+typename ConcurrentSet<Key, Compare>::Node* ConcurrentSet<Key, Compare>::search(const Key& key, bool strict) const
+{
+	Links links = const_cast<Links>(_head);
+	Node* next = nullptr;
+	for (unsigned level = _height.load(std::memory_order_acquire); level-- > 0; )
+	{
+		next = links[level].load(std::memory_order_acquire);
+		while (next && (strict ? !_comp(key, next->key) : _comp(next->key, key)))
+		{
+			links = next->next();
+			next = links[level].load(std::memory_order_acquire);
+		}
+	}
+	return next;
+}
+
+template<typename Key, typename Compare>
+typename ConcurrentSet<Key, Compare>::Node* ConcurrentSet<Key, Compare>::search(const Key& key, Links* preds) const
+{
+	Links links = const_cast<Links>(_head);
+	Node* next = nullptr;
+	for (unsigned level = max_height; level-- > 0; )
+	{
+		next = links[level].load(std::memory_order_relaxed);
+		while (next && _comp(next->key, key))
+		{
+			links = next->next();
+			next = links[level].load(std::memory_order_relaxed);
+		}
+		preds[level] = links;
+	}
+	return next;
+}
@@ -0,0 +1,189 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <utility>
+#include <vector>
+
+// Освобождение памяти по эпохам для структур с неблокирующим чтением.
+// Читатель входит в критическую секцию (Guard) и объявляет текущую глобальную эпоху; писатель,
+// отцепив узел, откладывает его с эпохой момента удаления. Эпоха растёт, только когда все активные
+// читатели её догнали, поэтому узел, отложенный в эпоху e, недостижим ни для одного читателя,
+// как только глобальная эпоха дошла до e + 2.
+// Домен один на процесс: записи потоков не удаляются, а переиспользуются после выхода потока
+namespace epoch
+{
+	class Domain
+	{
+	public:
+		struct Record
+		{
+			// (эпоха << 1) | 1 у читателя внутри секции, 0 — вне её
+			std::atomic<std::uint64_t> state{ 0 };
+			std::atomic<bool> in_use{ false };
+			Record* next = nullptr;
+			// Глубина вложенных Guard; трогает только владеющий поток
+			unsigned depth = 0;
+		};
+
+		static Domain& instance()
+		{
+			// Намеренно не разрушается: потоки могут завершаться после статических деструкторов
+			static Domain* const domain = new Domain();
+			return *domain;
+		}
+
+		std::uint64_t current() const
+		{
+			return _epoch.load(std::memory_order_acquire);
+		}
+
+		// Продвигает эпоху, если все читатели внутри секций её уже видели; возвращает текущую
+		std::uint64_t try_advance()
+		{
+			std::atomic_thread_fence(std::memory_order_seq_cst);
+			std::uint64_t epoch = _epoch.load(std::memory_order_acquire);
+			for (Record* record = _records.load(std::memory_order_acquire); record; record = record->next)
+			{
+				std::uint64_t state = record->state.load(std::memory_order_acquire);
+				if ((state & 1) && (state >> 1) != epoch)
+					return epoch;
+			}
+			_epoch.compare_exchange_strong(epoch, epoch + 1, std::memory_order_acq_rel);
+			return _epoch.load(std::memory_order_acquire);
+		}
+
+		// Запись текущего потока; регистрируется при первом обращении без блокировок
+		Record& local()
+		{
+			thread_local Registration registration(*this);
+			return *registration.record;
+		}
+
+	private:
+		struct Registration
+		{
+			Record* record;
+
+			explicit Registration(Domain& domain)
+				: record(domain.acquire())
+			{
+			}
+
+			~Registration()
+			{
+				record->state.store(0, std::memory_order_release);
+				record->in_use.store(false, std::memory_order_release);
+			}
+		};
+
+		Domain() = default;
+
+		Record* acquire()
+		{
+			for (Record* record = _records.load(std::memory_order_acquire); record; record = record->next)
+			{
+				bool expected = false;
+				if (!record->in_use.load(std::memory_order_relaxed)
+					&& record->in_use.compare_exchange_strong(expected, true, std::memory_order_acq_rel))
+					return record;
+			}
+
+			Record* record = new Record();
+			record->in_use.store(true, std::memory_order_relaxed);
+			Record* head = _records.load(std::memory_order_relaxed);
+			do
+				record->next = head;
+			while (!_records.compare_exchange_weak(head, record, std::memory_order_release, std::memory_order_relaxed));
+			return record;
+		}
+
+		std::atomic<std::uint64_t> _epoch{ 1 };
+		std::atomic<Record*> _records{ nullptr };
+	};
+
+	// Критическая секция читателя: пока жив Guard, отложенные после входа узлы не освобождаются.
+	// Вложенные Guard одного потока допустимы
+	class Guard
+	{
+	public:
+		Guard()
+			: _record(Domain::instance().local())
+		{
+			if (_record.depth++ == 0)
+			{
+				_record.state.store((Domain::instance().current() << 1) | 1, std::memory_order_relaxed);
+				std::atomic_thread_fence(std::memory_order_seq_cst);
+			}
+		}
+
+		~Guard()
+		{
+			if (--_record.depth == 0)
+				_record.state.store(0, std::memory_order_release);
+		}
+
+		Guard(const Guard&) = delete;
+		Guard& operator=(const Guard&) = delete;
+
+	private:
+		Domain::Record& _record;
+	};
+
+	// Отложенные на освобождение объекты одного владельца. Не потокобезопасен: им пользуются писатели,
+	// уже упорядоченные между собой. Deleter вызывается для объекта, когда его не может видеть ни один читатель
+	template<typename T, typename Deleter>
+	class RetireList
+	{
+	public:
+		explicit RetireList(Deleter deleter = Deleter())
+			: _deleter(std::move(deleter))
+		{
+		}
+
+		RetireList(const RetireList&) = delete;
+		RetireList& operator=(const RetireList&) = delete;
+
+		// Владелец разрушается без конкурентных читателей — всё освобождается сразу
+		~RetireList()
+		{
+			for (auto& entry : _entries)
+				_deleter(entry.second);
+		}
+
+		void retire(T* object)
+		{
+			_entries.emplace_back(Domain::instance().current(), object);
+			if (_entries.size() >= _next_collect)
+				collect();
+		}
+
+		// Освобождает всё, что отложено не позже двух эпох назад
+		void collect()
+		{
+			std::uint64_t epoch = Domain::instance().try_advance();
+			std::size_t kept = 0;
+			for (auto& entry : _entries)
+			{
+				if (entry.first + 2 <= epoch)
+					_deleter(entry.second);
+				else
+					_entries[kept++] = entry;
+			}
+			_entries.resize(kept);
+			// Следующая попытка — когда список вырастет вдвое: сборка амортизированно O(1) на объект
+			_next_collect = std::max<std::size_t>(64, 2 * kept);
+		}
+
+		std::size_t pending() const
+		{
+			return _entries.size();
+		}
+
+	private:
+		std::vector<std::pair<std::uint64_t, T*>> _entries;
+		std::size_t _next_collect = 64;
+		Deleter _deleter;
+	};
+}
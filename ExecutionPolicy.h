@@ -0,0 +1,31 @@
+#pragma once
+
+#include <execution>
+#include <type_traits>
+
+#include "ThreadPool.h"
+
+// Политики из <execution> как исполнители параллельных операций Set. Алгоритмы std::execution::par
+// в libstdc++ требуют TBB при компоновке, поэтому политики служат только признаком и выполняются на
+// ThreadPool: std::execution::seq и unseq — в вызывающем потоке, остальные — на ThreadPool::shared().
+// Заголовок подключается отдельно: уже <execution> с установленным oneTBB требует компоновки с TBB
+// (в CMake — цель set::execution)
+namespace parallel
+{
+	template<typename E>
+		requires std::is_execution_policy_v<E>
+	struct executor_traits<E>
+	{
+		static ThreadPool* pool(const E&)
+		{
+			if constexpr (std::is_same_v<E, std::execution::sequenced_policy>)
+				return nullptr;
+#if defined(__cpp_lib_execution) && __cpp_lib_execution >= 201902L
+			else if constexpr (std::is_same_v<E, std::execution::unsequenced_policy>)
+				return nullptr;
+#endif
+			else
+				return &ThreadPool::shared();
+		}
+	};
+}
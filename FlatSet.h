@@ -0,0 +1,516 @@
+#pragma once
+
+#include <algorithm>
+#include <functional>
+#include <initializer_list>
+#include <iterator>
+#include <memory>
+#include <span>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+#include "Set.h"
+#include "SimdSearch.h"
+
+// Множество на отсортированном массиве для сценария «собрали один раз — много раз ищем».
+// Интерфейс поиска и обхода совпадает с Set, элементы так же пары с ключом в first.
+// Одиночная вставка и удаление — O(n), пакетная вставка сортирует новые ключи и сливает их с массивом.
+// Вставка и удаление делают итераторы недействительными
+template<typename Key, typename Compare = std::less<Key>, typename Allocator = std::allocator<Key>>
+class FlatSet
+{
+private:
+	using Element = KeyValuePair<Key, EmptyStruct>;
+	using Storage = std::vector<Element, typename std::allocator_traits<Allocator>::template rebind_alloc<Element>>;
+
+	Storage _data;
+	Compare _comp;
+
+	struct ElementLess
+	{
+		const Compare& comp;
+
+		bool operator()(const Element& lhs, const Element& rhs) const { return comp(lhs.first, rhs.first); }
+		bool operator()(const Element& lhs, const Key& rhs) const { return comp(lhs.first, rhs); }
+		bool operator()(const Key& lhs, const Element& rhs) const { return comp(lhs, rhs.first); }
+	};
+
+	ElementLess less() const;
+	bool equivalent(const Key& lhs, const Key& rhs) const;
+
+public:
+	using key_type = Key;
+	using value_type = Key;
+	using size_type = std::size_t;
+	using difference_type = std::ptrdiff_t;
+	using key_compare = Compare;
+	using value_compare = Compare;
+	using allocator_type = Allocator;
+
+	// Ключи неизменяемы: обычный и константный итераторы совпадают
+	using iterator = typename Storage::const_iterator;
+	using const_iterator = typename Storage::const_iterator;
+	using reverse_iterator = typename Storage::const_reverse_iterator;
+	using const_reverse_iterator = typename Storage::const_reverse_iterator;
+
+
+	FlatSet();
+	explicit FlatSet(const Compare& comp, const Allocator& alloc = Allocator());
+	explicit FlatSet(const Allocator& alloc);
+	FlatSet(std::initializer_list<Key> init);
+
+	template<typename InputIt>
+	FlatSet(InputIt first, InputIt last);
+
+	// Диапазон уже упорядочен по Compare и не содержит повторов: ключи просто копируются
+	template<typename InputIt>
+	FlatSet(sorted_unique_t, InputIt first, InputIt last, const Compare& comp = Compare());
+
+	// «Заморозка» Set после фазы загрузки: обход Set уже упорядочен, поэтому O(n)
+	template<typename A, typename B>
+	explicit FlatSet(const Set<Key, Compare, A, B>& set);
+
+	// Обратное преобразование за O(n): дерево строится из упорядоченного массива
+	template<typename SetType = Set<Key, Compare>>
+	SetType to_set() const;
+
+	allocator_type get_allocator() const;
+	key_compare key_comp() const;
+
+	const_iterator begin() const noexcept;
+	const_iterator end() const noexcept;
+	const_iterator cbegin() const noexcept;
+	const_iterator cend() const noexcept;
+
+	const_reverse_iterator rbegin() const noexcept;
+	const_reverse_iterator rend() const noexcept;
+	const_reverse_iterator crbegin() const noexcept;
+	const_reverse_iterator crend() const noexcept;
+
+	bool empty() const noexcept;
+	size_type size() const noexcept;
+	size_type capacity() const noexcept;
+	void reserve(size_type n);
+	void shrink_to_fit();
+	void clear() noexcept;
+
+	std::pair<iterator, bool> insert(const Key& key);
+	std::pair<iterator, bool> insert(Key&& key);
+	iterator insert(const_iterator hint, const Key& key);
+	iterator insert(const_iterator hint, Key&& key);
+
+	// Пакетная вставка: новые ключи дописываются в конец, сортируются и сливаются с массивом за O(n + k log k)
+	template<typename InputIt>
+	void insert(InputIt first, InputIt last);
+	void insert(std::initializer_list<Key> init);
+
+	template<typename... Args>
+	std::pair<iterator, bool> emplace(Args&&... args);
+	template<typename... Args>
+	iterator emplace_hint(const_iterator hint, Args&&... args);
+
+	size_type erase(const Key& key);
+	iterator erase(const_iterator pos);
+	iterator erase(const_iterator first, const_iterator last);
+
+	const_iterator find(const Key& key) const;
+	bool contains(const Key& key) const;
+	size_type count(const Key& key) const;
+	// result[i] = contains(keys[i]); result не короче keys
+	void contains_many(std::span<const Key> keys, std::span<bool> result) const;
+
+	const_iterator lower_bound(const Key& key) const;
+	const_iterator upper_bound(const Key& key) const;
+	std::pair<const_iterator, const_iterator> equal_range(const Key& key) const;
+
+	template<typename K, typename C, typename A>
+	friend bool operator==(const FlatSet<K, C, A>& lhs, const FlatSet<K, C, A>& rhs);
+
+	template<typename K, typename C, typename A>
+	friend bool operator!=(const FlatSet<K, C, A>& lhs, const FlatSet<K, C, A>& rhs);
+
+	template<typename K, typename C, typename A>
+	friend void swap(FlatSet<K, C, A>& lhs, FlatSet<K, C, A>& rhs) noexcept;
+
+private:
+	template<typename K>
+	std::pair<iterator, bool> insert_unique(K&& key);
+	template<typename K>
+	iterator insert_hint(const_iterator hint, K&& key);
+};
+
+template<typename Key, typename Compare, typename Allocator>
+inline typename FlatSet<Key, Compare, Allocator>::ElementLess FlatSet<Key, Compare, Allocator>::less() const
+{
+	return ElementLess{ _comp };
+}
+
+template<typename Key, typename Compare, typename Allocator>
+inline bool FlatSet<Key, Compare, Allocator>::equivalent(const Key& lhs, const Key& rhs) const
+{
+	return !_comp(lhs, rhs) && !_comp(rhs, lhs);
+}
+
+template<typename Key, typename Compare, typename Allocator>
+inline FlatSet<Key, Compare, Allocator>::FlatSet()
+	: FlatSet(Compare())
+{
+}
+
+template<typename Key, typename Compare, typename Allocator>
+inline FlatSet<Key, Compare, Allocator>::FlatSet(const Compare& comp, const Allocator& alloc)
+	: _data(typename Storage::allocator_type(alloc))
+	, _comp(comp)
+{
+}
+
+template<typename Key, typename Compare, typename Allocator>
+inline FlatSet<Key, Compare, Allocator>::FlatSet(const Allocator& alloc)
+	: FlatSet(Compare(), alloc)
+{
+}
+
+template<typename Key, typename Compare, typename Allocator>
+inline FlatSet<Key, Compare, Allocator>::FlatSet(std::initializer_list<Key> init)
+	: FlatSet()
+{
+	insert(init.begin(), init.end());
+}
+
+template<typename Key, typename Compare, typename Allocator>
+template<typename InputIt>
+inline FlatSet<Key, Compare, Allocator>::FlatSet(InputIt first, InputIt last)
+	: FlatSet()
+{
+	insert(first, last);
+}
+
+template<typename Key, typename Compare, typename Allocator>
+template<typename InputIt>
+inline FlatSet<Key, Compare, Allocator>::FlatSet(sorted_unique_t, InputIt first, InputIt last, const Compare& comp)
+	: FlatSet(comp)
+{
+	using category = typename std::iterator_traits<InputIt>::iterator_category;
+	if constexpr (std::is_base_of<std::forward_iterator_tag, category>::value)
+		_data.reserve(static_cast<size_type>(std::distance(first, last)));
+	for (; first != last; ++first)
+		_data.emplace_back(element_key<Key>(*first), EmptyStruct{});
+}
+
+template<typename Key, typename Compare, typename Allocator>
+template<typename A, typename B>
+inline FlatSet<Key, Compare, Allocator>::FlatSet(const Set<Key, Compare, A, B>& set)
+	: FlatSet(sorted_unique, set.begin(), set.end(), set.key_comp())
+{
+}
+
+template<typename Key, typename Compare, typename Allocator>
+template<typename SetType>
+inline SetType FlatSet<Key, Compare, Allocator>::to_set() const
+{
+	return SetType(sorted_unique, begin(), end(), _comp);
+}
+
+template<typename Key, typename Compare, typename Allocator>
+inline typename FlatSet<Key, Compare, Allocator>::allocator_type FlatSet<Key, Compare, Allocator>::get_allocator() const
+{
+	return allocator_type(_data.get_allocator());
+}
+
+template<typename Key, typename Compare, typename Allocator>
+inline typename FlatSet<Key, Compare, Allocator>::key_compare FlatSet<Key, Compare, Allocator>::key_comp() const
+{
+	return _comp;
+}
+
+template<typename Key, typename Compare, typename Allocator>
+inline typename FlatSet<Key, Compare, Allocator>::const_iterator FlatSet<Key, Compare, Allocator>::begin() const noexcept
+{
+	return _data.cbegin();
+}
+
+template<typename Key, typename Compare, typename Allocator>
+inline typename FlatSet<Key, Compare, Allocator>::const_iterator FlatSet<Key, Compare, Allocator>::end() const noexcept
+{
+	return _data.cend();
+}
+
+template<typename Key, typename Compare, typename Allocator>
+inline typename FlatSet<Key, Compare, Allocator>::const_iterator FlatSet<Key, Compare, Allocator>::cbegin() const noexcept
+{
+	return _data.cbegin();
+}
+
+template<typename Key, typename Compare, typename Allocator>
+inline typename FlatSet<Key, Compare, Allocator>::const_iterator FlatSet<Key, Compare, Allocator>::cend() const noexcept
+{
+	return _data.cend();
+}
+
+template<typename Key, typename Compare, typename Allocator>
+inline typename FlatSet<Key, Compare, Allocator>::const_reverse_iterator FlatSet<Key, Compare, Allocator>::rbegin() const noexcept
+{
+	return _data.crbegin();
+}
+
+template<typename Key, typename Compare, typename Allocator>
+inline typename FlatSet<Key, Compare, Allocator>::const_reverse_iterator FlatSet<Key, Compare, Allocator>::rend() const noexcept
+{
+	return _data.crend();
+}
+
+template<typename Key, typename Compare, typename Allocator>
+inline typename FlatSet<Key, Compare, Allocator>::const_reverse_iterator FlatSet<Key, Compare, Allocator>::crbegin() const noexcept
+{
+	return _data.crbegin();
+}
+
+template<typename Key, typename Compare, typename Allocator>
+inline typename FlatSet<Key, Compare, Allocator>::const_reverse_iterator FlatSet<Key, Compare, Allocator>::crend() const noexcept
+{
+	return _data.crend();
+}
+
+template<typename Key, typename Compare, typename Allocator>
+inline bool FlatSet<Key, Compare, Allocator>::empty() const noexcept
+{
+	return _data.empty();
+}
+
+template<typename Key, typename Compare, typename Allocator>
+inline typename FlatSet<Key, Compare, Allocator>::size_type FlatSet<Key, Compare, Allocator>::size() const noexcept
+{
+	return _data.size();
+}
+
+template<typename Key, typename Compare, typename Allocator>
+inline typename FlatSet<Key, Compare, Allocator>::size_type FlatSet<Key, Compare, Allocator>::capacity() const noexcept
+{
+	return _data.capacity();
+}
+
+template<typename Key, typename Compare, typename Allocator>
+inline void FlatSet<Key, Compare, Allocator>::reserve(size_type n)
+{
+	_data.reserve(n);
+}
+
+template<typename Key, typename Compare, typename Allocator>
+inline void FlatSet<Key, Compare, Allocator>::shrink_to_fit()
+{
+	_data.shrink_to_fit();
+}
+
+template<typename Key, typename Compare, typename Allocator>
+inline void FlatSet<Key, Compare, Allocator>::clear() noexcept
+{
+	_data.clear();
+}
+
+template<typename Key, typename Compare, typename Allocator>
+inline std::pair<typename FlatSet<Key, Compare, Allocator>::iterator, bool> FlatSet<Key, Compare, Allocator>::insert(const Key& key)
+{
+	return insert_unique(key);
+}
+
+template<typename Key, typename Compare, typename Allocator>
+inline std::pair<typename FlatSet<Key, Compare, Allocator>::iterator, bool> FlatSet<Key, Compare, Allocator>::insert(Key&& key)
+{
+	return insert_unique(std::move(key));
+}
+
+template<typename Key, typename Compare, typename Allocator>
+inline typename FlatSet<Key, Compare, Allocator>::iterator FlatSet<Key, Compare, Allocator>::insert(const_iterator hint, const Key& key)
+{
+	return insert_hint(hint, key);
+}
+
+template<typename Key, typename Compare, typename Allocator>
+inline typename FlatSet<Key, Compare, Allocator>::iterator FlatSet<Key, Compare, Allocator>::insert(const_iterator hint, Key&& key)
+{
+	return insert_hint(hint, std::move(key));
+}
+
+template<typename Key, typename Compare, typename Allocator>
+template<typename InputIt>
+inline void FlatSet<Key, Compare, Allocator>::insert(InputIt first, InputIt last)
+{
+	// Новые элементы дописываются в хвост и сортируются там; если копирование или компаратор бросят,
+	// хвост отрезается и массив остаётся прежним
+	size_type old_size = _data.size();
+	try
+	{
+		for (; first != last; ++first)
+			_data.emplace_back(element_key<Key>(*first), EmptyStruct{});
+		std::stable_sort(_data.begin() + static_cast<difference_type>(old_size), _data.end(), less());
+	}
+	catch (...)
+	{
+		_data.erase(_data.begin() + static_cast<difference_type>(old_size), _data.end());
+		throw;
+	}
+
+	// Слияние переставляет и старые элементы: исключение посреди него оставляет массив неупорядоченным,
+	// и тогда он очищается
+	try
+	{
+		// При равных ключах слияние устойчиво: уже лежащий в массиве элемент идёт первым и остаётся
+		std::inplace_merge(_data.begin(), _data.begin() + static_cast<difference_type>(old_size), _data.end(), less());
+		_data.erase(std::unique(_data.begin(), _data.end(),
+			[this](const Element& lhs, const Element& rhs) { return equivalent(lhs.first, rhs.first); }), _data.end());
+	}
+	catch (...)
+	{
+		_data.clear();
+		throw;
+	}
+}
+
+template<typename Key, typename Compare, typename Allocator>
+inline void FlatSet<Key, Compare, Allocator>::insert(std::initializer_list<Key> init)
+{
+	insert(init.begin(), init.end());
+}
+
+template<typename Key, typename Compare, typename Allocator>
+template<typename... Args>
+inline std::pair<typename FlatSet<Key, Compare, Allocator>::iterator, bool> FlatSet<Key, Compare, Allocator>::emplace(Args&&... args)
+{
+	return insert_unique(Key(std::forward<Args>(args)...));
+}
+
+template<typename Key, typename Compare, typename Allocator>
+template<typename... Args>
+inline typename FlatSet<Key, Compare, Allocator>::iterator FlatSet<Key, Compare, Allocator>::emplace_hint(const_iterator hint, Args&&... args)
+{
+	return insert_hint(hint, Key(std::forward<Args>(args)...));
+}
+
+template<typename Key, typename Compare, typename Allocator>
+inline typename FlatSet<Key, Compare, Allocator>::size_type FlatSet<Key, Compare, Allocator>::erase(const Key& key)
+{
+	const_iterator it = find(key);
+	if (it == end())
+		return 0;
+	_data.erase(it);
+	return 1;
+}
+
+template<typename Key, typename Compare, typename Allocator>
+inline typename FlatSet<Key, Compare, Allocator>::iterator FlatSet<Key, Compare, Allocator>::erase(const_iterator pos)
+{
+	return _data.erase(pos);
+}
+
+template<typename Key, typename Compare, typename Allocator>
+inline typename FlatSet<Key, Compare, Allocator>::iterator FlatSet<Key, Compare, Allocator>::erase(const_iterator first, const_iterator last)
+{
+	return _data.erase(first, last);
+}
+
+template<typename Key, typename Compare, typename Allocator>
+inline typename FlatSet<Key, Compare, Allocator>::const_iterator FlatSet<Key, Compare, Allocator>::find(const Key& key) const
+{
+	const_iterator it = lower_bound(key);
+	return (it == end() || _comp(key, it->first)) ? end() : it;
+}
+
+template<typename Key, typename Compare, typename Allocator>
+inline bool FlatSet<Key, Compare, Allocator>::contains(const Key& key) const
+{
+	return find(key) != end();
+}
+
+template<typename Key, typename Compare, typename Allocator>
+inline typename FlatSet<Key, Compare, Allocator>::size_type FlatSet<Key, Compare, Allocator>::count(const Key& key) const
+{
+	return contains(key) ? 1 : 0;
+}
+
+template<typename Key, typename Compare, typename Allocator>
+inline void FlatSet<Key, Compare, Allocator>::contains_many(std::span<const Key> keys, std::span<bool> result) const
+{
+	for (std::size_t i = 0; i < keys.size(); ++i)
+		result[i] = contains(keys[i]);
+}
+
+template<typename Key, typename Compare, typename Allocator>
+inline typename FlatSet<Key, Compare, Allocator>::const_iterator FlatSet<Key, Compare, Allocator>::lower_bound(const Key& key) const
+{
+	if constexpr (simd_search::enabled<Key, Compare> && sizeof(Element) == sizeof(Key))
+	{
+		if (_data.empty())
+			return end();
+		return begin() + simd_search::lower_bound(&_data.front().first, _data.size(), key, _comp);
+	}
+	else
+	{
+		return std::lower_bound(_data.begin(), _data.end(), key, less());
+	}
+}
+
+template<typename Key, typename Compare, typename Allocator>
+inline typename FlatSet<Key, Compare, Allocator>::const_iterator FlatSet<Key, Compare, Allocator>::upper_bound(const Key& key) const
+{
+	if constexpr (simd_search::enabled<Key, Compare> && sizeof(Element) == sizeof(Key))
+	{
+		if (_data.empty())
+			return end();
+		return begin() + simd_search::upper_bound(&_data.front().first, _data.size(), key, _comp);
+	}
+	else
+	{
+		return std::upper_bound(_data.begin(), _data.end(), key, less());
+	}
+}
+
+template<typename Key, typename Compare, typename Allocator>
+inline std::pair<typename FlatSet<Key, Compare, Allocator>::const_iterator, typename FlatSet<Key, Compare, Allocator>::const_iterator>
+		FlatSet<Key, Compare, Allocator>::equal_range(const Key& key) const
+{
+	const_iterator first = lower_bound(key);
+	const_iterator last = (first != end() && !_comp(key, first->first)) ? std::next(first) : first;
+	return { first, last };
+}
+
+template<typename Key, typename Compare, typename Allocator>
+template<typename K>
+inline std::pair<typename FlatSet<Key, Compare, Allocator>::iterator, bool> FlatSet<Key, Compare, Allocator>::insert_unique(K&& key)
+{
+	const_iterator it = lower_bound(key);
+	if (it != end() && !_comp(key, it->first))
+		return { it, false };
+	return { _data.emplace(it, std::forward<K>(key), EmptyStruct{}), true };
+}
+
+template<typename Key, typename Compare, typename Allocator>
+template<typename K>
+inline typename FlatSet<Key, Compare, Allocator>::iterator FlatSet<Key, Compare, Allocator>::insert_hint(const_iterator hint, K&& key)
+{
+	// Верная подсказка (ключ между соседями) избавляет от двоичного поиска — важно для дописывания в конец
+	bool after_prev = hint == begin() || _comp(std::prev(hint)->first, key);
+	bool before_next = hint == end() || _comp(key, hint->first);
+	if (after_prev && before_next)
+		return _data.emplace(hint, std::forward<K>(key), EmptyStruct{});
+	return insert_unique(std::forward<K>(key)).first;
+}
+
+template<typename K, typename C, typename A>
+inline bool operator==(const FlatSet<K, C, A>& lhs, const FlatSet<K, C, A>& rhs)
+{
+	return lhs._data == rhs._data;
+}
+
+template<typename K, typename C, typename A>
+inline bool operator!=(const FlatSet<K, C, A>& lhs, const FlatSet<K, C, A>& rhs)
+{
+	return !(lhs == rhs);
+}
+
+template<typename K, typename C, typename A>
+inline void swap(FlatSet<K, C, A>& lhs, FlatSet<K, C, A>& rhs) noexcept
+{
+	std::swap(lhs._data, rhs._data);
+	std::swap(lhs._comp, rhs._comp);
+}
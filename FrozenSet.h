@@ -0,0 +1,544 @@
+#pragma once
+
+#include <algorithm>
+#include <bit>
+#include <cstddef>
+#include <functional>
+#include <iterator>
+#include <new>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+#include "Set.h"
+
+#if defined(__GNUC__) || defined(__clang__)
+#define FROZENSET_PREFETCH(p) __builtin_prefetch(p)
+#elif defined(_MSC_VER) && (defined(_M_X64) || defined(_M_IX86))
+#include <xmmintrin.h>
+#define FROZENSET_PREFETCH(p) _mm_prefetch(reinterpret_cast<const char*>(p), _MM_HINT_T0)
+#else
+#define FROZENSET_PREFETCH(p) ((void)0)
+#endif
+
+// Неизменяемое множество в раскладке Эйтцингера: неявное двоичное дерево поиска в порядке обхода
+// в ширину, корень в ячейке 1, дети ячейки k — в 2k и 2k + 1. Поиск идёт без ветвлений,
+// а потомки на несколько уровней вперёд лежат в одной кэш-линии и подгружаются заранее.
+// Элементы — пары с ключом в first, как у Set; обход идёт в порядке возрастания
+template<typename Key, typename Compare = std::less<Key>>
+class FrozenSet
+{
+private:
+	using Element = KeyValuePair<Key, EmptyStruct>;
+
+	static constexpr std::size_t cache_line = 64;
+	static constexpr std::size_t alignment = std::max(cache_line, alignof(Element));
+
+	// Потомки ячейки k на d уровней ниже занимают ячейки [k·2^d, k·2^d + 2^d) — подряд.
+	// Шаг выбран так, чтобы эти 2^d элементов заполняли одну кэш-линию
+	static constexpr std::size_t prefetch_stride = std::max<std::size_t>(2, std::bit_floor(std::max<std::size_t>(1, cache_line / sizeof(Element))));
+
+public:
+	using key_type = Key;
+	using value_type = Key;
+	using size_type = std::size_t;
+	using difference_type = std::ptrdiff_t;
+	using key_compare = Compare;
+
+	class ConstIterator
+	{
+	private:
+		const Element* _data;
+		size_type _size;
+		size_type _index;
+
+		friend class FrozenSet;
+
+		ConstIterator(const Element* data, size_type size, size_type index);
+
+	public:
+		using iterator_category = std::bidirectional_iterator_tag;
+		using value_type = KeyValuePair<Key, EmptyStruct>;
+		using difference_type = std::ptrdiff_t;
+		using pointer = const value_type*;
+		using reference = const value_type&;
+
+		ConstIterator();
+
+		reference operator*() const;
+		pointer operator->() const;
+
+		ConstIterator& operator++();
+		ConstIterator operator++(int);
+		ConstIterator& operator--();
+		ConstIterator operator--(int);
+
+		bool operator==(const ConstIterator& other) const;
+		bool operator!=(const ConstIterator& other) const;
+	};
+
+	using iterator = ConstIterator;
+	using const_iterator = ConstIterator;
+	using reverse_iterator = std::reverse_iterator<const_iterator>;
+	using const_reverse_iterator = std::reverse_iterator<const_iterator>;
+
+
+	FrozenSet();
+	explicit FrozenSet(const Compare& comp);
+	FrozenSet(const FrozenSet& other);
+	FrozenSet(FrozenSet&& other) noexcept;
+	~FrozenSet();
+
+	// Диапазон уже упорядочен по Compare и не содержит повторов
+	template<typename InputIt>
+	FrozenSet(sorted_unique_t, InputIt first, InputIt last, const Compare& comp = Compare());
+
+	template<typename A, typename B>
+	explicit FrozenSet(const Set<Key, Compare, A, B>& set);
+
+	FrozenSet& operator=(const FrozenSet& other);
+	FrozenSet& operator=(FrozenSet&& other) noexcept;
+
+	key_compare key_comp() const;
+
+	const_iterator begin() const noexcept;
+	const_iterator end() const noexcept;
+	const_iterator cbegin() const noexcept;
+	const_iterator cend() const noexcept;
+	const_reverse_iterator rbegin() const noexcept;
+	const_reverse_iterator rend() const noexcept;
+
+	bool empty() const noexcept;
+	size_type size() const noexcept;
+
+	bool contains(const Key& key) const;
+	size_type count(const Key& key) const;
+	const_iterator find(const Key& key) const;
+
+	// Та же семантика, что у RedBlackTree::lower_bound/upper_bound: первый элемент не меньше (больше) key
+	const_iterator lower_bound(const Key& key) const;
+	const_iterator upper_bound(const Key& key) const;
+	std::pair<const_iterator, const_iterator> equal_range(const Key& key) const;
+
+	template<typename K, typename C>
+	friend bool operator==(const FrozenSet<K, C>& lhs, const FrozenSet<K, C>& rhs);
+
+	template<typename K, typename C>
+	friend bool operator!=(const FrozenSet<K, C>& lhs, const FrozenSet<K, C>& rhs);
+
+	template<typename K, typename C>
+	friend void swap(FrozenSet<K, C>& lhs, FrozenSet<K, C>& rhs) noexcept;
+
+private:
+	Element* _data;
+	size_type _size;
+	Compare _comp;
+
+	// Ячейка 0 не используется: с индексацией от единицы дети и переход к ответу считаются сдвигами
+	static Element* allocate(size_type n);
+	static void deallocate(Element* data, size_type constructed_until, size_type n) noexcept;
+
+	static size_type first_index(size_type n);
+	static size_type last_index(size_type n);
+	static size_type next_index(size_type k, size_type n);
+	static size_type prev_index(size_type k, size_type n);
+
+	template<typename FwdIt>
+	void build(FwdIt first, size_type n);
+
+	void release() noexcept;
+};
+
+template<typename Key, typename Compare>
+inline FrozenSet<Key, Compare>::ConstIterator::ConstIterator()
+	: _data(nullptr)
+	, _size(0)
+	, _index(0)
+{
+}
+
+template<typename Key, typename Compare>
+inline FrozenSet<Key, Compare>::ConstIterator::ConstIterator(const Element* data, size_type size, size_type index)
+	: _data(data)
+	, _size(size)
+	, _index(index)
+{
+}
+
+template<typename Key, typename Compare>
+inline typename FrozenSet<Key, Compare>::ConstIterator::reference FrozenSet<Key, Compare>::ConstIterator::operator*() const
+{
+	return _data[_index];
+}
+
+template<typename Key, typename Compare>
+inline typename FrozenSet<Key, Compare>::ConstIterator::pointer FrozenSet<Key, Compare>::ConstIterator::operator->() const
+{
+	return &_data[_index];
+}
+
+template<typename Key, typename Compare>
+inline typename FrozenSet<Key, Compare>::ConstIterator& FrozenSet<Key, Compare>::ConstIterator::operator++()
+{
+	_index = next_index(_index, _size);
+	return *this;
+}
+
+template<typename Key, typename Compare>
+inline typename FrozenSet<Key, Compare>::ConstIterator FrozenSet<Key, Compare>::ConstIterator::operator++(int)
+{
+	ConstIterator temp = *this;
+	++*this;
+	return temp;
+}
+
+template<typename Key, typename Compare>
+inline typename FrozenSet<Key, Compare>::ConstIterator& FrozenSet<Key, Compare>::ConstIterator::operator--()
+{
+	_index = (_index == 0) ? last_index(_size) : prev_index(_index, _size);
+	return *this;
+}
+
+template<typename Key, typename Compare>
+inline typename FrozenSet<Key, Compare>::ConstIterator FrozenSet<Key, Compare>::ConstIterator::operator--(int)
+{
+	ConstIterator temp = *this;
+	--*this;
+	return temp;
+}
+
+template<typename Key, typename Compare>
+inline bool FrozenSet<Key, Compare>::ConstIterator::operator==(const ConstIterator& other) const
+{
+	return _data == other._data && _index == other._index;
+}
+
+template<typename Key, typename Compare>
+inline bool FrozenSet<Key, Compare>::ConstIterator::operator!=(const ConstIterator& other) const
+{
+	return !(*this == other);
+}
+
+
+template<typename Key, typename Compare>
+inline FrozenSet<Key, Compare>::FrozenSet()
+	: FrozenSet(Compare())
+{
+}
+
+template<typename Key, typename Compare>
+inline FrozenSet<Key, Compare>::FrozenSet(const Compare& comp)
+	: _data(nullptr)
+	, _size(0)
+	, _comp(comp)
+{
+}
+
+template<typename Key, typename Compare>
+inline FrozenSet<Key, Compare>::FrozenSet(const FrozenSet& other)
+	: FrozenSet(other._comp)
+{
+	build(other.begin(), other._size);
+}
+
+template<typename Key, typename Compare>
+inline FrozenSet<Key, Compare>::FrozenSet(FrozenSet&& other) noexcept
+	: _data(std::exchange(other._data, nullptr))
+	, _size(std::exchange(other._size, 0))
+	, _comp(other._comp)
+{
+}
+
+template<typename Key, typename Compare>
+inline FrozenSet<Key, Compare>::~FrozenSet()
+{
+	release();
+}
+
+template<typename Key, typename Compare>
+template<typename InputIt>
+inline FrozenSet<Key, Compare>::FrozenSet(sorted_unique_t, InputIt first, InputIt last, const Compare& comp)
+	: FrozenSet(comp)
+{
+	using category = typename std::iterator_traits<InputIt>::iterator_category;
+	if constexpr (std::is_base_of<std::forward_iterator_tag, category>::value)
+	{
+		build(first, static_cast<size_type>(std::distance(first, last)));
+	}
+	else
+	{
+		// Раскладке нужен размер заранее: однопроходный диапазон сначала копируется
+		std::vector<Key> keys;
+		for (; first != last; ++first)
+			keys.push_back(element_key<Key>(*first));
+		build(keys.begin(), keys.size());
+	}
+}
+
+template<typename Key, typename Compare>
+template<typename A, typename B>
+inline FrozenSet<Key, Compare>::FrozenSet(const Set<Key, Compare, A, B>& set)
+	: FrozenSet(set.key_comp())
+{
+	build(set.begin(), set.size());
+}
+
+template<typename Key, typename Compare>
+inline FrozenSet<Key, Compare>& FrozenSet<Key, Compare>::operator=(const FrozenSet& other)
+{
+	if (this != &other)
+	{
+		FrozenSet copy(other);
+		swap(*this, copy);
+	}
+	return *this;
+}
+
+template<typename Key, typename Compare>
+inline FrozenSet<Key, Compare>& FrozenSet<Key, Compare>::operator=(FrozenSet&& other) noexcept
+{
+	if (this != &other)
+	{
+		release();
+		_data = std::exchange(other._data, nullptr);
+		_size = std::exchange(other._size, 0);
+		_comp = other._comp;
+	}
+	return *this;
+}
+
+template<typename Key, typename Compare>
+inline typename FrozenSet<Key, Compare>::key_compare FrozenSet<Key, Compare>::key_comp() const
+{
+	return _comp;
+}
+
+template<typename Key, typename Compare>
+inline typename FrozenSet<Key, Compare>::const_iterator FrozenSet<Key, Compare>::begin() const noexcept
+{
+	return const_iterator(_data, _size, first_index(_size));
+}
+
+template<typename Key, typename Compare>
+inline typename FrozenSet<Key, Compare>::const_iterator FrozenSet<Key, Compare>::end() const noexcept
+{
+	return const_iterator(_data, _size, 0);
+}
+
+template<typename Key, typename Compare>
+inline typename FrozenSet<Key, Compare>::const_iterator FrozenSet<Key, Compare>::cbegin() const noexcept
+{
+	return begin();
+}
+
+template<typename Key, typename Compare>
+inline typename FrozenSet<Key, Compare>::const_iterator FrozenSet<Key, Compare>::cend() const noexcept
+{
+	return end();
+}
+
+template<typename Key, typename Compare>
+inline typename FrozenSet<Key, Compare>::const_reverse_iterator FrozenSet<Key, Compare>::rbegin() const noexcept
+{
+	return const_reverse_iterator(end());
+}
+
+template<typename Key, typename Compare>
+inline typename FrozenSet<Key, Compare>::const_reverse_iterator FrozenSet<Key, Compare>::rend() const noexcept
+{
+	return const_reverse_iterator(begin());
+}
+
+template<typename Key, typename Compare>
+inline bool FrozenSet<Key, Compare>::empty() const noexcept
+{
+	return _size == 0;
+}
+
+template<typename Key, typename Compare>
+inline typename FrozenSet<Key, Compare>::size_type FrozenSet<Key, Compare>::size() const noexcept
+{
+	return _size;
+}
+
+template<typename Key, typename Compare>
+inline bool FrozenSet<Key, Compare>::contains(const Key& key) const
+{
+	return find(key) != end();
+}
+
+template<typename Key, typename Compare>
+inline typename FrozenSet<Key, Compare>::size_type FrozenSet<Key, Compare>::count(const Key& key) const
+{
+	return contains(key) ? 1 : 0;
+}
+
+template<typename Key, typename Compare>
+inline typename FrozenSet<Key, Compare>::const_iterator FrozenSet<Key, Compare>::find(const Key& key) const
+{
+	const_iterator it = lower_bound(key);
+	return (it == end() || _comp(key, it->first)) ? end() : it;
+}
+
+template<typename Key, typename Compare>
+inline typename FrozenSet<Key, Compare>::const_iterator FrozenSet<Key, Compare>::lower_bound(const Key& key) const
+{
+	// Спуск без ветвлений: направление — бит сравнения. После выхода за массив путь кодирует
+	// повороты, ответ — узел, где был последний поворот налево: снимаем хвост единиц и ещё один бит
+	size_type k = 1;
+	while (k <= _size)
+	{
+		FROZENSET_PREFETCH(_data + k * prefetch_stride);
+		k = 2 * k + static_cast<size_type>(_comp(_data[k].first, key));
+	}
+	k >>= std::countr_one(k) + 1;
+	return const_iterator(_data, _size, k);
+}
+
+template<typename Key, typename Compare>
+inline typename FrozenSet<Key, Compare>::const_iterator FrozenSet<Key, Compare>::upper_bound(const Key& key) const
+{
+	size_type k = 1;
+	while (k <= _size)
+	{
+		FROZENSET_PREFETCH(_data + k * prefetch_stride);
+		k = 2 * k + static_cast<size_type>(!_comp(key, _data[k].first));
+	}
+	k >>= std::countr_one(k) + 1;
+	return const_iterator(_data, _size, k);
+}
+
+template<typename Key, typename Compare>
+inline std::pair<typename FrozenSet<Key, Compare>::const_iterator, typename FrozenSet<Key, Compare>::const_iterator>
+			FrozenSet<Key, Compare>::equal_range(const Key& key) const
+{
+	const_iterator first = lower_bound(key);
+	const_iterator last = (first != end() && !_comp(key, first->first)) ? std::next(first) : first;
+	return { first, last };
+}
+
+template<typename Key, typename Compare>
+inline typename FrozenSet<Key, Compare>::Element* FrozenSet<Key, Compare>::allocate(size_type n)
+{
+	return static_cast<Element*>(::operator new((n + 1) * sizeof(Element), std::align_val_t(alignment)));
+}
+
+template<typename Key, typename Compare>
+inline void FrozenSet<Key, Compare>::deallocate(Element* data, size_type constructed_until, size_type n) noexcept
+{
+	// Построенные элементы — первые в порядке возрастания, до ячейки constructed_until (0 — все)
+	for (size_type k = first_index(n); k != constructed_until; k = next_index(k, n))
+		data[k].~Element();
+	::operator delete(data, std::align_val_t(alignment));
+}
+
+template<typename Key, typename Compare>
+inline typename FrozenSet<Key, Compare>::size_type FrozenSet<Key, Compare>::first_index(size_type n)
+{
+	// Самый левый узел; для пустого множества — 0, то есть конец
+	if (n == 0)
+		return 0;
+	size_type k = 1;
+	while (2 * k <= n)
+		k = 2 * k;
+	return k;
+}
+
+template<typename Key, typename Compare>
+inline typename FrozenSet<Key, Compare>::size_type FrozenSet<Key, Compare>::last_index(size_type n)
+{
+	if (n == 0)
+		return 0;
+	size_type k = 1;
+	while (2 * k + 1 <= n)
+		k = 2 * k + 1;
+	return k;
+}
+
+template<typename Key, typename Compare>
+inline typename FrozenSet<Key, Compare>::size_type FrozenSet<Key, Compare>::next_index(size_type k, size_type n)
+{
+	// Есть правое поддерево — его самый левый узел, иначе подъём до первого предка, в которого пришли слева
+	if (2 * k + 1 <= n)
+	{
+		k = 2 * k + 1;
+		while (2 * k <= n)
+			k = 2 * k;
+		return k;
+	}
+	return k >> (std::countr_one(k) + 1);
+}
+
+template<typename Key, typename Compare>
+inline typename FrozenSet<Key, Compare>::size_type FrozenSet<Key, Compare>::prev_index(size_type k, size_type n)
+{
+	if (2 * k <= n)
+	{
+		k = 2 * k;
+		while (2 * k + 1 <= n)
+			k = 2 * k + 1;
+		return k;
+	}
+	return k >> (std::countr_zero(k) + 1);
+}
+
+template<typename Key, typename Compare>
+template<typename FwdIt>
+inline void FrozenSet<Key, Compare>::build(FwdIt first, size_type n)
+{
+	// Симметричный обход неявного дерева раздаёт упорядоченные ключи по ячейкам за O(n)
+	if (n == 0)
+		return;
+
+	Element* data = allocate(n);
+	size_type k = first_index(n);
+	try
+	{
+		for (; k != 0; k = next_index(k, n), ++first)
+			::new (static_cast<void*>(data + k)) Element(element_key<Key>(*first), EmptyStruct{});
+	}
+	catch (...)
+	{
+		deallocate(data, k, n);
+		throw;
+	}
+	_data = data;
+	_size = n;
+}
+
+template<typename Key, typename Compare>
+inline void FrozenSet<Key, Compare>::release() noexcept
+{
+	if (_data)
+		deallocate(_data, 0, _size);
+	_data = nullptr;
+	_size = 0;
+}
+
+template<typename K, typename C>
+inline bool operator==(const FrozenSet<K, C>& lhs, const FrozenSet<K, C>& rhs)
+{
+	// Одинаковые множества одного размера раскладываются одинаково
+	if (lhs._size != rhs._size)
+		return false;
+	for (std::size_t k = 1; k <= lhs._size; ++k)
+	{
+		if (!(lhs._data[k] == rhs._data[k]))
+			return false;
+	}
+	return true;
+}
+
+template<typename K, typename C>
+inline bool operator!=(const FrozenSet<K, C>& lhs, const FrozenSet<K, C>& rhs)
+{
+	return !(lhs == rhs);
+}
+
+template<typename K, typename C>
+inline void swap(FrozenSet<K, C>& lhs, FrozenSet<K, C>& rhs) noexcept
+{
+	std::swap(lhs._data, rhs._data);
+	std::swap(lhs._size, rhs._size);
+	std::swap(lhs._comp, rhs._comp);
+}
@@ -0,0 +1,273 @@
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <memory>
+#include <new>
+#include <vector>
+#include <type_traits>
+
+// Пул блоков фиксированного размера: память берётся слэбами, освобождённые блоки
+// попадают в список свободных и переиспользуются следующими аллокациями
+class SlabPool
+{
+private:
+    struct FreeBlock
+    {
+        FreeBlock* next;
+    };
+
+    std::size_t _block_size;
+    std::size_t _blocks_per_slab;
+    std::vector<void*> _slabs;
+    FreeBlock* _free_list;
+    char* _bump;
+    char* _bump_end;
+    std::size_t _in_use;
+
+    void add_slab();
+
+public:
+    SlabPool(std::size_t block_size, std::size_t blocks_per_slab);
+    ~SlabPool();
+
+    SlabPool(const SlabPool&) = delete;
+    SlabPool& operator=(const SlabPool&) = delete;
+
+    void* allocate();
+    void deallocate(void* p) noexcept;
+
+    // Освобождает все слэбы разом; блоки, выданные ранее, становятся недействительными
+    void release() noexcept;
+
+    std::size_t in_use() const noexcept;
+    std::size_t capacity() const noexcept;
+};
+
+inline SlabPool::SlabPool(std::size_t block_size, std::size_t blocks_per_slab)
+    : _block_size((std::max(block_size, sizeof(FreeBlock)) + alignof(FreeBlock) - 1) / alignof(FreeBlock) * alignof(FreeBlock))
+    , _blocks_per_slab(blocks_per_slab)
+    , _free_list(nullptr)
+    , _bump(nullptr)
+    , _bump_end(nullptr)
+    , _in_use(0)
+{
+}
+
+inline SlabPool::~SlabPool()
+{
+    release();
+}
+
+inline void SlabPool::add_slab()
+{
+    _slabs.reserve(_slabs.size() + 1);
+    _bump = static_cast<char*>(::operator new(_block_size * _blocks_per_slab));
+    _bump_end = _bump + _block_size * _blocks_per_slab;
+    _slabs.push_back(_bump);
+}
+
+inline void* SlabPool::allocate()
+{
+    if (_free_list)
+    {
+        FreeBlock* block = _free_list;
+        _free_list = block->next;
+        ++_in_use;
+        return block;
+    }
+
+    if (_bump == _bump_end)
+        add_slab();
+
+    void* block = _bump;
+    _bump += _block_size;
+    ++_in_use;
+    return block;
+}
+
+inline void SlabPool::deallocate(void* p) noexcept
+{
+    FreeBlock* block = static_cast<FreeBlock*>(p);
+    block->next = _free_list;
+    _free_list = block;
+    --_in_use;
+}
+
+inline void SlabPool::release() noexcept
+{
+    for (void* slab : _slabs)
+        ::operator delete(slab);
+    _slabs.clear();
+    _free_list = nullptr;
+    _bump = _bump_end = nullptr;
+    _in_use = 0;
+}
+
+inline std::size_t SlabPool::in_use() const noexcept
+{
+    return _in_use;
+}
+
+inline std::size_t SlabPool::capacity() const noexcept
+{
+    return _slabs.size() * _blocks_per_slab;
+}
+
+
+// Набор пулов, по одному на каждый размер блока; общий для всех копий и rebind'ов аллокатора
+class SlabPoolSet
+{
+private:
+    std::vector<std::unique_ptr<SlabPool>> _pools;
+    std::vector<std::size_t> _block_sizes;
+    std::size_t _blocks_per_slab;
+
+public:
+    explicit SlabPoolSet(std::size_t blocks_per_slab);
+
+    SlabPool& pool_for(std::size_t block_size);
+};
+
+inline SlabPoolSet::SlabPoolSet(std::size_t blocks_per_slab)
+    : _blocks_per_slab(blocks_per_slab)
+{
+}
+
+inline SlabPool& SlabPoolSet::pool_for(std::size_t block_size)
+{
+    for (std::size_t i = 0; i < _block_sizes.size(); ++i)
+    {
+        if (_block_sizes[i] == block_size)
+            return *_pools[i];
+    }
+    _pools.push_back(std::make_unique<SlabPool>(block_size, _blocks_per_slab));
+    _block_sizes.push_back(block_size);
+    return *_pools.back();
+}
+
+
+// Аллокатор узлов поверх SlabPool. Копии и rebind'ы разделяют один набор пулов,
+// копирование контейнера (select_on_container_copy_construction) заводит новый.
+// Одиночные аллокации идут через пул, массивы — через обычный operator new.
+template<typename T, std::size_t BlocksPerSlab = 256>
+class PoolAllocator
+{
+private:
+    std::shared_ptr<SlabPoolSet> _pools;
+    SlabPool* _pool;
+
+    template<typename U, std::size_t N>
+    friend class PoolAllocator;
+
+public:
+    using value_type = T;
+    using size_type = std::size_t;
+    using difference_type = std::ptrdiff_t;
+
+    using propagate_on_container_copy_assignment = std::false_type;
+    using propagate_on_container_move_assignment = std::true_type;
+    using propagate_on_container_swap = std::true_type;
+    using is_always_equal = std::false_type;
+
+    template<typename U>
+    struct rebind
+    {
+        using other = PoolAllocator<U, BlocksPerSlab>;
+    };
+
+    PoolAllocator();
+
+    // Перемещение не должно обнулять источник: контейнер продолжает им пользоваться
+    PoolAllocator(const PoolAllocator& other) = default;
+    PoolAllocator& operator=(const PoolAllocator& other) = default;
+
+    template<typename U>
+    PoolAllocator(const PoolAllocator<U, BlocksPerSlab>& other);
+
+    T* allocate(size_type n);
+    void deallocate(T* p, size_type n) noexcept;
+
+    PoolAllocator select_on_container_copy_construction() const;
+
+    void release() noexcept;
+    size_type in_use() const noexcept;
+    size_type capacity() const noexcept;
+
+    template<typename U>
+    bool operator==(const PoolAllocator<U, BlocksPerSlab>& other) const noexcept;
+
+    template<typename U>
+    bool operator!=(const PoolAllocator<U, BlocksPerSlab>& other) const noexcept;
+};
+
+template<typename T, std::size_t BlocksPerSlab>
+inline PoolAllocator<T, BlocksPerSlab>::PoolAllocator()
+    : _pools(std::make_shared<SlabPoolSet>(BlocksPerSlab))
+    , _pool(&_pools->pool_for(sizeof(T)))
+{
+    static_assert(alignof(T) <= alignof(std::max_align_t), "PoolAllocator does not support over-aligned types");
+}
+
+template<typename T, std::size_t BlocksPerSlab>
+template<typename U>
+inline PoolAllocator<T, BlocksPerSlab>::PoolAllocator(const PoolAllocator<U, BlocksPerSlab>& other)
+    : _pools(other._pools)
+    , _pool(&_pools->pool_for(sizeof(T)))
+{
+}
+
+template<typename T, std::size_t BlocksPerSlab>
+inline T* PoolAllocator<T, BlocksPerSlab>::allocate(size_type n)
+{
+    if (n != 1)
+        return static_cast<T*>(::operator new(n * sizeof(T)));
+    return static_cast<T*>(_pool->allocate());
+}
+
+template<typename T, std::size_t BlocksPerSlab>
+inline void PoolAllocator<T, BlocksPerSlab>::deallocate(T* p, size_type n) noexcept
+{
+    if (n != 1)
+        ::operator delete(p);
+    else
+        _pool->deallocate(p);
+}
+
+template<typename T, std::size_t BlocksPerSlab>
+inline PoolAllocator<T, BlocksPerSlab> PoolAllocator<T, BlocksPerSlab>::select_on_container_copy_construction() const
+{
+    return PoolAllocator();
+}
+
+template<typename T, std::size_t BlocksPerSlab>
+inline void PoolAllocator<T, BlocksPerSlab>::release() noexcept
+{
+    _pool->release();
+}
+
+template<typename T, std::size_t BlocksPerSlab>
+inline typename PoolAllocator<T, BlocksPerSlab>::size_type PoolAllocator<T, BlocksPerSlab>::in_use() const noexcept
+{
+    return _pool->in_use();
+}
+
+template<typename T, std::size_t BlocksPerSlab>
+inline typename PoolAllocator<T, BlocksPerSlab>::size_type PoolAllocator<T, BlocksPerSlab>::capacity() const noexcept
+{
+    return _pool->capacity();
+}
+
+template<typename T, std::size_t BlocksPerSlab>
+template<typename U>
+inline bool PoolAllocator<T, BlocksPerSlab>::operator==(const PoolAllocator<U, BlocksPerSlab>& other) const noexcept
+{
+    return _pools == other._pools;
+}
+
+template<typename T, std::size_t BlocksPerSlab>
+template<typename U>
+inline bool PoolAllocator<T, BlocksPerSlab>::operator!=(const PoolAllocator<U, BlocksPerSlab>& other) const noexcept
+{
+    return !(*this == other);
+}
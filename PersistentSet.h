@@ -0,0 +1,748 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <initializer_list>
+#include <iterator>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+#include "Set.h"
+
+// Персистентное красно-чёрное множество: узлы неизменяемы и разделяются версиями со счётчиком ссылок.
+// snapshot() и копирование — O(1), вставка и удаление копируют только O(log n) узлов на пути к ключу,
+// прежние версии остаются нетронутыми. Узлы и их счётчики можно читать и освобождать из разных потоков,
+// поэтому снимок можно отдать другому потоку, пока эта версия продолжает меняться; сам объект
+// PersistentSet, как и Set, не допускает одновременной записи и чтения.
+// Балансировка построена на склейке join(left, key, right) (Blelloch, Ferizovic, Sun, «Just Join
+// for Parallel Ordered Sets»): вставка и удаление пересобирают путь склейками соседних уровней,
+// каждая стоит O(1 + разница чёрных высот), в сумме — O(log n).
+// Ссылок на родителя нет (узел разделяется разными родителями), поэтому ++ итератора ищет
+// следующий ключ от корня за O(log n); для полного обхода есть for_each за O(n).
+// Элементы — пары с ключом в first, как у Set
+template<typename Key, typename Compare = std::less<Key>>
+class PersistentSet
+{
+private:
+	using Element = KeyValuePair<Key, EmptyStruct>;
+
+	enum Color : std::uint8_t
+	{
+		RED,
+		BLACK
+	};
+
+	struct Node;
+
+	// Владеющая ссылка на узел; копирование увеличивает счётчик, последняя ссылка освобождает узел
+	class NodePtr
+	{
+	private:
+		const Node* _node = nullptr;
+
+	public:
+		NodePtr() = default;
+
+		explicit NodePtr(const Node* node)
+			: _node(node)
+		{
+		}
+
+		NodePtr(const NodePtr& other)
+			: _node(other._node)
+		{
+			if (_node)
+				_node->refs.fetch_add(1, std::memory_order_relaxed);
+		}
+
+		NodePtr(NodePtr&& other) noexcept
+			: _node(std::exchange(other._node, nullptr))
+		{
+		}
+
+		NodePtr& operator=(NodePtr other) noexcept
+		{
+			std::swap(_node, other._node);
+			return *this;
+		}
+
+		~NodePtr()
+		{
+			if (_node && _node->refs.fetch_sub(1, std::memory_order_acq_rel) == 1)
+				delete _node;
+		}
+
+		const Node* get() const { return _node; }
+		const Node* operator->() const { return _node; }
+		explicit operator bool() const { return _node != nullptr; }
+		bool operator==(const NodePtr& other) const { return _node == other._node; }
+	};
+
+	struct Node
+	{
+		Element data;
+		NodePtr left;
+		NodePtr right;
+		mutable std::atomic<std::size_t> refs{ 1 };
+		Color color;
+		// Чёрная высота поддерева с этим узлом; у пустого поддерева — 0
+		std::uint8_t black_height;
+
+		Node(NodePtr l, const Key& key, NodePtr r, Color c)
+			: data(key, EmptyStruct{})
+			, left(std::move(l))
+			, right(std::move(r))
+			, color(c)
+			, black_height(static_cast<std::uint8_t>(PersistentSet::black_height(left) + (c == BLACK ? 1 : 0)))
+		{
+		}
+	};
+
+	NodePtr _root;
+	std::size_t _size = 0;
+	RBTREE_NO_UNIQUE_ADDRESS Compare _comp;
+
+public:
+	using key_type = Key;
+	using value_type = Key;
+	using size_type = std::size_t;
+	using difference_type = std::ptrdiff_t;
+	using key_compare = Compare;
+
+	class ConstIterator
+	{
+	private:
+		const Node* _root = nullptr;
+		const Node* _node = nullptr;
+		RBTREE_NO_UNIQUE_ADDRESS Compare _comp;
+
+		friend class PersistentSet;
+
+		ConstIterator(const Node* root, const Node* node, const Compare& comp);
+
+	public:
+		using iterator_category = std::bidirectional_iterator_tag;
+		using value_type = KeyValuePair<Key, EmptyStruct>;
+		using difference_type = std::ptrdiff_t;
+		using pointer = const value_type*;
+		using reference = const value_type&;
+
+		ConstIterator() = default;
+
+		reference operator*() const;
+		pointer operator->() const;
+
+		ConstIterator& operator++();
+		ConstIterator operator++(int);
+		ConstIterator& operator--();
+		ConstIterator operator--(int);
+
+		bool operator==(const ConstIterator& other) const;
+		bool operator!=(const ConstIterator& other) const;
+	};
+
+	using iterator = ConstIterator;
+	using const_iterator = ConstIterator;
+
+	PersistentSet() = default;
+	explicit PersistentSet(const Compare& comp);
+	PersistentSet(std::initializer_list<Key> init, const Compare& comp = Compare());
+
+	// Диапазон уже упорядочен по Compare и не содержит повторов: дерево строится за O(n)
+	template<typename InputIt>
+	PersistentSet(sorted_unique_t, InputIt first, InputIt last, const Compare& comp = Compare());
+
+	// Копирование разделяет все узлы: O(1)
+	PersistentSet(const PersistentSet& other) = default;
+	PersistentSet(PersistentSet&& other) noexcept;
+	PersistentSet& operator=(const PersistentSet& other) = default;
+	PersistentSet& operator=(PersistentSet&& other) noexcept;
+
+	// Неизменяемая версия на текущий момент за O(1); последующие изменения этого множества её не затрагивают
+	PersistentSet snapshot() const;
+
+	key_compare key_comp() const;
+
+	size_type size() const noexcept;
+	bool empty() const noexcept;
+	void clear() noexcept;
+
+	// Копируют O(log n) узлов; узлы, общие с другими версиями, не меняются
+	bool insert(const Key& key);
+	bool erase(const Key& key);
+
+	bool contains(const Key& key) const;
+	const_iterator find(const Key& key) const;
+	const_iterator lower_bound(const Key& key) const;
+	const_iterator upper_bound(const Key& key) const;
+
+	const_iterator begin() const;
+	const_iterator end() const;
+
+	// Обход по возрастанию за O(n) со стеком пути
+	template<typename Visitor>
+	void for_each(Visitor&& visit) const;
+
+	// Общие с other узлы: версии, разошедшиеся после snapshot(), делят всё, кроме изменённых путей
+	bool shares_root_with(const PersistentSet& other) const noexcept;
+
+	// Порядок ключей, цвета, чёрные высоты
+	bool is_valid() const;
+
+	bool operator==(const PersistentSet& other) const;
+	bool operator!=(const PersistentSet& other) const;
+
+private:
+	static std::size_t black_height(const NodePtr& t);
+	static bool is_red(const NodePtr& t);
+
+	static NodePtr make(NodePtr left, const Key& key, NodePtr right, Color color);
+	static NodePtr with_color(const NodePtr& t, Color color);
+
+	// Склейка деревьев с ключами left < key < right
+	static NodePtr join(NodePtr left, const Key& key, NodePtr right);
+	static NodePtr join_right(const NodePtr& left, const Key& key, const NodePtr& right);
+	static NodePtr join_left(const NodePtr& left, const Key& key, const NodePtr& right);
+	// Узел t с новыми детьми: если чёрная высота и цвета сошлись — одна копия узла, иначе склейка
+	static NodePtr replace_children(const NodePtr& t, NodePtr left, NodePtr right);
+	// Склейка без среднего ключа: наибольший ключ left становится средним
+	static NodePtr join2(const NodePtr& left, const NodePtr& right);
+	// Дерево без наибольшего ключа; узел с ним — в last
+	static NodePtr split_last(const NodePtr& t, const Node*& last);
+
+	NodePtr insert_helper(const NodePtr& t, const Key& key, bool& inserted) const;
+	NodePtr erase_helper(const NodePtr& t, const Key& key, bool& erased) const;
+
+	template<typename It>
+	static NodePtr build_helper(It& it, std::size_t n, std::size_t depth, std::size_t red_depth);
+
+	long validate_helper(const Node* node) const;
+};
+
+template<typename Key, typename Compare>
+inline PersistentSet<Key, Compare>::PersistentSet(const Compare& comp)
+	: _comp(comp)
+{
+}
+
+template<typename Key, typename Compare>
+inline PersistentSet<Key, Compare>::PersistentSet(std::initializer_list<Key> init, const Compare& comp)
+	: _comp(comp)
+{
+	for (const Key& key : init)
+		insert(key);
+}
+
+template<typename Key, typename Compare>
+template<typename InputIt>
+PersistentSet<Key, Compare>::PersistentSet(sorted_unique_t, InputIt first, InputIt last, const Compare& comp)
+	: _comp(comp)
+{
+	// Длина нужна заранее: однопроходный диапазон сначала собирается в массив
+	if constexpr (std::is_base_of<std::forward_iterator_tag, typename std::iterator_traits<InputIt>::iterator_category>::value)
+	{
+		_size = static_cast<std::size_t>(std::distance(first, last));
+		std::size_t red_depth = 0;
+		while ((std::size_t(2) << red_depth) <= _size + 1)
+			++red_depth;
+		_root = build_helper(first, _size, 0, red_depth);
+	}
+	else
+	{
+		std::vector<Key> keys(first, last);
+		*this = PersistentSet(sorted_unique, keys.begin(), keys.end(), comp);
+	}
+}
+
+template<typename Key, typename Compare>
+inline PersistentSet<Key, Compare>::PersistentSet(PersistentSet&& other) noexcept
+	: _root(std::move(other._root))
+	, _size(std::exchange(other._size, 0))
+	, _comp(other._comp)
+{
+}
+
+template<typename Key, typename Compare>
+inline PersistentSet<Key, Compare>& PersistentSet<Key, Compare>::operator=(PersistentSet&& other) noexcept
+{
+	_root = std::move(other._root);
+	_size = std::exchange(other._size, 0);
+	_comp = other._comp;
+	return *this;
+}
+
+template<typename Key, typename Compare>
+inline PersistentSet<Key, Compare> PersistentSet<Key, Compare>::snapshot() const
+{
+	return *this;
+}
+
+template<typename Key, typename Compare>
+inline typename PersistentSet<Key, Compare>::key_compare PersistentSet<Key, Compare>::key_comp() const
+{
+	return _comp;
+}
+
+template<typename Key, typename Compare>
+inline typename PersistentSet<Key, Compare>::size_type PersistentSet<Key, Compare>::size() const noexcept
+{
+	return _size;
+}
+
+template<typename Key, typename Compare>
+inline bool PersistentSet<Key, Compare>::empty() const noexcept
+{
+	return !_root;
+}
+
+template<typename Key, typename Compare>
+inline void PersistentSet<Key, Compare>::clear() noexcept
+{
+	_root = NodePtr();
+	_size = 0;
+}
+
+template<typename Key, typename Compare>
+bool PersistentSet<Key, Compare>::insert(const Key& key)
+{
+	bool inserted = false;
+	NodePtr root = insert_helper(_root, key, inserted);
+	if (inserted)
+	{
+		_root = std::move(root);
+		++_size;
+	}
+	return inserted;
+}
+
+template<typename Key, typename Compare>
+bool PersistentSet<Key, Compare>::erase(const Key& key)
+{
+	bool erased = false;
+	NodePtr root = erase_helper(_root, key, erased);
+	if (erased)
+	{
+		_root = std::move(root);
+		--_size;
+	}
+	return erased;
+}
+
+template<typename Key, typename Compare>
+inline bool PersistentSet<Key, Compare>::contains(const Key& key) const
+{
+	return find(key) != end();
+}
+
+template<typename Key, typename Compare>
+typename PersistentSet<Key, Compare>::const_iterator PersistentSet<Key, Compare>::find(const Key& key) const
+{
+	const Node* node = _root.get();
+	while (node)
+	{
+		if (_comp(key, node->data.first))
+			node = node->left.get();
+		else if (_comp(node->data.first, key))
+			node = node->right.get();
+		else
+			break;
+	}
+	return const_iterator(_root.get(), node, _comp);
+}
+
+template<typename Key, typename Compare>
+typename PersistentSet<Key, Compare>::const_iterator PersistentSet<Key, Compare>::lower_bound(const Key& key) const
+{
+	const Node* result = nullptr;
+	for (const Node* node = _root.get(); node; )
+	{
+		if (_comp(node->data.first, key))
+			node = node->right.get();
+		else
+		{
+			result = node;
+			node = node->left.get();
+		}
+	}
+	return const_iterator(_root.get(), result, _comp);
+}
+
+template<typename Key, typename Compare>
+typename PersistentSet<Key, Compare>::const_iterator PersistentSet<Key, Compare>::upper_bound(const Key& key) const
+{
+	const Node* result = nullptr;
+	for (const Node* node = _root.get(); node; )
+	{
+		if (!_comp(key, node->data.first))
+			node = node->right.get();
+		else
+		{
+			result = node;
+			node = node->left.get();
+		}
+	}
+	return const_iterator(_root.get(), result, _comp);
+}
+
+template<typename Key, typename Compare>
+typename PersistentSet<Key, Compare>::const_iterator PersistentSet<Key, Compare>::begin() const
+{
+	const Node* node = _root.get();
+	while (node && node->left)
+		node = node->left.get();
+	return const_iterator(_root.get(), node, _comp);
+}
+
+template<typename Key, typename Compare>
+inline typename PersistentSet<Key, Compare>::const_iterator PersistentSet<Key, Compare>::end() const
+{
+	return const_iterator(_root.get(), nullptr, _comp);
+}
+
+template<typename Key, typename Compare>
+template<typename Visitor>
+void PersistentSet<Key, Compare>::for_each(Visitor&& visit) const
+{
+	// Высота красно-чёрного дерева не больше удвоенной чёрной высоты
+	std::vector<const Node*> stack;
+	stack.reserve(_root ? 2 * _root->black_height + 1 : 0);
+	const Node* node = _root.get();
+	while (node || !stack.empty())
+	{
+		for (; node; node = node->left.get())
+			stack.push_back(node);
+		node = stack.back();
+		stack.pop_back();
+		visit(static_cast<const Element&>(node->data));
+		node = node->right.get();
+	}
+}
+
+template<typename Key, typename Compare>
+inline bool PersistentSet<Key, Compare>::shares_root_with(const PersistentSet& other) const noexcept
+{
+	return _root == other._root;
+}
+
+template<typename Key, typename Compare>
+bool PersistentSet<Key, Compare>::is_valid() const
+{
+	size_type count = 0;
+	const Element* prev = nullptr;
+	bool ordered = true;
+	for_each([&](const Element& element)
+		{
+			if (prev && !_comp(prev->first, element.first))
+				ordered = false;
+			prev = &element;
+			++count;
+		});
+	return ordered && count == _size && validate_helper(_root.get()) >= 0;
+}
+
+template<typename Key, typename Compare>
+bool PersistentSet<Key, Compare>::operator==(const PersistentSet& other) const
+{
+	if (_size != other._size)
+		return false;
+	if (_root == other._root)
+		return true;
+	return std::equal(begin(), end(), other.begin(), [&](const Element& lhs, const Element& rhs)
+		{
+			return !_comp(lhs.first, rhs.first) && !_comp(rhs.first, lhs.first);
+		});
+}
+
+template<typename Key, typename Compare>
+inline bool PersistentSet<Key, Compare>::operator!=(const PersistentSet& other) const
+{
+	return !(*this == other);
+}
+
+template<typename Key, typename Compare>
+inline std::size_t PersistentSet<Key, Compare>::black_height(const NodePtr& t)
+{
+	return t ? t->black_height : 0;
+}
+
+template<typename Key, typename Compare>
+inline bool PersistentSet<Key, Compare>::is_red(const NodePtr& t)
+{
+	return t && t->color == RED;
+}
+
+template<typename Key, typename Compare>
+inline typename PersistentSet<Key, Compare>::NodePtr PersistentSet<Key, Compare>::make(NodePtr left, const Key& key, NodePtr right, Color color)
+{
+	return NodePtr(new Node(std::move(left), key, std::move(right), color));
+}
+
+template<typename Key, typename Compare>
+inline typename PersistentSet<Key, Compare>::NodePtr PersistentSet<Key, Compare>::with_color(const NodePtr& t, Color color)
+{
+	if (!t || t->color == color)
+		return t;
+	return make(t->left, t->data.first, t->right, color);
+}
+
+template<typename Key, typename Compare>
+typename PersistentSet<Key, Compare>::NodePtr PersistentSet<Key, Compare>::join(NodePtr left, const Key& key, NodePtr right)
+{
+	// Корни чернеют заранее: спуску остаётся единственный случай — красный узел между чёрными
+	left = with_color(left, BLACK);
+	right = with_color(right, BLACK);
+	std::size_t left_height = black_height(left);
+	std::size_t right_height = black_height(right);
+
+	if (left_height > right_height)
+	{
+		NodePtr t = join_right(left, key, right);
+		return (is_red(t) && is_red(t->right)) ? with_color(t, BLACK) : t;
+	}
+	if (right_height > left_height)
+	{
+		NodePtr t = join_left(left, key, right);
+		return (is_red(t) && is_red(t->left)) ? with_color(t, BLACK) : t;
+	}
+	return make(std::move(left), key, std::move(right), RED);
+}
+
+template<typename Key, typename Compare>
+typename PersistentSet<Key, Compare>::NodePtr PersistentSet<Key, Compare>::join_right(const NodePtr& left, const Key& key, const NodePtr& right)
+{
+	// Спуск по правому краю left до чёрного узла с чёрной высотой right
+	if (!is_red(left) && black_height(left) == black_height(right))
+		return make(left, key, right, RED);
+
+	NodePtr r = join_right(left->right, key, right);
+	if (!is_red(left) && is_red(r) && is_red(r->right))
+	{
+		// Два красных подряд под чёрным узлом: левый поворот, нижний красный чернеет
+		return make(make(left->left, left->data.first, r->left, BLACK), r->data.first, with_color(r->right, BLACK), RED);
+	}
+	return make(left->left, left->data.first, std::move(r), left->color);
+}
+
+template<typename Key, typename Compare>
+typename PersistentSet<Key, Compare>::NodePtr PersistentSet<Key, Compare>::join_left(const NodePtr& left, const Key& key, const NodePtr& right)
+{
+	if (!is_red(right) && black_height(right) == black_height(left))
+		return make(left, key, right, RED);
+
+	NodePtr l = join_left(left, key, right->left);
+	if (!is_red(right) && is_red(l) && is_red(l->left))
+		return make(with_color(l->left, BLACK), l->data.first, make(l->right, right->data.first, right->right, BLACK), RED);
+	return make(std::move(l), right->data.first, right->right, right->color);
+}
+
+template<typename Key, typename Compare>
+typename PersistentSet<Key, Compare>::NodePtr PersistentSet<Key, Compare>::replace_children(const NodePtr& t, NodePtr left, NodePtr right)
+{
+	// Дети — корректные деревья с возможно красным корнем; склейка нужна, только если изменилась
+	// чёрная высота или под красным узлом оказался красный
+	if (black_height(left) == black_height(right) && !(t->color == RED && (is_red(left) || is_red(right))))
+		return make(std::move(left), t->data.first, std::move(right), t->color);
+	return join(std::move(left), t->data.first, std::move(right));
+}
+
+template<typename Key, typename Compare>
+typename PersistentSet<Key, Compare>::NodePtr PersistentSet<Key, Compare>::join2(const NodePtr& left, const NodePtr& right)
+{
+	if (!left)
+		return right;
+	const Node* last = nullptr;
+	NodePtr rest = split_last(left, last);
+	// last жив, пока жив left
+	return join(std::move(rest), last->data.first, right);
+}
+
+template<typename Key, typename Compare>
+typename PersistentSet<Key, Compare>::NodePtr PersistentSet<Key, Compare>::split_last(const NodePtr& t, const Node*& last)
+{
+	if (!t->right)
+	{
+		last = t.get();
+		return t->left;
+	}
+	NodePtr rest = split_last(t->right, last);
+	return replace_children(t, t->left, std::move(rest));
+}
+
+template<typename Key, typename Compare>
+typename PersistentSet<Key, Compare>::NodePtr PersistentSet<Key, Compare>::insert_helper(const NodePtr& t, const Key& key, bool& inserted) const
+{
+	if (!t)
+	{
+		inserted = true;
+		return make(NodePtr(), key, NodePtr(), RED);
+	}
+	if (_comp(key, t->data.first))
+	{
+		NodePtr l = insert_helper(t->left, key, inserted);
+		return inserted ? replace_children(t, std::move(l), t->right) : t;
+	}
+	if (_comp(t->data.first, key))
+	{
+		NodePtr r = insert_helper(t->right, key, inserted);
+		return inserted ? replace_children(t, t->left, std::move(r)) : t;
+	}
+	return t;
+}
+
+template<typename Key, typename Compare>
+typename PersistentSet<Key, Compare>::NodePtr PersistentSet<Key, Compare>::erase_helper(const NodePtr& t, const Key& key, bool& erased) const
+{
+	if (!t)
+		return t;
+	if (_comp(key, t->data.first))
+	{
+		NodePtr l = erase_helper(t->left, key, erased);
+		return erased ? replace_children(t, std::move(l), t->right) : t;
+	}
+	if (_comp(t->data.first, key))
+	{
+		NodePtr r = erase_helper(t->right, key, erased);
+		return erased ? replace_children(t, t->left, std::move(r)) : t;
+	}
+	erased = true;
+	return join2(t->left, t->right);
+}
+
+template<typename Key, typename Compare>
+template<typename It>
+typename PersistentSet<Key, Compare>::NodePtr PersistentSet<Key, Compare>::build_helper(It& it, std::size_t n, std::size_t depth, std::size_t red_depth)
+{
+	// Как у RedBlackTree::build_sorted: красные — только узлы единственного неполного уровня
+	if (n == 0)
+		return NodePtr();
+	std::size_t left_size = (n - 1) / 2;
+	NodePtr left = build_helper(it, left_size, depth + 1, red_depth);
+	const Key& key = *it;
+	++it;
+	NodePtr right = build_helper(it, n - 1 - left_size, depth + 1, red_depth);
+	return make(std::move(left), key, std::move(right), (depth == red_depth) ? RED : BLACK);
+}
+
+template<typename Key, typename Compare>
+long PersistentSet<Key, Compare>::validate_helper(const Node* node) const
+{
+	if (!node)
+		return 0;
+	if (node->color == RED && (is_red(node->left) || is_red(node->right)))
+		return -1;
+	long left = validate_helper(node->left.get());
+	long right = validate_helper(node->right.get());
+	long height = left + (node->color == BLACK ? 1 : 0);
+	if (left < 0 || left != right || height != node->black_height)
+		return -1;
+	return height;
+}
+
+template<typename Key, typename Compare>
+inline PersistentSet<Key, Compare>::ConstIterator::ConstIterator(const Node* root, const Node* node, const Compare& comp)
+	: _root(root)
+	, _node(node)
+	, _comp(comp)
+{
+}
+
+template<typename Key, typename Compare>
+inline typename PersistentSet<Key, Compare>::ConstIterator::reference PersistentSet<Key, Compare>::ConstIterator::operator*() const
+{
+	return _node->data;
+}
+
+template<typename Key, typename Compare>
+inline typename PersistentSet<Key, Compare>::ConstIterator::pointer PersistentSet<Key, Compare>::ConstIterator::operator->() const
+{
+	return &_node->data;
+}
+
+template<typename Key, typename Compare>
+typename PersistentSet<Key, Compare>::ConstIterator& PersistentSet<Key, Compare>::ConstIterator::operator++()
+{
+	// Правое поддерево — шаг вниз; иначе следующий ключ ищется от корня
+	if (_node->right)
+	{
+		_node = _node->right.get();
+		while (_node->left)
+			_node = _node->left.get();
+		return *this;
+	}
+	const Node* next = nullptr;
+	for (const Node* node = _root; node != _node; )
+	{
+		if (_comp(_node->data.first, node->data.first))
+		{
+			next = node;
+			node = node->left.get();
+		}
+		else
+			node = node->right.get();
+	}
+	_node = next;
+	return *this;
+}
+
+template<typename Key, typename Compare>
+inline typename PersistentSet<Key, Compare>::ConstIterator PersistentSet<Key, Compare>::ConstIterator::operator++(int)
+{
+	ConstIterator tmp = *this;
+	++*this;
+	return tmp;
+}
+
+template<typename Key, typename Compare>
+typename PersistentSet<Key, Compare>::ConstIterator& PersistentSet<Key, Compare>::ConstIterator::operator--()
+{
+	if (!_node)
+	{
+		_node = _root;
+		while (_node && _node->right)
+			_node = _node->right.get();
+		return *this;
+	}
+	if (_node->left)
+	{
+		_node = _node->left.get();
+		while (_node->right)
+			_node = _node->right.get();
+		return *this;
+	}
+	const Node* prev = nullptr;
+	for (const Node* node = _root; node != _node; )
+	{
+		if (_comp(node->data.first, _node->data.first))
+		{
+			prev = node;
+			node = node->right.get();
+		}
+		else
+			node = node->left.get();
+	}
+	_node = prev;
+	return *this;
+}
+
+template<typename Key, typename Compare>
+inline typename PersistentSet<Key, Compare>::ConstIterator PersistentSet<Key, Compare>::ConstIterator::operator--(int)
+{
+	ConstIterator tmp = *this;
+	--*this;
+	return tmp;
+}
+
+template<typename Key, typename Compare>
+inline bool PersistentSet<Key, Compare>::ConstIterator::operator==(const ConstIterator& other) const
+{
+	return _node == other._node;
+}
+
+template<typename Key, typename Compare>
+inline bool PersistentSet<Key, Compare>::ConstIterator::operator!=(const ConstIterator& other) const
+{
+	return !(*this == other);
+}
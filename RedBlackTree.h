@@ -1,6 +1,9 @@
 ﻿#pragma once
 
 #include <iostream>
+#include <algorithm>
+#include <atomic>
+#include <bit>
 #include <functional>
 #include <vector>
 #include <stack>
@@ -8,7 +11,12 @@
 #include <iterator>
 #include <memory>
 #include <initializer_list>
-#include <queue>
+#include <optional>
+#include <span>
+#include <tuple>
+#include <type_traits>
+#include <concepts>
+#include <cstdint>
 
 struct EmptyStruct {};
 
@@ -22,21 +30,211 @@ inline bool operator!=(const EmptyStruct&, const EmptyStruct&)
     return false;
 }
 
+#if defined(_MSC_VER) && !defined(__clang__)
+#define RBTREE_NO_UNIQUE_ADDRESS [[msvc::no_unique_address]]
+#else
+#define RBTREE_NO_UNIQUE_ADDRESS [[no_unique_address]]
+#endif
 
+#if defined(__GNUC__) || defined(__clang__)
+#define RBTREE_PREFETCH(p) __builtin_prefetch(p)
+#elif defined(_MSC_VER) && (defined(_M_X64) || defined(_M_IX86))
+#include <xmmintrin.h>
+#define RBTREE_PREFETCH(p) _mm_prefetch(reinterpret_cast<const char*>(p), _MM_HINT_T0)
+#else
+#define RBTREE_PREFETCH(p) ((void)0)
+#endif
 
-template<typename Key, typename T = EmptyStruct, typename Compare = std::less<Key>, bool AllowDuplicates = false>
+// Пара ключ-значение в узле дерева. В отличие от std::pair пустое значение
+// (EmptyStruct у Set) не занимает места и не раздувает узел
+template<typename First, typename Second>
+struct KeyValuePair
+{
+    using first_type = First;
+    using second_type = Second;
+
+    First first;
+    RBTREE_NO_UNIQUE_ADDRESS Second second;
+
+    KeyValuePair()
+        : first()
+        , second()
+    {
+    }
+
+    KeyValuePair(const KeyValuePair&) = default;
+    KeyValuePair(KeyValuePair&&) = default;
+
+    // Для const First (узлы RedBlackTree) присваивание удалено, как у std::pair<const Key, T>
+    KeyValuePair& operator=(const KeyValuePair&) = default;
+    KeyValuePair& operator=(KeyValuePair&&) = default;
+
+    template<typename U1, typename U2>
+    KeyValuePair(U1&& f, U2&& s)
+        : first(std::forward<U1>(f))
+        , second(std::forward<U2>(s))
+    {
+    }
+
+    template<typename U1, typename U2>
+    KeyValuePair(const KeyValuePair<U1, U2>& other)
+        : first(other.first)
+        , second(other.second)
+    {
+    }
+
+    template<typename U1, typename U2>
+    KeyValuePair(const std::pair<U1, U2>& other)
+        : first(other.first)
+        , second(other.second)
+    {
+    }
+
+    template<typename U1, typename U2>
+    KeyValuePair(std::pair<U1, U2>&& other)
+        : first(std::forward<U1>(other.first))
+        , second(std::forward<U2>(other.second))
+    {
+    }
+
+    template<typename... Args1, typename... Args2>
+    KeyValuePair(std::piecewise_construct_t, std::tuple<Args1...> first_args, std::tuple<Args2...> second_args)
+        : KeyValuePair(first_args, second_args, std::index_sequence_for<Args1...>(), std::index_sequence_for<Args2...>())
+    {
+    }
+
+    operator std::pair<std::remove_const_t<First>, Second>() const
+    {
+        return { first, second };
+    }
+
+private:
+    template<typename Tuple1, typename Tuple2, std::size_t... I1, std::size_t... I2>
+    KeyValuePair(Tuple1& first_args, Tuple2& second_args, std::index_sequence<I1...>, std::index_sequence<I2...>)
+        : first(std::forward<std::tuple_element_t<I1, Tuple1>>(std::get<I1>(first_args))...)
+        , second(std::forward<std::tuple_element_t<I2, Tuple2>>(std::get<I2>(second_args))...)
+    {
+    }
+};
+
+template<typename F1, typename S1, typename F2, typename S2>
+inline bool operator==(const KeyValuePair<F1, S1>& lhs, const KeyValuePair<F2, S2>& rhs)
+{
+    return lhs.first == rhs.first && lhs.second == rhs.second;
+}
+
+template<typename F1, typename S1, typename F2, typename S2>
+inline bool operator!=(const KeyValuePair<F1, S1>& lhs, const KeyValuePair<F2, S2>& rhs)
+{
+    return !(lhs == rhs);
+}
+
+template<typename F1, typename S1, typename F2, typename S2>
+inline bool operator<(const KeyValuePair<F1, S1>& lhs, const KeyValuePair<F2, S2>& rhs)
+{
+    return lhs.first < rhs.first || (!(rhs.first < lhs.first) && lhs.second < rhs.second);
+}
+
+
+
+// Аллокаторы-пулы (см. NodePool.h) сообщают число живых блоков и умеют освобождать все слэбы разом
+template<typename A, typename = void>
+struct is_node_pool : std::false_type {};
+
+template<typename A>
+struct is_node_pool<A, std::void_t<decltype(std::declval<A&>().release()),
+    decltype(std::declval<const A&>().in_use())>> : std::true_type {};
+
+
+// Тег для конструкторов и assign: последовательность уже упорядочена и не содержит повторов
+struct sorted_unique_t
+{
+    explicit sorted_unique_t() = default;
+};
+
+inline constexpr sorted_unique_t sorted_unique{};
+
+// Ключ элемента диапазона, из которого строится контейнер (BTree, FlatSet, FrozenSet):
+// элементы Set и деревьев — пары с ключом в first, у остальных диапазонов — сами ключи
+template<typename Key, typename V>
+inline decltype(auto) element_key(V&& v)
+{
+    if constexpr (std::is_constructible<Key, V&&>::value)
+        return std::forward<V>(v);
+    else
+        return (std::forward<V>(v).first);
+}
+
+// Компаратор с is_transparent умеет сравнивать ключ с объектами других типов без конвертации
+template<typename C, typename = void>
+struct is_transparent_compare : std::false_type {};
+
+template<typename C>
+struct is_transparent_compare<C, std::void_t<typename C::is_transparent>> : std::true_type {};
+
+
+// Дополнение узлов сводкой по поддереву — моноидом над элементами в порядке ключей. Политика задаёт
+// summary_type, identity() — нейтральный элемент, lift(value) — сводку одного элемента (value_type дерева)
+// и ассоциативную combine(a, b); коммутативность не нужна, порядок элементов сохраняется.
+// Сводка узла — combine(combine(левое поддерево, lift(элемент)), правое поддерево), у _nil — identity().
+// Дерево пересчитывает сводки при вставке, удалении, поворотах, split/join и построении
+struct NoAugment
+{
+    // Не EmptyStruct: два пустых подобъекта одного типа не могут лежать по одному адресу,
+    // и рядом с пустым значением множества сводка увеличила бы узел
+    struct summary_type {};
+};
+
+// Размер поддерева: rank, select, count_range и сдвиг итератора на n за O(log n)
+struct SubtreeSize
+{
+    using summary_type = std::size_t;
+
+    static std::size_t identity()
+    {
+        return 0;
+    }
+
+    template<typename Value>
+    static std::size_t lift(const Value&)
+    {
+        return 1;
+    }
+
+    static std::size_t combine(std::size_t left, std::size_t right)
+    {
+        return left + right;
+    }
+
+    static std::size_t size_of(std::size_t summary)
+    {
+        return summary;
+    }
+};
+
+template<typename Key, typename T = EmptyStruct, typename Compare = std::less<Key>, bool AllowDuplicates = false,
+    typename Allocator = std::allocator<KeyValuePair<const Key, T>>, typename Augment = NoAugment>
 class RedBlackTree
 {
 public:
     using key_type = Key;
     using mapped_type = T;
-    using value_type = std::pair<const Key, T>;
+    using value_type = KeyValuePair<const Key, T>;
     using reference = value_type&;
     using const_reference = const value_type&;
     using pointer = value_type*;
     using const_pointer = const value_type*;
     using size_type = std::size_t;
     using difference_type = std::ptrdiff_t;
+    using key_compare = Compare;
+    using allocator_type = Allocator;
+
+    using summary_type = typename Augment::summary_type;
+
+    // Узлы несут сводки поддеревьев: доступны aggregate и update_summary
+    static constexpr bool augmented = !std::is_same<Augment, NoAugment>::value;
+    // Политика дополнения хранит размер поддерева (SubtreeSize): доступны rank, select, count_range и iterator + n
+    static constexpr bool order_statistics = requires(const summary_type& s) { Augment::size_of(s); };
 
 private:
     enum Color
@@ -45,52 +243,232 @@ private:
         BLACK
     };
 
+    // Цвет хранится в младшем бите указателя на родителя: узлы выровнены
+    // как минимум по указателю, так что этот бит всегда свободен
     struct Node
     {
         value_type data;
-        Node* parent;
         Node* left;
         Node* right;
-        Color color;
+        std::uintptr_t parent_and_color;
+        // Сводка поддерева; у _nil — значение по умолчанию. Для NoAugment места не занимает
+        RBTREE_NO_UNIQUE_ADDRESS summary_type summary{};
 
         Node(const Key& k = Key{}, const T& val = T{}, Color c = BLACK, Node* p = nullptr)
-            : data(std::make_pair(k, val))
-            , parent(p)
+            : data(k, val)
             , left(nullptr)
             , right(nullptr)
-            , color(c)
+            , parent_and_color(reinterpret_cast<std::uintptr_t>(p) | c)
         {
         }
 
         Node(Key&& k, T&& val, Color c = BLACK, Node* p = nullptr)
-            : data(std::make_pair(std::move(k), std::move(val)))
-            , parent(p)
+            : data(std::move(k), std::move(val))
+            , left(nullptr)
+            , right(nullptr)
+            , parent_and_color(reinterpret_cast<std::uintptr_t>(p) | c)
+        {
+        }
+
+        template<typename... Args>
+        explicit Node(std::in_place_t, Args&&... args)
+            : data(std::forward<Args>(args)...)
             , left(nullptr)
             , right(nullptr)
-            , color(c)
+            , parent_and_color(RED)
+        {
+        }
+
+        Node* parent() const
+        {
+            return reinterpret_cast<Node*>(parent_and_color & ~std::uintptr_t(1));
+        }
+
+        void set_parent(Node* p)
+        {
+            parent_and_color = reinterpret_cast<std::uintptr_t>(p) | (parent_and_color & 1);
+        }
+
+        Color color() const
+        {
+            return static_cast<Color>(parent_and_color & 1);
+        }
+
+        void set_color(Color c)
         {
+            parent_and_color = (parent_and_color & ~std::uintptr_t(1)) | c;
         }
     };
 
-    Node* create_node(const Key& key, const T& value, Color color = RED, Node* parent = nullptr)
+    static_assert(alignof(Node) >= 2, "the color bit is packed into the parent pointer");
+
+    // Место вставки ключа: родитель нового узла и сторона, либо уже существующий узел
+    struct InsertPosition
+    {
+        Node* node;
+        bool left;
+        bool exists;
+    };
+
+    using node_allocator_type = typename std::allocator_traits<Allocator>::template rebind_alloc<Node>;
+    using node_traits = std::allocator_traits<node_allocator_type>;
+
+    // Конструирует узел в уже выделенной памяти; при исключении память возвращается аллокатору
+    template<typename... Args>
+    Node* construct_node(Node* node, Args&&... args)
     {
-        Node* node = new Node(key, value, color, parent);
+        try
+        {
+            node_traits::construct(_alloc, node, std::forward<Args>(args)...);
+        }
+        catch (...)
+        {
+            node_traits::deallocate(_alloc, node, 1);
+            throw;
+        }
+        node->set_color(RED);
         node->left = node->right = _nil;
         return node;
     }
 
-    Node* create_node(Key&& key, T&& value, Color color = RED, Node* parent = nullptr)
+    template<typename... Args>
+    Node* create_node(Args&&... args)
+    {
+        return construct_node(node_traits::allocate(_alloc, 1), std::forward<Args>(args)...);
+    }
+
+    // Узел из элемента входной последовательности: value_type или, для множества, сам ключ.
+    // storage — память уже снятого с дерева узла, которую можно занять вместо новой аллокации
+    template<typename V>
+    Node* create_node_from(V&& v, Node* storage = nullptr)
     {
-        Node* node = new Node(std::move(key), std::move(value), color, parent);
-        node->left = node->right = _nil;
-        return node;
+        if (!storage)
+            storage = node_traits::allocate(_alloc, 1);
+        if constexpr (std::is_constructible<value_type, V&&>::value)
+            return construct_node(storage, std::in_place, std::forward<V>(v));
+        else
+            return construct_node(storage, std::in_place, std::piecewise_construct,
+                std::forward_as_tuple(std::forward<V>(v)), std::tuple<>());
+    }
+
+    // Берёт память из списка снятых с дерева узлов (см. detach_nodes), а когда он пуст — у аллокатора
+    template<typename V>
+    Node* reuse_node(Node*& reuse, V&& v)
+    {
+        if (!reuse)
+            return create_node_from(std::forward<V>(v));
+        Node* node = reuse;
+        reuse = reuse->right;
+        node_traits::destroy(_alloc, node);
+        return create_node_from(std::forward<V>(v), node);
+    }
+
+    template<typename V>
+    static const auto& key_of(const V& v)
+    {
+        if constexpr (std::is_constructible<value_type, const V&>::value)
+            return v.first;
+        else
+            return v;
+    }
+
+    static constexpr size_type unknown_size = ~size_type(0);
+
+    // Число элементов. После split без order statistics размер частей неизвестен без обхода (unknown_size),
+    // и его запоминает первый size(). Это запись из const-метода, которую могут сделать несколько читающих
+    // потоков сразу, поэтому значение атомарное; relaxed достаточно — все они пишут одно и то же число
+    class SizeCache
+    {
+    public:
+        explicit SizeCache(size_type value = 0) noexcept
+            : _value(value)
+        {
+        }
+
+        SizeCache(const SizeCache& other) noexcept
+            : _value(other)
+        {
+        }
+
+        SizeCache& operator=(const SizeCache& other) noexcept
+        {
+            return *this = static_cast<size_type>(other);
+        }
+
+        SizeCache& operator=(size_type value) noexcept
+        {
+            _value.store(value, std::memory_order_relaxed);
+            return *this;
+        }
+
+        operator size_type() const noexcept
+        {
+            return _value.load(std::memory_order_relaxed);
+        }
+
+    private:
+        std::atomic<size_type> _value;
+    };
+
+    void adjust_size(difference_type delta)
+    {
+        if (_tree_size != unknown_size)
+            _tree_size = _tree_size + delta;
+    }
+
+    static summary_type summarize(const Node* x)
+    {
+        return Augment::combine(Augment::combine(x->left->summary, Augment::lift(x->data)), x->right->summary);
+    }
+
+    // Пересчитывает сводку узла по детям. Вызывается только для узлов дерева, не для _nil
+    void update(Node* x)
+    {
+        if constexpr (augmented)
+            x->summary = summarize(x);
+    }
+
+    // Пересчитывает сводки от x до корня после изменения поддерева x
+    void update_path(Node* x)
+    {
+        if constexpr (augmented)
+        {
+            for (; x != _nil; x = x->parent())
+                update(x);
+        }
+    }
+
+    void destroy_node(Node* node)
+    {
+        node_traits::destroy(_alloc, node);
+        node_traits::deallocate(_alloc, node, 1);
+    }
+
+    // Sentinel не является элементом и живёт вне аллокатора узлов, чтобы пул можно было освободить,
+    // как только удалён последний элемент. Он один на все деревья этого типа и только читается:
+    // поддеревья переходят между деревьями (split/join) без переписывания ссылок на листья.
+    // Намеренно не освобождается — деревья в статических объектах могут пережить его деструктор
+    static Node* shared_nil()
+    {
+        static Node* const nil = []
+            {
+                Node* node = new Node();
+                node->set_color(BLACK);
+                node->left = node->right = nullptr;
+                node->set_parent(nullptr);
+                if constexpr (augmented)
+                    node->summary = Augment::identity();
+                return node;
+            }();
+        return nil;
     }
 
 
     Node* _root;
     Node* _nil;
-    size_t _tree_size;
+    mutable SizeCache _tree_size;
     Compare _comp;
+    node_allocator_type _alloc;
 
 public:
     class Iterator
@@ -124,6 +502,14 @@ public:
         Iterator& operator--();
         Iterator operator--(int);
 
+        // Сдвиг на n позиций за O(log n) по размерам поддеревьев, только при order_statistics.
+        // Категория остаётся двунаправленной: std::next и std::distance по-прежнему идут по шагам
+        Iterator& operator+=(difference_type n) requires order_statistics;
+        Iterator& operator-=(difference_type n) requires order_statistics;
+        Iterator operator+(difference_type n) const requires order_statistics;
+        Iterator operator-(difference_type n) const requires order_statistics;
+        difference_type operator-(const Iterator& other) const requires order_statistics;
+
         bool operator==(const Iterator& other) const;
         bool operator!=(const Iterator& other) const;
 
@@ -144,6 +530,7 @@ public:
         using reference = const value_type&;
 
         ConstIterator(Node* node = nullptr, Node* nil = nullptr, Node* root = nullptr);
+        ConstIterator(const Iterator& it);
 
         reference operator*() const;
         pointer operator->() const;
@@ -154,8 +541,16 @@ public:
         ConstIterator& operator--();
         ConstIterator operator--(int);
 
+        ConstIterator& operator+=(difference_type n) requires order_statistics;
+        ConstIterator& operator-=(difference_type n) requires order_statistics;
+        ConstIterator operator+(difference_type n) const requires order_statistics;
+        ConstIterator operator-(difference_type n) const requires order_statistics;
+        difference_type operator-(const ConstIterator& other) const requires order_statistics;
+
         bool operator==(const ConstIterator& other) const;
         bool operator!=(const ConstIterator& other) const;
+
+        Node* node() const;
     };
 
 
@@ -164,12 +559,105 @@ public:
     using reverse_iterator = std::reverse_iterator<iterator>;
     using const_reverse_iterator = std::reverse_iterator<const_iterator>;
 
+
+    // Диапазон элементов [begin, end), который делится пополам по структуре дерева: параллельный обход
+    // (пул, задачи OpenMP, tbb::parallel_for) без копирования элементов в массив. Интерфейс — как у диапазонов
+    // TBB: empty, is_divisible и конструктор разделения; split() оставляет здесь левую половину и возвращает правую.
+    // Граница — общий предок крайних элементов, самый высокий узел диапазона: половины равны с точностью
+    // до балансировки, деление — O(log n) без сравнений ключей. С размерами поддеревьев (order_statistics)
+    // граница — середина по рангу, и размер частей точный. Дерево не должно меняться, пока диапазон используется
+    class Range
+    {
+    private:
+        const RedBlackTree* _tree;
+        Node* _first;
+        Node* _last;
+        // Без order_statistics — оценка: делится пополам вместе с диапазоном
+        size_type _size;
+        size_type _grain;
+
+        Range(const RedBlackTree* tree, Node* first, Node* last, size_type size, size_type grain);
+
+        Node* split_node() const;
+        static Node* common_ancestor(Node* a, Node* b, Node* nil);
+
+        friend class RedBlackTree;
+
+    public:
+        // Конструктор разделения TBB: other становится левой половиной, новый диапазон — правой
+        template<typename Split>
+            requires std::is_empty_v<Split>
+        Range(Range& other, Split);
+
+        const_iterator begin() const;
+        const_iterator end() const;
+
+        bool empty() const;
+        size_type size() const;
+        size_type grainsize() const;
+        // Больше grainsize элементов (по оценке размера) и хотя бы два на самом деле
+        bool is_divisible() const;
+        Range split();
+    };
+
+    using range_type = Range;
+
+
+    // Владеющий дескриптор узла, снятого с дерева (аналог node_type из C++17).
+    // Позволяет перенести элемент в другое дерево без аллокации и копирования ключа
+    class NodeHandle
+    {
+    private:
+        Node* _node;
+        std::optional<node_allocator_type> _alloc;
+
+        NodeHandle(Node* node, const node_allocator_type& alloc);
+        Node* release();
+
+        friend class RedBlackTree;
+
+    public:
+        using key_type = typename RedBlackTree::key_type;
+        using mapped_type = typename RedBlackTree::mapped_type;
+        using value_type = typename RedBlackTree::value_type;
+        using allocator_type = typename RedBlackTree::allocator_type;
+
+        NodeHandle() noexcept;
+        NodeHandle(NodeHandle&& other) noexcept;
+        NodeHandle& operator=(NodeHandle&& other) noexcept;
+        ~NodeHandle();
+
+        bool empty() const noexcept;
+        explicit operator bool() const noexcept;
+
+        // Ключ можно изменить до повторной вставки
+        key_type& key() const;
+        mapped_type& mapped() const;
+        value_type& value() const;
+
+        allocator_type get_allocator() const;
+    };
+
+    using node_type = NodeHandle;
+
+    struct insert_return_type
+    {
+        iterator position;
+        bool inserted;
+        node_type node;
+    };
+
     RedBlackTree();
     RedBlackTree(const RedBlackTree& other);
     RedBlackTree(RedBlackTree&& other) noexcept;
     RedBlackTree(std::initializer_list<value_type> init);
+
+    template<typename InputIt>
+    RedBlackTree(sorted_unique_t, InputIt first, InputIt last, const Compare& comp = Compare(), const Allocator& alloc = Allocator());
     explicit RedBlackTree(const Compare& comp);
     explicit RedBlackTree(Compare&& comp);
+    explicit RedBlackTree(const Allocator& alloc);
+    RedBlackTree(const Compare& comp, const Allocator& alloc);
     ~RedBlackTree();
 
     template<typename U = T>
@@ -177,18 +665,36 @@ public:
 
 
     RedBlackTree& operator=(const RedBlackTree& other);
-    RedBlackTree& operator=(RedBlackTree&& other) noexcept;
+    // Без аллокации, только если узлы other можно забрать: аллокатор переходит вместе с ними или всегда равен
+    RedBlackTree& operator=(RedBlackTree&& other)
+        noexcept(node_traits::propagate_on_container_move_assignment::value || node_traits::is_always_equal::value);
+
+    allocator_type get_allocator() const;
+    key_compare key_comp() const;
 
     size_type size() const;
     size_type height() const;
     bool empty() const;
 
+    // Проверка инвариантов красно-чёрного дерева: порядок ключей, цвета, чёрная высота, ссылки на родителя
+    bool is_valid() const;
+
+    // Размер одного узла в байтах, включая ключ, значение, ссылки и цвет
+    static constexpr size_type node_size() noexcept;
+
     void clear();
 
     iterator find(const Key& key);
     const_iterator find(const Key& key) const;
     bool contains(const Key& key) const;
 
+    // Поиск пакета ключей: result[i] соответствует keys[i], result не короче keys.
+    // Спуски идут по нескольку одновременно, шаг за шагом по очереди, а следующий узел каждого
+    // подгружается заранее — промахи кэша разных ключей перекрываются, а не ждут друг друга
+    void find_batch(std::span<const Key> keys, std::span<iterator> result);
+    void find_batch(std::span<const Key> keys, std::span<const_iterator> result) const;
+    void contains_batch(std::span<const Key> keys, std::span<bool> result) const;
+
     iterator lower_bound(const Key& key);
     const_iterator lower_bound(const Key& key) const;
 
@@ -198,20 +704,114 @@ public:
     std::pair<iterator, iterator> equal_range(const Key& key);
     std::pair<const_iterator, const_iterator> equal_range(const Key& key) const;
 
+    // Порядковые статистики за O(log n), только при order_statistics: rank — число элементов меньше key,
+    // select — k-й по порядку элемент (с нуля) или end(), count_range — число элементов в [lo, hi)
+    size_type rank(const Key& key) const requires order_statistics;
+    iterator select(size_type k) requires order_statistics;
+    const_iterator select(size_type k) const requires order_statistics;
+    size_type count_range(const Key& lo, const Key& hi) const requires order_statistics;
+
+    // Сводка элементов с ключами в [lo, hi) в порядке ключей за O(log n); без аргументов — всего дерева за O(1)
+    summary_type aggregate(const Key& lo, const Key& hi) const requires augmented;
+    summary_type aggregate() const requires augmented;
+    // Пересчитывает сводки после изменения mapped-значения элемента через итератор
+    void update_summary(const_iterator pos) requires augmented;
+
     std::pair<iterator, bool> insert(const value_type& val);
     std::pair<iterator, bool> insert(value_type&& val);
 
+    // Вставка диапазона; в пустое дерево упорядоченный диапазон без повторов строится за O(n)
+    template<typename InputIt>
+    void insert(InputIt first, InputIt last);
+
+    // Заменяет содержимое диапазоном, переиспользуя память текущих узлов
+    template<typename InputIt>
+    void assign(InputIt first, InputIt last);
+    template<typename InputIt>
+    void assign(sorted_unique_t, InputIt first, InputIt last);
+
+    // Параллельные построение из упорядоченного диапазона и копирование. fork(f, g) выполняет f и g,
+    // возможно одновременно, и возвращается, когда завершились обе (см. parallel::Fork): верхние уровни
+    // дерева делятся между задачами, поддеревья меньше parallel_grain строятся целиком в одной.
+    // Аллокатор, копии которого не равны друг другу (пул узлов), не разделяется между потоками — тогда
+    // всё выполняется в вызывающем потоке
+    template<typename RandomIt, typename Fork>
+    void assign_parallel(sorted_unique_t, RandomIt first, RandomIt last, Fork&& fork);
+    template<typename Fork>
+    void assign_parallel(const RedBlackTree& other, Fork&& fork);
+
+    // Границы деления на parts частей примерно равного размера: узлы верхних уровней по возрастанию,
+    // без обхода дерева. Красно-чёрные поддеревья одной глубины различаются по размеру не более
+    // чем в несколько раз, части — тоже
+    std::vector<const_iterator> split_points(size_type parts) const;
+
+    // Делимый диапазон всех элементов или ключей из [lo, hi); части не больше grain не делятся
+    Range range(size_type grain = 1) const;
+    Range range(const Key& lo, const Key& hi, size_type grain = 1) const;
+
+    // Применяет упорядоченный по ключу пакет без повторов: вставку ключа it->first, если it->second, иначе удаление;
+    // ключи вставок перемещаются из пакета. Небольшой пакет применяется по очереди, и поиск каждого ключа
+    // начинается от места предыдущего — подъём до общего предка соседей и спуск, O(log d) для соседей
+    // на расстоянии d. Пакет, сравнимый с деревом, сливается с ним в новое дерево из тех же узлов за O(n + m)
+    template<typename RandomIt>
+    void apply_sorted(RandomIt first, RandomIt last) requires (!AllowDuplicates);
+
     bool erase(const Key& key);
 
+    // Удаление по итератору не ищет ключ заново; возвращает итератор на следующий элемент
+    iterator erase(const_iterator pos);
+    iterator erase(const_iterator first, const_iterator last);
+
+    node_type extract(const_iterator pos);
+    node_type extract(const Key& key);
+
+    insert_return_type insert(node_type&& nh);
+    iterator insert(const_iterator hint, node_type&& nh);
+
+    // Переносит из source узлы с отсутствующими здесь ключами, перевешивая их без аллокаций
+    void merge(RedBlackTree& source);
+    void merge(RedBlackTree&& source);
+
+    // Разрезает дерево за O(log n): в first — ключи меньше key, в second — остальные. Узлы
+    // перевешиваются, а не копируются, само дерево остаётся пустым. С order statistics размеры частей
+    // берутся из сводок корней, без них неизвестны без обхода — первый size() каждой части считает узлы
+    std::pair<RedBlackTree, RedBlackTree> split(const Key& key);
+
+    // Склеивают деревья за O(log n): все ключи left не больше ключей right (и middle между ними).
+    // Аллокаторы должны быть равны, аргументы остаются пустыми
+    static RedBlackTree join(RedBlackTree&& left, RedBlackTree&& right);
+    template<typename V>
+    static RedBlackTree join(RedBlackTree&& left, V&& middle, RedBlackTree&& right);
+
+    // Операция над множествами с упорядоченным диапазоном без повторов [first, last), который намного меньше
+    // дерева: дерево режется split по каждому ключу диапазона, куски склеиваются join. Остаются ключи только
+    // из дерева (left_only), из обоих (both) и только из диапазона (right_only, копируются) — O(m log n),
+    // узлы дерева перевешиваются, а не копируются
+    template<typename InputIt>
+    void split_join(InputIt first, InputIt last, bool left_only, bool both, bool right_only) requires (!AllowDuplicates);
+
     template<typename... Args>
     std::pair<iterator, bool> emplace(Args&&... args);
 
+    // Вставка с подсказкой: hint — позиция, перед которой должен оказаться элемент.
+    // Если подсказка верна, поиск от корня не выполняется
+    iterator insert(const_iterator hint, const value_type& val);
+    iterator insert(const_iterator hint, value_type&& val);
+
+    template<typename... Args>
+    iterator emplace_hint(const_iterator hint, Args&&... args);
+
     template<typename U = T>
     std::enable_if_t<std::is_same<U, EmptyStruct>::value, std::pair<iterator, bool>> insert(const Key& key);
 
     template<typename U = T>
     std::enable_if_t<std::is_same<U, EmptyStruct>::value, std::pair<iterator, bool>> emplace(const Key& key);
 
+    // Ищет ключ и только при промахе создаёт узел, конструируя ключ из key и значение из args.
+    // При прозрачном компараторе поиск идёт по key без конвертации в Key.
+    template<typename K, typename... Args>
+    std::pair<iterator, bool> try_emplace(K&& key, Args&&... args);
+
     iterator begin();
     iterator end();
     const_iterator begin() const;
@@ -231,10 +831,15 @@ public:
     std::vector<value_type> postorder() const;
     std::vector<value_type> levelorder() const;
 
-    void inorder(std::function<void(const_reference)> visit) const;
-    void preorder(std::function<void(const_reference)> visit) const;
-    void postorder(std::function<void(const_reference)> visit) const;
-    void levelorder(std::function<void(const_reference)> visit) const;
+    // Обходы с посетителем: вызов встраивается, обход идёт по ссылкам на родителя без рекурсии и стека
+    template<typename Visitor>
+    void inorder(Visitor&& visit) const;
+    template<typename Visitor>
+    void preorder(Visitor&& visit) const;
+    template<typename Visitor>
+    void postorder(Visitor&& visit) const;
+    template<typename Visitor>
+    void levelorder(Visitor&& visit) const;
 
     bool operator==(const RedBlackTree& other) const;
     bool operator!=(const RedBlackTree& other) const;
@@ -249,188 +854,432 @@ private:
 
     void clear_helper(Node* node);
 
-    void insert_fix(Node* z);
+    // true, если в конце пришлось перекрасить корень — чёрная высота дерева выросла на 1
+    bool insert_fix(Node* z);
 
     void transplant(Node* u, Node* v);
+    void unlink_node(Node* z);
     void delete_node(Node* z);
-    void erase_fix(Node* x);
+    // x может быть _nil, поэтому его родитель передаётся отдельно: в sentinel ничего не пишется
+    void erase_fix(Node* x, Node* x_parent);
 
     Node* find_helper(const Key& key) const;
+    // lower_bound, который начинается от узла finger с ключом меньше key: подъём, пока поддерево не накроет key
+    Node* lower_bound_from(Node* finger, const Key& key) const;
+    template<typename RandomIt>
+    void merge_sorted(RandomIt first, RandomIt last);
+
+    // Чёрная высота поддерева: число чёрных узлов на пути до листа, _nil не считается
+    size_type black_height(Node* node) const;
+    // Отцепляет поддерево от родителя как самостоятельное дерево: корень чернеет; h — высота до и после
+    Node* detach_subtree(Node* node, size_type& h) const;
+    // Склеивает деревья с корнями a < mid < b и чёрными высотами ha, hb через узел mid.
+    // Спуск идёт по краю более высокого дерева до чёрного узла высоты меньшего, дальше — insert_fix.
+    // Возвращает корень, его чёрная высота — в h
+    Node* join_roots(Node* a, size_type ha, Node* mid, Node* b, size_type hb, size_type& h);
+    // Вызывает found(i, node) для каждого keys[i], node == _nil при отсутствии; порядок вызовов произвольный
+    template<typename Found>
+    void find_batch_helper(std::span<const Key> keys, Found&& found) const;
+
+    long validate_helper(const Node* node, const Node* parent) const;
+
+    static size_type subtree_size(const Node* x) requires order_statistics;
+    // k-й по порядку узел поддерева root или nil, если k не меньше его размера
+    static Node* select_node(Node* root, Node* nil, size_type k) requires order_statistics;
+    // Позиция x в дереве; для nil — размер дерева. root — корень, известный итератору,
+    // на выходе — фактический корень, до которого дошёл подъём от x
+    static size_type node_index(Node* x, Node* nil, Node*& root) requires order_statistics;
+
+    Node* successor(Node* x) const;
+    Node* predecessor(Node* x) const;
+
+    template<typename K>
+    InsertPosition insert_position(const K& key) const;
+    template<typename K>
+    InsertPosition insert_position_between(Node* prev, Node* next, const K& key) const;
+    template<typename K>
+    InsertPosition find_position(Node* hint, const K& key) const;
+    std::pair<iterator, bool> link_node(Node* z, const InsertPosition& pos);
 
-    void copy_helper(const Node* node, const Node* source_nil);
-
-    void inorder_helper(Node* node, std::function<void(const_reference)> visit) const;
-    void preorder_helper(Node* node, std::function<void(const_reference)> visit) const;
-    void postorder_helper(Node* node, std::function<void(const_reference)> visit) const;
+    template<typename... Args>
+    std::pair<iterator, bool> emplace_at(Node* hint, Args&&... args);
+    template<typename K, typename... Args>
+    std::pair<iterator, bool> try_emplace_at(Node* hint, K&& key, Args&&... args);
+    template<typename P>
+    std::pair<iterator, bool> emplace_single(Node* hint, P&& arg);
+    template<typename... Args>
+    std::pair<iterator, bool> emplace_node(Node* hint, Args&&... args);
+
+    void clone_from(const RedBlackTree& other, Node*& reuse);
+    Node* clone_helper(const Node* src_root, const Node* src_nil, Node*& reuse);
+    template<typename Fork>
+    Node* clone_parallel(const Node* src, const Node* src_nil, size_type levels, Fork& fork);
+
+    Node* detach_nodes();
+    void destroy_detached(Node* list);
+    void rebuild_without(Node* first, Node* last, size_type count);
+
+    template<typename FwdIt>
+    bool is_sorted_unique(FwdIt first, FwdIt last) const;
+
+    template<typename InputIt, typename Make>
+    void build_sorted(InputIt first, size_type n, Make&& make);
+    template<typename InputIt, typename Make>
+    Node* build_helper(InputIt& it, size_type n, size_type depth, size_type red_depth, Make& make);
+    template<typename RandomIt, typename Fork>
+    Node* build_parallel(RandomIt first, size_type n, size_type depth, size_type red_depth, Fork& fork);
+    template<typename InputIt, typename Make>
+    void append_sorted(InputIt first, InputIt last, Make&& make);
+
+    void collect_split_points(const Node* x, size_type levels, std::vector<const_iterator>& points) const;
+
+    // Поддеревья меньше этого строятся и копируются одной задачей
+    static constexpr size_type parallel_grain = 8192;
+    // Аллокатор можно разделять между потоками
+    static constexpr bool parallel_allocator = node_traits::is_always_equal::value;
+
+    Node* preorder_next(Node* node) const;
+    Node* postorder_first(Node* node) const;
 };
 
-template<typename Key, typename T, typename Compare, bool AllowDuplicates>
-inline RedBlackTree<Key, T, Compare, AllowDuplicates>::RedBlackTree()
-    : _tree_size(0)
+template<typename Key, typename T, typename Compare, bool AllowDuplicates, typename Allocator, typename Augment>
+inline RedBlackTree<Key, T, Compare, AllowDuplicates, Allocator, Augment>::RedBlackTree()
+    : _root(nullptr)
+    , _nil(shared_nil())
+    , _tree_size(0)
     , _comp(Compare())
+    , _alloc()
 {
-    _nil = new Node();
-    _nil->color = BLACK;
-    _nil->left = _nil->right = _nil->parent = nullptr;
     _root = _nil;
 }
 
-template<typename Key, typename T, typename Compare, bool AllowDuplicates>
-inline RedBlackTree<Key, T, Compare, AllowDuplicates>::RedBlackTree(const RedBlackTree& other)
-    : RedBlackTree()
+template<typename Key, typename T, typename Compare, bool AllowDuplicates, typename Allocator, typename Augment>
+inline RedBlackTree<Key, T, Compare, AllowDuplicates, Allocator, Augment>::RedBlackTree(const RedBlackTree& other)
+    : _root(nullptr)
+    , _nil(shared_nil())
+    , _tree_size(0)
+    , _comp(other._comp)
+    , _alloc(node_traits::select_on_container_copy_construction(other._alloc))
 {
-    copy_helper(other._root, other._nil);
+    _root = _nil;
+    Node* reuse = nullptr;
+    clone_from(other, reuse);
 }
 
-template<typename Key, typename T, typename Compare, bool AllowDuplicates>
-inline RedBlackTree<Key, T, Compare, AllowDuplicates>::RedBlackTree(RedBlackTree&& other) noexcept
+template<typename Key, typename T, typename Compare, bool AllowDuplicates, typename Allocator, typename Augment>
+inline RedBlackTree<Key, T, Compare, AllowDuplicates, Allocator, Augment>::RedBlackTree(RedBlackTree&& other) noexcept
     : _root(other._root)
     , _nil(other._nil)
     , _tree_size(other._tree_size)
     , _comp(std::move(other._comp))
+    , _alloc(std::move(other._alloc))
 {
     // Восстанавливаем other в пустое валидное состояние
-    other._nil = new Node(); // создаём новый nil-узел
-    other._nil->color = BLACK;
-    other._nil->left = other._nil->right = other._nil->parent = nullptr;
-
-    other._root = other._nil;  // указывает на пустое дерево
+    other._root = other._nil;
     other._tree_size = 0;
 }
 
-template<typename Key, typename T, typename Compare, bool AllowDuplicates>
-inline RedBlackTree<Key, T, Compare, AllowDuplicates>::RedBlackTree(std::initializer_list<value_type> init)
+template<typename Key, typename T, typename Compare, bool AllowDuplicates, typename Allocator, typename Augment>
+inline RedBlackTree<Key, T, Compare, AllowDuplicates, Allocator, Augment>::RedBlackTree(std::initializer_list<value_type> init)
     : RedBlackTree()
 {
-    for (const auto& elem : init)
-        insert(elem);
+    insert(init.begin(), init.end());
 }
 
-template<typename Key, typename T, typename Compare, bool AllowDuplicates>
-inline RedBlackTree<Key, T, Compare, AllowDuplicates>::RedBlackTree(const Compare& comp)
-    : _tree_size(0)
-    , _comp(comp)
+template<typename Key, typename T, typename Compare, bool AllowDuplicates, typename Allocator, typename Augment>
+template<typename InputIt>
+inline RedBlackTree<Key, T, Compare, AllowDuplicates, Allocator, Augment>::RedBlackTree(sorted_unique_t, InputIt first, InputIt last, 
+                const Compare& comp, const Allocator& alloc)
+    : RedBlackTree(comp, alloc)
 {
-    _nil = new Node();
-    _nil->color = BLACK;
-    _nil->left = _nil->right = _nil->parent = nullptr;
-    _root = _nil;
+    assign(sorted_unique, first, last);
 }
 
-template<typename Key, typename T, typename Compare, bool AllowDuplicates>
-inline RedBlackTree<Key, T, Compare, AllowDuplicates>::RedBlackTree(Compare&& comp)
-    : _tree_size(0)
+template<typename Key, typename T, typename Compare, bool AllowDuplicates, typename Allocator, typename Augment>
+inline RedBlackTree<Key, T, Compare, AllowDuplicates, Allocator, Augment>::RedBlackTree(const Compare& comp)
+    : RedBlackTree(comp, Allocator())
+{
+}
+
+template<typename Key, typename T, typename Compare, bool AllowDuplicates, typename Allocator, typename Augment>
+inline RedBlackTree<Key, T, Compare, AllowDuplicates, Allocator, Augment>::RedBlackTree(Compare&& comp)
+    : _root(nullptr)
+    , _nil(shared_nil())
+    , _tree_size(0)
     , _comp(std::move(comp))
+    , _alloc()
+{
+    _root = _nil;
+}
+
+template<typename Key, typename T, typename Compare, bool AllowDuplicates, typename Allocator, typename Augment>
+inline RedBlackTree<Key, T, Compare, AllowDuplicates, Allocator, Augment>::RedBlackTree(const Allocator& alloc)
+    : RedBlackTree(Compare(), alloc)
+{
+}
+
+template<typename Key, typename T, typename Compare, bool AllowDuplicates, typename Allocator, typename Augment>
+inline RedBlackTree<Key, T, Compare, AllowDuplicates, Allocator, Augment>::RedBlackTree(const Compare& comp, const Allocator& alloc)
+    : _root(nullptr)
+    , _nil(shared_nil())
+    , _tree_size(0)
+    , _comp(comp)
+    , _alloc(alloc)
 {
-    _nil = new Node();
-    _nil->color = BLACK;
-    _nil->left = _nil->right = _nil->parent = nullptr;
     _root = _nil;
 }
 
-template<typename Key, typename T, typename Compare, bool AllowDuplicates>
-inline RedBlackTree<Key, T, Compare, AllowDuplicates>::~RedBlackTree()
+template<typename Key, typename T, typename Compare, bool AllowDuplicates, typename Allocator, typename Augment>
+inline RedBlackTree<Key, T, Compare, AllowDuplicates, Allocator, Augment>::~RedBlackTree()
 {
     clear();
-    delete _nil;
 }
 
-template<typename Key, typename T, typename Compare, bool AllowDuplicates>
-inline RedBlackTree<Key, T, Compare, AllowDuplicates>& 
-        RedBlackTree<Key, T, Compare, AllowDuplicates>::operator=(const RedBlackTree& other)
+template<typename Key, typename T, typename Compare, bool AllowDuplicates, typename Allocator, typename Augment>
+inline RedBlackTree<Key, T, Compare, AllowDuplicates, Allocator, Augment>& 
+        RedBlackTree<Key, T, Compare, AllowDuplicates, Allocator, Augment>::operator=(const RedBlackTree& other)
 {
     if (this != &other)
     {
-        clear();
-        copy_helper(other._root, other._nil);
+        if constexpr (node_traits::propagate_on_container_copy_assignment::value)
+        {
+            // Узлы, выделенные прежним аллокатором, переиспользовать нельзя
+            if (!(_alloc == other._alloc))
+                clear();
+            _alloc = other._alloc;
+        }
+        _comp = other._comp;
+
+        Node* reuse = detach_nodes();
+        try
+        {
+            clone_from(other, reuse);
+        }
+        catch (...)
+        {
+            destroy_detached(reuse);
+            throw;
+        }
+        destroy_detached(reuse);
     }
     return *this;
 }
 
-template<typename Key, typename T, typename Compare, bool AllowDuplicates>
-inline RedBlackTree<Key, T, Compare, AllowDuplicates>& 
-        RedBlackTree<Key, T, Compare, AllowDuplicates>::operator=(RedBlackTree&& other) noexcept
+template<typename Key, typename T, typename Compare, bool AllowDuplicates, typename Allocator, typename Augment>
+inline RedBlackTree<Key, T, Compare, AllowDuplicates, Allocator, Augment>& 
+        RedBlackTree<Key, T, Compare, AllowDuplicates, Allocator, Augment>::operator=(RedBlackTree&& other)
+        noexcept(node_traits::propagate_on_container_move_assignment::value || node_traits::is_always_equal::value)
 {
-    if (this != &other)
-    {
-        clear();      // удалить текущие узлы
-        delete _nil;  // удалить текущий sentinel
-
-        _root = other._root;
-        _nil = other._nil;
-        _tree_size = other._tree_size;
-        _comp = std::move(other._comp);
+    if (this == &other)
+        return *this;
 
-        // Восстанавливаем other
-        other._nil = new Node();
-        other._nil->color = BLACK;
-        other._nil->left = other._nil->right = other._nil->parent = nullptr;
+    clear();      // удалить текущие узлы
+    _comp = std::move(other._comp);
 
-        other._root = other._nil;
-        other._tree_size = 0;
+    if constexpr (node_traits::propagate_on_container_move_assignment::value)
+    {
+        _alloc = std::move(other._alloc);
+    }
+    else if constexpr (!node_traits::is_always_equal::value)
+    {
+        // Узлы other нельзя освободить нашим аллокатором — значения переносятся в свои узлы той же формы за O(n).
+        // Если аллокация бросит, other очищается: часть его ключей уже перемещена
+        if (!(_alloc == other._alloc))
+        {
+            try
+            {
+                build_sorted(other.begin(), other.size(), [this](value_type& value)
+                    {
+                        return create_node_from(value_type(std::move(const_cast<Key&>(value.first)), std::move(value.second)));
+                    });
+            }
+            catch (...)
+            {
+                other.clear();
+                throw;
+            }
+            other.clear();
+            return *this;
+        }
     }
+
+    _root = other._root;
+    _tree_size = other._tree_size;
+
+    // Восстанавливаем other
+    other._root = other._nil;
+    other._tree_size = 0;
     return *this;
 }
 
-template<typename Key, typename T, typename Compare, bool AllowDuplicates>
-typename RedBlackTree<Key, T, Compare, AllowDuplicates>::size_type RedBlackTree<Key, T, Compare, AllowDuplicates>::size() const
+template<typename Key, typename T, typename Compare, bool AllowDuplicates, typename Allocator, typename Augment>
+inline typename RedBlackTree<Key, T, Compare, AllowDuplicates, Allocator, Augment>::allocator_type RedBlackTree<Key, T, Compare, AllowDuplicates, Allocator, Augment>::get_allocator() const
 {
-    return _tree_size;
+    return allocator_type(_alloc);
 }
 
-template<typename Key, typename T, typename Compare, bool AllowDuplicates>
-typename RedBlackTree<Key, T, Compare, AllowDuplicates>::size_type RedBlackTree<Key, T, Compare, AllowDuplicates>::height() const
+template<typename Key, typename T, typename Compare, bool AllowDuplicates, typename Allocator, typename Augment>
+inline typename RedBlackTree<Key, T, Compare, AllowDuplicates, Allocator, Augment>::key_compare RedBlackTree<Key, T, Compare, AllowDuplicates, Allocator, Augment>::key_comp() const
 {
-    std::function<size_type(Node*)> dfs = [&](Node* node) -> size_type
-        {
-            if (node == _nil)
-                return 0;
-            size_type lh = dfs(node->left);
-            size_type rh = dfs(node->right);
-            return 1 + std::max(lh, rh);
-        };
-    return dfs(_root);
+    return _comp;
+}
+
+template<typename Key, typename T, typename Compare, bool AllowDuplicates, typename Allocator, typename Augment>
+typename RedBlackTree<Key, T, Compare, AllowDuplicates, Allocator, Augment>::size_type RedBlackTree<Key, T, Compare, AllowDuplicates, Allocator, Augment>::size() const
+{
+    size_type count = _tree_size;
+    if (count == unknown_size)
+    {
+        count = 0;
+        for (Node* node = minimum(_root); node != _nil; node = successor(node))
+            ++count;
+        _tree_size = count;
+    }
+    return count;
+}
+
+template<typename Key, typename T, typename Compare, bool AllowDuplicates, typename Allocator, typename Augment>
+typename RedBlackTree<Key, T, Compare, AllowDuplicates, Allocator, Augment>::size_type RedBlackTree<Key, T, Compare, AllowDuplicates, Allocator, Augment>::height() const
+{
+    // Прямой обход по ссылкам на родителя с подсчётом текущей глубины
+    size_type result = 0;
+    size_type depth = 1;
+    Node* node = _root;
+    while (node != _nil)
+    {
+        result = std::max(result, depth);
+        if (node->left != _nil)
+        {
+            node = node->left;
+            ++depth;
+        }
+        else if (node->right != _nil)
+        {
+            node = node->right;
+            ++depth;
+        }
+        else
+        {
+            Node* parent = node->parent();
+            while (parent != _nil && (node == parent->right || parent->right == _nil))
+            {
+                node = parent;
+                parent = parent->parent();
+                --depth;
+            }
+            node = (parent == _nil) ? _nil : parent->right;
+        }
+    }
+    return result;
+}
+
+template<typename Key, typename T, typename Compare, bool AllowDuplicates, typename Allocator, typename Augment>
+constexpr typename RedBlackTree<Key, T, Compare, AllowDuplicates, Allocator, Augment>::size_type RedBlackTree<Key, T, Compare, AllowDuplicates, Allocator, Augment>::node_size() noexcept
+{
+    return sizeof(Node);
+}
+
+template<typename Key, typename T, typename Compare, bool AllowDuplicates, typename Allocator, typename Augment>
+inline bool RedBlackTree<Key, T, Compare, AllowDuplicates, Allocator, Augment>::is_valid() const
+{
+    if (_root != _nil && (_root->color() != BLACK || _root->parent() != _nil))
+        return false;
+
+    size_type count = 0;
+    const_iterator prev = end();
+    for (const_iterator it = begin(); it != end(); ++it, ++count)
+    {
+        if (prev != end() && (AllowDuplicates ? _comp(it->first, prev->first) : !_comp(prev->first, it->first)))
+            return false;
+        prev = it;
+    }
+    return count == size() && validate_helper(_root, _nil) >= 0;
 }
 
-template<typename Key, typename T, typename Compare, bool AllowDuplicates>
-inline bool RedBlackTree<Key, T, Compare, AllowDuplicates>::empty() const
+template<typename Key, typename T, typename Compare, bool AllowDuplicates, typename Allocator, typename Augment>
+inline bool RedBlackTree<Key, T, Compare, AllowDuplicates, Allocator, Augment>::empty() const
 {
-    return _tree_size == 0;
+    return _root == _nil;
 }
 
-template<typename Key, typename T, typename Compare, bool AllowDuplicates>
-inline void RedBlackTree<Key, T, Compare, AllowDuplicates>::clear()
+template<typename Key, typename T, typename Compare, bool AllowDuplicates, typename Allocator, typename Augment>
+inline void RedBlackTree<Key, T, Compare, AllowDuplicates, Allocator, Augment>::clear()
 {
+    if constexpr (is_node_pool<node_allocator_type>::value && std::is_trivially_destructible<Node>::value)
+    {
+        // Пул обслуживает только это дерево — слэбы освобождаются целиком, без обхода узлов
+        if (_alloc.in_use() == _tree_size)
+        {
+            _alloc.release();
+            _root = _nil;
+            _tree_size = 0;
+            return;
+        }
+    }
+
     clear_helper(_root);
     _root = _nil;
     _tree_size = 0;
+
+    if constexpr (is_node_pool<node_allocator_type>::value)
+    {
+        if (_alloc.in_use() == 0)
+            _alloc.release();
+    }
 }
 
-template<typename Key, typename T, typename Compare, bool AllowDuplicates>
-typename RedBlackTree<Key, T, Compare, AllowDuplicates>::iterator 
-            RedBlackTree<Key, T, Compare, AllowDuplicates>::find(const Key& key)
+template<typename Key, typename T, typename Compare, bool AllowDuplicates, typename Allocator, typename Augment>
+typename RedBlackTree<Key, T, Compare, AllowDuplicates, Allocator, Augment>::iterator 
+            RedBlackTree<Key, T, Compare, AllowDuplicates, Allocator, Augment>::find(const Key& key)
 {
     Node* result = find_helper(key);
     return (result != _nil) ? iterator(result, _nil, _root) : end();
 }
 
-template<typename Key, typename T, typename Compare, bool AllowDuplicates>
-typename RedBlackTree<Key, T, Compare, AllowDuplicates>::const_iterator 
-            RedBlackTree<Key, T, Compare, AllowDuplicates>::find(const Key& key) const
+template<typename Key, typename T, typename Compare, bool AllowDuplicates, typename Allocator, typename Augment>
+typename RedBlackTree<Key, T, Compare, AllowDuplicates, Allocator, Augment>::const_iterator 
+            RedBlackTree<Key, T, Compare, AllowDuplicates, Allocator, Augment>::find(const Key& key) const
 {
     Node* result = find_helper(key);
     return (result != _nil) ? const_iterator(result, _nil, _root) : end();
 }
 
-template<typename Key, typename T, typename Compare, bool AllowDuplicates>
-inline bool RedBlackTree<Key, T, Compare, AllowDuplicates>::contains(const Key& key) const
+template<typename Key, typename T, typename Compare, bool AllowDuplicates, typename Allocator, typename Augment>
+inline bool RedBlackTree<Key, T, Compare, AllowDuplicates, Allocator, Augment>::contains(const Key& key) const
 {
     return find_helper(key) != _nil;
 }
 
-template<typename Key, typename T, typename Compare, bool AllowDuplicates>
-typename RedBlackTree<Key, T, Compare, AllowDuplicates>::iterator 
-            RedBlackTree<Key, T, Compare, AllowDuplicates>::lower_bound(const Key& key)
+template<typename Key, typename T, typename Compare, bool AllowDuplicates, typename Allocator, typename Augment>
+void RedBlackTree<Key, T, Compare, AllowDuplicates, Allocator, Augment>::find_batch(std::span<const Key> keys, std::span<iterator> result)
+{
+    find_batch_helper(keys, [&](std::size_t i, Node* node)
+        {
+            result[i] = (node != _nil) ? iterator(node, _nil, _root) : end();
+        });
+}
+
+template<typename Key, typename T, typename Compare, bool AllowDuplicates, typename Allocator, typename Augment>
+void RedBlackTree<Key, T, Compare, AllowDuplicates, Allocator, Augment>::find_batch(std::span<const Key> keys, std::span<const_iterator> result) const
+{
+    find_batch_helper(keys, [&](std::size_t i, Node* node)
+        {
+            result[i] = (node != _nil) ? const_iterator(node, _nil, _root) : end();
+        });
+}
+
+template<typename Key, typename T, typename Compare, bool AllowDuplicates, typename Allocator, typename Augment>
+void RedBlackTree<Key, T, Compare, AllowDuplicates, Allocator, Augment>::contains_batch(std::span<const Key> keys, std::span<bool> result) const
+{
+    find_batch_helper(keys, [&](std::size_t i, Node* node)
+        {
+            result[i] = node != _nil;
+        });
+}
+
+template<typename Key, typename T, typename Compare, bool AllowDuplicates, typename Allocator, typename Augment>
+typename RedBlackTree<Key, T, Compare, AllowDuplicates, Allocator, Augment>::iterator 
+            RedBlackTree<Key, T, Compare, AllowDuplicates, Allocator, Augment>::lower_bound(const Key& key)
 {
     Node* current = _root;
     Node* result = _nil;
@@ -448,9 +1297,9 @@ typename RedBlackTree<Key, T, Compare, AllowDuplicates>::iterator
     return iterator(result, _nil, _root);
 }
 
-template<typename Key, typename T, typename Compare, bool AllowDuplicates>
-typename RedBlackTree<Key, T, Compare, AllowDuplicates>::const_iterator 
-            RedBlackTree<Key, T, Compare, AllowDuplicates>::lower_bound(const Key& key) const
+template<typename Key, typename T, typename Compare, bool AllowDuplicates, typename Allocator, typename Augment>
+typename RedBlackTree<Key, T, Compare, AllowDuplicates, Allocator, Augment>::const_iterator 
+            RedBlackTree<Key, T, Compare, AllowDuplicates, Allocator, Augment>::lower_bound(const Key& key) const
 {
     Node* current = _root;
     Node* result = _nil;
@@ -468,9 +1317,9 @@ typename RedBlackTree<Key, T, Compare, AllowDuplicates>::const_iterator
     return const_iterator(result, _nil, _root);
 }
 
-template<typename Key, typename T, typename Compare, bool AllowDuplicates>
-typename RedBlackTree<Key, T, Compare, AllowDuplicates>::iterator 
-            RedBlackTree<Key, T, Compare, AllowDuplicates>::upper_bound(const Key& key)
+template<typename Key, typename T, typename Compare, bool AllowDuplicates, typename Allocator, typename Augment>
+typename RedBlackTree<Key, T, Compare, AllowDuplicates, Allocator, Augment>::iterator 
+            RedBlackTree<Key, T, Compare, AllowDuplicates, Allocator, Augment>::upper_bound(const Key& key)
 {
     Node* current = _root;
     Node* result = _nil;
@@ -488,9 +1337,9 @@ typename RedBlackTree<Key, T, Compare, AllowDuplicates>::iterator
     return iterator(result, _nil, _root);
 }
 
-template<typename Key, typename T, typename Compare, bool AllowDuplicates>
-typename RedBlackTree<Key, T, Compare, AllowDuplicates>::const_iterator 
-            RedBlackTree<Key, T, Compare, AllowDuplicates>::upper_bound(const Key& key) const
+template<typename Key, typename T, typename Compare, bool AllowDuplicates, typename Allocator, typename Augment>
+typename RedBlackTree<Key, T, Compare, AllowDuplicates, Allocator, Augment>::const_iterator 
+            RedBlackTree<Key, T, Compare, AllowDuplicates, Allocator, Augment>::upper_bound(const Key& key) const
 {
     Node* current = _root;
     Node* result = _nil;
@@ -508,619 +1357,2233 @@ typename RedBlackTree<Key, T, Compare, AllowDuplicates>::const_iterator
     return const_iterator(result, _nil, _root);
 }
 
-template<typename Key, typename T, typename Compare, bool AllowDuplicates>
-inline std::pair<typename RedBlackTree<Key, T, Compare, AllowDuplicates>::iterator, typename RedBlackTree
-    <Key, T, Compare, AllowDuplicates>::iterator> RedBlackTree<Key, T, Compare, AllowDuplicates>::equal_range(const Key& key)
+template<typename Key, typename T, typename Compare, bool AllowDuplicates, typename Allocator, typename Augment>
+inline std::pair<typename RedBlackTree<Key, T, Compare, AllowDuplicates, Allocator, Augment>::iterator, typename RedBlackTree
+    <Key, T, Compare, AllowDuplicates, Allocator, Augment>::iterator> RedBlackTree<Key, T, Compare, AllowDuplicates, Allocator, Augment>::equal_range(const Key& key)
 {
     return { lower_bound(key), upper_bound(key) };
 }
 
-template<typename Key, typename T, typename Compare, bool AllowDuplicates>
-inline std::pair<typename RedBlackTree<Key, T, Compare, AllowDuplicates>::const_iterator, 
-    typename RedBlackTree<Key, T, Compare, AllowDuplicates>::const_iterator> 
-    RedBlackTree<Key, T, Compare, AllowDuplicates>::equal_range(const Key& key) const
+template<typename Key, typename T, typename Compare, bool AllowDuplicates, typename Allocator, typename Augment>
+inline std::pair<typename RedBlackTree<Key, T, Compare, AllowDuplicates, Allocator, Augment>::const_iterator, 
+    typename RedBlackTree<Key, T, Compare, AllowDuplicates, Allocator, Augment>::const_iterator> 
+    RedBlackTree<Key, T, Compare, AllowDuplicates, Allocator, Augment>::equal_range(const Key& key) const
 {
     return { lower_bound(key), upper_bound(key) };
 }
 
-template<typename Key, typename T, typename Compare, bool AllowDuplicates>
-        std::pair<typename RedBlackTree<Key, T, Compare, AllowDuplicates>::iterator, bool> 
-        RedBlackTree<Key, T, Compare, AllowDuplicates>::insert(const value_type& val)
+template<typename Key, typename T, typename Compare, bool AllowDuplicates, typename Allocator, typename Augment>
+typename RedBlackTree<Key, T, Compare, AllowDuplicates, Allocator, Augment>::size_type RedBlackTree<Key, T, Compare, AllowDuplicates, Allocator, Augment>::rank(const Key& key) const requires order_statistics
 {
-    Node* z = create_node(val.first, val.second);
-    Node* y = _nil;
-    Node* x = _root;
-
-    while (x != _nil)
+    size_type result = 0;
+    for (Node* x = _root; x != _nil; )
     {
-        y = x;
-        if (_comp(z->data.first, x->data.first))
-            x = x->left;
-        else if (_comp(x->data.first, z->data.first))
-            x = x->right;
-        else if constexpr (!AllowDuplicates)
+        if (_comp(x->data.first, key))
         {
-            delete z;
-            return { iterator(x, _nil), false };
+            result += subtree_size(x->left) + 1;
+            x = x->right;
         }
         else
-            x = x->right;
+            x = x->left;
     }
+    return result;
+}
 
-    z->parent = y;
-    if (y == _nil)
-        _root = z;
-    else if (_comp(z->data.first, y->data.first))
-        y->left = z;
-    else
-        y->right = z;
+template<typename Key, typename T, typename Compare, bool AllowDuplicates, typename Allocator, typename Augment>
+typename RedBlackTree<Key, T, Compare, AllowDuplicates, Allocator, Augment>::iterator RedBlackTree<Key, T, Compare, AllowDuplicates, Allocator, Augment>::select(size_type k) requires order_statistics
+{
+    return iterator(select_node(_root, _nil, k), _nil, _root);
+}
 
-    insert_fix(z);
-    ++_tree_size;
-    return { iterator(z, _nil), true };
+template<typename Key, typename T, typename Compare, bool AllowDuplicates, typename Allocator, typename Augment>
+typename RedBlackTree<Key, T, Compare, AllowDuplicates, Allocator, Augment>::const_iterator RedBlackTree<Key, T, Compare, AllowDuplicates, Allocator, Augment>::select(size_type k) const requires order_statistics
+{
+    return const_iterator(select_node(_root, _nil, k), _nil, _root);
 }
 
-template<typename Key, typename T, typename Compare, bool AllowDuplicates>
-        std::pair<typename RedBlackTree<Key, T, Compare, AllowDuplicates>::iterator, bool>
-        RedBlackTree<Key, T, Compare, AllowDuplicates>::insert(value_type&& val)
+template<typename Key, typename T, typename Compare, bool AllowDuplicates, typename Allocator, typename Augment>
+typename RedBlackTree<Key, T, Compare, AllowDuplicates, Allocator, Augment>::size_type RedBlackTree<Key, T, Compare, AllowDuplicates, Allocator, Augment>::count_range(const Key& lo, const Key& hi) const requires order_statistics
 {
-    Node* z = create_node(std::move(val.first), std::move(val.second));
-    Node* y = _nil;
-    Node* x = _root;
+    return _comp(lo, hi) ? rank(hi) - rank(lo) : 0;
+}
 
+template<typename Key, typename T, typename Compare, bool AllowDuplicates, typename Allocator, typename Augment>
+typename RedBlackTree<Key, T, Compare, AllowDuplicates, Allocator, Augment>::summary_type RedBlackTree<Key, T, Compare, AllowDuplicates, Allocator, Augment>::aggregate(const Key& lo, const Key& hi) const requires augmented
+{
+    // Спуск до первого узла внутри [lo, hi); дальше две ветви: к lo — копятся правые поддеревья,
+    // к hi — левые. Сводки собираются с краёв к середине, чтобы сохранить порядок элементов
+    Node* x = _root;
     while (x != _nil)
     {
-        y = x;
-        if (_comp(z->data.first, x->data.first))
-            x = x->left;
-        else if (_comp(x->data.first, z->data.first))
+        if (_comp(x->data.first, lo))
             x = x->right;
-        else if constexpr (!AllowDuplicates)
+        else if (!_comp(x->data.first, hi))
+            x = x->left;
+        else
+            break;
+    }
+    if (x == _nil)
+        return Augment::identity();
+
+    summary_type left = Augment::identity();
+    for (Node* y = x->left; y != _nil; )
+    {
+        if (_comp(y->data.first, lo))
+            y = y->right;
+        else
         {
-            delete z;
-            return { iterator(x, _nil), false };
+            left = Augment::combine(Augment::combine(Augment::lift(y->data), y->right->summary), left);
+            y = y->left;
         }
+    }
+
+    summary_type right = Augment::identity();
+    for (Node* y = x->right; y != _nil; )
+    {
+        if (!_comp(y->data.first, hi))
+            y = y->left;
         else
-            x = x->right;
+        {
+            right = Augment::combine(right, Augment::combine(y->left->summary, Augment::lift(y->data)));
+            y = y->right;
+        }
     }
+    return Augment::combine(Augment::combine(left, Augment::lift(x->data)), right);
+}
 
-    z->parent = y;
-    if (y == _nil)
-        _root = z;
-    else if (_comp(z->data.first, y->data.first))
-        y->left = z;
-    else
-        y->right = z;
+template<typename Key, typename T, typename Compare, bool AllowDuplicates, typename Allocator, typename Augment>
+typename RedBlackTree<Key, T, Compare, AllowDuplicates, Allocator, Augment>::summary_type RedBlackTree<Key, T, Compare, AllowDuplicates, Allocator, Augment>::aggregate() const requires augmented
+{
+    return _root->summary;
+}
 
-    insert_fix(z);
-    ++_tree_size;
-    return { iterator(z, _nil), true };
+template<typename Key, typename T, typename Compare, bool AllowDuplicates, typename Allocator, typename Augment>
+void RedBlackTree<Key, T, Compare, AllowDuplicates, Allocator, Augment>::update_summary(const_iterator pos) requires augmented
+{
+    if (pos.node() != _nil)
+        update_path(pos.node());
 }
 
-template<typename Key, typename T, typename Compare, bool AllowDuplicates>
-inline bool RedBlackTree<Key, T, Compare, AllowDuplicates>::erase(const Key& key)
+template<typename Key, typename T, typename Compare, bool AllowDuplicates, typename Allocator, typename Augment>
+        std::pair<typename RedBlackTree<Key, T, Compare, AllowDuplicates, Allocator, Augment>::iterator, bool> 
+        RedBlackTree<Key, T, Compare, AllowDuplicates, Allocator, Augment>::insert(const value_type& val)
 {
-    Node* z = find_helper(key);
-    if (z == _nil)
-        return false;
+    InsertPosition pos = insert_position(val.first);
+    if (pos.exists)
+        return { iterator(pos.node, _nil, _root), false };
+    return link_node(create_node(std::in_place, val), pos);
+}
 
-    delete_node(z);
-    --_tree_size;
-    return true;
+template<typename Key, typename T, typename Compare, bool AllowDuplicates, typename Allocator, typename Augment>
+        std::pair<typename RedBlackTree<Key, T, Compare, AllowDuplicates, Allocator, Augment>::iterator, bool>
+        RedBlackTree<Key, T, Compare, AllowDuplicates, Allocator, Augment>::insert(value_type&& val)
+{
+    InsertPosition pos = insert_position(val.first);
+    if (pos.exists)
+        return { iterator(pos.node, _nil, _root), false };
+    return link_node(create_node(std::in_place, std::move(val)), pos);
 }
 
-template<typename Key, typename T, typename Compare, bool AllowDuplicates>
-typename RedBlackTree<Key, T, Compare, AllowDuplicates>::iterator RedBlackTree<Key, T, Compare, AllowDuplicates>::begin()
+template<typename Key, typename T, typename Compare, bool AllowDuplicates, typename Allocator, typename Augment>
+template<typename InputIt>
+inline void RedBlackTree<Key, T, Compare, AllowDuplicates, Allocator, Augment>::insert(InputIt first, InputIt last)
 {
-    return iterator(minimum(_root), _nil, _root);
+    using category = typename std::iterator_traits<InputIt>::iterator_category;
+    using element = std::decay_t<decltype(key_of(*first))>;
+
+    if constexpr (std::is_base_of<std::forward_iterator_tag, category>::value && std::is_same<element, Key>::value)
+    {
+        if (empty() && is_sorted_unique(first, last))
+        {
+            build_sorted(first, static_cast<size_type>(std::distance(first, last)),
+                [this](auto&& value) { return create_node_from(std::forward<decltype(value)>(value)); });
+            return;
+        }
+    }
+
+    if constexpr (std::is_same<element, Key>::value)
+    {
+        // Соседи последнего вставленного элемента служат подсказкой для следующего:
+        // на упорядоченных и почти упорядоченных данных вставка обходится без спуска от корня
+        Node* prev = nullptr;
+        Node* next = nullptr;
+        for (; first != last; ++first)
+        {
+            auto&& value = *first;
+            InsertPosition pos = prev ? insert_position_between(prev, next, key_of(value)) : InsertPosition{ nullptr, false, false };
+            bool between = pos.node != nullptr;
+            if (!between)
+                pos = insert_position(key_of(value));
+
+            if (pos.exists)
+            {
+                prev = pos.node;
+                next = successor(prev);
+                continue;
+            }
+
+            Node* z = create_node_from(std::forward<decltype(value)>(value));
+            link_node(z, pos);
+            prev = z;
+            if (!between)
+                next = successor(z);
+        }
+    }
+    else
+    {
+        for (; first != last; ++first)
+            emplace(*first);
+    }
 }
 
-template<typename Key, typename T, typename Compare, bool AllowDuplicates>
-typename RedBlackTree<Key, T, Compare, AllowDuplicates>::iterator RedBlackTree<Key, T, Compare, AllowDuplicates>::end()
+template<typename Key, typename T, typename Compare, bool AllowDuplicates, typename Allocator, typename Augment>
+template<typename InputIt>
+inline void RedBlackTree<Key, T, Compare, AllowDuplicates, Allocator, Augment>::assign(InputIt first, InputIt last)
 {
-    return iterator(_nil, _nil, _root);
+    using category = typename std::iterator_traits<InputIt>::iterator_category;
+    using element = std::decay_t<decltype(key_of(*first))>;
+
+    if constexpr (std::is_base_of<std::forward_iterator_tag, category>::value && std::is_same<element, Key>::value)
+    {
+        if (is_sorted_unique(first, last))
+        {
+            assign(sorted_unique, first, last);
+            return;
+        }
+    }
+
+    Node* reuse = detach_nodes();
+    try
+    {
+        for (; first != last; ++first)
+        {
+            Node* z = reuse_node(reuse, *first);
+            InsertPosition pos = insert_position(z->data.first);
+            if (pos.exists)
+            {
+                z->right = reuse;
+                reuse = z;
+            }
+            else
+                link_node(z, pos);
+        }
+    }
+    catch (...)
+    {
+        destroy_detached(reuse);
+        throw;
+    }
+    destroy_detached(reuse);
 }
 
-template<typename Key, typename T, typename Compare, bool AllowDuplicates>
-typename RedBlackTree<Key, T, Compare, AllowDuplicates>::const_iterator 
-            RedBlackTree<Key, T, Compare, AllowDuplicates>::begin() const
+template<typename Key, typename T, typename Compare, bool AllowDuplicates, typename Allocator, typename Augment>
+template<typename InputIt>
+inline void RedBlackTree<Key, T, Compare, AllowDuplicates, Allocator, Augment>::assign(sorted_unique_t, InputIt first, InputIt last)
 {
-    return const_iterator(minimum(_root), _nil, _root);
+    Node* reuse = detach_nodes();
+    auto make = [this, &reuse](auto&& value) { return reuse_node(reuse, std::forward<decltype(value)>(value)); };
+
+    try
+    {
+        using category = typename std::iterator_traits<InputIt>::iterator_category;
+        if constexpr (std::is_base_of<std::forward_iterator_tag, category>::value)
+            build_sorted(first, static_cast<size_type>(std::distance(first, last)), make);
+        else
+            append_sorted(first, last, make);
+    }
+    catch (...)
+    {
+        destroy_detached(reuse);
+        throw;
+    }
+    destroy_detached(reuse);
 }
 
-template<typename Key, typename T, typename Compare, bool AllowDuplicates>
-typename RedBlackTree<Key, T, Compare, AllowDuplicates>::const_iterator RedBlackTree<Key, T, Compare, AllowDuplicates>::end() const
+template<typename Key, typename T, typename Compare, bool AllowDuplicates, typename Allocator, typename Augment>
+template<typename RandomIt, typename Fork>
+inline void RedBlackTree<Key, T, Compare, AllowDuplicates, Allocator, Augment>::assign_parallel(sorted_unique_t, RandomIt first, RandomIt last, Fork&& fork)
 {
-    return const_iterator(_nil, _nil, _root);
+    clear();
+    size_type n = static_cast<size_type>(last - first);
+    if (!parallel_allocator || n < 2 * parallel_grain)
+    {
+        build_sorted(first, n, [this](auto&& value) { return create_node_from(std::forward<decltype(value)>(value)); });
+        return;
+    }
+
+    size_type red_depth = 0;
+    while ((size_type(2) << red_depth) <= n + 1)
+        ++red_depth;
+
+    _root = build_parallel(first, n, 0, red_depth, fork);
+    _root->set_parent(_nil);
+    _tree_size = n;
 }
 
-template<typename Key, typename T, typename Compare, bool AllowDuplicates>
-typename RedBlackTree<Key, T, Compare, AllowDuplicates>::const_iterator 
-            RedBlackTree<Key, T, Compare, AllowDuplicates>::cbegin() const
+template<typename Key, typename T, typename Compare, bool AllowDuplicates, typename Allocator, typename Augment>
+template<typename Fork>
+inline void RedBlackTree<Key, T, Compare, AllowDuplicates, Allocator, Augment>::assign_parallel(const RedBlackTree& other, Fork&& fork)
 {
-    return begin();
+    if (this == &other)
+        return;
+    clear();
+    if (other._root == other._nil)
+        return;
+
+    // Число уровней, на которых копирование делится между задачами: листовые задачи — около parallel_grain узлов
+    size_type n = other.size();
+    size_type levels = 0;
+    if (parallel_allocator)
+    {
+        while ((parallel_grain << levels) < n)
+            ++levels;
+    }
+
+    _root = clone_parallel(other._root, other._nil, levels, fork);
+    _root->set_parent(_nil);
+    _tree_size = n;
 }
 
-template<typename Key, typename T, typename Compare, bool AllowDuplicates>
-typename RedBlackTree<Key, T, Compare, AllowDuplicates>::const_iterator RedBlackTree<Key, T, Compare, AllowDuplicates>::cend() const
+template<typename Key, typename T, typename Compare, bool AllowDuplicates, typename Allocator, typename Augment>
+std::vector<typename RedBlackTree<Key, T, Compare, AllowDuplicates, Allocator, Augment>::const_iterator> 
+            RedBlackTree<Key, T, Compare, AllowDuplicates, Allocator, Augment>::split_points(size_type parts) const
 {
-    return end();
+    // Узлы первых levels уровней делят дерево на 2^levels поддеревьев
+    size_type levels = 0;
+    while ((size_type(1) << levels) < parts)
+        ++levels;
+
+    std::vector<const_iterator> points;
+    collect_split_points(_root, levels, points);
+    return points;
 }
 
-template<typename Key, typename T, typename Compare, bool AllowDuplicates>
-typename RedBlackTree<Key, T, Compare, AllowDuplicates>::reverse_iterator RedBlackTree<Key, T, Compare, AllowDuplicates>::rbegin()
+template<typename Key, typename T, typename Compare, bool AllowDuplicates, typename Allocator, typename Augment>
+typename RedBlackTree<Key, T, Compare, AllowDuplicates, Allocator, Augment>::Range RedBlackTree<Key, T, Compare, AllowDuplicates, Allocator, Augment>::range(size_type grain) const
 {
-    return reverse_iterator(end());
+    return Range(this, minimum(_root), _nil, size(), grain);
 }
 
-template<typename Key, typename T, typename Compare, bool AllowDuplicates>
-typename RedBlackTree<Key, T, Compare, AllowDuplicates>::reverse_iterator RedBlackTree<Key, T, Compare, AllowDuplicates>::rend()
+template<typename Key, typename T, typename Compare, bool AllowDuplicates, typename Allocator, typename Augment>
+typename RedBlackTree<Key, T, Compare, AllowDuplicates, Allocator, Augment>::Range RedBlackTree<Key, T, Compare, AllowDuplicates, Allocator, Augment>::range(const Key& lo, const Key& hi, size_type grain) const
 {
-    return reverse_iterator(begin());
+    if (!_comp(lo, hi))
+        return Range(this, _nil, _nil, 0, grain);
+
+    Node* first = lower_bound(lo).node();
+    Node* last = lower_bound(hi).node();
+    // Без размеров поддеревьев число ключей в [lo, hi) неизвестно без обхода — оценка сверху
+    size_type count;
+    if constexpr (order_statistics)
+        count = count_range(lo, hi);
+    else
+        count = (first == last) ? 0 : size();
+    return Range(this, first, last, count, grain);
 }
 
-template<typename Key, typename T, typename Compare, bool AllowDuplicates>
-typename RedBlackTree<Key, T, Compare, AllowDuplicates>::const_reverse_iterator 
-            RedBlackTree<Key, T, Compare, AllowDuplicates>::rbegin() const
+template<typename Key, typename T, typename Compare, bool AllowDuplicates, typename Allocator, typename Augment>
+inline RedBlackTree<Key, T, Compare, AllowDuplicates, Allocator, Augment>::Range::Range(const RedBlackTree* tree, Node* first, Node* last, size_type size, size_type grain)
+    : _tree(tree)
+    , _first(first)
+    , _last(last)
+    , _size(size)
+    , _grain(std::max<size_type>(grain, 1))
 {
-    return const_reverse_iterator(end());
 }
 
-template<typename Key, typename T, typename Compare, bool AllowDuplicates>
-typename RedBlackTree<Key, T, Compare, AllowDuplicates>::const_reverse_iterator 
-            RedBlackTree<Key, T, Compare, AllowDuplicates>::rend() const
+template<typename Key, typename T, typename Compare, bool AllowDuplicates, typename Allocator, typename Augment>
+template<typename Split>
+    requires std::is_empty_v<Split>
+inline RedBlackTree<Key, T, Compare, AllowDuplicates, Allocator, Augment>::Range::Range(Range& other, Split)
+    : Range(other.split())
 {
-    return const_reverse_iterator(begin());
 }
 
-template<typename Key, typename T, typename Compare, bool AllowDuplicates>
-typename RedBlackTree<Key, T, Compare, AllowDuplicates>::const_reverse_iterator 
-            RedBlackTree<Key, T, Compare, AllowDuplicates>::crbegin() const
+template<typename Key, typename T, typename Compare, bool AllowDuplicates, typename Allocator, typename Augment>
+inline typename RedBlackTree<Key, T, Compare, AllowDuplicates, Allocator, Augment>::const_iterator RedBlackTree<Key, T, Compare, AllowDuplicates, Allocator, Augment>::Range::begin() const
 {
-    return rbegin();
+    return const_iterator(_first, _tree->_nil, _tree->_root);
 }
 
-template<typename Key, typename T, typename Compare, bool AllowDuplicates>
-typename RedBlackTree<Key, T, Compare, AllowDuplicates>::const_reverse_iterator 
-            RedBlackTree<Key, T, Compare, AllowDuplicates>::crend() const
+template<typename Key, typename T, typename Compare, bool AllowDuplicates, typename Allocator, typename Augment>
+inline typename RedBlackTree<Key, T, Compare, AllowDuplicates, Allocator, Augment>::const_iterator RedBlackTree<Key, T, Compare, AllowDuplicates, Allocator, Augment>::Range::end() const
 {
-    return rend();
+    return const_iterator(_last, _tree->_nil, _tree->_root);
 }
 
-template<typename Key, typename T, typename Compare, bool AllowDuplicates>
-inline std::vector<typename RedBlackTree<Key, T, Compare, AllowDuplicates>::value_type> 
-            RedBlackTree<Key, T, Compare, AllowDuplicates>::inorder() const
+template<typename Key, typename T, typename Compare, bool AllowDuplicates, typename Allocator, typename Augment>
+inline bool RedBlackTree<Key, T, Compare, AllowDuplicates, Allocator, Augment>::Range::empty() const
 {
-    std::vector<value_type> result;
-    inorder([&](const_reference value) { result.push_back(value); });
-    return result;
+    return _first == _last;
 }
 
-template<typename Key, typename T, typename Compare, bool AllowDuplicates>
-inline std::vector<typename RedBlackTree<Key, T, Compare, AllowDuplicates>::value_type> 
-            RedBlackTree<Key, T, Compare, AllowDuplicates>::preorder() const
+template<typename Key, typename T, typename Compare, bool AllowDuplicates, typename Allocator, typename Augment>
+inline typename RedBlackTree<Key, T, Compare, AllowDuplicates, Allocator, Augment>::size_type RedBlackTree<Key, T, Compare, AllowDuplicates, Allocator, Augment>::Range::size() const
 {
-    std::vector<value_type> result;
-    preorder([&](const_reference value) { result.push_back(value); });
-    return result;
+    return _size;
 }
 
-template<typename Key, typename T, typename Compare, bool AllowDuplicates>
-inline std::vector<typename RedBlackTree<Key, T, Compare, AllowDuplicates>::value_type> 
-            RedBlackTree<Key, T, Compare, AllowDuplicates>::postorder() const
+template<typename Key, typename T, typename Compare, bool AllowDuplicates, typename Allocator, typename Augment>
+inline typename RedBlackTree<Key, T, Compare, AllowDuplicates, Allocator, Augment>::size_type RedBlackTree<Key, T, Compare, AllowDuplicates, Allocator, Augment>::Range::grainsize() const
 {
-    std::vector<value_type> result;
-    postorder([&](const_reference value) { result.push_back(value); });
-    return result;
+    return _grain;
 }
 
-template<typename Key, typename T, typename Compare, bool AllowDuplicates>
-inline std::vector<typename RedBlackTree<Key, T, Compare, AllowDuplicates>::value_type> 
-            RedBlackTree<Key, T, Compare, AllowDuplicates>::levelorder() const
+template<typename Key, typename T, typename Compare, bool AllowDuplicates, typename Allocator, typename Augment>
+inline bool RedBlackTree<Key, T, Compare, AllowDuplicates, Allocator, Augment>::Range::is_divisible() const
 {
-    std::vector<value_type> result;
-    levelorder([&](const_reference value) { result.push_back(value); });
-    return result;
+    if (_size <= _grain || _first == _last)
+        return false;
+    if constexpr (order_statistics)
+        return true;
+    else
+        return _tree->successor(_first) != _last;
 }
 
-template<typename Key, typename T, typename Compare, bool AllowDuplicates>
-typename RedBlackTree<Key, T, Compare, AllowDuplicates>::Node* 
-            RedBlackTree<Key, T, Compare, AllowDuplicates>::minimum(Node* x) const
+template<typename Key, typename T, typename Compare, bool AllowDuplicates, typename Allocator, typename Augment>
+typename RedBlackTree<Key, T, Compare, AllowDuplicates, Allocator, Augment>::Range RedBlackTree<Key, T, Compare, AllowDuplicates, Allocator, Augment>::Range::split()
 {
-    while (x != _nil && x->left != _nil)
-        x = x->left;
-    return x;
+    Node* middle = split_node();
+    if (middle == _tree->_nil)
+        return Range(_tree, _last, _last, 0, _grain);
+
+    size_type left_size = _size / 2;
+    Range right(_tree, middle, _last, _size - left_size, _grain);
+    _last = middle;
+    _size = left_size;
+    return right;
 }
 
-template<typename Key, typename T, typename Compare, bool AllowDuplicates>
-typename RedBlackTree<Key, T, Compare, AllowDuplicates>::Node* 
-            RedBlackTree<Key, T, Compare, AllowDuplicates>::maximum(Node* x) const
+template<typename Key, typename T, typename Compare, bool AllowDuplicates, typename Allocator, typename Augment>
+typename RedBlackTree<Key, T, Compare, AllowDuplicates, Allocator, Augment>::Node* RedBlackTree<Key, T, Compare, AllowDuplicates, Allocator, Augment>::Range::split_node() const
 {
-    while (x != _nil && x->right != _nil)
-        x = x->right;
-    return x;
+    // Первый элемент правой половины; _nil, если делить нечего. Левая половина никогда не пуста
+    Node* nil = _tree->_nil;
+    if (_first == _last || _size < 2)
+        return nil;
+
+    if constexpr (order_statistics)
+    {
+        Node* root = _tree->_root;
+        size_type index = node_index(_first, nil, root);
+        return select_node(_tree->_root, nil, index + _size / 2);
+    }
+    else
+    {
+        // Общий предок крайних элементов лежит между ними; если это сам первый, остальные — в его
+        // правом поддереве, и граница — их общий предок
+        Node* back = (_last == nil) ? _tree->maximum(_tree->_root) : _tree->predecessor(_last);
+        if (back == _first)
+            return nil;
+        Node* middle = common_ancestor(_first, back, nil);
+        if (middle == _first)
+            middle = common_ancestor(_tree->minimum(_first->right), back, nil);
+        return middle;
+    }
 }
 
-template<typename Key, typename T, typename Compare, bool AllowDuplicates>
-inline void RedBlackTree<Key, T, Compare, AllowDuplicates>::clear_helper(Node* node)
+template<typename Key, typename T, typename Compare, bool AllowDuplicates, typename Allocator, typename Augment>
+typename RedBlackTree<Key, T, Compare, AllowDuplicates, Allocator, Augment>::Node* RedBlackTree<Key, T, Compare, AllowDuplicates, Allocator, Augment>::Range::common_ancestor(Node* a, Node* b, Node* nil)
 {
-    if (node == _nil)
+    auto depth = [nil](Node* x)
+        {
+            size_type d = 0;
+            for (x = x->parent(); x != nil; x = x->parent())
+                ++d;
+            return d;
+        };
+
+    size_type da = depth(a);
+    size_type db = depth(b);
+    for (; da > db; --da)
+        a = a->parent();
+    for (; db > da; --db)
+        b = b->parent();
+    while (a != b)
+    {
+        a = a->parent();
+        b = b->parent();
+    }
+    return a;
+}
+
+template<typename Key, typename T, typename Compare, bool AllowDuplicates, typename Allocator, typename Augment>
+void RedBlackTree<Key, T, Compare, AllowDuplicates, Allocator, Augment>::collect_split_points(const Node* x, size_type levels, std::vector<const_iterator>& points) const
+{
+    if (levels == 0 || x == _nil)
         return;
-    clear_helper(node->left);
-    clear_helper(node->right);
-    delete node;
+    collect_split_points(x->left, levels - 1, points);
+    points.push_back(const_iterator(const_cast<Node*>(x), _nil, _root));
+    collect_split_points(x->right, levels - 1, points);
 }
 
-template<typename Key, typename T, typename Compare, bool AllowDuplicates>
-inline void RedBlackTree<Key, T, Compare, AllowDuplicates>::insert_fix(Node* z)
+template<typename Key, typename T, typename Compare, bool AllowDuplicates, typename Allocator, typename Augment>
+template<typename RandomIt>
+void RedBlackTree<Key, T, Compare, AllowDuplicates, Allocator, Augment>::apply_sorted(RandomIt first, RandomIt last) requires (!AllowDuplicates)
 {
-    while (z->parent && z->parent->color == RED)
+    size_type m = static_cast<size_type>(last - first);
+    size_type n = size();
+    if (m == 0)
+        return;
+    // Те же пороги, что у операций над множествами: m поисков по O(log n) против прохода по n узлам
+    if (m >= n / static_cast<size_type>(std::bit_width(n) + 1))
+    {
+        merge_sorted(first, last);
+        return;
+    }
+
+    // finger — узел с ключом меньше следующего в пакете, nullptr — искать от корня
+    Node* finger = nullptr;
+    for (; first != last; ++first)
     {
-        if (z->parent == z->parent->parent->left)
+        const Key& key = first->first;
+        Node* pos = finger ? lower_bound_from(finger, key) : lower_bound(key).node();
+        bool exists = (pos != _nil) && !_comp(key, pos->data.first);
+
+        if (first->second)
         {
-            Node* y = z->parent->parent->right;
-            if (y->color == RED)
+            if (exists)
             {
-                z->parent->color = BLACK;
-                y->color = BLACK;
-                z->parent->parent->color = RED;
-                z = z->parent->parent;
+                finger = pos;
+                continue;
             }
+            // Новый узел — непосредственно перед pos: левый ребёнок pos или правый его предшественника
+            InsertPosition where;
+            if (pos == _nil)
+                where = { maximum(_root), false, false };
+            else if (pos->left == _nil)
+                where = { pos, true, false };
             else
+                where = { maximum(pos->left), false, false };
+            finger = link_node(create_node_from(std::move(first->first)), where).first.node();
+        }
+        else
+        {
+            Node* prev = (pos == _nil) ? maximum(_root) : predecessor(pos);
+            if (exists)
             {
-                if (z == z->parent->right)
-                {
-                    z = z->parent;
-                    rotate_left(z);
-                }
-                z->parent->color = BLACK;
-                z->parent->parent->color = RED;
-                rotate_right(z->parent->parent);
+                delete_node(pos);
+                adjust_size(-1);
             }
+            finger = (prev != _nil) ? prev : nullptr;
         }
-        else
+    }
+}
+
+template<typename Key, typename T, typename Compare, bool AllowDuplicates, typename Allocator, typename Augment>
+template<typename RandomIt>
+void RedBlackTree<Key, T, Compare, AllowDuplicates, Allocator, Augment>::merge_sorted(RandomIt first, RandomIt last)
+{
+    // Всё, что может бросить, делается до того, как дерево тронуто: создаются узлы вставок, а проход
+    // по нетронутому дереву записывает для каждой операции, сколько узлов меньше её ключа и есть ли ключ.
+    // Если бросят аллокация или компаратор, дерево не изменено. Место под указатели и шаги резервируется
+    // до первого узла, чтобы push_back не бросал с узлом на руках
+    struct Step
+    {
+        size_type preceding;
+        bool exists;
+    };
+    std::vector<Node*> created;
+    std::vector<Step> steps;
+    created.reserve(static_cast<size_type>(last - first));
+    steps.reserve(static_cast<size_type>(last - first));
+    try
+    {
+        for (RandomIt it = first; it != last; ++it)
+        {
+            if (it->second)
+                created.push_back(create_node_from(std::move(it->first)));
+        }
+
+        Node* node = minimum(_root);
+        size_type preceding = 0;
+        size_type next_created = 0;
+        for (RandomIt it = first; it != last; ++it)
+        {
+            const Key& key = it->second ? created[next_created++]->data.first : it->first;
+            for (; node != _nil && _comp(node->data.first, key); node = successor(node))
+                ++preceding;
+            steps.push_back({ preceding, node != _nil && !_comp(key, node->data.first) });
+        }
+    }
+    catch (...)
+    {
+        for (Node* node : created)
+            destroy_node(node);
+        throw;
+    }
+
+    // detach_nodes отдаёт узлы по убыванию — разворачиваем
+    Node* list = detach_nodes();
+    Node* tree = nullptr;
+    while (list)
+    {
+        Node* node = list;
+        list = list->right;
+        node->right = tree;
+        tree = node;
+    }
+
+    // Слияние двух упорядоченных последовательностей в список по right — по записанным шагам, без сравнений
+    Node* head = nullptr;
+    Node** tail = &head;
+    size_type kept = 0;
+    auto append = [&](Node* node)
+        {
+            *tail = node;
+            tail = &node->right;
+            ++kept;
+        };
+
+    size_type taken = 0;
+    size_type next_created = 0;
+    for (const Step& step : steps)
+    {
+        for (; taken < step.preceding; ++taken)
+        {
+            Node* next = tree->right;
+            append(tree);
+            tree = next;
+        }
+
+        Node* inserted = (first++)->second ? created[next_created++] : nullptr;
+        if (inserted)
+        {
+            if (step.exists)
+                destroy_node(inserted);
+            else
+                append(inserted);
+        }
+        else if (step.exists)
+        {
+            Node* next = tree->right;
+            destroy_node(tree);
+            tree = next;
+            ++taken;
+        }
+    }
+    while (tree)
+    {
+        Node* next = tree->right;
+        append(tree);
+        tree = next;
+    }
+    *tail = nullptr;
+
+    struct ListIterator
+    {
+        Node* node;
+
+        Node* operator*() const { return node; }
+        ListIterator& operator++() { node = node->right; return *this; }
+    };
+
+    build_sorted(ListIterator{ head }, kept, [](Node* node) { return node; });
+}
+
+template<typename Key, typename T, typename Compare, bool AllowDuplicates, typename Allocator, typename Augment>
+inline bool RedBlackTree<Key, T, Compare, AllowDuplicates, Allocator, Augment>::erase(const Key& key)
+{
+    Node* z = find_helper(key);
+    if (z == _nil)
+        return false;
+
+    delete_node(z);
+    adjust_size(-1);
+    return true;
+}
+
+template<typename Key, typename T, typename Compare, bool AllowDuplicates, typename Allocator, typename Augment>
+inline typename RedBlackTree<Key, T, Compare, AllowDuplicates, Allocator, Augment>::iterator 
+            RedBlackTree<Key, T, Compare, AllowDuplicates, Allocator, Augment>::erase(const_iterator pos)
+{
+    Node* z = pos.node();
+    if (z == _nil)
+        return end();
+
+    Node* next = successor(z);
+    delete_node(z);
+    adjust_size(-1);
+    return iterator(next, _nil, _root);
+}
+
+template<typename Key, typename T, typename Compare, bool AllowDuplicates, typename Allocator, typename Augment>
+typename RedBlackTree<Key, T, Compare, AllowDuplicates, Allocator, Augment>::iterator 
+            RedBlackTree<Key, T, Compare, AllowDuplicates, Allocator, Augment>::erase(const_iterator first, const_iterator last)
+{
+    Node* from = first.node();
+    Node* to = last.node();
+    if (from == to)
+        return iterator(to, _nil, _root);
+
+    if (from == minimum(_root) && to == _nil)
+    {
+        clear();
+        return end();
+    }
+
+    size_type count = 0;
+    for (Node* node = from; node != to; node = successor(node))
+        ++count;
+
+    // Если удаляется большая часть дерева, дешевле собрать заново оставшиеся узлы за O(n),
+    // чем выполнять erase_fix для каждого удаляемого
+    if (count > size() / 2)
+    {
+        rebuild_without(from, to, count);
+        return iterator(to, _nil, _root);
+    }
+
+    while (from != to)
+    {
+        Node* next = successor(from);
+        delete_node(from);
+        adjust_size(-1);
+        from = next;
+    }
+    return iterator(to, _nil, _root);
+}
+
+template<typename Key, typename T, typename Compare, bool AllowDuplicates, typename Allocator, typename Augment>
+inline typename RedBlackTree<Key, T, Compare, AllowDuplicates, Allocator, Augment>::node_type 
+            RedBlackTree<Key, T, Compare, AllowDuplicates, Allocator, Augment>::extract(const_iterator pos)
+{
+    Node* z = pos.node();
+    unlink_node(z);
+    adjust_size(-1);
+    return node_type(z, _alloc);
+}
+
+template<typename Key, typename T, typename Compare, bool AllowDuplicates, typename Allocator, typename Augment>
+inline typename RedBlackTree<Key, T, Compare, AllowDuplicates, Allocator, Augment>::node_type 
+            RedBlackTree<Key, T, Compare, AllowDuplicates, Allocator, Augment>::extract(const Key& key)
+{
+    Node* z = find_helper(key);
+    if (z == _nil)
+        return node_type();
+    return extract(const_iterator(z, _nil, _root));
+}
+
+template<typename Key, typename T, typename Compare, bool AllowDuplicates, typename Allocator, typename Augment>
+inline typename RedBlackTree<Key, T, Compare, AllowDuplicates, Allocator, Augment>::insert_return_type 
+            RedBlackTree<Key, T, Compare, AllowDuplicates, Allocator, Augment>::insert(node_type&& nh)
+{
+    if (nh.empty())
+        return { end(), false, node_type() };
+
+    InsertPosition pos = insert_position(nh._node->data.first);
+    if (pos.exists)
+        return { iterator(pos.node, _nil, _root), false, std::move(nh) };
+
+    Node* z = nh.release();
+    z->left = z->right = _nil;
+    z->set_color(RED);
+    return { link_node(z, pos).first, true, node_type() };
+}
+
+template<typename Key, typename T, typename Compare, bool AllowDuplicates, typename Allocator, typename Augment>
+inline typename RedBlackTree<Key, T, Compare, AllowDuplicates, Allocator, Augment>::iterator 
+            RedBlackTree<Key, T, Compare, AllowDuplicates, Allocator, Augment>::insert(const_iterator hint, node_type&& nh)
+{
+    if (nh.empty())
+        return end();
+
+    InsertPosition pos = find_position(hint.node(), nh._node->data.first);
+    if (pos.exists)
+        return iterator(pos.node, _nil, _root);
+
+    Node* z = nh.release();
+    z->left = z->right = _nil;
+    z->set_color(RED);
+    return link_node(z, pos).first;
+}
+
+template<typename Key, typename T, typename Compare, bool AllowDuplicates, typename Allocator, typename Augment>
+inline void RedBlackTree<Key, T, Compare, AllowDuplicates, Allocator, Augment>::merge(RedBlackTree& source)
+{
+    if (this == &source)
+        return;
+
+    // Источник упорядочен: соседи последнего перенесённого узла служат подсказкой для следующего
+    Node* prev = nullptr;
+    Node* next = nullptr;
+    Node* node = source.minimum(source._root);
+    while (node != source._nil)
+    {
+        Node* following = source.successor(node);
+
+        InsertPosition pos = prev ? insert_position_between(prev, next, node->data.first) : InsertPosition{ nullptr, false, false };
+        bool between = pos.node != nullptr;
+        if (!between)
+            pos = insert_position(node->data.first);
+
+        if (pos.exists)
+        {
+            prev = pos.node;
+            next = successor(prev);
+        }
+        else
+        {
+            source.unlink_node(node);
+            source.adjust_size(-1);
+            node->left = node->right = _nil;
+            node->set_color(RED);
+            link_node(node, pos);
+            prev = node;
+            if (!between)
+                next = successor(node);
+        }
+        node = following;
+    }
+}
+
+template<typename Key, typename T, typename Compare, bool AllowDuplicates, typename Allocator, typename Augment>
+inline void RedBlackTree<Key, T, Compare, AllowDuplicates, Allocator, Augment>::merge(RedBlackTree&& source)
+{
+    merge(source);
+}
+
+template<typename Key, typename T, typename Compare, bool AllowDuplicates, typename Allocator, typename Augment>
+std::pair<RedBlackTree<Key, T, Compare, AllowDuplicates, Allocator, Augment>, RedBlackTree<Key, T, Compare, AllowDuplicates, Allocator, Augment>>
+            RedBlackTree<Key, T, Compare, AllowDuplicates, Allocator, Augment>::split(const Key& key)
+{
+    std::pair<RedBlackTree, RedBlackTree> result(std::piecewise_construct,
+        std::forward_as_tuple(_comp, get_allocator()), std::forward_as_tuple(_comp, get_allocator()));
+    if (_root == _nil)
+        return result;
+
+    // Путь поиска key проходится снизу вверх: каждый узел с поддеревьем по другую сторону пути
+    // приклеивается к уже собранной части. Высоты склеиваемых частей растут, и суммарно это O(log n)
+    Node* last = _nil;
+    for (Node* x = _root; x != _nil; x = _comp(x->data.first, key) ? x->right : x->left)
+        last = x;
+
+    Node* left = _nil;
+    Node* right = _nil;
+    size_type left_h = 0;
+    size_type right_h = 0;
+    size_type child_h = 0;  // чёрная высота детей текущего узла
+    for (Node* x = last; x != _nil; )
+    {
+        Node* parent = x->parent();
+        size_type x_h = child_h + (x->color() == BLACK ? 1 : 0);
+        size_type sub_h = child_h;
+        if (_comp(x->data.first, key))
+        {
+            Node* sub = detach_subtree(x->left, sub_h);
+            left = join_roots(sub, sub_h, x, left, left_h, left_h);
+        }
+        else
+        {
+            Node* sub = detach_subtree(x->right, sub_h);
+            right = join_roots(right, right_h, x, sub, sub_h, right_h);
+        }
+        child_h = x_h;
+        x = parent;
+    }
+
+    result.first._root = left;
+    result.second._root = right;
+    if constexpr (order_statistics)
+    {
+        result.first._tree_size = subtree_size(left);
+        result.second._tree_size = subtree_size(right);
+    }
+    else
+    {
+        result.first._tree_size = (right == _nil) ? _tree_size : (left == _nil) ? 0 : unknown_size;
+        result.second._tree_size = (left == _nil) ? _tree_size : (right == _nil) ? 0 : unknown_size;
+    }
+    _root = _nil;
+    _tree_size = 0;
+    return result;
+}
+
+template<typename Key, typename T, typename Compare, bool AllowDuplicates, typename Allocator, typename Augment>
+RedBlackTree<Key, T, Compare, AllowDuplicates, Allocator, Augment>
+            RedBlackTree<Key, T, Compare, AllowDuplicates, Allocator, Augment>::join(RedBlackTree&& left, RedBlackTree&& right)
+{
+    if (right._root == right._nil)
+        return std::move(left);
+    if (left._root == left._nil)
+        return std::move(right);
+
+    // Наибольший узел left становится средним
+    size_type total = (left._tree_size == unknown_size || right._tree_size == unknown_size)
+        ? unknown_size : left._tree_size + right._tree_size;
+    Node* mid = left.maximum(left._root);
+    left.unlink_node(mid);
+
+    size_type h = 0;
+    Node* root = left.join_roots(left._root, left.black_height(left._root), mid, right._root, right.black_height(right._root), h);
+    RedBlackTree result(std::move(left));
+    result._root = root;
+    result._tree_size = total;
+    right._root = right._nil;
+    right._tree_size = 0;
+    return result;
+}
+
+template<typename Key, typename T, typename Compare, bool AllowDuplicates, typename Allocator, typename Augment>
+template<typename V>
+RedBlackTree<Key, T, Compare, AllowDuplicates, Allocator, Augment>
+            RedBlackTree<Key, T, Compare, AllowDuplicates, Allocator, Augment>::join(RedBlackTree&& left, V&& middle, RedBlackTree&& right)
+{
+    size_type total = (left._tree_size == unknown_size || right._tree_size == unknown_size)
+        ? unknown_size : left._tree_size + right._tree_size + 1;
+    Node* mid = left.create_node_from(std::forward<V>(middle));
+
+    size_type h = 0;
+    Node* root = left.join_roots(left._root, left.black_height(left._root), mid, right._root, right.black_height(right._root), h);
+    RedBlackTree result(std::move(left));
+    result._root = root;
+    result._tree_size = total;
+    right._root = right._nil;
+    right._tree_size = 0;
+    return result;
+}
+
+template<typename Key, typename T, typename Compare, bool AllowDuplicates, typename Allocator, typename Augment>
+template<typename InputIt>
+void RedBlackTree<Key, T, Compare, AllowDuplicates, Allocator, Augment>::split_join(InputIt first, InputIt last,
+    bool left_only, bool both, bool right_only) requires (!AllowDuplicates)
+{
+    // result — собранная часть с ключами меньше текущего, rest — ещё не разрезанный остаток.
+    // Узлы переходят между деревьями с копиями нашего аллокатора, само дерево в конце забирает корень result
+    auto adopt = [this](RedBlackTree& from)
+        {
+            _root = from._root;
+            _tree_size = from._tree_size;
+            from._root = from._nil;
+            from._tree_size = 0;
+        };
+
+    const size_type total = _tree_size;
+    size_type present = 0;
+    size_type kept = 0;
+    RedBlackTree result(_comp, get_allocator());
+    RedBlackTree rest(_comp, get_allocator());
+    rest._root = _root;
+    rest._tree_size = total;
+    _root = _nil;
+    _tree_size = 0;
+    try
+    {
+        for (; first != last; ++first)
+        {
+            auto parts = rest.split(first->first);
+            rest = std::move(parts.second);
+            if (left_only)
+                result = join(std::move(result), std::move(parts.first));
+
+            // Ключ, если он есть в дереве, — наименьший в rest
+            Node* node = minimum(rest._root);
+            if (node != _nil && !_comp(first->first, node->data.first))
+            {
+                ++present;
+                rest.unlink_node(node);
+                rest.adjust_size(-1);
+                if (both)
+                {
+                    size_type h = 0;
+                    result._root = result.join_roots(result._root, result.black_height(result._root), node, _nil, 0, h);
+                    result.adjust_size(1);
+                    ++kept;
+                }
+                else
+                {
+                    destroy_node(node);
+                }
+            }
+            else if (right_only)
+            {
+                result = join(std::move(result), *first, RedBlackTree(_comp, get_allocator()));
+                ++kept;
+            }
+        }
+    }
+    catch (...)
+    {
+        // Бросил компаратор или аллокация: склеиваем то, что есть, — дерево остаётся корректным
+        RedBlackTree joined = join(std::move(result), std::move(rest));
+        adopt(joined);
+        throw;
+    }
+
+    if (left_only)
+        result = join(std::move(result), std::move(rest));
+    adopt(result);
+    if (!left_only)
+        _tree_size = kept;
+    else if (total != unknown_size)
+        _tree_size = total - present + kept;
+}
+
+template<typename Key, typename T, typename Compare, bool AllowDuplicates, typename Allocator, typename Augment>
+typename RedBlackTree<Key, T, Compare, AllowDuplicates, Allocator, Augment>::iterator RedBlackTree<Key, T, Compare, AllowDuplicates, Allocator, Augment>::begin()
+{
+    return iterator(minimum(_root), _nil, _root);
+}
+
+template<typename Key, typename T, typename Compare, bool AllowDuplicates, typename Allocator, typename Augment>
+typename RedBlackTree<Key, T, Compare, AllowDuplicates, Allocator, Augment>::iterator RedBlackTree<Key, T, Compare, AllowDuplicates, Allocator, Augment>::end()
+{
+    return iterator(_nil, _nil, _root);
+}
+
+template<typename Key, typename T, typename Compare, bool AllowDuplicates, typename Allocator, typename Augment>
+typename RedBlackTree<Key, T, Compare, AllowDuplicates, Allocator, Augment>::const_iterator 
+            RedBlackTree<Key, T, Compare, AllowDuplicates, Allocator, Augment>::begin() const
+{
+    return const_iterator(minimum(_root), _nil, _root);
+}
+
+template<typename Key, typename T, typename Compare, bool AllowDuplicates, typename Allocator, typename Augment>
+typename RedBlackTree<Key, T, Compare, AllowDuplicates, Allocator, Augment>::const_iterator RedBlackTree<Key, T, Compare, AllowDuplicates, Allocator, Augment>::end() const
+{
+    return const_iterator(_nil, _nil, _root);
+}
+
+template<typename Key, typename T, typename Compare, bool AllowDuplicates, typename Allocator, typename Augment>
+typename RedBlackTree<Key, T, Compare, AllowDuplicates, Allocator, Augment>::const_iterator 
+            RedBlackTree<Key, T, Compare, AllowDuplicates, Allocator, Augment>::cbegin() const
+{
+    return begin();
+}
+
+template<typename Key, typename T, typename Compare, bool AllowDuplicates, typename Allocator, typename Augment>
+typename RedBlackTree<Key, T, Compare, AllowDuplicates, Allocator, Augment>::const_iterator RedBlackTree<Key, T, Compare, AllowDuplicates, Allocator, Augment>::cend() const
+{
+    return end();
+}
+
+template<typename Key, typename T, typename Compare, bool AllowDuplicates, typename Allocator, typename Augment>
+typename RedBlackTree<Key, T, Compare, AllowDuplicates, Allocator, Augment>::reverse_iterator RedBlackTree<Key, T, Compare, AllowDuplicates, Allocator, Augment>::rbegin()
+{
+    return reverse_iterator(end());
+}
+
+template<typename Key, typename T, typename Compare, bool AllowDuplicates, typename Allocator, typename Augment>
+typename RedBlackTree<Key, T, Compare, AllowDuplicates, Allocator, Augment>::reverse_iterator RedBlackTree<Key, T, Compare, AllowDuplicates, Allocator, Augment>::rend()
+{
+    return reverse_iterator(begin());
+}
+
+template<typename Key, typename T, typename Compare, bool AllowDuplicates, typename Allocator, typename Augment>
+typename RedBlackTree<Key, T, Compare, AllowDuplicates, Allocator, Augment>::const_reverse_iterator 
+            RedBlackTree<Key, T, Compare, AllowDuplicates, Allocator, Augment>::rbegin() const
+{
+    return const_reverse_iterator(end());
+}
+
+template<typename Key, typename T, typename Compare, bool AllowDuplicates, typename Allocator, typename Augment>
+typename RedBlackTree<Key, T, Compare, AllowDuplicates, Allocator, Augment>::const_reverse_iterator 
+            RedBlackTree<Key, T, Compare, AllowDuplicates, Allocator, Augment>::rend() const
+{
+    return const_reverse_iterator(begin());
+}
+
+template<typename Key, typename T, typename Compare, bool AllowDuplicates, typename Allocator, typename Augment>
+typename RedBlackTree<Key, T, Compare, AllowDuplicates, Allocator, Augment>::const_reverse_iterator 
+            RedBlackTree<Key, T, Compare, AllowDuplicates, Allocator, Augment>::crbegin() const
+{
+    return rbegin();
+}
+
+template<typename Key, typename T, typename Compare, bool AllowDuplicates, typename Allocator, typename Augment>
+typename RedBlackTree<Key, T, Compare, AllowDuplicates, Allocator, Augment>::const_reverse_iterator 
+            RedBlackTree<Key, T, Compare, AllowDuplicates, Allocator, Augment>::crend() const
+{
+    return rend();
+}
+
+template<typename Key, typename T, typename Compare, bool AllowDuplicates, typename Allocator, typename Augment>
+inline std::vector<typename RedBlackTree<Key, T, Compare, AllowDuplicates, Allocator, Augment>::value_type> 
+            RedBlackTree<Key, T, Compare, AllowDuplicates, Allocator, Augment>::inorder() const
+{
+    std::vector<value_type> result;
+    result.reserve(size());
+    inorder([&](const_reference value) { result.push_back(value); });
+    return result;
+}
+
+template<typename Key, typename T, typename Compare, bool AllowDuplicates, typename Allocator, typename Augment>
+inline std::vector<typename RedBlackTree<Key, T, Compare, AllowDuplicates, Allocator, Augment>::value_type> 
+            RedBlackTree<Key, T, Compare, AllowDuplicates, Allocator, Augment>::preorder() const
+{
+    std::vector<value_type> result;
+    result.reserve(size());
+    preorder([&](const_reference value) { result.push_back(value); });
+    return result;
+}
+
+template<typename Key, typename T, typename Compare, bool AllowDuplicates, typename Allocator, typename Augment>
+inline std::vector<typename RedBlackTree<Key, T, Compare, AllowDuplicates, Allocator, Augment>::value_type> 
+            RedBlackTree<Key, T, Compare, AllowDuplicates, Allocator, Augment>::postorder() const
+{
+    std::vector<value_type> result;
+    result.reserve(size());
+    postorder([&](const_reference value) { result.push_back(value); });
+    return result;
+}
+
+template<typename Key, typename T, typename Compare, bool AllowDuplicates, typename Allocator, typename Augment>
+inline std::vector<typename RedBlackTree<Key, T, Compare, AllowDuplicates, Allocator, Augment>::value_type> 
+            RedBlackTree<Key, T, Compare, AllowDuplicates, Allocator, Augment>::levelorder() const
+{
+    std::vector<value_type> result;
+    result.reserve(size());
+    levelorder([&](const_reference value) { result.push_back(value); });
+    return result;
+}
+
+template<typename Key, typename T, typename Compare, bool AllowDuplicates, typename Allocator, typename Augment>
+typename RedBlackTree<Key, T, Compare, AllowDuplicates, Allocator, Augment>::Node* 
+            RedBlackTree<Key, T, Compare, AllowDuplicates, Allocator, Augment>::minimum(Node* x) const
+{
+    while (x != _nil && x->left != _nil)
+        x = x->left;
+    return x;
+}
+
+template<typename Key, typename T, typename Compare, bool AllowDuplicates, typename Allocator, typename Augment>
+typename RedBlackTree<Key, T, Compare, AllowDuplicates, Allocator, Augment>::Node* 
+            RedBlackTree<Key, T, Compare, AllowDuplicates, Allocator, Augment>::maximum(Node* x) const
+{
+    while (x != _nil && x->right != _nil)
+        x = x->right;
+    return x;
+}
+
+template<typename Key, typename T, typename Compare, bool AllowDuplicates, typename Allocator, typename Augment>
+inline void RedBlackTree<Key, T, Compare, AllowDuplicates, Allocator, Augment>::clear_helper(Node* node)
+{
+    // Левый потомок поворачивается наверх, пока его нет; тогда узел удаляется и обход идёт вправо.
+    // O(n), без рекурсии и стека, ссылки на родителя не нужны
+    while (node != _nil)
+    {
+        Node* left = node->left;
+        if (left != _nil)
+        {
+            node->left = left->right;
+            left->right = node;
+            node = left;
+        }
+        else
+        {
+            Node* right = node->right;
+            destroy_node(node);
+            node = right;
+        }
+    }
+}
+
+template<typename Key, typename T, typename Compare, bool AllowDuplicates, typename Allocator, typename Augment>
+inline bool RedBlackTree<Key, T, Compare, AllowDuplicates, Allocator, Augment>::insert_fix(Node* z)
+{
+    while (z->parent() && z->parent()->color() == RED)
+    {
+        if (z->parent() == z->parent()->parent()->left)
+        {
+            Node* y = z->parent()->parent()->right;
+            if (y->color() == RED)
+            {
+                z->parent()->set_color(BLACK);
+                y->set_color(BLACK);
+                z->parent()->parent()->set_color(RED);
+                z = z->parent()->parent();
+            }
+            else
+            {
+                if (z == z->parent()->right)
+                {
+                    z = z->parent();
+                    rotate_left(z);
+                }
+                z->parent()->set_color(BLACK);
+                z->parent()->parent()->set_color(RED);
+                rotate_right(z->parent()->parent());
+            }
+        }
+        else
+        {
+            Node* y = z->parent()->parent()->left;
+            if (y->color() == RED)
+            {
+                z->parent()->set_color(BLACK);
+                y->set_color(BLACK);
+                z->parent()->parent()->set_color(RED);
+                z = z->parent()->parent();
+            }
+            else
+            {
+                if (z == z->parent()->left)
+                {
+                    z = z->parent();
+                    rotate_right(z);
+                }
+                z->parent()->set_color(BLACK);
+                z->parent()->parent()->set_color(RED);
+                rotate_left(z->parent()->parent());
+            }
+        }
+    }
+    bool grew = _root->color() == RED;
+    _root->set_color(BLACK);
+    return grew;
+}
+
+template<typename Key, typename T, typename Compare, bool AllowDuplicates, typename Allocator, typename Augment>
+inline void RedBlackTree<Key, T, Compare, AllowDuplicates, Allocator, Augment>::transplant(Node* u, Node* v)
+{
+    if (u->parent() == _nil)
+        _root = v;
+    else if (u == u->parent()->left)
+        u->parent()->left = v;
+    else
+        u->parent()->right = v;
+    if (v != _nil)
+        v->set_parent(u->parent());
+}
+
+template<typename Key, typename T, typename Compare, bool AllowDuplicates, typename Allocator, typename Augment>
+inline void RedBlackTree<Key, T, Compare, AllowDuplicates, Allocator, Augment>::delete_node(Node* z)
+{
+    unlink_node(z);
+    destroy_node(z);
+}
+
+template<typename Key, typename T, typename Compare, bool AllowDuplicates, typename Allocator, typename Augment>
+inline void RedBlackTree<Key, T, Compare, AllowDuplicates, Allocator, Augment>::unlink_node(Node* z)
+{
+    Node* y = z;
+    Node* x;
+    Node* x_parent;
+    Color original_color = y->color();
+
+    if (z->left == _nil)
+    {
+        x = z->right;
+        x_parent = z->parent();
+        transplant(z, z->right);
+    }
+    else if (z->right == _nil)
+    {
+        x = z->left;
+        x_parent = z->parent();
+        transplant(z, z->left);
+    }
+    else
+    {
+        y = minimum(z->right);
+        original_color = y->color();
+        x = y->right;
+
+        if (y->parent() == z)
+            x_parent = y;
+        else
+        {
+            x_parent = y->parent();
+            transplant(y, y->right);
+            y->right = z->right;
+            y->right->set_parent(y);
+        }
+
+        transplant(z, y);
+        y->left = z->left;
+        y->left->set_parent(y);
+        y->set_color(z->color());
+    }
+
+    // Поворотам erase_fix нужны верные сводки: они меняют форму, но не состав поддеревьев выше
+    update_path(x_parent);
+    if (original_color == BLACK)
+        erase_fix(x, x_parent);
+}
+
+template<typename Key, typename T, typename Compare, bool AllowDuplicates, typename Allocator, typename Augment>
+inline void RedBlackTree<Key, T, Compare, AllowDuplicates, Allocator, Augment>::erase_fix(Node* x, Node* x_parent)
+{
+    while (x != _root && x->color() == BLACK)
+    {
+        if (x == x_parent->left)
+        {
+            Node* w = x_parent->right;
+            if (w->color() == RED)
+            {
+                w->set_color(BLACK);
+                x_parent->set_color(RED);
+                rotate_left(x_parent);
+                w = x_parent->right;
+            }
+
+            if (w->left->color() == BLACK && w->right->color() == BLACK)
+            {
+                w->set_color(RED);
+                x = x_parent;
+                x_parent = x->parent();
+            }
+            else
+            {
+                if (w->right->color() == BLACK)
+                {
+                    w->left->set_color(BLACK);
+                    w->set_color(RED);
+                    rotate_right(w);
+                    w = x_parent->right;
+                }
+
+                w->set_color(x_parent->color());
+                x_parent->set_color(BLACK);
+                w->right->set_color(BLACK);
+                rotate_left(x_parent);
+                x = _root;
+            }
+        }
+        else
+        {
+            Node* w = x_parent->left;
+            if (w->color() == RED)
+            {
+                w->set_color(BLACK);
+                x_parent->set_color(RED);
+                rotate_right(x_parent);
+                w = x_parent->left;
+            }
+
+            if (w->right->color() == BLACK && w->left->color() == BLACK)
+            {
+                w->set_color(RED);
+                x = x_parent;
+                x_parent = x->parent();
+            }
+            else
+            {
+                if (w->left->color() == BLACK)
+                {
+                    w->right->set_color(BLACK);
+                    w->set_color(RED);
+                    rotate_left(w);
+                    w = x_parent->left;
+                }
+
+                w->set_color(x_parent->color());
+                x_parent->set_color(BLACK);
+                w->left->set_color(BLACK);
+                rotate_right(x_parent);
+                x = _root;
+            }
+        }
+    }
+
+    if (x != _nil)
+        x->set_color(BLACK);
+}
+
+template<typename Key, typename T, typename Compare, bool AllowDuplicates, typename Allocator, typename Augment>
+long RedBlackTree<Key, T, Compare, AllowDuplicates, Allocator, Augment>::validate_helper(const Node* node, const Node* parent) const
+{
+    if (node == _nil)
+        return 0;
+    if (node->parent() != parent)
+        return -1;
+    if (node->color() == RED && (node->left->color() == RED || node->right->color() == RED))
+        return -1;
+
+    long left = validate_helper(node->left, node);
+    long right = validate_helper(node->right, node);
+    if (left < 0 || left != right)
+        return -1;
+    if constexpr (augmented && std::equality_comparable<summary_type>)
+    {
+        if (!(node->summary == summarize(node)))
+            return -1;
+    }
+    return left + (node->color() == BLACK ? 1 : 0);
+}
+
+template<typename Key, typename T, typename Compare, bool AllowDuplicates, typename Allocator, typename Augment>
+inline typename RedBlackTree<Key, T, Compare, AllowDuplicates, Allocator, Augment>::size_type RedBlackTree<Key, T, Compare, AllowDuplicates, Allocator, Augment>::subtree_size(const Node* x) requires order_statistics
+{
+    return static_cast<size_type>(Augment::size_of(x->summary));
+}
+
+template<typename Key, typename T, typename Compare, bool AllowDuplicates, typename Allocator, typename Augment>
+typename RedBlackTree<Key, T, Compare, AllowDuplicates, Allocator, Augment>::Node* RedBlackTree<Key, T, Compare, AllowDuplicates, Allocator, Augment>::select_node(Node* root, Node* nil, size_type k) requires order_statistics
+{
+    while (root != nil)
+    {
+        size_type left = subtree_size(root->left);
+        if (k < left)
+            root = root->left;
+        else if (k == left)
+            return root;
+        else
+        {
+            k -= left + 1;
+            root = root->right;
+        }
+    }
+    return nil;
+}
+
+template<typename Key, typename T, typename Compare, bool AllowDuplicates, typename Allocator, typename Augment>
+typename RedBlackTree<Key, T, Compare, AllowDuplicates, Allocator, Augment>::size_type RedBlackTree<Key, T, Compare, AllowDuplicates, Allocator, Augment>::node_index(Node* x, Node* nil, Node*& root) requires order_statistics
+{
+    if (x == nil)
+        return subtree_size(root);
+
+    size_type index = subtree_size(x->left);
+    for (Node* p = x->parent(); p != nil; x = p, p = p->parent())
+    {
+        if (x == p->right)
+            index += subtree_size(p->left) + 1;
+    }
+    root = x;
+    return index;
+}
+
+template<typename Key, typename T, typename Compare, bool AllowDuplicates, typename Allocator, typename Augment>
+typename RedBlackTree<Key, T, Compare, AllowDuplicates, Allocator, Augment>::Node* 
+            RedBlackTree<Key, T, Compare, AllowDuplicates, Allocator, Augment>::lower_bound_from(Node* finger, const Key& key) const
+{
+    // Подъём останавливается на левом ребёнке, чей родитель не меньше key: ответ — в поддереве x или сам родитель
+    Node* x = finger;
+    Node* result = _nil;
+    while (x != _root)
+    {
+        Node* parent = x->parent();
+        if (x == parent->left && !_comp(parent->data.first, key))
+        {
+            result = parent;
+            break;
+        }
+        x = parent;
+    }
+
+    while (x != _nil)
+    {
+        if (!_comp(x->data.first, key))
+        {
+            result = x;
+            x = x->left;
+        }
+        else
+            x = x->right;
+    }
+    return result;
+}
+
+template<typename Key, typename T, typename Compare, bool AllowDuplicates, typename Allocator, typename Augment>
+typename RedBlackTree<Key, T, Compare, AllowDuplicates, Allocator, Augment>::Node* 
+            RedBlackTree<Key, T, Compare, AllowDuplicates, Allocator, Augment>::find_helper(const Key& key) const
+{
+    Node* current = _root;
+    while (current != _nil)
+    {
+        if (_comp(key, current->data.first))
+            current = current->left;
+        else if (_comp(current->data.first, key))
+            current = current->right;
+        else
+            return current;
+    }
+    return _nil;
+}
+
+template<typename Key, typename T, typename Compare, bool AllowDuplicates, typename Allocator, typename Augment>
+inline typename RedBlackTree<Key, T, Compare, AllowDuplicates, Allocator, Augment>::size_type
+            RedBlackTree<Key, T, Compare, AllowDuplicates, Allocator, Augment>::black_height(Node* node) const
+{
+    size_type h = 0;
+    for (; node != _nil; node = node->left)
+        h += (node->color() == BLACK) ? 1 : 0;
+    return h;
+}
+
+template<typename Key, typename T, typename Compare, bool AllowDuplicates, typename Allocator, typename Augment>
+inline typename RedBlackTree<Key, T, Compare, AllowDuplicates, Allocator, Augment>::Node*
+            RedBlackTree<Key, T, Compare, AllowDuplicates, Allocator, Augment>::detach_subtree(Node* node, size_type& h) const
+{
+    if (node == _nil)
+        return node;
+    node->set_parent(_nil);
+    if (node->color() == RED)
+    {
+        node->set_color(BLACK);
+        ++h;
+    }
+    return node;
+}
+
+template<typename Key, typename T, typename Compare, bool AllowDuplicates, typename Allocator, typename Augment>
+typename RedBlackTree<Key, T, Compare, AllowDuplicates, Allocator, Augment>::Node*
+            RedBlackTree<Key, T, Compare, AllowDuplicates, Allocator, Augment>::join_roots(Node* a, size_type ha, Node* mid, Node* b, size_type hb, size_type& h)
+{
+    // Повороты и insert_fix работают от _root — на время склейки им подставляется корень результата
+    Node* saved_root = _root;
+    mid->set_color(RED);
+
+    Node* parent = _nil;
+    if (ha >= hb)
+    {
+        Node* c = a;
+        for (size_type hc = ha; c->color() == RED || hc > hb; c = c->right)
+        {
+            hc -= (c->color() == BLACK) ? 1 : 0;
+            parent = c;
+        }
+        mid->left = c;
+        mid->right = b;
+        _root = (parent == _nil) ? mid : a;
+        if (parent != _nil)
+            parent->right = mid;
+    }
+    else
+    {
+        Node* c = b;
+        for (size_type hc = hb; c->color() == RED || hc > ha; c = c->left)
+        {
+            hc -= (c->color() == BLACK) ? 1 : 0;
+            parent = c;
+        }
+        mid->left = a;
+        mid->right = c;
+        _root = (parent == _nil) ? mid : b;
+        if (parent != _nil)
+            parent->left = mid;
+    }
+
+    mid->set_parent(parent);
+    if (mid->left != _nil)
+        mid->left->set_parent(mid);
+    if (mid->right != _nil)
+        mid->right->set_parent(mid);
+
+    update_path(mid);
+    h = std::max(ha, hb) + (insert_fix(mid) ? 1 : 0);
+    Node* root = _root;
+    _root = saved_root;
+    return root;
+}
+
+template<typename Key, typename T, typename Compare, bool AllowDuplicates, typename Allocator, typename Augment>
+template<typename Found>
+void RedBlackTree<Key, T, Compare, AllowDuplicates, Allocator, Augment>::find_batch_helper(std::span<const Key> keys, Found&& found) const
+{
+    // Конвейер из lanes спусков: закончивший спуск сразу берёт следующий ключ пакета,
+    // так что в полёте всё время столько независимых загрузок узлов, сколько дорожек
+    constexpr std::size_t lanes = 16;
+    struct Lane
+    {
+        Node* node;
+        std::size_t index;
+    };
+
+    if (_root == _nil)
+    {
+        for (std::size_t i = 0; i < keys.size(); ++i)
+            found(i, _nil);
+        return;
+    }
+
+    Lane lane[lanes];
+    std::size_t active = 0;
+    std::size_t next = 0;
+    while (active < lanes && next < keys.size())
+        lane[active++] = { _root, next++ };
+
+    while (active > 0)
+    {
+        for (std::size_t j = 0; j < active; )
+        {
+            // Один шаг спуска по дорожке; узел уже подгружен, пока шли шаги остальных
+            Node* node = lane[j].node;
+            const Key& key = keys[lane[j].index];
+            bool equal = false;
+            if (_comp(key, node->data.first))
+                node = node->left;
+            else if (_comp(node->data.first, key))
+                node = node->right;
+            else
+                equal = true;
+
+            if (!equal && node != _nil)
+            {
+                RBTREE_PREFETCH(node);
+                lane[j].node = node;
+                ++j;
+                continue;
+            }
+
+            found(lane[j].index, node);
+            if (next < keys.size())
+            {
+                lane[j] = { _root, next++ };
+                ++j;
+            }
+            else
+            {
+                lane[j] = lane[--active];
+            }
+        }
+    }
+}
+
+template<typename Key, typename T, typename Compare, bool AllowDuplicates, typename Allocator, typename Augment>
+template<typename K>
+inline typename RedBlackTree<Key, T, Compare, AllowDuplicates, Allocator, Augment>::InsertPosition 
+            RedBlackTree<Key, T, Compare, AllowDuplicates, Allocator, Augment>::insert_position(const K& key) const
+{
+    Node* parent = _nil;
+    Node* current = _root;
+    bool left = false;
+
+    while (current != _nil)
+    {
+        parent = current;
+        if (_comp(key, current->data.first))
+        {
+            left = true;
+            current = current->left;
+        }
+        else if constexpr (AllowDuplicates)
+        {
+            left = false;
+            current = current->right;
+        }
+        else if (_comp(current->data.first, key))
+        {
+            left = false;
+            current = current->right;
+        }
+        else
+            return { current, false, true };
+    }
+    return { parent, left, false };
+}
+
+template<typename Key, typename T, typename Compare, bool AllowDuplicates, typename Allocator, typename Augment>
+template<typename K>
+inline typename RedBlackTree<Key, T, Compare, AllowDuplicates, Allocator, Augment>::InsertPosition 
+            RedBlackTree<Key, T, Compare, AllowDuplicates, Allocator, Augment>::insert_position_between(Node* prev, Node* next, const K& key) const
+{
+    // prev и next — соседние по порядку узлы (любой может быть _nil); если key не лежит между ними,
+    // возвращается позиция с node == nullptr
+    if (prev != _nil)
+    {
+        if (_comp(key, prev->data.first))
+            return { nullptr, false, false };
+        if constexpr (!AllowDuplicates)
+        {
+            if (!_comp(prev->data.first, key))
+                return { prev, false, true };
+        }
+    }
+    if (next != _nil)
+    {
+        if (_comp(next->data.first, key))
+            return { nullptr, false, false };
+        if constexpr (!AllowDuplicates)
+        {
+            if (!_comp(key, next->data.first))
+                return { next, false, true };
+        }
+    }
+
+    // У соседних узлов свободен либо правый потомок prev, либо левый потомок next
+    if (prev != _nil && prev->right == _nil)
+        return { prev, false, false };
+    if (next != _nil)
+        return { next, true, false };
+    return { _nil, false, false };
+}
+
+template<typename Key, typename T, typename Compare, bool AllowDuplicates, typename Allocator, typename Augment>
+template<typename K>
+inline typename RedBlackTree<Key, T, Compare, AllowDuplicates, Allocator, Augment>::InsertPosition 
+            RedBlackTree<Key, T, Compare, AllowDuplicates, Allocator, Augment>::find_position(Node* hint, const K& key) const
+{
+    if (hint)
+    {
+        Node* prev = (hint == _nil) ? maximum(_root) : predecessor(hint);
+        InsertPosition pos = insert_position_between(prev, hint, key);
+        if (pos.node)
+            return pos;
+    }
+    return insert_position(key);
+}
+
+template<typename Key, typename T, typename Compare, bool AllowDuplicates, typename Allocator, typename Augment>
+typename RedBlackTree<Key, T, Compare, AllowDuplicates, Allocator, Augment>::Node* 
+            RedBlackTree<Key, T, Compare, AllowDuplicates, Allocator, Augment>::successor(Node* x) const
+{
+    if (x->right != _nil)
+        return minimum(x->right);
+    Node* y = x->parent();
+    while (y != _nil && x == y->right)
+    {
+        x = y;
+        y = y->parent();
+    }
+    return y;
+}
+
+template<typename Key, typename T, typename Compare, bool AllowDuplicates, typename Allocator, typename Augment>
+typename RedBlackTree<Key, T, Compare, AllowDuplicates, Allocator, Augment>::Node* 
+            RedBlackTree<Key, T, Compare, AllowDuplicates, Allocator, Augment>::predecessor(Node* x) const
+{
+    if (x->left != _nil)
+        return maximum(x->left);
+    Node* y = x->parent();
+    while (y != _nil && x == y->left)
+    {
+        x = y;
+        y = y->parent();
+    }
+    return y;
+}
+
+template<typename Key, typename T, typename Compare, bool AllowDuplicates, typename Allocator, typename Augment>
+inline std::pair<typename RedBlackTree<Key, T, Compare, AllowDuplicates, Allocator, Augment>::iterator, bool> 
+            RedBlackTree<Key, T, Compare, AllowDuplicates, Allocator, Augment>::link_node(Node* z, const InsertPosition& pos)
+{
+    z->set_parent(pos.node);
+    if (pos.node == _nil)
+        _root = z;
+    else if (pos.left)
+        pos.node->left = z;
+    else
+        pos.node->right = z;
+
+    update_path(z);
+    insert_fix(z);
+    adjust_size(1);
+    return { iterator(z, _nil, _root), true };
+}
+
+template<typename Key, typename T, typename Compare, bool AllowDuplicates, typename Allocator, typename Augment>
+template<typename P>
+inline std::pair<typename RedBlackTree<Key, T, Compare, AllowDuplicates, Allocator, Augment>::iterator, bool> 
+            RedBlackTree<Key, T, Compare, AllowDuplicates, Allocator, Augment>::emplace_single(Node* hint, P&& arg)
+{
+    using Arg = std::decay_t<P>;
+    if constexpr (std::is_same<Arg, value_type>::value || std::is_same<Arg, std::pair<Key, T>>::value
+        || std::is_same<Arg, std::pair<const Key, T>>::value)
+    {
+        InsertPosition pos = find_position(hint, arg.first);
+        if (pos.exists)
+            return { iterator(pos.node, _nil, _root), false };
+        return link_node(create_node(std::in_place, std::forward<P>(arg)), pos);
+    }
+    else
+        return emplace_node(hint, std::forward<P>(arg));
+}
+
+template<typename Key, typename T, typename Compare, bool AllowDuplicates, typename Allocator, typename Augment>
+template<typename... Args>
+inline std::pair<typename RedBlackTree<Key, T, Compare, AllowDuplicates, Allocator, Augment>::iterator, bool> 
+            RedBlackTree<Key, T, Compare, AllowDuplicates, Allocator, Augment>::emplace_node(Node* hint, Args&&... args)
+{
+    // Ключ неизвестен, пока значение не построено: строим узел сразу и ищем по нему
+    Node* z = create_node(std::in_place, std::forward<Args>(args)...);
+    InsertPosition pos = find_position(hint, z->data.first);
+    if (pos.exists)
+    {
+        destroy_node(z);
+        return { iterator(pos.node, _nil, _root), false };
+    }
+    return link_node(z, pos);
+}
+
+template<typename Key, typename T, typename Compare, bool AllowDuplicates, typename Allocator, typename Augment>
+inline void RedBlackTree<Key, T, Compare, AllowDuplicates, Allocator, Augment>::clone_from(const RedBlackTree& other, Node*& reuse)
+{
+    if (other._root == other._nil)
+        return;
+    _root = clone_helper(other._root, other._nil, reuse);
+    _root->set_parent(_nil);
+    _tree_size = other._tree_size;
+}
+
+template<typename Key, typename T, typename Compare, bool AllowDuplicates, typename Allocator, typename Augment>
+typename RedBlackTree<Key, T, Compare, AllowDuplicates, Allocator, Augment>::Node* 
+            RedBlackTree<Key, T, Compare, AllowDuplicates, Allocator, Augment>::clone_helper(const Node* src_root, const Node* src_nil, Node*& reuse)
+{
+    // Копирует форму и цвета поддерева без сравнений и поворотов.
+    // Обход в прямом порядке по ссылкам на родителя: ни рекурсии, ни стека
+    const Node* src = src_root;
+    Node* root = reuse_node(reuse, src->data);
+    root->set_color(src->color());
+    root->summary = src->summary;
+
+    Node* dst = root;
+    try
+    {
+        while (true)
         {
-            Node* y = z->parent->parent->left;
-            if (y->color == RED)
+            if (src->left != src_nil && dst->left == _nil)
+            {
+                src = src->left;
+                Node* node = reuse_node(reuse, src->data);
+                node->set_color(src->color());
+                node->summary = src->summary;
+                node->set_parent(dst);
+                dst->left = node;
+                dst = node;
+            }
+            else if (src->right != src_nil && dst->right == _nil)
             {
-                z->parent->color = BLACK;
-                y->color = BLACK;
-                z->parent->parent->color = RED;
-                z = z->parent->parent;
+                src = src->right;
+                Node* node = reuse_node(reuse, src->data);
+                node->set_color(src->color());
+                node->summary = src->summary;
+                node->set_parent(dst);
+                dst->right = node;
+                dst = node;
             }
+            else if (src == src_root)
+                break;
             else
             {
-                if (z == z->parent->left)
-                {
-                    z = z->parent;
-                    rotate_right(z);
-                }
-                z->parent->color = BLACK;
-                z->parent->parent->color = RED;
-                rotate_left(z->parent->parent);
+                src = src->parent();
+                dst = dst->parent();
             }
         }
     }
-    _root->color = BLACK;
+    catch (...)
+    {
+        clear_helper(root);
+        throw;
+    }
+    return root;
 }
 
-template<typename Key, typename T, typename Compare, bool AllowDuplicates>
-inline void RedBlackTree<Key, T, Compare, AllowDuplicates>::transplant(Node* u, Node* v)
+template<typename Key, typename T, typename Compare, bool AllowDuplicates, typename Allocator, typename Augment>
+template<typename Fork>
+typename RedBlackTree<Key, T, Compare, AllowDuplicates, Allocator, Augment>::Node* 
+            RedBlackTree<Key, T, Compare, AllowDuplicates, Allocator, Augment>::clone_parallel(const Node* src, const Node* src_nil, size_type levels, Fork& fork)
 {
-    if (u->parent == _nil)
-        _root = v;
-    else if (u == u->parent->left)
-        u->parent->left = v;
-    else
-        u->parent->right = v;
-    v->parent = u->parent;
-}
+    if (src == src_nil)
+        return _nil;
+    Node* reuse = nullptr;
+    if (levels == 0)
+        return clone_helper(src, src_nil, reuse);
 
-template<typename Key, typename T, typename Compare, bool AllowDuplicates>
-inline void RedBlackTree<Key, T, Compare, AllowDuplicates>::delete_node(Node* z)
-{
-    Node* y = z;
-    Node* x;
-    Color original_color = y->color;
+    Node* node = create_node_from(src->data);
+    node->set_color(src->color());
+    node->summary = src->summary;
 
-    if (z->left == _nil)
+    Node* left = _nil;
+    Node* right = _nil;
+    try
     {
-        x = z->right;
-        transplant(z, z->right);
+        fork([&] { left = clone_parallel(src->left, src_nil, levels - 1, fork); },
+            [&] { right = clone_parallel(src->right, src_nil, levels - 1, fork); });
     }
-    else if (z->right == _nil)
+    catch (...)
     {
-        x = z->left;
-        transplant(z, z->left);
+        clear_helper(left);
+        clear_helper(right);
+        destroy_node(node);
+        throw;
     }
-    else
-    {
-        y = minimum(z->right);
-        original_color = y->color;
-        x = y->right;
 
-        if (y->parent == z)
-            x->parent = y;
+    node->left = left;
+    if (left != _nil)
+        left->set_parent(node);
+    node->right = right;
+    if (right != _nil)
+        right->set_parent(node);
+    return node;
+}
+
+template<typename Key, typename T, typename Compare, bool AllowDuplicates, typename Allocator, typename Augment>
+typename RedBlackTree<Key, T, Compare, AllowDuplicates, Allocator, Augment>::Node* 
+            RedBlackTree<Key, T, Compare, AllowDuplicates, Allocator, Augment>::detach_nodes()
+{
+    // Разворачивает дерево в список по указателю right правыми поворотами — без стека и рекурсии
+    Node* list = nullptr;
+    Node* node = _root;
+    while (node != _nil)
+    {
+        if (node->left != _nil)
+        {
+            Node* left = node->left;
+            node->left = left->right;
+            left->right = node;
+            node = left;
+        }
         else
         {
-            transplant(y, y->right);
-            y->right = z->right;
-            y->right->parent = y;
+            Node* next = node->right;
+            node->right = list;
+            list = node;
+            node = next;
         }
-
-        transplant(z, y);
-        y->left = z->left;
-        y->left->parent = y;
-        y->color = z->color;
     }
 
-    delete z;
-
-    if (original_color == BLACK)
-        erase_fix(x);
+    _root = _nil;
+    _tree_size = 0;
+    return list;
 }
 
-template<typename Key, typename T, typename Compare, bool AllowDuplicates>
-inline void RedBlackTree<Key, T, Compare, AllowDuplicates>::erase_fix(Node* x)
+template<typename Key, typename T, typename Compare, bool AllowDuplicates, typename Allocator, typename Augment>
+inline void RedBlackTree<Key, T, Compare, AllowDuplicates, Allocator, Augment>::rebuild_without(Node* first, Node* last, size_type count)
 {
-    while (x != _root && x->color == BLACK)
+    // detach_nodes отдаёт узлы по убыванию: сначала [max, last], затем удаляемые [first, last), затем остальные
+    size_type kept_size = size() - count;
+    Node* list = detach_nodes();
+    Node* kept = nullptr;
+    Node* erased = nullptr;
+    bool in_range = (last == _nil);
+
+    while (list)
     {
-        if (x == x->parent->left)
+        Node* node = list;
+        list = list->right;
+        if (in_range)
         {
-            Node* w = x->parent->right;
-            if (w->color == RED)
-            {
-                w->color = BLACK;
-                x->parent->color = RED;
-                rotate_left(x->parent);
-                w = x->parent->right;
-            }
-
-            if (w->left->color == BLACK && w->right->color == BLACK)
-            {
-                w->color = RED;
-                x = x->parent;
-            }
-            else
-            {
-                if (w->right->color == BLACK)
-                {
-                    w->left->color = BLACK;
-                    w->color = RED;
-                    rotate_right(w);
-                    w = x->parent->right;
-                }
-
-                w->color = x->parent->color;
-                x->parent->color = BLACK;
-                w->right->color = BLACK;
-                rotate_left(x->parent);
-                x = _root;
-            }
+            node->right = erased;
+            erased = node;
+            if (node == first)
+                in_range = false;
         }
         else
         {
-            Node* w = x->parent->left;
-            if (w->color == RED)
-            {
-                w->color = BLACK;
-                x->parent->color = RED;
-                rotate_right(x->parent);
-                w = x->parent->left;
-            }
+            // Разворачиваем в возрастающий порядок для build_sorted
+            node->right = kept;
+            kept = node;
+            if (node == last)
+                in_range = true;
+        }
+    }
+    destroy_detached(erased);
 
-            if (w->right->color == BLACK && w->left->color == BLACK)
-            {
-                w->color = RED;
-                x = x->parent;
-            }
-            else
-            {
-                if (w->left->color == BLACK)
-                {
-                    w->right->color = BLACK;
-                    w->color = RED;
-                    rotate_left(w);
-                    w = x->parent->left;
-                }
+    struct ListIterator
+    {
+        Node* node;
 
-                w->color = x->parent->color;
-                x->parent->color = BLACK;
-                w->left->color = BLACK;
-                rotate_right(x->parent);
-                x = _root;
-            }
-        }
+        Node* operator*() const { return node; }
+        ListIterator& operator++() { node = node->right; return *this; }
+    };
+
+    build_sorted(ListIterator{ kept }, kept_size, [](Node* node) { return node; });
+}
+
+template<typename Key, typename T, typename Compare, bool AllowDuplicates, typename Allocator, typename Augment>
+inline void RedBlackTree<Key, T, Compare, AllowDuplicates, Allocator, Augment>::destroy_detached(Node* list)
+{
+    while (list)
+    {
+        Node* next = list->right;
+        destroy_node(list);
+        list = next;
+    }
+}
+
+template<typename Key, typename T, typename Compare, bool AllowDuplicates, typename Allocator, typename Augment>
+template<typename FwdIt>
+inline bool RedBlackTree<Key, T, Compare, AllowDuplicates, Allocator, Augment>::is_sorted_unique(FwdIt first, FwdIt last) const
+{
+    if (first == last)
+        return true;
+    for (FwdIt next = std::next(first); next != last; first = next, ++next)
+    {
+        if (!_comp(key_of(*first), key_of(*next)))
+            return false;
     }
+    return true;
+}
 
-    x->color = BLACK;
+template<typename Key, typename T, typename Compare, bool AllowDuplicates, typename Allocator, typename Augment>
+template<typename InputIt, typename Make>
+inline void RedBlackTree<Key, T, Compare, AllowDuplicates, Allocator, Augment>::build_sorted(InputIt first, size_type n, Make&& make)
+{
+    // Узлы на глубине floor(log2(n + 1)) — единственный неполный уровень — красные, остальные чёрные:
+    // на любом пути от корня до листа одинаковое число чёрных узлов
+    size_type red_depth = 0;
+    while ((size_type(2) << red_depth) <= n + 1)
+        ++red_depth;
+
+    _root = build_helper(first, n, 0, red_depth, make);
+    if (_root != _nil)
+        _root->set_parent(_nil);
+    _tree_size = n;
 }
 
-template<typename Key, typename T, typename Compare, bool AllowDuplicates>
-typename RedBlackTree<Key, T, Compare, AllowDuplicates>::Node* 
-            RedBlackTree<Key, T, Compare, AllowDuplicates>::find_helper(const Key& key) const
+template<typename Key, typename T, typename Compare, bool AllowDuplicates, typename Allocator, typename Augment>
+template<typename InputIt, typename Make>
+typename RedBlackTree<Key, T, Compare, AllowDuplicates, Allocator, Augment>::Node* 
+            RedBlackTree<Key, T, Compare, AllowDuplicates, Allocator, Augment>::build_helper(InputIt& it, size_type n, size_type depth, size_type red_depth, Make& make)
 {
-    Node* current = _root;
-    while (current != _nil)
+    if (n == 0)
+        return _nil;
+
+    size_type left_size = (n - 1) / 2;
+    Node* left = build_helper(it, left_size, depth + 1, red_depth, make);
+
+    Node* node;
+    try
     {
-        if (_comp(key, current->data.first))
-            current = current->left;
-        else if (_comp(current->data.first, key))
-            current = current->right;
-        else
-            return current;
+        node = make(*it);
     }
-    return _nil;
+    catch (...)
+    {
+        clear_helper(left);
+        throw;
+    }
+    ++it;
+
+    node->set_color((depth == red_depth) ? RED : BLACK);
+    node->left = left;
+    if (left != _nil)
+        left->set_parent(node);
+
+    Node* right;
+    try
+    {
+        right = build_helper(it, n - 1 - left_size, depth + 1, red_depth, make);
+    }
+    catch (...)
+    {
+        clear_helper(node);
+        throw;
+    }
+
+    node->right = right;
+    if (right != _nil)
+        right->set_parent(node);
+    update(node);
+    return node;
 }
 
-template<typename Key, typename T, typename Compare, bool AllowDuplicates>
-inline void RedBlackTree<Key, T, Compare, AllowDuplicates>::copy_helper(const Node* node, const Node* source_nil)
+template<typename Key, typename T, typename Compare, bool AllowDuplicates, typename Allocator, typename Augment>
+template<typename RandomIt, typename Fork>
+typename RedBlackTree<Key, T, Compare, AllowDuplicates, Allocator, Augment>::Node* 
+            RedBlackTree<Key, T, Compare, AllowDuplicates, Allocator, Augment>::build_parallel(RandomIt first, size_type n, size_type depth, size_type red_depth, Fork& fork)
 {
-    if (node == source_nil)
-        return;
-    insert(node->data);
-    copy_helper(node->left, source_nil);
-    copy_helper(node->right, source_nil);
+    // Форма та же, что у build_helper: корень — элемент (n - 1) / 2, поддеревья строятся независимо
+    if (n < parallel_grain)
+    {
+        auto make = [this](auto&& value) { return create_node_from(std::forward<decltype(value)>(value)); };
+        return build_helper(first, n, depth, red_depth, make);
+    }
+
+    size_type left_size = (n - 1) / 2;
+    Node* node = create_node_from(first[left_size]);
+    node->set_color((depth == red_depth) ? RED : BLACK);
+
+    Node* left = _nil;
+    Node* right = _nil;
+    try
+    {
+        fork([&] { left = build_parallel(first, left_size, depth + 1, red_depth, fork); },
+            [&] { right = build_parallel(first + (left_size + 1), n - 1 - left_size, depth + 1, red_depth, fork); });
+    }
+    catch (...)
+    {
+        clear_helper(left);
+        clear_helper(right);
+        destroy_node(node);
+        throw;
+    }
+
+    node->left = left;
+    left->set_parent(node);
+    node->right = right;
+    right->set_parent(node);
+    update(node);
+    return node;
 }
 
-template<typename Key, typename T, typename Compare, bool AllowDuplicates>
-inline void RedBlackTree<Key, T, Compare, AllowDuplicates>::inorder_helper(Node* node, std::function<void(const_reference)> visit) const
+template<typename Key, typename T, typename Compare, bool AllowDuplicates, typename Allocator, typename Augment>
+template<typename InputIt, typename Make>
+inline void RedBlackTree<Key, T, Compare, AllowDuplicates, Allocator, Augment>::append_sorted(InputIt first, InputIt last, Make&& make)
 {
-    if (node == _nil)
-        return;
-    inorder_helper(node->left, visit);
-    visit(node->data);
-    inorder_helper(node->right, visit);
+    // Длина однопроходного диапазона неизвестна: каждый узел подвешивается справа от максимума,
+    // insert_fix в среднем обходится O(1) поворотов
+    Node* last_node = maximum(_root);
+    for (; first != last; ++first)
+    {
+        Node* z = make(*first);
+        z->set_parent(last_node);
+        if (last_node == _nil)
+            _root = z;
+        else
+            last_node->right = z;
+        update_path(z);
+        insert_fix(z);
+        adjust_size(1);
+        last_node = z;
+    }
 }
 
-template<typename Key, typename T, typename Compare, bool AllowDuplicates>
-inline void RedBlackTree<Key, T, Compare, AllowDuplicates>::preorder_helper(Node* node, 
-                std::function<void(const_reference)> visit) const
+template<typename Key, typename T, typename Compare, bool AllowDuplicates, typename Allocator, typename Augment>
+typename RedBlackTree<Key, T, Compare, AllowDuplicates, Allocator, Augment>::Node* 
+            RedBlackTree<Key, T, Compare, AllowDuplicates, Allocator, Augment>::preorder_next(Node* node) const
 {
-    if (node == _nil)
-        return;
-    visit(node->data);
-    preorder_helper(node->left, visit);
-    preorder_helper(node->right, visit);
+    if (node->left != _nil)
+        return node->left;
+    if (node->right != _nil)
+        return node->right;
+
+    // Поднимаемся, пока не придём слева в узел с правым поддеревом
+    Node* parent = node->parent();
+    while (parent != _nil && (node == parent->right || parent->right == _nil))
+    {
+        node = parent;
+        parent = parent->parent();
+    }
+    return (parent == _nil) ? _nil : parent->right;
 }
 
-template<typename Key, typename T, typename Compare, bool AllowDuplicates>
-inline void RedBlackTree<Key, T, Compare, AllowDuplicates>::postorder_helper(Node* node, 
-                std::function<void(const_reference)> visit) const
+template<typename Key, typename T, typename Compare, bool AllowDuplicates, typename Allocator, typename Augment>
+typename RedBlackTree<Key, T, Compare, AllowDuplicates, Allocator, Augment>::Node* 
+            RedBlackTree<Key, T, Compare, AllowDuplicates, Allocator, Augment>::postorder_first(Node* node) const
 {
-    if (node == _nil)
-        return;
-    postorder_helper(node->left, visit);
-    postorder_helper(node->right, visit);
-    visit(node->data);
+    // Первый в обратном порядке узел поддерева — самый левый из самых глубоких листьев пути
+    while (true)
+    {
+        if (node->left != _nil)
+            node = node->left;
+        else if (node->right != _nil)
+            node = node->right;
+        else
+            return node;
+    }
 }
 
-template<typename Key, typename T, typename Compare, bool AllowDuplicates>
-inline void RedBlackTree<Key, T, Compare, AllowDuplicates>::rotate_left(Node* x)
+template<typename Key, typename T, typename Compare, bool AllowDuplicates, typename Allocator, typename Augment>
+inline void RedBlackTree<Key, T, Compare, AllowDuplicates, Allocator, Augment>::rotate_left(Node* x)
 {
     Node* y = x->right;
     x->right = y->left;
     if (y->left != _nil)
-        y->left->parent = x;
-    y->parent = x->parent;
-    if (x->parent == _nil)
+        y->left->set_parent(x);
+    y->set_parent(x->parent());
+    if (x->parent() == _nil)
         _root = y;
-    else if (x == x->parent->left)
-        x->parent->left = y;
+    else if (x == x->parent()->left)
+        x->parent()->left = y;
     else
-        x->parent->right = y;
+        x->parent()->right = y;
     y->left = x;
-    x->parent = y;
+    x->set_parent(y);
+    update(x);
+    update(y);
 }
 
-template<typename Key, typename T, typename Compare, bool AllowDuplicates>
-inline void RedBlackTree<Key, T, Compare, AllowDuplicates>::rotate_right(Node* x)
+template<typename Key, typename T, typename Compare, bool AllowDuplicates, typename Allocator, typename Augment>
+inline void RedBlackTree<Key, T, Compare, AllowDuplicates, Allocator, Augment>::rotate_right(Node* x)
 {
     Node* y = x->left;
     x->left = y->right;
     if (y->right != _nil)
-        y->right->parent = x;
-    y->parent = x->parent;
-    if (x->parent == _nil)
+        y->right->set_parent(x);
+    y->set_parent(x->parent());
+    if (x->parent() == _nil)
         _root = y;
-    else if (x == x->parent->right)
-        x->parent->right = y;
+    else if (x == x->parent()->right)
+        x->parent()->right = y;
     else
-        x->parent->left = y;
+        x->parent()->left = y;
     y->right = x;
-    x->parent = y;
+    x->set_parent(y);
+    update(x);
+    update(y);
 }
 
-template<typename Key, typename T, typename Compare, bool AllowDuplicates>
-typename RedBlackTree<Key, T, Compare, AllowDuplicates>::Node* 
-            RedBlackTree<Key, T, Compare, AllowDuplicates>::Iterator::minimum(Node* x) const
+template<typename Key, typename T, typename Compare, bool AllowDuplicates, typename Allocator, typename Augment>
+typename RedBlackTree<Key, T, Compare, AllowDuplicates, Allocator, Augment>::Node* 
+            RedBlackTree<Key, T, Compare, AllowDuplicates, Allocator, Augment>::Iterator::minimum(Node* x) const
 {
     while (x->left != _nil)
         x = x->left;
     return x;
 }
 
-template<typename Key, typename T, typename Compare, bool AllowDuplicates>
-typename RedBlackTree<Key, T, Compare, AllowDuplicates>::Node* 
-            RedBlackTree<Key, T, Compare, AllowDuplicates>::Iterator::maximum(Node* x) const
+template<typename Key, typename T, typename Compare, bool AllowDuplicates, typename Allocator, typename Augment>
+typename RedBlackTree<Key, T, Compare, AllowDuplicates, Allocator, Augment>::Node* 
+            RedBlackTree<Key, T, Compare, AllowDuplicates, Allocator, Augment>::Iterator::maximum(Node* x) const
 {
     while (x->right != _nil)
         x = x->right;
     return x;
 }
 
-template<typename Key, typename T, typename Compare, bool AllowDuplicates>
-typename RedBlackTree<Key, T, Compare, AllowDuplicates>::Node* 
-            RedBlackTree<Key, T, Compare, AllowDuplicates>::Iterator::successor(Node* x) const
+template<typename Key, typename T, typename Compare, bool AllowDuplicates, typename Allocator, typename Augment>
+typename RedBlackTree<Key, T, Compare, AllowDuplicates, Allocator, Augment>::Node* 
+            RedBlackTree<Key, T, Compare, AllowDuplicates, Allocator, Augment>::Iterator::successor(Node* x) const
 {
     if (x->right != _nil)
         return minimum(x->right);
-    Node* y = x->parent;
+    Node* y = x->parent();
     while (y != nullptr && x == y->right)
     {
         x = y;
-        y = y->parent;
+        y = y->parent();
     }
     return y ? y : _nil;
 }
 
-template<typename Key, typename T, typename Compare, bool AllowDuplicates>
-typename RedBlackTree<Key, T, Compare, AllowDuplicates>::Node* 
-            RedBlackTree<Key, T, Compare, AllowDuplicates>::Iterator::predecessor(Node* x) const
+template<typename Key, typename T, typename Compare, bool AllowDuplicates, typename Allocator, typename Augment>
+typename RedBlackTree<Key, T, Compare, AllowDuplicates, Allocator, Augment>::Node* 
+            RedBlackTree<Key, T, Compare, AllowDuplicates, Allocator, Augment>::Iterator::predecessor(Node* x) const
 {
     if (x->left != _nil)
         return maximum(x->left);
-    Node* y = x->parent;
+    Node* y = x->parent();
     while (y != nullptr && x == y->left)
     {
         x = y;
-        y = y->parent;
+        y = y->parent();
     }
     return y ? y : _nil;
 }
 
-template<typename Key, typename T, typename Compare, bool AllowDuplicates>
-inline RedBlackTree<Key, T, Compare, AllowDuplicates>::Iterator::Iterator(Node* node, Node* nil, Node* root)
+template<typename Key, typename T, typename Compare, bool AllowDuplicates, typename Allocator, typename Augment>
+inline RedBlackTree<Key, T, Compare, AllowDuplicates, Allocator, Augment>::Iterator::Iterator(Node* node, Node* nil, Node* root)
     : _node(node)
     , _nil(nil)
     , _root(root)
 {
 }
 
-template<typename Key, typename T, typename Compare, bool AllowDuplicates>
-typename RedBlackTree<Key, T, Compare, AllowDuplicates>::Iterator::reference 
-            RedBlackTree<Key, T, Compare, AllowDuplicates>::Iterator::operator*() const
+template<typename Key, typename T, typename Compare, bool AllowDuplicates, typename Allocator, typename Augment>
+typename RedBlackTree<Key, T, Compare, AllowDuplicates, Allocator, Augment>::Iterator::reference 
+            RedBlackTree<Key, T, Compare, AllowDuplicates, Allocator, Augment>::Iterator::operator*() const
 {
     return _node->data;
 }
 
-template<typename Key, typename T, typename Compare, bool AllowDuplicates>
-typename RedBlackTree<Key, T, Compare, AllowDuplicates>::Iterator::pointer 
-            RedBlackTree<Key, T, Compare, AllowDuplicates>::Iterator::operator->() const
+template<typename Key, typename T, typename Compare, bool AllowDuplicates, typename Allocator, typename Augment>
+typename RedBlackTree<Key, T, Compare, AllowDuplicates, Allocator, Augment>::Iterator::pointer 
+            RedBlackTree<Key, T, Compare, AllowDuplicates, Allocator, Augment>::Iterator::operator->() const
 {
     return &_node->data;
 }
 
-template<typename Key, typename T, typename Compare, bool AllowDuplicates>
-typename RedBlackTree<Key, T, Compare, AllowDuplicates>::Iterator::Iterator& 
-            RedBlackTree<Key, T, Compare, AllowDuplicates>::Iterator::operator++()
+template<typename Key, typename T, typename Compare, bool AllowDuplicates, typename Allocator, typename Augment>
+typename RedBlackTree<Key, T, Compare, AllowDuplicates, Allocator, Augment>::Iterator::Iterator& 
+            RedBlackTree<Key, T, Compare, AllowDuplicates, Allocator, Augment>::Iterator::operator++()
 {
     _node = successor(_node);
     return *this;
 }
 
-template<typename Key, typename T, typename Compare, bool AllowDuplicates>
-typename RedBlackTree<Key, T, Compare, AllowDuplicates>::Iterator::Iterator 
-            RedBlackTree<Key, T, Compare, AllowDuplicates>::Iterator::operator++(int)
+template<typename Key, typename T, typename Compare, bool AllowDuplicates, typename Allocator, typename Augment>
+typename RedBlackTree<Key, T, Compare, AllowDuplicates, Allocator, Augment>::Iterator::Iterator 
+            RedBlackTree<Key, T, Compare, AllowDuplicates, Allocator, Augment>::Iterator::operator++(int)
 {
     Iterator temp = *this;
     ++(*this);
     return temp;
 }
 
-template<typename Key, typename T, typename Compare, bool AllowDuplicates>
-typename RedBlackTree<Key, T, Compare, AllowDuplicates>::Iterator::Iterator& 
-            RedBlackTree<Key, T, Compare, AllowDuplicates>::Iterator::operator--()
+template<typename Key, typename T, typename Compare, bool AllowDuplicates, typename Allocator, typename Augment>
+typename RedBlackTree<Key, T, Compare, AllowDuplicates, Allocator, Augment>::Iterator::Iterator& 
+            RedBlackTree<Key, T, Compare, AllowDuplicates, Allocator, Augment>::Iterator::operator--()
 {
     if (_node == _nil)
         _node = maximum(_root);
@@ -1129,144 +3592,244 @@ typename RedBlackTree<Key, T, Compare, AllowDuplicates>::Iterator::Iterator&
     return *this;
 }
 
-template<typename Key, typename T, typename Compare, bool AllowDuplicates>
-typename RedBlackTree<Key, T, Compare, AllowDuplicates>::Iterator::Iterator 
-            RedBlackTree<Key, T, Compare, AllowDuplicates>::Iterator::operator--(int)
+template<typename Key, typename T, typename Compare, bool AllowDuplicates, typename Allocator, typename Augment>
+typename RedBlackTree<Key, T, Compare, AllowDuplicates, Allocator, Augment>::Iterator::Iterator 
+            RedBlackTree<Key, T, Compare, AllowDuplicates, Allocator, Augment>::Iterator::operator--(int)
 {
     Iterator temp = *this;
     --(*this);
     return temp;
 }
 
-template<typename Key, typename T, typename Compare, bool AllowDuplicates>
-inline bool RedBlackTree<Key, T, Compare, AllowDuplicates>::Iterator::operator==(const Iterator& other) const
+template<typename Key, typename T, typename Compare, bool AllowDuplicates, typename Allocator, typename Augment>
+typename RedBlackTree<Key, T, Compare, AllowDuplicates, Allocator, Augment>::Iterator& RedBlackTree<Key, T, Compare, AllowDuplicates, Allocator, Augment>::Iterator::operator+=(difference_type n) requires order_statistics
+{
+    // Сдвиг за начало даёт огромный индекс, и select_node возвращает end()
+    size_type index = node_index(_node, _nil, _root);
+    _node = select_node(_root, _nil, index + static_cast<size_type>(n));
+    return *this;
+}
+
+template<typename Key, typename T, typename Compare, bool AllowDuplicates, typename Allocator, typename Augment>
+typename RedBlackTree<Key, T, Compare, AllowDuplicates, Allocator, Augment>::Iterator& RedBlackTree<Key, T, Compare, AllowDuplicates, Allocator, Augment>::Iterator::operator-=(difference_type n) requires order_statistics
+{
+    return *this += -n;
+}
+
+template<typename Key, typename T, typename Compare, bool AllowDuplicates, typename Allocator, typename Augment>
+typename RedBlackTree<Key, T, Compare, AllowDuplicates, Allocator, Augment>::Iterator RedBlackTree<Key, T, Compare, AllowDuplicates, Allocator, Augment>::Iterator::operator+(difference_type n) const requires order_statistics
+{
+    Iterator result = *this;
+    return result += n;
+}
+
+template<typename Key, typename T, typename Compare, bool AllowDuplicates, typename Allocator, typename Augment>
+typename RedBlackTree<Key, T, Compare, AllowDuplicates, Allocator, Augment>::Iterator RedBlackTree<Key, T, Compare, AllowDuplicates, Allocator, Augment>::Iterator::operator-(difference_type n) const requires order_statistics
+{
+    Iterator result = *this;
+    return result -= n;
+}
+
+template<typename Key, typename T, typename Compare, bool AllowDuplicates, typename Allocator, typename Augment>
+typename RedBlackTree<Key, T, Compare, AllowDuplicates, Allocator, Augment>::Iterator::difference_type RedBlackTree<Key, T, Compare, AllowDuplicates, Allocator, Augment>::Iterator::operator-(const Iterator& other) const requires order_statistics
+{
+    Node* root = _root;
+    Node* other_root = other._root;
+    return static_cast<difference_type>(node_index(_node, _nil, root)) - static_cast<difference_type>(node_index(other._node, other._nil, other_root));
+}
+
+template<typename Key, typename T, typename Compare, bool AllowDuplicates, typename Allocator, typename Augment>
+inline bool RedBlackTree<Key, T, Compare, AllowDuplicates, Allocator, Augment>::Iterator::operator==(const Iterator& other) const
 {
     return _node == other._node;
 }
 
-template<typename Key, typename T, typename Compare, bool AllowDuplicates>
-inline bool RedBlackTree<Key, T, Compare, AllowDuplicates>::Iterator::operator!=(const Iterator& other) const
+template<typename Key, typename T, typename Compare, bool AllowDuplicates, typename Allocator, typename Augment>
+inline bool RedBlackTree<Key, T, Compare, AllowDuplicates, Allocator, Augment>::Iterator::operator!=(const Iterator& other) const
 {
     return _node != other._node;
 }
 
-template<typename Key, typename T, typename Compare, bool AllowDuplicates>
-typename RedBlackTree<Key, T, Compare, AllowDuplicates>::Node* 
-            RedBlackTree<Key, T, Compare, AllowDuplicates>::Iterator::node() const
+template<typename Key, typename T, typename Compare, bool AllowDuplicates, typename Allocator, typename Augment>
+typename RedBlackTree<Key, T, Compare, AllowDuplicates, Allocator, Augment>::Node* 
+            RedBlackTree<Key, T, Compare, AllowDuplicates, Allocator, Augment>::Iterator::node() const
 {
     return _node;
 }
 
-template<typename Key, typename T, typename Compare, bool AllowDuplicates>
-inline RedBlackTree<Key, T, Compare, AllowDuplicates>::ConstIterator::ConstIterator(Node* node, Node* nil, Node* root)
+template<typename Key, typename T, typename Compare, bool AllowDuplicates, typename Allocator, typename Augment>
+inline RedBlackTree<Key, T, Compare, AllowDuplicates, Allocator, Augment>::ConstIterator::ConstIterator(Node* node, Node* nil, Node* root)
     : _it(node, nil, root)
 {
 }
 
-template<typename Key, typename T, typename Compare, bool AllowDuplicates>
-typename RedBlackTree<Key, T, Compare, AllowDuplicates>::ConstIterator::reference 
-            RedBlackTree<Key, T, Compare, AllowDuplicates>::ConstIterator::operator*() const
+template<typename Key, typename T, typename Compare, bool AllowDuplicates, typename Allocator, typename Augment>
+inline RedBlackTree<Key, T, Compare, AllowDuplicates, Allocator, Augment>::ConstIterator::ConstIterator(const Iterator& it)
+    : _it(it)
+{
+}
+
+template<typename Key, typename T, typename Compare, bool AllowDuplicates, typename Allocator, typename Augment>
+typename RedBlackTree<Key, T, Compare, AllowDuplicates, Allocator, Augment>::ConstIterator::reference 
+            RedBlackTree<Key, T, Compare, AllowDuplicates, Allocator, Augment>::ConstIterator::operator*() const
 {
     return *_it;
 }
 
-template<typename Key, typename T, typename Compare, bool AllowDuplicates>
-typename RedBlackTree<Key, T, Compare, AllowDuplicates>::ConstIterator::pointer 
-            RedBlackTree<Key, T, Compare, AllowDuplicates>::ConstIterator::operator->() const
+template<typename Key, typename T, typename Compare, bool AllowDuplicates, typename Allocator, typename Augment>
+typename RedBlackTree<Key, T, Compare, AllowDuplicates, Allocator, Augment>::ConstIterator::pointer 
+            RedBlackTree<Key, T, Compare, AllowDuplicates, Allocator, Augment>::ConstIterator::operator->() const
 {
-    return &this->_node->data;
+    return _it.operator->();
 }
 
-template<typename Key, typename T, typename Compare, bool AllowDuplicates>
-typename RedBlackTree<Key, T, Compare, AllowDuplicates>::ConstIterator::ConstIterator& 
-            RedBlackTree<Key, T, Compare, AllowDuplicates>::ConstIterator::operator++()
+template<typename Key, typename T, typename Compare, bool AllowDuplicates, typename Allocator, typename Augment>
+typename RedBlackTree<Key, T, Compare, AllowDuplicates, Allocator, Augment>::ConstIterator::ConstIterator& 
+            RedBlackTree<Key, T, Compare, AllowDuplicates, Allocator, Augment>::ConstIterator::operator++()
 {
     ++_it;
     return *this;
 }
 
-template<typename Key, typename T, typename Compare, bool AllowDuplicates>
-typename RedBlackTree<Key, T, Compare, AllowDuplicates>::ConstIterator::ConstIterator
-            RedBlackTree<Key, T, Compare, AllowDuplicates>::ConstIterator::operator++(int)
+template<typename Key, typename T, typename Compare, bool AllowDuplicates, typename Allocator, typename Augment>
+typename RedBlackTree<Key, T, Compare, AllowDuplicates, Allocator, Augment>::ConstIterator::ConstIterator
+            RedBlackTree<Key, T, Compare, AllowDuplicates, Allocator, Augment>::ConstIterator::operator++(int)
 {
-    Iterator temp = *this;
+    ConstIterator temp = *this;
     ++(*this);
     return temp;
 }
 
-template<typename Key, typename T, typename Compare, bool AllowDuplicates>
-typename RedBlackTree<Key, T, Compare, AllowDuplicates>::ConstIterator::ConstIterator& 
-            RedBlackTree<Key, T, Compare, AllowDuplicates>::ConstIterator::operator--()
+template<typename Key, typename T, typename Compare, bool AllowDuplicates, typename Allocator, typename Augment>
+typename RedBlackTree<Key, T, Compare, AllowDuplicates, Allocator, Augment>::ConstIterator::ConstIterator& 
+            RedBlackTree<Key, T, Compare, AllowDuplicates, Allocator, Augment>::ConstIterator::operator--()
 {
-    if (this->_node == _nil)
-        this->_node = maximum(this->_root);
-    else
-        this->_node = predecessor(this->_node);
+    --_it;
     return *this;
 }
 
-template<typename Key, typename T, typename Compare, bool AllowDuplicates>
-typename RedBlackTree<Key, T, Compare, AllowDuplicates>::ConstIterator::ConstIterator
-            RedBlackTree<Key, T, Compare, AllowDuplicates>::ConstIterator::operator--(int)
+template<typename Key, typename T, typename Compare, bool AllowDuplicates, typename Allocator, typename Augment>
+typename RedBlackTree<Key, T, Compare, AllowDuplicates, Allocator, Augment>::ConstIterator::ConstIterator
+            RedBlackTree<Key, T, Compare, AllowDuplicates, Allocator, Augment>::ConstIterator::operator--(int)
 {
-    Iterator temp = *this;
+    ConstIterator temp = *this;
     --(*this);
     return temp;
 }
 
-template<typename Key, typename T, typename Compare, bool AllowDuplicates>
-inline bool RedBlackTree<Key, T, Compare, AllowDuplicates>::ConstIterator::operator==(const ConstIterator& other) const
+template<typename Key, typename T, typename Compare, bool AllowDuplicates, typename Allocator, typename Augment>
+typename RedBlackTree<Key, T, Compare, AllowDuplicates, Allocator, Augment>::ConstIterator& RedBlackTree<Key, T, Compare, AllowDuplicates, Allocator, Augment>::ConstIterator::operator+=(difference_type n) requires order_statistics
+{
+    _it += n;
+    return *this;
+}
+
+template<typename Key, typename T, typename Compare, bool AllowDuplicates, typename Allocator, typename Augment>
+typename RedBlackTree<Key, T, Compare, AllowDuplicates, Allocator, Augment>::ConstIterator& RedBlackTree<Key, T, Compare, AllowDuplicates, Allocator, Augment>::ConstIterator::operator-=(difference_type n) requires order_statistics
+{
+    _it -= n;
+    return *this;
+}
+
+template<typename Key, typename T, typename Compare, bool AllowDuplicates, typename Allocator, typename Augment>
+typename RedBlackTree<Key, T, Compare, AllowDuplicates, Allocator, Augment>::ConstIterator RedBlackTree<Key, T, Compare, AllowDuplicates, Allocator, Augment>::ConstIterator::operator+(difference_type n) const requires order_statistics
+{
+    return ConstIterator(_it + n);
+}
+
+template<typename Key, typename T, typename Compare, bool AllowDuplicates, typename Allocator, typename Augment>
+typename RedBlackTree<Key, T, Compare, AllowDuplicates, Allocator, Augment>::ConstIterator RedBlackTree<Key, T, Compare, AllowDuplicates, Allocator, Augment>::ConstIterator::operator-(difference_type n) const requires order_statistics
+{
+    return ConstIterator(_it - n);
+}
+
+template<typename Key, typename T, typename Compare, bool AllowDuplicates, typename Allocator, typename Augment>
+typename RedBlackTree<Key, T, Compare, AllowDuplicates, Allocator, Augment>::ConstIterator::difference_type RedBlackTree<Key, T, Compare, AllowDuplicates, Allocator, Augment>::ConstIterator::operator-(const ConstIterator& other) const requires order_statistics
+{
+    return _it - other._it;
+}
+
+template<typename Key, typename T, typename Compare, bool AllowDuplicates, typename Allocator, typename Augment>
+inline bool RedBlackTree<Key, T, Compare, AllowDuplicates, Allocator, Augment>::ConstIterator::operator==(const ConstIterator& other) const
 {
     return _it == other._it;
 }
 
-template<typename Key, typename T, typename Compare, bool AllowDuplicates>
-inline bool RedBlackTree<Key, T, Compare, AllowDuplicates>::ConstIterator::operator!=(const ConstIterator& other) const
+template<typename Key, typename T, typename Compare, bool AllowDuplicates, typename Allocator, typename Augment>
+inline bool RedBlackTree<Key, T, Compare, AllowDuplicates, Allocator, Augment>::ConstIterator::operator!=(const ConstIterator& other) const
 {
     return _it != other._it;
 }
 
-template<typename Key, typename T, typename Compare, bool AllowDuplicates>
-inline void RedBlackTree<Key, T, Compare, AllowDuplicates>::inorder(std::function<void(const_reference)> visit) const
+template<typename Key, typename T, typename Compare, bool AllowDuplicates, typename Allocator, typename Augment>
+typename RedBlackTree<Key, T, Compare, AllowDuplicates, Allocator, Augment>::Node* 
+            RedBlackTree<Key, T, Compare, AllowDuplicates, Allocator, Augment>::ConstIterator::node() const
 {
-    inorder_helper(_root, visit);
+    return _it.node();
 }
 
-template<typename Key, typename T, typename Compare, bool AllowDuplicates>
-inline void RedBlackTree<Key, T, Compare, AllowDuplicates>::preorder(std::function<void(const_reference)> visit) const
+template<typename Key, typename T, typename Compare, bool AllowDuplicates, typename Allocator, typename Augment>
+template<typename Visitor>
+inline void RedBlackTree<Key, T, Compare, AllowDuplicates, Allocator, Augment>::inorder(Visitor&& visit) const
 {
-    preorder_helper(_root, visit);
+    for (Node* node = minimum(_root); node != _nil; node = successor(node))
+        visit(static_cast<const_reference>(node->data));
 }
 
-template<typename Key, typename T, typename Compare, bool AllowDuplicates>
-inline void RedBlackTree<Key, T, Compare, AllowDuplicates>::postorder(std::function<void(const_reference)> visit) const
+template<typename Key, typename T, typename Compare, bool AllowDuplicates, typename Allocator, typename Augment>
+template<typename Visitor>
+inline void RedBlackTree<Key, T, Compare, AllowDuplicates, Allocator, Augment>::preorder(Visitor&& visit) const
 {
-    postorder_helper(_root, visit);
+    for (Node* node = _root; node != _nil; node = preorder_next(node))
+        visit(static_cast<const_reference>(node->data));
 }
 
-template<typename Key, typename T, typename Compare, bool AllowDuplicates>
-inline void RedBlackTree<Key, T, Compare, AllowDuplicates>::levelorder(std::function<void(const_reference)> visit) const
+template<typename Key, typename T, typename Compare, bool AllowDuplicates, typename Allocator, typename Augment>
+template<typename Visitor>
+inline void RedBlackTree<Key, T, Compare, AllowDuplicates, Allocator, Augment>::postorder(Visitor&& visit) const
 {
     if (_root == _nil)
         return;
-    std::queue<Node*> q;
-    q.push(_root);
 
-    while (!q.empty())
+    Node* node = postorder_first(_root);
+    while (true)
     {
-        Node* node = q.front();
-        q.pop();
-        visit(node->data);
+        visit(static_cast<const_reference>(node->data));
+        Node* parent = node->parent();
+        if (parent == _nil)
+            return;
+        node = (node == parent->left && parent->right != _nil) ? postorder_first(parent->right) : parent;
+    }
+}
 
-        if (node->left != _nil)
-            q.push(node->left);
-        if (node->right != _nil)
-            q.push(node->right);
+template<typename Key, typename T, typename Compare, bool AllowDuplicates, typename Allocator, typename Augment>
+template<typename Visitor>
+inline void RedBlackTree<Key, T, Compare, AllowDuplicates, Allocator, Augment>::levelorder(Visitor&& visit) const
+{
+    // Обходу в ширину нужен фронт: два буфера на текущий и следующий уровни
+    // переиспользуются от уровня к уровню
+    if (_root == _nil)
+        return;
+
+    std::vector<Node*> level{ _root };
+    std::vector<Node*> next;
+    while (!level.empty())
+    {
+        for (Node* node : level)
+        {
+            visit(static_cast<const_reference>(node->data));
+            if (node->left != _nil)
+                next.push_back(node->left);
+            if (node->right != _nil)
+                next.push_back(node->right);
+        }
+        level.swap(next);
+        next.clear();
     }
 }
 
-template<typename Key, typename T, typename Compare, bool AllowDuplicates>
-inline bool RedBlackTree<Key, T, Compare, AllowDuplicates>::operator==(const RedBlackTree& other) const
+template<typename Key, typename T, typename Compare, bool AllowDuplicates, typename Allocator, typename Augment>
+inline bool RedBlackTree<Key, T, Compare, AllowDuplicates, Allocator, Augment>::operator==(const RedBlackTree& other) const
 {
     if (this == &other)
         return true;
@@ -1286,46 +3849,217 @@ inline bool RedBlackTree<Key, T, Compare, AllowDuplicates>::operator==(const Red
     return true;
 }
 
-template<typename Key, typename T, typename Compare, bool AllowDuplicates>
-inline bool RedBlackTree<Key, T, Compare, AllowDuplicates>::operator!=(const RedBlackTree& other) const
+template<typename Key, typename T, typename Compare, bool AllowDuplicates, typename Allocator, typename Augment>
+inline bool RedBlackTree<Key, T, Compare, AllowDuplicates, Allocator, Augment>::operator!=(const RedBlackTree& other) const
 {
     return !(*this == other);
 }
 
-template<typename Key, typename T, typename Compare, bool AllowDuplicates>
+template<typename Key, typename T, typename Compare, bool AllowDuplicates, typename Allocator, typename Augment>
 template<typename U>
-inline RedBlackTree<Key, T, Compare, AllowDuplicates>::RedBlackTree(std::initializer_list<key_type> init,
+inline RedBlackTree<Key, T, Compare, AllowDuplicates, Allocator, Augment>::RedBlackTree(std::initializer_list<key_type> init,
     std::enable_if_t<std::is_same<U, EmptyStruct>::value>*)
     : RedBlackTree()
 {
-    for (const auto& key : init)
-        insert(key);
+    insert(init.begin(), init.end());
 }
 
-template<typename Key, typename T, typename Compare, bool AllowDuplicates>
+template<typename Key, typename T, typename Compare, bool AllowDuplicates, typename Allocator, typename Augment>
 template<typename ...Args>
-inline std::pair<typename RedBlackTree<Key, T, Compare, AllowDuplicates>::iterator, bool> 
-            RedBlackTree<Key, T, Compare, AllowDuplicates>::emplace(Args && ...args)
+inline std::pair<typename RedBlackTree<Key, T, Compare, AllowDuplicates, Allocator, Augment>::iterator, bool> 
+            RedBlackTree<Key, T, Compare, AllowDuplicates, Allocator, Augment>::emplace(Args && ...args)
+{
+    return emplace_at(nullptr, std::forward<Args>(args)...);
+}
+
+template<typename Key, typename T, typename Compare, bool AllowDuplicates, typename Allocator, typename Augment>
+inline typename RedBlackTree<Key, T, Compare, AllowDuplicates, Allocator, Augment>::iterator 
+            RedBlackTree<Key, T, Compare, AllowDuplicates, Allocator, Augment>::insert(const_iterator hint, const value_type& val)
+{
+    return emplace_at(hint.node(), val).first;
+}
+
+template<typename Key, typename T, typename Compare, bool AllowDuplicates, typename Allocator, typename Augment>
+inline typename RedBlackTree<Key, T, Compare, AllowDuplicates, Allocator, Augment>::iterator 
+            RedBlackTree<Key, T, Compare, AllowDuplicates, Allocator, Augment>::insert(const_iterator hint, value_type&& val)
+{
+    return emplace_at(hint.node(), std::move(val)).first;
+}
+
+template<typename Key, typename T, typename Compare, bool AllowDuplicates, typename Allocator, typename Augment>
+template<typename... Args>
+inline typename RedBlackTree<Key, T, Compare, AllowDuplicates, Allocator, Augment>::iterator 
+            RedBlackTree<Key, T, Compare, AllowDuplicates, Allocator, Augment>::emplace_hint(const_iterator hint, Args&&... args)
+{
+    return emplace_at(hint.node(), std::forward<Args>(args)...).first;
+}
+
+template<typename Key, typename T, typename Compare, bool AllowDuplicates, typename Allocator, typename Augment>
+template<typename... Args>
+inline std::pair<typename RedBlackTree<Key, T, Compare, AllowDuplicates, Allocator, Augment>::iterator, bool> 
+            RedBlackTree<Key, T, Compare, AllowDuplicates, Allocator, Augment>::emplace_at(Node* hint, Args&&... args)
 {
-    return insert(value_type(std::forward<Args>(args)...));
+    if constexpr (std::is_same<T, EmptyStruct>::value && std::is_constructible<Key, Args&&...>::value)
+    {
+        // Для множества значение — это ключ: узел создаётся только при промахе
+        if constexpr (sizeof...(Args) == 1 && (std::is_same<std::decay_t<Args>, Key>::value && ...))
+            return try_emplace_at(hint, std::forward<Args>(args)...);
+        else
+            return try_emplace_at(hint, Key(std::forward<Args>(args)...));
+    }
+    else if constexpr (sizeof...(Args) == 2)
+    {
+        if constexpr (std::is_same<std::decay_t<std::tuple_element_t<0, std::tuple<Args...>>>, Key>::value)
+            return try_emplace_at(hint, std::forward<Args>(args)...);
+        else
+            return emplace_node(hint, std::forward<Args>(args)...);
+    }
+    else if constexpr (sizeof...(Args) == 1)
+        return emplace_single(hint, std::forward<Args>(args)...);
+    else
+        return emplace_node(hint, std::forward<Args>(args)...);
 }
 
-template<typename Key, typename T, typename Compare, bool AllowDuplicates>
+template<typename Key, typename T, typename Compare, bool AllowDuplicates, typename Allocator, typename Augment>
 template<typename U>
 inline std::enable_if_t<std::is_same<U, EmptyStruct>::value, 
-            std::pair<typename RedBlackTree<Key, T, Compare, AllowDuplicates>::iterator, bool>>
-            RedBlackTree<Key, T, Compare, AllowDuplicates>::insert(const Key& key)
+            std::pair<typename RedBlackTree<Key, T, Compare, AllowDuplicates, Allocator, Augment>::iterator, bool>>
+            RedBlackTree<Key, T, Compare, AllowDuplicates, Allocator, Augment>::insert(const Key& key)
 {
-    return insert(std::make_pair(key, EmptyStruct{}));
+    return try_emplace(key);
 }
 
-template<typename Key, typename T, typename Compare, bool AllowDuplicates>
+template<typename Key, typename T, typename Compare, bool AllowDuplicates, typename Allocator, typename Augment>
 template<typename U>
 inline std::enable_if_t<std::is_same<U, EmptyStruct>::value, 
-            std::pair<typename RedBlackTree<Key, T, Compare, AllowDuplicates>::iterator, bool>>
-            RedBlackTree<Key, T, Compare, AllowDuplicates>::emplace(const Key& key)
+            std::pair<typename RedBlackTree<Key, T, Compare, AllowDuplicates, Allocator, Augment>::iterator, bool>>
+            RedBlackTree<Key, T, Compare, AllowDuplicates, Allocator, Augment>::emplace(const Key& key)
+{
+    return try_emplace(key);
+}
+
+template<typename Key, typename T, typename Compare, bool AllowDuplicates, typename Allocator, typename Augment>
+template<typename K, typename... Args>
+inline std::pair<typename RedBlackTree<Key, T, Compare, AllowDuplicates, Allocator, Augment>::iterator, bool> 
+            RedBlackTree<Key, T, Compare, AllowDuplicates, Allocator, Augment>::try_emplace(K&& key, Args&&... args)
+{
+    return try_emplace_at(nullptr, std::forward<K>(key), std::forward<Args>(args)...);
+}
+
+template<typename Key, typename T, typename Compare, bool AllowDuplicates, typename Allocator, typename Augment>
+template<typename K, typename... Args>
+inline std::pair<typename RedBlackTree<Key, T, Compare, AllowDuplicates, Allocator, Augment>::iterator, bool> 
+            RedBlackTree<Key, T, Compare, AllowDuplicates, Allocator, Augment>::try_emplace_at(Node* hint, K&& key, Args&&... args)
+{
+    if constexpr (!std::is_same<std::decay_t<K>, Key>::value && !is_transparent_compare<Compare>::value)
+    {
+        // Без прозрачного компаратора сравнивать можно только Key — конвертируем один раз
+        return try_emplace_at(hint, Key(std::forward<K>(key)), std::forward<Args>(args)...);
+    }
+    else
+    {
+        InsertPosition pos = find_position(hint, key);
+        if (pos.exists)
+            return { iterator(pos.node, _nil, _root), false };
+
+        Node* z = create_node(std::in_place, std::piecewise_construct,
+            std::forward_as_tuple(std::forward<K>(key)), std::forward_as_tuple(std::forward<Args>(args)...));
+        return link_node(z, pos);
+    }
+}
+
+template<typename Key, typename T, typename Compare, bool AllowDuplicates, typename Allocator, typename Augment>
+inline RedBlackTree<Key, T, Compare, AllowDuplicates, Allocator, Augment>::NodeHandle::NodeHandle() noexcept
+    : _node(nullptr)
+{
+}
+
+template<typename Key, typename T, typename Compare, bool AllowDuplicates, typename Allocator, typename Augment>
+inline RedBlackTree<Key, T, Compare, AllowDuplicates, Allocator, Augment>::NodeHandle::NodeHandle(Node* node, const node_allocator_type& alloc)
+    : _node(node)
+    , _alloc(alloc)
+{
+}
+
+template<typename Key, typename T, typename Compare, bool AllowDuplicates, typename Allocator, typename Augment>
+inline RedBlackTree<Key, T, Compare, AllowDuplicates, Allocator, Augment>::NodeHandle::NodeHandle(NodeHandle&& other) noexcept
+    : _node(other._node)
+    , _alloc(std::move(other._alloc))
+{
+    other._node = nullptr;
+    other._alloc.reset();
+}
+
+template<typename Key, typename T, typename Compare, bool AllowDuplicates, typename Allocator, typename Augment>
+inline typename RedBlackTree<Key, T, Compare, AllowDuplicates, Allocator, Augment>::NodeHandle& 
+            RedBlackTree<Key, T, Compare, AllowDuplicates, Allocator, Augment>::NodeHandle::operator=(NodeHandle&& other) noexcept
+{
+    if (this != &other)
+    {
+        if (_node)
+        {
+            node_traits::destroy(*_alloc, _node);
+            node_traits::deallocate(*_alloc, _node, 1);
+        }
+        _node = other._node;
+        _alloc = std::move(other._alloc);
+        other._node = nullptr;
+        other._alloc.reset();
+    }
+    return *this;
+}
+
+template<typename Key, typename T, typename Compare, bool AllowDuplicates, typename Allocator, typename Augment>
+inline RedBlackTree<Key, T, Compare, AllowDuplicates, Allocator, Augment>::NodeHandle::~NodeHandle()
+{
+    if (_node)
+    {
+        node_traits::destroy(*_alloc, _node);
+        node_traits::deallocate(*_alloc, _node, 1);
+    }
+}
+
+template<typename Key, typename T, typename Compare, bool AllowDuplicates, typename Allocator, typename Augment>
+inline typename RedBlackTree<Key, T, Compare, AllowDuplicates, Allocator, Augment>::Node* RedBlackTree<Key, T, Compare, AllowDuplicates, Allocator, Augment>::NodeHandle::release()
+{
+    Node* node = _node;
+    _node = nullptr;
+    _alloc.reset();
+    return node;
+}
+
+template<typename Key, typename T, typename Compare, bool AllowDuplicates, typename Allocator, typename Augment>
+inline bool RedBlackTree<Key, T, Compare, AllowDuplicates, Allocator, Augment>::NodeHandle::empty() const noexcept
+{
+    return _node == nullptr;
+}
+
+template<typename Key, typename T, typename Compare, bool AllowDuplicates, typename Allocator, typename Augment>
+inline RedBlackTree<Key, T, Compare, AllowDuplicates, Allocator, Augment>::NodeHandle::operator bool() const noexcept
+{
+    return _node != nullptr;
+}
+
+template<typename Key, typename T, typename Compare, bool AllowDuplicates, typename Allocator, typename Augment>
+inline typename RedBlackTree<Key, T, Compare, AllowDuplicates, Allocator, Augment>::key_type& RedBlackTree<Key, T, Compare, AllowDuplicates, Allocator, Augment>::NodeHandle::key() const
 {
-    return insert(std::make_pair(key, EmptyStruct{}));
+    return const_cast<key_type&>(_node->data.first);
 }
 
+template<typename Key, typename T, typename Compare, bool AllowDuplicates, typename Allocator, typename Augment>
+inline typename RedBlackTree<Key, T, Compare, AllowDuplicates, Allocator, Augment>::mapped_type& RedBlackTree<Key, T, Compare, AllowDuplicates, Allocator, Augment>::NodeHandle::mapped() const
+{
+    return _node->data.second;
+}
+
+template<typename Key, typename T, typename Compare, bool AllowDuplicates, typename Allocator, typename Augment>
+inline typename RedBlackTree<Key, T, Compare, AllowDuplicates, Allocator, Augment>::value_type& RedBlackTree<Key, T, Compare, AllowDuplicates, Allocator, Augment>::NodeHandle::value() const
+{
+    return _node->data;
+}
 
+template<typename Key, typename T, typename Compare, bool AllowDuplicates, typename Allocator, typename Augment>
+inline typename RedBlackTree<Key, T, Compare, AllowDuplicates, Allocator, Augment>::allocator_type RedBlackTree<Key, T, Compare, AllowDuplicates, Allocator, Augment>::NodeHandle::get_allocator() const
+{
+    return allocator_type(*_alloc);
+}
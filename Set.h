@@ -1,16 +1,114 @@
 #pragma once
 
+#include <atomic>
 #include <initializer_list>
 #include <utility>
 #include <functional>
+#include <span>
+#include <tuple>
+#include <type_traits>
+#include <algorithm>
+#include <bit>
+#include <vector>
 
 #include "RedBlackTree.h"
+#include "ThreadPool.h"
 
-template<typename Key, typename Compare = std::less<Key>>
+// Бэкенд задаёт дерево, на котором построен Set: шаблон от ключа, компаратора и аллокатора.
+// Второй бэкенд — BTreeBackend из BTree.h
+struct RedBlackTreeBackend
+{
+	template<typename Key, typename Compare, typename Allocator>
+	using tree = RedBlackTree<Key, EmptyStruct, Compare, false, Allocator>;
+};
+
+// Красно-чёрное дерево со сводками поддеревьев по политике Augment (см. NoAugment): aggregate за O(log n).
+// Узел больше на размер сводки, вставка и удаление пересчитывают сводки на пути до корня
+template<typename Augment>
+struct AugmentedBackend
+{
+	template<typename Key, typename Compare, typename Allocator>
+	using tree = RedBlackTree<Key, EmptyStruct, Compare, false, Allocator, Augment>;
+};
+
+// Размеры поддеревьев: rank, select, count_range и iterator + n за O(log n)
+using OrderStatisticsBackend = AugmentedBackend<SubtreeSize>;
+
+// У B-дерева ключи лежат в массивах, отдельных узлов нет — нет и node handle'ов
+struct NoNodeHandle {};
+
+template<typename Tree, typename = void>
+struct tree_node_handle
+{
+	using node_type = NoNodeHandle;
+	using insert_return_type = NoNodeHandle;
+};
+
+template<typename Tree>
+struct tree_node_handle<Tree, std::void_t<typename Tree::node_type>>
+{
+	using node_type = typename Tree::node_type;
+	using insert_return_type = typename Tree::insert_return_type;
+};
+
+// Неделимый диапазон для бэкендов без деления по структуре (см. RedBlackTree::Range): параллельный обход
+// через него идёт одной задачей
+template<typename It>
+class SerialRange
+{
+public:
+	SerialRange(It first, It last, std::size_t size)
+		: _first(first)
+		, _last(last)
+		, _size(size)
+	{
+	}
+
+	template<typename Split>
+		requires std::is_empty_v<Split>
+	SerialRange(SerialRange& other, Split)
+		: SerialRange(other.split())
+	{
+	}
+
+	It begin() const { return _first; }
+	It end() const { return _last; }
+
+	bool empty() const { return _first == _last; }
+	std::size_t size() const { return _size; }
+	bool is_divisible() const { return false; }
+	SerialRange split() { return SerialRange(_last, _last, 0); }
+
+private:
+	It _first;
+	It _last;
+	std::size_t _size;
+};
+
+template<typename Tree, typename = void>
+struct tree_range
+{
+	using type = SerialRange<typename Tree::const_iterator>;
+};
+
+template<typename Tree>
+struct tree_range<Tree, std::void_t<typename Tree::range_type>>
+{
+	using type = typename Tree::range_type;
+};
+
+// Размеры настолько разные, что small поисков по большему множеству (small · log large) дешевле слияния
+inline bool set_sizes_skewed(std::size_t small, std::size_t large)
+{
+	return small < large / static_cast<std::size_t>(std::bit_width(large) + 1);
+}
+
+template<typename Key, typename Compare = std::less<Key>, typename Allocator = std::allocator<Key>,
+	typename Backend = RedBlackTreeBackend>
 class Set
 {
 private:
-	using Tree = RedBlackTree<Key, EmptyStruct, Compare>;
+	using Tree = typename Backend::template tree<Key, Compare, Allocator>;
 	Tree _tree;
 
 public:
@@ -20,15 +118,21 @@ public:
 	using difference_type = std::ptrdiff_t;
 	using key_compare = Compare;
 	using value_compare = Compare;
+	using allocator_type = Allocator;
 
 	using iterator = typename Tree::iterator;
 	using const_iterator = typename Tree::const_iterator;
 	using reverse_iterator = typename Tree::reverse_iterator;
 	using const_reverse_iterator = typename Tree::const_reverse_iterator;
+	using node_type = typename tree_node_handle<Tree>::node_type;
+	using insert_return_type = typename tree_node_handle<Tree>::insert_return_type;
+	using range_type = typename tree_range<Tree>::type;
 
 
 	Set();
 	explicit Set(const Compare& comp);
+	explicit Set(const Allocator& alloc);
+	Set(const Compare& comp, const Allocator& alloc);
 	Set(std::initializer_list<Key> init);
 	Set(const Set& other);
 	Set(Set&& other) noexcept;
@@ -37,8 +141,28 @@ public:
 	template<typename InputIt>
 	Set(InputIt first, InputIt last);
 
+	// Диапазон уже упорядочен по Compare и не содержит повторов: дерево строится за O(n)
+	template<typename InputIt>
+	Set(sorted_unique_t, InputIt first, InputIt last, const Compare& comp = Compare());
+
+	// Параллельные построение и копирование: exec — ThreadPool или, с ExecutionPolicy.h, политика из <execution>
+	// (std::execution::seq — в вызывающем потоке, остальные — на ThreadPool::shared()).
+	// Красно-чёрное дерево строится и копируется по поддеревьям в разных задачах, другие бэкенды — последовательно
+	template<parallel::executor Exec, typename RandomIt>
+	Set(Exec&& exec, sorted_unique_t, RandomIt first, RandomIt last, const Compare& comp = Compare());
+	template<parallel::executor Exec>
+	Set(Exec&& exec, const Set& other);
+
 	Set& operator=(const Set& other);
-	Set& operator=(Set&& other);
+	Set& operator=(Set&& other) noexcept(std::is_nothrow_move_assignable<Tree>::value);
+
+	allocator_type get_allocator() const;
+	key_compare key_comp() const;
+
+	template<typename InputIt>
+	void assign(InputIt first, InputIt last);
+	template<typename InputIt>
+	void assign(sorted_unique_t, InputIt first, InputIt last);
 
 	iterator begin() noexcept;
 	iterator end() noexcept;
@@ -61,16 +185,67 @@ public:
 	std::pair<iterator, bool> insert(const Key& key);
 	std::pair<iterator, bool> insert(Key&& key);
 
+	iterator insert(const_iterator hint, const Key& key);
+	iterator insert(const_iterator hint, Key&& key);
+
+	// Диапазон вставляется с подсказкой от предыдущего элемента: на упорядоченных данных — амортизированно O(1)
+	template<typename InputIt>
+	void insert(InputIt first, InputIt last);
+
 	template<typename... Args>
 	std::pair<iterator, bool> emplace(Args&&... args);
 
+	template<typename... Args>
+	iterator emplace_hint(const_iterator hint, Args&&... args);
+
+	template<typename K>
+	std::pair<iterator, bool> try_emplace(K&& key);
+
 	size_type erase(const Key& key);
-	void erase(iterator pos);
+	iterator erase(iterator pos);
+	iterator erase(const_iterator pos);
+	iterator erase(const_iterator first, const_iterator last);
+
+	node_type extract(const_iterator pos);
+	node_type extract(const Key& key);
+
+	insert_return_type insert(node_type&& nh);
+	iterator insert(const_iterator hint, node_type&& nh);
+
+	// Перевешивает узлы из source без аллокаций; ключи, уже имеющиеся здесь, остаются в source
+	void merge(Set& source);
+	void merge(Set&& source);
+
+	// Операции над множествами на месте. Узлы этого множества не копируются: лишние удаляются,
+	// новые вставляются с подсказкой по ходу слияния; из временного множества узлы перевешиваются.
+	// Если other намного меньше, красно-чёрное дерево режется split по ключам other и склеивается join — O(m log n)
+	Set& operator|=(const Set& other);
+	Set& operator|=(Set&& other);
+	Set& operator&=(const Set& other);
+	Set& operator-=(const Set& other);
+	Set& operator^=(const Set& other);
+
+	// Разрезание и склейка: в first — ключи меньше key, в second — остальные, само множество остаётся пустым;
+	// в join все ключи left меньше ключей right (и middle между ними). У красно-чёрного дерева — O(log n)
+	// с перевешиванием узлов, у бэкендов без split/join — перестроение за O(n). Результат join берёт
+	// аллокатор left; если аллокатор right не равен ему, узлы right копируются через аллокатор left за O(m)
+	std::pair<Set, Set> split(const Key& key);
+	static Set join(Set&& left, Set&& right);
+	static Set join(Set&& left, const Key& middle, Set&& right);
 
 	iterator find(const Key& key);
 	const_iterator find(const Key& key) const;
 
 	bool contains(const Key& key) const;
+	// result[i] = contains(keys[i]); result не короче keys. Бэкенд может обойти дерево
+	// один раз на весь пакет — B-дерево, например, не спускается от корня внутри одного листа
+	void contains_many(std::span<const Key> keys, std::span<bool> result) const;
+
+	// Пакетный поиск: result[i] соответствует keys[i]. Красно-чёрное дерево ведёт несколько спусков
+	// одновременно с предвыборкой узлов, чтобы промахи кэша разных ключей перекрывались
+	void find_batch(std::span<const Key> keys, std::span<iterator> result);
+	void find_batch(std::span<const Key> keys, std::span<const_iterator> result) const;
+	void contains_batch(std::span<const Key> keys, std::span<bool> result) const;
 
 	iterator lower_bound(const Key& key);
 	const_iterator lower_bound(const Key& key) const;
@@ -81,247 +256,1191 @@ public:
 	std::pair<iterator, iterator> equal_range(const Key& key);
 	std::pair<const_iterator, const_iterator> equal_range(const Key& key) const;
 
-	template<typename K, typename C>
-	friend bool operator==(const Set<K, C>& lhs, const Set<K, C>& rhs);
+	// Порядковые статистики: rank — число ключей меньше key, select — k-й по порядку ключ (с нуля) или end(),
+	// count_range — число ключей в [lo, hi). С OrderStatisticsBackend — O(log n), с остальными бэкендами — проход итераторами
+	size_type rank(const Key& key) const;
+	iterator select(size_type k);
+	const_iterator select(size_type k) const;
+	size_type count_range(const Key& lo, const Key& hi) const;
+
+	// Сводка ключей из [lo, hi) по политике AugmentedBackend за O(log n); без аргументов — всего множества за O(1)
+	auto aggregate(const Key& lo, const Key& hi) const requires Tree::augmented;
+	auto aggregate() const requires Tree::augmented;
+
+	// Буферизованная запись: вставки и удаления копятся в WriteBatch и применяются одним упорядоченным проходом
+	class WriteBatch;
+	static constexpr size_type default_batch_size = size_type(1) << 16;
+	WriteBatch batch(size_type max_pending = default_batch_size);
+
+	// Границы деления на parts частей примерно равного размера: begin(), внутренние границы по возрастанию, end().
+	// У красно-чёрного дерева — узлы верхних уровней без обхода; у других бэкендов — одна часть
+	std::vector<const_iterator> partition(size_type parts) const;
+
+	// Делимый диапазон всех ключей или ключей из [lo, hi) для параллельного обхода (см. RedBlackTree::Range):
+	// части не больше grain не делятся. У бэкендов без деления по структуре диапазон неделим
+	range_type range(size_type grain = 1) const;
+	range_type range(const Key& lo, const Key& hi, size_type grain = 1) const;
+
+	// Параллельные обход и сравнение: обход делит range(), сравнение — части partition. f вызывается для каждого ключа ровно один раз,
+	// из разных потоков и не по порядку; equal — параллельный operator==
+	template<parallel::executor Exec, typename F>
+	void for_each(Exec&& exec, F&& f) const;
+	template<parallel::executor Exec>
+	bool equal(Exec&& exec, const Set& other) const;
+
+	template<typename K, typename C, typename A, typename B>
+	friend bool operator==(const Set<K, C, A, B>& lhs, const Set<K, C, A, B>& rhs);
+
+	template<typename K, typename C, typename A, typename B>
+	friend bool operator!=(const Set<K, C, A, B>& lhs, const Set<K, C, A, B>& rhs);
+
+	template<typename K, typename C, typename A, typename B>
+	friend void swap(Set<K, C, A, B>& lhs, Set<K, C, A, B>& rhs) noexcept;
+
+private:
+	// Бэкенд выполняет операции над множествами разрезанием и склейкой (RedBlackTree::split_join)
+	static constexpr bool split_joinable = requires (Tree& tree, const_iterator it) { tree.split_join(it, it, true, true, true); };
 
-	template<typename K, typename C>
-	friend bool operator!=(const Set<K, C>& lhs, const Set<K, C>& rhs);
+	// Дерево source, узлы которого может освободить alloc: само дерево или, при неравных аллокаторах, его копия через alloc
+	static Tree relinkable_tree(Set&& source, const allocator_type& alloc);
 
-	template<typename K, typename C>
-	friend void swap(Set<K, C>& lhs, Set<K, C>& rhs) noexcept;
+	// Упорядоченный по ключу пакет без повторов из WriteBatch: it->second — вставка it->first, иначе удаление
+	template<typename RandomIt>
+	void apply_sorted(RandomIt first, RandomIt last);
 };
 
-template<typename Key, typename Compare>
-inline Set<Key, Compare>::Set() = default;
+// Пакет записей в Set. insert и erase только запоминаются; flush упорядочивает пакет, оставляет по каждому
+// ключу последнюю операцию и применяет всё одним проходом: у красно-чёрного дерева поиск очередного ключа
+// начинается от места предыдущего, а большой пакет сливается с деревом за O(n + m) (RedBlackTree::apply_sorted).
+// contains пакета учитывает ожидающие записи, чтения самого множества — нет. Пакет применяется сам,
+// когда в нём max_pending операций, и в деструкторе; деструктор не бросает — если flush в нём не удался,
+// записи пакета теряются, поэтому, чтобы обработать ошибку, flush вызывают явно. Если flush бросил,
+// пакет пуст, а часть записей могла примениться
+template<typename Key, typename Compare, typename Allocator, typename Backend>
+class Set<Key, Compare, Allocator, Backend>::WriteBatch
+{
+public:
+	explicit WriteBatch(Set& set, size_type max_pending = default_batch_size);
+	~WriteBatch();
+
+	WriteBatch(const WriteBatch&) = delete;
+	WriteBatch& operator=(const WriteBatch&) = delete;
+
+	void insert(const Key& key);
+	void insert(Key&& key);
+	void erase(const Key& key);
+
+	// Есть ли ключ в множестве после применения пакета
+	bool contains(const Key& key) const;
+
+	// Операций в пакете, включая повторы одного ключа
+	size_type pending() const noexcept;
+	void flush();
+	void discard() noexcept;
+
+private:
+	using Op = std::pair<Key, bool>;
 
-template<typename Key, typename Compare>
-inline Set<Key, Compare>::Set(const Compare& comp) 
+	void push(Op&& op);
+	// Упорядочивает операции, добавленные после прошлого вызова, и сливает с уже упорядоченными;
+	// из операций с одним ключом остаётся последняя. O(k log k + m) для k новых из m
+	void normalize() const;
+
+	Set& _set;
+	mutable std::vector<Op> _ops;
+	mutable size_type _normalized = 0;
+	size_type _max_pending;
+};
+
+template<typename Key, typename Compare, typename Allocator, typename Backend>
+inline Set<Key, Compare, Allocator, Backend>::Set() = default;
+
+template<typename Key, typename Compare, typename Allocator, typename Backend>
+inline Set<Key, Compare, Allocator, Backend>::Set(const Compare& comp) 
 	: _tree(Tree(comp))
 {
 }
 
-template<typename Key, typename Compare>
-inline Set<Key, Compare>::Set(std::initializer_list<Key> init)
+template<typename Key, typename Compare, typename Allocator, typename Backend>
+inline Set<Key, Compare, Allocator, Backend>::Set(const Allocator& alloc)
+	: _tree(alloc)
+{
+}
+
+template<typename Key, typename Compare, typename Allocator, typename Backend>
+inline Set<Key, Compare, Allocator, Backend>::Set(const Compare& comp, const Allocator& alloc)
+	: _tree(comp, alloc)
+{
+}
+
+template<typename Key, typename Compare, typename Allocator, typename Backend>
+inline Set<Key, Compare, Allocator, Backend>::Set(std::initializer_list<Key> init)
 	: _tree(init)
 {
 }
 
-template<typename Key, typename Compare>
-inline Set<Key, Compare>::Set(const Set& other) = default;
+template<typename Key, typename Compare, typename Allocator, typename Backend>
+inline Set<Key, Compare, Allocator, Backend>::Set(const Set& other) = default;
+
+template<typename Key, typename Compare, typename Allocator, typename Backend>
+inline Set<Key, Compare, Allocator, Backend>::Set(Set&& other) noexcept = default;
+
+template<typename Key, typename Compare, typename Allocator, typename Backend>
+inline Set<Key, Compare, Allocator, Backend>::~Set() = default;
+
+template<typename Key, typename Compare, typename Allocator, typename Backend>
+template<parallel::executor Exec, typename RandomIt>
+inline Set<Key, Compare, Allocator, Backend>::Set(Exec&& exec, sorted_unique_t, RandomIt first, RandomIt last, const Compare& comp)
+	: _tree(comp)
+{
+	if constexpr (requires { _tree.assign_parallel(sorted_unique, first, last, parallel::Fork{}); })
+		_tree.assign_parallel(sorted_unique, first, last, parallel::Fork{ parallel::pool_of(exec) });
+	else
+		_tree.assign(sorted_unique, first, last);
+}
+
+template<typename Key, typename Compare, typename Allocator, typename Backend>
+template<parallel::executor Exec>
+inline Set<Key, Compare, Allocator, Backend>::Set(Exec&& exec, const Set& other)
+	: _tree(other.key_comp(), std::allocator_traits<Allocator>::select_on_container_copy_construction(other.get_allocator()))
+{
+	if constexpr (requires { _tree.assign_parallel(other._tree, parallel::Fork{}); })
+		_tree.assign_parallel(other._tree, parallel::Fork{ parallel::pool_of(exec) });
+	else
+		_tree = other._tree;
+}
 
-template<typename Key, typename Compare>
-inline Set<Key, Compare>::Set(Set&& other) noexcept = default;
+template<typename Key, typename Compare, typename Allocator, typename Backend>
+inline Set<Key, Compare, Allocator, Backend>& Set<Key, Compare, Allocator, Backend>::operator=(const Set& other) = default;
 
-template<typename Key, typename Compare>
-inline Set<Key, Compare>::~Set() = default;
+template<typename Key, typename Compare, typename Allocator, typename Backend>
+inline Set<Key, Compare, Allocator, Backend>& Set<Key, Compare, Allocator, Backend>::operator=(Set&& other)
+	noexcept(std::is_nothrow_move_assignable<Tree>::value) = default;
 
-template<typename Key, typename Compare>
-inline Set<Key, Compare>& Set<Key, Compare>::operator=(const Set& other) = default;
+template<typename Key, typename Compare, typename Allocator, typename Backend>
+inline typename Set<Key, Compare, Allocator, Backend>::allocator_type Set<Key, Compare, Allocator, Backend>::get_allocator() const
+{
+	return _tree.get_allocator();
+}
 
-template<typename Key, typename Compare>
-inline Set<Key, Compare>& Set<Key, Compare>::operator=(Set&& other) = default;
+template<typename Key, typename Compare, typename Allocator, typename Backend>
+inline typename Set<Key, Compare, Allocator, Backend>::key_compare Set<Key, Compare, Allocator, Backend>::key_comp() const
+{
+	return _tree.key_comp();
+}
 
-template<typename Key, typename Compare>
+template<typename Key, typename Compare, typename Allocator, typename Backend>
 template<typename InputIt>
-inline Set<Key, Compare>::Set(InputIt first, InputIt last)
+inline Set<Key, Compare, Allocator, Backend>::Set(InputIt first, InputIt last)
 {
-	for (; first != last; ++first)
-		_tree.insert(*first);
+	_tree.insert(first, last);
 }
 
-template<typename Key, typename Compare>
-typename Set<Key, Compare>::iterator Set<Key, Compare>::begin() noexcept
+template<typename Key, typename Compare, typename Allocator, typename Backend>
+template<typename InputIt>
+inline Set<Key, Compare, Allocator, Backend>::Set(sorted_unique_t, InputIt first, InputIt last, const Compare& comp)
+	: _tree(sorted_unique, first, last, comp)
+{
+}
+
+template<typename Key, typename Compare, typename Allocator, typename Backend>
+template<typename InputIt>
+inline void Set<Key, Compare, Allocator, Backend>::assign(InputIt first, InputIt last)
+{
+	_tree.assign(first, last);
+}
+
+template<typename Key, typename Compare, typename Allocator, typename Backend>
+template<typename InputIt>
+inline void Set<Key, Compare, Allocator, Backend>::assign(sorted_unique_t, InputIt first, InputIt last)
+{
+	_tree.assign(sorted_unique, first, last);
+}
+
+template<typename Key, typename Compare, typename Allocator, typename Backend>
+typename Set<Key, Compare, Allocator, Backend>::iterator Set<Key, Compare, Allocator, Backend>::begin() noexcept
 {
 	return _tree.begin();
 }
 
-template<typename Key, typename Compare>
-typename Set<Key, Compare>::iterator Set<Key, Compare>::end() noexcept
+template<typename Key, typename Compare, typename Allocator, typename Backend>
+typename Set<Key, Compare, Allocator, Backend>::iterator Set<Key, Compare, Allocator, Backend>::end() noexcept
 {
 	return _tree.end();
 }
 
-template<typename Key, typename Compare>
-typename Set<Key, Compare>::const_iterator Set<Key, Compare>::begin() const noexcept
+template<typename Key, typename Compare, typename Allocator, typename Backend>
+typename Set<Key, Compare, Allocator, Backend>::const_iterator Set<Key, Compare, Allocator, Backend>::begin() const noexcept
 {
 	return _tree.begin();
 }
 
-template<typename Key, typename Compare>
-typename Set<Key, Compare>::const_iterator Set<Key, Compare>::end() const noexcept
+template<typename Key, typename Compare, typename Allocator, typename Backend>
+typename Set<Key, Compare, Allocator, Backend>::const_iterator Set<Key, Compare, Allocator, Backend>::end() const noexcept
 {
 	return _tree.end();
 }
 
-template<typename Key, typename Compare>
-typename Set<Key, Compare>::const_iterator Set<Key, Compare>::cbegin() const noexcept
+template<typename Key, typename Compare, typename Allocator, typename Backend>
+typename Set<Key, Compare, Allocator, Backend>::const_iterator Set<Key, Compare, Allocator, Backend>::cbegin() const noexcept
 {
 	return _tree.cbegin();
 }
 
-template<typename Key, typename Compare>
-typename Set<Key, Compare>::const_iterator Set<Key, Compare>::cend() const noexcept
+template<typename Key, typename Compare, typename Allocator, typename Backend>
+typename Set<Key, Compare, Allocator, Backend>::const_iterator Set<Key, Compare, Allocator, Backend>::cend() const noexcept
 {
 	return _tree.cend();
 }
 
-template<typename Key, typename Compare>
-typename Set<Key, Compare>::reverse_iterator Set<Key, Compare>::rbegin() noexcept
+template<typename Key, typename Compare, typename Allocator, typename Backend>
+typename Set<Key, Compare, Allocator, Backend>::reverse_iterator Set<Key, Compare, Allocator, Backend>::rbegin() noexcept
 {
 	return _tree.rbegin();
 }
 
-template<typename Key, typename Compare>
-typename Set<Key, Compare>::reverse_iterator Set<Key, Compare>::rend() noexcept
+template<typename Key, typename Compare, typename Allocator, typename Backend>
+typename Set<Key, Compare, Allocator, Backend>::reverse_iterator Set<Key, Compare, Allocator, Backend>::rend() noexcept
 {
 	return _tree.rend();
 }
 
-template<typename Key, typename Compare>
-typename Set<Key, Compare>::const_reverse_iterator Set<Key, Compare>::rbegin() const noexcept
+template<typename Key, typename Compare, typename Allocator, typename Backend>
+typename Set<Key, Compare, Allocator, Backend>::const_reverse_iterator Set<Key, Compare, Allocator, Backend>::rbegin() const noexcept
 {
 	return _tree.rbegin();
 }
 
-template<typename Key, typename Compare>
-typename Set<Key, Compare>::const_reverse_iterator Set<Key, Compare>::rend() const noexcept
+template<typename Key, typename Compare, typename Allocator, typename Backend>
+typename Set<Key, Compare, Allocator, Backend>::const_reverse_iterator Set<Key, Compare, Allocator, Backend>::rend() const noexcept
 {
 	return _tree.rend();
 }
 
-template<typename Key, typename Compare>
-typename Set<Key, Compare>::const_reverse_iterator Set<Key, Compare>::crbegin() const noexcept
+template<typename Key, typename Compare, typename Allocator, typename Backend>
+typename Set<Key, Compare, Allocator, Backend>::const_reverse_iterator Set<Key, Compare, Allocator, Backend>::crbegin() const noexcept
 {
 	return _tree.crbegin();
 }
 
-template<typename Key, typename Compare>
-typename Set<Key, Compare>::const_reverse_iterator Set<Key, Compare>::crend() const noexcept
+template<typename Key, typename Compare, typename Allocator, typename Backend>
+typename Set<Key, Compare, Allocator, Backend>::const_reverse_iterator Set<Key, Compare, Allocator, Backend>::crend() const noexcept
 {
 	return _tree.crend();
 }
 
-template<typename Key, typename Compare>
-bool Set<Key, Compare>::empty() const noexcept
+template<typename Key, typename Compare, typename Allocator, typename Backend>
+bool Set<Key, Compare, Allocator, Backend>::empty() const noexcept
 {
 	return _tree.empty();
 }
 
-template<typename Key, typename Compare>
-typename Set<Key, Compare>::size_type Set<Key, Compare>::size() const noexcept
+template<typename Key, typename Compare, typename Allocator, typename Backend>
+typename Set<Key, Compare, Allocator, Backend>::size_type Set<Key, Compare, Allocator, Backend>::size() const noexcept
 {
 	return _tree.size();
 }
 
-template<typename Key, typename Compare>
-void Set<Key, Compare>::clear() noexcept
+template<typename Key, typename Compare, typename Allocator, typename Backend>
+void Set<Key, Compare, Allocator, Backend>::clear() noexcept
 {
 	_tree.clear();
 }
 
-template<typename Key, typename Compare>
-std::pair<typename Set<Key, Compare>::iterator, bool> Set<Key, Compare>::insert(const Key& key)
+template<typename Key, typename Compare, typename Allocator, typename Backend>
+std::pair<typename Set<Key, Compare, Allocator, Backend>::iterator, bool> Set<Key, Compare, Allocator, Backend>::insert(const Key& key)
 {
-	return _tree.insert(key);
+	return _tree.try_emplace(key);
 }
 
-template<typename Key, typename Compare>
-inline std::pair<typename Set<Key, Compare>::iterator, bool> Set<Key, Compare>::insert(Key&& key)
+template<typename Key, typename Compare, typename Allocator, typename Backend>
+inline std::pair<typename Set<Key, Compare, Allocator, Backend>::iterator, bool> Set<Key, Compare, Allocator, Backend>::insert(Key&& key)
 {
-	return _tree.insert(std::move(key));
+	return _tree.try_emplace(std::move(key));
 }
 
-template<typename Key, typename Compare>
+template<typename Key, typename Compare, typename Allocator, typename Backend>
+inline typename Set<Key, Compare, Allocator, Backend>::iterator Set<Key, Compare, Allocator, Backend>::insert(const_iterator hint, const Key& key)
+{
+	return _tree.emplace_hint(hint, key);
+}
+
+template<typename Key, typename Compare, typename Allocator, typename Backend>
+inline typename Set<Key, Compare, Allocator, Backend>::iterator Set<Key, Compare, Allocator, Backend>::insert(const_iterator hint, Key&& key)
+{
+	return _tree.emplace_hint(hint, std::move(key));
+}
+
+template<typename Key, typename Compare, typename Allocator, typename Backend>
+template<typename InputIt>
+inline void Set<Key, Compare, Allocator, Backend>::insert(InputIt first, InputIt last)
+{
+	_tree.insert(first, last);
+}
+
+template<typename Key, typename Compare, typename Allocator, typename Backend>
 template<typename... Args>
-std::pair<typename Set<Key, Compare>::iterator, bool> Set<Key, Compare>::emplace(Args&&... args)
+std::pair<typename Set<Key, Compare, Allocator, Backend>::iterator, bool> Set<Key, Compare, Allocator, Backend>::emplace(Args&&... args)
 {
 	return _tree.emplace(std::forward<Args>(args)...);
 }
 
-template<typename Key, typename Compare>
-typename Set<Key, Compare>::size_type Set<Key, Compare>::erase(const Key& key)
+template<typename Key, typename Compare, typename Allocator, typename Backend>
+template<typename... Args>
+inline typename Set<Key, Compare, Allocator, Backend>::iterator Set<Key, Compare, Allocator, Backend>::emplace_hint(const_iterator hint, Args&&... args)
+{
+	return _tree.emplace_hint(hint, std::forward<Args>(args)...);
+}
+
+template<typename Key, typename Compare, typename Allocator, typename Backend>
+template<typename K>
+inline std::pair<typename Set<Key, Compare, Allocator, Backend>::iterator, bool> Set<Key, Compare, Allocator, Backend>::try_emplace(K&& key)
+{
+	return _tree.try_emplace(std::forward<K>(key));
+}
+
+template<typename Key, typename Compare, typename Allocator, typename Backend>
+typename Set<Key, Compare, Allocator, Backend>::size_type Set<Key, Compare, Allocator, Backend>::erase(const Key& key)
 {
 	return _tree.erase(key) ? 1 : 0;
 }
 
-template<typename Key, typename Compare>
-void Set<Key, Compare>::erase(iterator pos)
+template<typename Key, typename Compare, typename Allocator, typename Backend>
+typename Set<Key, Compare, Allocator, Backend>::iterator Set<Key, Compare, Allocator, Backend>::erase(iterator pos)
+{
+	return _tree.erase(const_iterator(pos));
+}
+
+template<typename Key, typename Compare, typename Allocator, typename Backend>
+typename Set<Key, Compare, Allocator, Backend>::iterator Set<Key, Compare, Allocator, Backend>::erase(const_iterator pos)
+{
+	return _tree.erase(pos);
+}
+
+template<typename Key, typename Compare, typename Allocator, typename Backend>
+typename Set<Key, Compare, Allocator, Backend>::iterator Set<Key, Compare, Allocator, Backend>::erase(const_iterator first, const_iterator last)
+{
+	return _tree.erase(first, last);
+}
+
+template<typename Key, typename Compare, typename Allocator, typename Backend>
+inline typename Set<Key, Compare, Allocator, Backend>::node_type Set<Key, Compare, Allocator, Backend>::extract(const_iterator pos)
+{
+	return _tree.extract(pos);
+}
+
+template<typename Key, typename Compare, typename Allocator, typename Backend>
+inline typename Set<Key, Compare, Allocator, Backend>::node_type Set<Key, Compare, Allocator, Backend>::extract(const Key& key)
+{
+	return _tree.extract(key);
+}
+
+template<typename Key, typename Compare, typename Allocator, typename Backend>
+inline typename Set<Key, Compare, Allocator, Backend>::insert_return_type Set<Key, Compare, Allocator, Backend>::insert(node_type&& nh)
+{
+	return _tree.insert(std::move(nh));
+}
+
+template<typename Key, typename Compare, typename Allocator, typename Backend>
+inline typename Set<Key, Compare, Allocator, Backend>::iterator Set<Key, Compare, Allocator, Backend>::insert(const_iterator hint, node_type&& nh)
+{
+	return _tree.insert(hint, std::move(nh));
+}
+
+template<typename Key, typename Compare, typename Allocator, typename Backend>
+inline void Set<Key, Compare, Allocator, Backend>::merge(Set& source)
+{
+	_tree.merge(source._tree);
+}
+
+template<typename Key, typename Compare, typename Allocator, typename Backend>
+inline void Set<Key, Compare, Allocator, Backend>::merge(Set&& source)
+{
+	_tree.merge(source._tree);
+}
+
+template<typename Key, typename Compare, typename Allocator, typename Backend>
+std::pair<Set<Key, Compare, Allocator, Backend>, Set<Key, Compare, Allocator, Backend>> Set<Key, Compare, Allocator, Backend>::split(const Key& key)
+{
+	std::pair<Set, Set> result(std::piecewise_construct,
+		std::forward_as_tuple(key_comp(), get_allocator()), std::forward_as_tuple(key_comp(), get_allocator()));
+	if constexpr (requires { _tree.split(key); })
+	{
+		auto parts = _tree.split(key);
+		result.first._tree = std::move(parts.first);
+		result.second._tree = std::move(parts.second);
+	}
+	else
+	{
+		const_iterator mid = lower_bound(key);
+		result.first.assign(sorted_unique, cbegin(), mid);
+		result.second.assign(sorted_unique, mid, cend());
+		clear();
+	}
+	return result;
+}
+
+template<typename Key, typename Compare, typename Allocator, typename Backend>
+Set<Key, Compare, Allocator, Backend> Set<Key, Compare, Allocator, Backend>::join(Set&& left, Set&& right)
+{
+	Set result(std::move(left));
+	if constexpr (requires { Tree::join(std::move(result._tree), std::move(right._tree)); })
+		result._tree = Tree::join(std::move(result._tree), relinkable_tree(std::move(right), result.get_allocator()));
+	else
+		result.insert(right.begin(), right.end());
+	right.clear();
+	return result;
+}
+
+template<typename Key, typename Compare, typename Allocator, typename Backend>
+Set<Key, Compare, Allocator, Backend> Set<Key, Compare, Allocator, Backend>::join(Set&& left, const Key& middle, Set&& right)
+{
+	Set result(std::move(left));
+	if constexpr (requires { Tree::join(std::move(result._tree), middle, std::move(right._tree)); })
+	{
+		result._tree = Tree::join(std::move(result._tree), middle, relinkable_tree(std::move(right), result.get_allocator()));
+	}
+	else
+	{
+		result.insert(result.end(), middle);
+		result.insert(right.begin(), right.end());
+	}
+	right.clear();
+	return result;
+}
+
+template<typename Key, typename Compare, typename Allocator, typename Backend>
+typename Set<Key, Compare, Allocator, Backend>::Tree Set<Key, Compare, Allocator, Backend>::relinkable_tree(Set&& source, const allocator_type& alloc)
+{
+	if (std::allocator_traits<allocator_type>::is_always_equal::value || source.get_allocator() == alloc)
+		return std::move(source._tree);
+
+	Set copy(source.key_comp(), alloc);
+	copy.assign(sorted_unique, source.cbegin(), source.cend());
+	source.clear();
+	return std::move(copy._tree);
+}
+
+template<typename Key, typename Compare, typename Allocator, typename Backend>
+Set<Key, Compare, Allocator, Backend>& Set<Key, Compare, Allocator, Backend>::operator|=(const Set& other)
 {
-	if (pos != end())
-		_tree.erase(pos->first);
+	if constexpr (split_joinable)
+	{
+		if (set_sizes_skewed(other.size(), size()))
+		{
+			_tree.split_join(other.begin(), other.end(), true, true, true);
+			return *this;
+		}
+	}
+
+	// Слияние: pos — первый элемент не меньше очередного ключа other, вставка перед ним — O(1)
+	const Compare comp = key_comp();
+	iterator pos = begin();
+	for (const auto& value : other)
+	{
+		while (pos != end() && comp(pos->first, value.first))
+			++pos;
+		if (pos == end() || comp(value.first, pos->first))
+			pos = std::next(insert(pos, value.first));
+		else
+			++pos;
+	}
+	return *this;
 }
 
-template<typename Key, typename Compare>
-typename Set<Key, Compare>::iterator Set<Key, Compare>::find(const Key& key)
+template<typename Key, typename Compare, typename Allocator, typename Backend>
+Set<Key, Compare, Allocator, Backend>& Set<Key, Compare, Allocator, Backend>::operator|=(Set&& other)
+{
+	if (this == &other)
+		return *this;
+
+	if constexpr (!std::is_same<node_type, NoNodeHandle>::value)
+	{
+		// Перевешивать узлы можно, только если их освободит аллокатор этого множества:
+		// у PoolAllocator, например, каждое множество по умолчанию берёт узлы из своего пула
+		if (std::allocator_traits<allocator_type>::is_always_equal::value || get_allocator() == other.get_allocator())
+		{
+			if (size() < other.size())
+				swap(*this, other);
+			merge(other);
+			other.clear();
+			return *this;
+		}
+	}
+	return *this |= static_cast<const Set&>(other);
+}
+
+template<typename Key, typename Compare, typename Allocator, typename Backend>
+Set<Key, Compare, Allocator, Backend>& Set<Key, Compare, Allocator, Backend>::operator&=(const Set& other)
+{
+	if constexpr (split_joinable)
+	{
+		// Остаётся не больше other.size() ключей: найденные узлы склеиваются, куски между ними удаляются целиком
+		if (set_sizes_skewed(other.size(), size()))
+		{
+			_tree.split_join(other.begin(), other.end(), false, true, false);
+			return *this;
+		}
+	}
+
+	// Это множество намного меньше: other не трогается, его проход заменяют поиски ключей этого
+	const Compare comp = key_comp();
+	if (set_sizes_skewed(size(), other.size()))
+	{
+		for (iterator it = begin(); it != end(); )
+			it = other.contains(it->first) ? std::next(it) : erase(it);
+		return *this;
+	}
+
+	const_iterator pos = other.begin();
+	for (iterator it = begin(); it != end(); )
+	{
+		while (pos != other.end() && comp(pos->first, it->first))
+			++pos;
+		if (pos == other.end() || comp(it->first, pos->first))
+			it = erase(it);
+		else
+			++it;
+	}
+	return *this;
+}
+
+template<typename Key, typename Compare, typename Allocator, typename Backend>
+Set<Key, Compare, Allocator, Backend>& Set<Key, Compare, Allocator, Backend>::operator-=(const Set& other)
+{
+	if (this == &other)
+	{
+		clear();
+		return *this;
+	}
+
+	if constexpr (split_joinable)
+	{
+		if (set_sizes_skewed(other.size(), size()))
+		{
+			_tree.split_join(other.begin(), other.end(), true, false, false);
+			return *this;
+		}
+	}
+
+	const Compare comp = key_comp();
+	const_iterator pos = other.begin();
+	for (iterator it = begin(); it != end() && pos != other.end(); )
+	{
+		if (comp(pos->first, it->first))
+			++pos;
+		else if (comp(it->first, pos->first))
+			++it;
+		else
+			it = erase(it);
+	}
+	return *this;
+}
+
+template<typename Key, typename Compare, typename Allocator, typename Backend>
+Set<Key, Compare, Allocator, Backend>& Set<Key, Compare, Allocator, Backend>::operator^=(const Set& other)
+{
+	if (this == &other)
+	{
+		clear();
+		return *this;
+	}
+
+	if constexpr (split_joinable)
+	{
+		if (set_sizes_skewed(other.size(), size()))
+		{
+			_tree.split_join(other.begin(), other.end(), true, false, true);
+			return *this;
+		}
+	}
+
+	// Слияние, как в |=: общие ключи удаляются, ключи только из other вставляются перед pos
+	const Compare comp = key_comp();
+	iterator pos = begin();
+	for (const auto& value : other)
+	{
+		while (pos != end() && comp(pos->first, value.first))
+			++pos;
+		if (pos == end() || comp(value.first, pos->first))
+			pos = std::next(insert(pos, value.first));
+		else
+			pos = erase(pos);
+	}
+	return *this;
+}
+
+template<typename Key, typename Compare, typename Allocator, typename Backend>
+typename Set<Key, Compare, Allocator, Backend>::iterator Set<Key, Compare, Allocator, Backend>::find(const Key& key)
 {
 	return _tree.find(key);
 }
 
-template<typename Key, typename Compare>
-typename Set<Key, Compare>::const_iterator Set<Key, Compare>::find(const Key& key) const
+template<typename Key, typename Compare, typename Allocator, typename Backend>
+typename Set<Key, Compare, Allocator, Backend>::const_iterator Set<Key, Compare, Allocator, Backend>::find(const Key& key) const
 {
 	return _tree.find(key);
 }
 
-template<typename Key, typename Compare>
-bool Set<Key, Compare>::contains(const Key& key) const
+template<typename Key, typename Compare, typename Allocator, typename Backend>
+bool Set<Key, Compare, Allocator, Backend>::contains(const Key& key) const
 {
 	return _tree.contains(key);
 }
 
-template<typename Key, typename Compare>
-typename Set<Key, Compare>::iterator Set<Key, Compare>::lower_bound(const Key& key)
+template<typename Key, typename Compare, typename Allocator, typename Backend>
+void Set<Key, Compare, Allocator, Backend>::contains_many(std::span<const Key> keys, std::span<bool> result) const
+{
+	if constexpr (requires { _tree.contains_many(keys, result); })
+	{
+		_tree.contains_many(keys, result);
+	}
+	else if constexpr (requires { _tree.contains_batch(keys, result); })
+	{
+		_tree.contains_batch(keys, result);
+	}
+	else
+	{
+		for (std::size_t i = 0; i < keys.size(); ++i)
+			result[i] = _tree.contains(keys[i]);
+	}
+}
+
+template<typename Key, typename Compare, typename Allocator, typename Backend>
+void Set<Key, Compare, Allocator, Backend>::find_batch(std::span<const Key> keys, std::span<iterator> result)
+{
+	if constexpr (requires { _tree.find_batch(keys, result); })
+	{
+		_tree.find_batch(keys, result);
+	}
+	else
+	{
+		for (std::size_t i = 0; i < keys.size(); ++i)
+			result[i] = _tree.find(keys[i]);
+	}
+}
+
+template<typename Key, typename Compare, typename Allocator, typename Backend>
+void Set<Key, Compare, Allocator, Backend>::find_batch(std::span<const Key> keys, std::span<const_iterator> result) const
+{
+	if constexpr (requires { _tree.find_batch(keys, result); })
+	{
+		_tree.find_batch(keys, result);
+	}
+	else
+	{
+		for (std::size_t i = 0; i < keys.size(); ++i)
+			result[i] = _tree.find(keys[i]);
+	}
+}
+
+template<typename Key, typename Compare, typename Allocator, typename Backend>
+void Set<Key, Compare, Allocator, Backend>::contains_batch(std::span<const Key> keys, std::span<bool> result) const
+{
+	if constexpr (requires { _tree.contains_batch(keys, result); })
+		_tree.contains_batch(keys, result);
+	else
+		contains_many(keys, result);
+}
+
+template<typename Key, typename Compare, typename Allocator, typename Backend>
+typename Set<Key, Compare, Allocator, Backend>::iterator Set<Key, Compare, Allocator, Backend>::lower_bound(const Key& key)
 {
 	return _tree.lower_bound(key);
 }
 
-template<typename Key, typename Compare>
-typename Set<Key, Compare>::const_iterator Set<Key, Compare>::lower_bound(const Key& key) const
+template<typename Key, typename Compare, typename Allocator, typename Backend>
+typename Set<Key, Compare, Allocator, Backend>::const_iterator Set<Key, Compare, Allocator, Backend>::lower_bound(const Key& key) const
 {
 	return _tree.lower_bound(key);
 }
 
-template<typename Key, typename Compare>
-typename Set<Key, Compare>::iterator Set<Key, Compare>::upper_bound(const Key& key)
+template<typename Key, typename Compare, typename Allocator, typename Backend>
+typename Set<Key, Compare, Allocator, Backend>::iterator Set<Key, Compare, Allocator, Backend>::upper_bound(const Key& key)
 {
 	return _tree.upper_bound(key);
 }
 
-template<typename Key, typename Compare>
-typename Set<Key, Compare>::const_iterator Set<Key, Compare>::upper_bound(const Key& key) const
+template<typename Key, typename Compare, typename Allocator, typename Backend>
+typename Set<Key, Compare, Allocator, Backend>::const_iterator Set<Key, Compare, Allocator, Backend>::upper_bound(const Key& key) const
 {
 	return _tree.upper_bound(key);
 }
 
-template<typename Key, typename Compare>
-std::pair<typename Set<Key, Compare>::iterator, typename Set<Key, Compare>::iterator> Set<Key, Compare>::equal_range(const Key& key)
+template<typename Key, typename Compare, typename Allocator, typename Backend>
+std::pair<typename Set<Key, Compare, Allocator, Backend>::iterator, typename Set<Key, Compare, Allocator, Backend>::iterator> Set<Key, Compare, Allocator, Backend>::equal_range(const Key& key)
 {
 	return _tree.equal_range(key);
 }
 
-template<typename Key, typename Compare>
-std::pair<typename Set<Key, Compare>::const_iterator, typename Set<Key, Compare>::const_iterator> 
-		Set<Key, Compare>::equal_range(const Key& key) const
+template<typename Key, typename Compare, typename Allocator, typename Backend>
+std::pair<typename Set<Key, Compare, Allocator, Backend>::const_iterator, typename Set<Key, Compare, Allocator, Backend>::const_iterator> 
+		Set<Key, Compare, Allocator, Backend>::equal_range(const Key& key) const
 {
 	return _tree.equal_range(key);
 }
 
-template<typename K, typename C>
-inline bool operator==(const Set<K, C>& lhs, const Set<K, C>& rhs)
+template<typename Key, typename Compare, typename Allocator, typename Backend>
+typename Set<Key, Compare, Allocator, Backend>::size_type Set<Key, Compare, Allocator, Backend>::rank(const Key& key) const
+{
+	if constexpr (requires { _tree.rank(key); })
+		return _tree.rank(key);
+	else
+		return static_cast<size_type>(std::distance(begin(), lower_bound(key)));
+}
+
+template<typename Key, typename Compare, typename Allocator, typename Backend>
+typename Set<Key, Compare, Allocator, Backend>::iterator Set<Key, Compare, Allocator, Backend>::select(size_type k)
+{
+	if constexpr (requires { _tree.select(k); })
+		return _tree.select(k);
+	else
+		return (k < size()) ? std::next(begin(), static_cast<difference_type>(k)) : end();
+}
+
+template<typename Key, typename Compare, typename Allocator, typename Backend>
+typename Set<Key, Compare, Allocator, Backend>::const_iterator Set<Key, Compare, Allocator, Backend>::select(size_type k) const
+{
+	if constexpr (requires { _tree.select(k); })
+		return _tree.select(k);
+	else
+		return (k < size()) ? std::next(begin(), static_cast<difference_type>(k)) : end();
+}
+
+template<typename Key, typename Compare, typename Allocator, typename Backend>
+typename Set<Key, Compare, Allocator, Backend>::size_type Set<Key, Compare, Allocator, Backend>::count_range(const Key& lo, const Key& hi) const
+{
+	if constexpr (requires { _tree.count_range(lo, hi); })
+		return _tree.count_range(lo, hi);
+	else if (!key_comp()(lo, hi))
+		return 0;
+	else
+		return static_cast<size_type>(std::distance(lower_bound(lo), lower_bound(hi)));
+}
+
+template<typename Key, typename Compare, typename Allocator, typename Backend>
+auto Set<Key, Compare, Allocator, Backend>::aggregate(const Key& lo, const Key& hi) const requires Tree::augmented
+{
+	return _tree.aggregate(lo, hi);
+}
+
+template<typename Key, typename Compare, typename Allocator, typename Backend>
+auto Set<Key, Compare, Allocator, Backend>::aggregate() const requires Tree::augmented
+{
+	return _tree.aggregate();
+}
+
+template<typename Key, typename Compare, typename Allocator, typename Backend>
+std::vector<typename Set<Key, Compare, Allocator, Backend>::const_iterator> Set<Key, Compare, Allocator, Backend>::partition(size_type parts) const
+{
+	std::vector<const_iterator> bounds{ begin() };
+	if constexpr (requires { _tree.split_points(parts); })
+	{
+		if (parts > 1)
+		{
+			auto points = _tree.split_points(parts);
+			bounds.insert(bounds.end(), points.begin(), points.end());
+		}
+	}
+	bounds.push_back(end());
+	return bounds;
+}
+
+template<typename Key, typename Compare, typename Allocator, typename Backend>
+typename Set<Key, Compare, Allocator, Backend>::range_type Set<Key, Compare, Allocator, Backend>::range(size_type grain) const
+{
+	if constexpr (requires { _tree.range(grain); })
+		return _tree.range(grain);
+	else
+		return range_type(begin(), end(), size());
+}
+
+template<typename Key, typename Compare, typename Allocator, typename Backend>
+typename Set<Key, Compare, Allocator, Backend>::range_type Set<Key, Compare, Allocator, Backend>::range(const Key& lo, const Key& hi, size_type grain) const
+{
+	if constexpr (requires { _tree.range(lo, hi, grain); })
+		return _tree.range(lo, hi, grain);
+	else if (!key_comp()(lo, hi))
+		return range_type(end(), end(), 0);
+	else
+		return range_type(lower_bound(lo), lower_bound(hi), count_range(lo, hi));
+}
+
+template<typename Key, typename Compare, typename Allocator, typename Backend>
+template<parallel::executor Exec, typename F>
+void Set<Key, Compare, Allocator, Backend>::for_each(Exec&& exec, F&& f) const
+{
+	ThreadPool* pool = parallel::pool_of(exec);
+	// Частей в несколько раз больше, чем потоков: неравные части выравниваются очередью пула
+	size_type grain = pool ? size() / (8 * pool->concurrency()) : size();
+	parallel::for_range(pool, range(grain), [&](const range_type& part)
+		{
+			for (const auto& value : part)
+				f(static_cast<const Key&>(value.first));
+		});
+}
+
+template<typename Key, typename Compare, typename Allocator, typename Backend>
+template<parallel::executor Exec>
+bool Set<Key, Compare, Allocator, Backend>::equal(Exec&& exec, const Set& other) const
+{
+	if (size() != other.size())
+		return false;
+
+	// Части этого множества сравниваются с теми же диапазонами ключей other: границы other — lower_bound
+	ThreadPool* pool = parallel::pool_of(exec);
+	auto bounds = partition(pool ? 4 * pool->concurrency() : 1);
+	std::atomic<bool> equal{ true };
+	parallel::for_each_index(pool, bounds.size() - 1, [&](std::size_t i)
+		{
+			if (!equal.load(std::memory_order_relaxed))
+				return;
+			const_iterator first = (i == 0) ? other.begin() : other.lower_bound(bounds[i]->first);
+			const_iterator last = (i + 2 == bounds.size()) ? other.end() : other.lower_bound(bounds[i + 1]->first);
+			if (!std::equal(bounds[i], bounds[i + 1], first, last))
+				equal.store(false, std::memory_order_relaxed);
+		});
+	return equal.load(std::memory_order_relaxed);
+}
+
+template<typename Key, typename Compare, typename Allocator, typename Backend>
+inline typename Set<Key, Compare, Allocator, Backend>::WriteBatch Set<Key, Compare, Allocator, Backend>::batch(size_type max_pending)
+{
+	return WriteBatch(*this, max_pending);
+}
+
+template<typename Key, typename Compare, typename Allocator, typename Backend>
+template<typename RandomIt>
+void Set<Key, Compare, Allocator, Backend>::apply_sorted(RandomIt first, RandomIt last)
+{
+	if constexpr (requires { _tree.apply_sorted(first, last); })
+	{
+		_tree.apply_sorted(first, last);
+	}
+	else
+	{
+		for (; first != last; ++first)
+		{
+			if (first->second)
+				insert(std::move(first->first));
+			else
+				erase(first->first);
+		}
+	}
+}
+
+template<typename Key, typename Compare, typename Allocator, typename Backend>
+inline Set<Key, Compare, Allocator, Backend>::WriteBatch::WriteBatch(Set& set, size_type max_pending)
+	: _set(set)
+	, _max_pending(std::max<size_type>(max_pending, 1))
+{
+}
+
+template<typename Key, typename Compare, typename Allocator, typename Backend>
+inline Set<Key, Compare, Allocator, Backend>::WriteBatch::~WriteBatch()
+{
+	try
+	{
+		flush();
+	}
+	catch (...)
+	{
+		// flush уже очистил пакет, множество корректно
+	}
+}
+
+template<typename Key, typename Compare, typename Allocator, typename Backend>
+inline void Set<Key, Compare, Allocator, Backend>::WriteBatch::insert(const Key& key)
+{
+	push(Op(key, true));
+}
+
+template<typename Key, typename Compare, typename Allocator, typename Backend>
+inline void Set<Key, Compare, Allocator, Backend>::WriteBatch::insert(Key&& key)
+{
+	push(Op(std::move(key), true));
+}
+
+template<typename Key, typename Compare, typename Allocator, typename Backend>
+inline void Set<Key, Compare, Allocator, Backend>::WriteBatch::erase(const Key& key)
+{
+	push(Op(key, false));
+}
+
+template<typename Key, typename Compare, typename Allocator, typename Backend>
+bool Set<Key, Compare, Allocator, Backend>::WriteBatch::contains(const Key& key) const
+{
+	normalize();
+	const Compare comp = _set.key_comp();
+	auto it = std::lower_bound(_ops.begin(), _ops.end(), key, [&comp](const Op& op, const Key& k) { return comp(op.first, k); });
+	if (it != _ops.end() && !comp(key, it->first))
+		return it->second;
+	return _set.contains(key);
+}
+
+template<typename Key, typename Compare, typename Allocator, typename Backend>
+inline typename Set<Key, Compare, Allocator, Backend>::size_type Set<Key, Compare, Allocator, Backend>::WriteBatch::pending() const noexcept
+{
+	return _ops.size();
+}
+
+template<typename Key, typename Compare, typename Allocator, typename Backend>
+void Set<Key, Compare, Allocator, Backend>::WriteBatch::flush()
+{
+	if (_ops.empty())
+		return;
+	normalize();
+	try
+	{
+		_set.apply_sorted(_ops.begin(), _ops.end());
+	}
+	catch (...)
+	{
+		discard();
+		throw;
+	}
+	discard();
+}
+
+template<typename Key, typename Compare, typename Allocator, typename Backend>
+inline void Set<Key, Compare, Allocator, Backend>::WriteBatch::discard() noexcept
+{
+	_ops.clear();
+	_normalized = 0;
+}
+
+template<typename Key, typename Compare, typename Allocator, typename Backend>
+inline void Set<Key, Compare, Allocator, Backend>::WriteBatch::push(Op&& op)
+{
+	_ops.push_back(std::move(op));
+	if (_ops.size() >= _max_pending)
+		flush();
+}
+
+template<typename Key, typename Compare, typename Allocator, typename Backend>
+void Set<Key, Compare, Allocator, Backend>::WriteBatch::normalize() const
+{
+	if (_normalized == _ops.size())
+		return;
+
+	// Оба слияния устойчивы: среди равных ключей поздняя операция остаётся правее
+	const Compare comp = _set.key_comp();
+	auto less = [&comp](const Op& a, const Op& b) { return comp(a.first, b.first); };
+	auto middle = _ops.begin() + static_cast<difference_type>(_normalized);
+	std::stable_sort(middle, _ops.end(), less);
+	std::inplace_merge(_ops.begin(), middle, _ops.end(), less);
+
+	size_type kept = 0;
+	for (size_type i = 0; i < _ops.size(); ++i)
+	{
+		if (i + 1 < _ops.size() && !less(_ops[i], _ops[i + 1]))
+			continue;
+		if (kept != i)
+			_ops[kept] = std::move(_ops[i]);
+		++kept;
+	}
+	_ops.erase(_ops.begin() + static_cast<difference_type>(kept), _ops.end());
+	_normalized = kept;
+}
+
+template<typename K, typename C, typename A, typename B>
+inline bool operator==(const Set<K, C, A, B>& lhs, const Set<K, C, A, B>& rhs)
 {
 	if (lhs.size() != rhs.size())
 		return false;
 	return std::equal(lhs.begin(), lhs.end(), rhs.begin());
 }
 
-template<typename K, typename C>
-inline bool operator!=(const Set<K, C>& lhs, const Set<K, C>& rhs)
+template<typename K, typename C, typename A, typename B>
+inline bool operator!=(const Set<K, C, A, B>& lhs, const Set<K, C, A, B>& rhs)
 {
 	return !(lhs == rhs);
 }
 
-template<typename K, typename C>
-inline void swap(Set<K, C>& lhs, Set<K, C>& rhs) noexcept
+template<typename K, typename C, typename A, typename B>
+inline void swap(Set<K, C, A, B>& lhs, Set<K, C, A, B>& rhs) noexcept
 {
 	std::swap(lhs._tree, rhs._tree);
 }
+
+// Слияние упорядоченных диапазонов двух множеств: в keys идут ключи только из [l, l_last), из обоих
+// и только из [r, r_last) по флагам. Ключи не копируются — в массиве ссылки
+template<typename It, typename K, typename C>
+void set_merge_range(It l, It l_last, It r, It r_last, const C& comp, bool left_only, bool both, bool right_only,
+	std::vector<std::reference_wrapper<const K>>& keys)
+{
+	while (l != l_last && r != r_last)
+	{
+		if (comp(l->first, r->first))
+		{
+			if (left_only)
+				keys.push_back(std::cref(l->first));
+			++l;
+		}
+		else if (comp(r->first, l->first))
+		{
+			if (right_only)
+				keys.push_back(std::cref(r->first));
+			++r;
+		}
+		else
+		{
+			if (both)
+				keys.push_back(std::cref(l->first));
+			++l;
+			++r;
+		}
+	}
+	for (; left_only && l != l_last; ++l)
+		keys.push_back(std::cref(l->first));
+	for (; right_only && r != r_last; ++r)
+		keys.push_back(std::cref(r->first));
+}
+
+// Слияние двух упорядоченных множеств: дерево результата строится из массива ссылок за O(n)
+template<typename K, typename C, typename A, typename B>
+Set<K, C, A, B> set_merge(const Set<K, C, A, B>& lhs, const Set<K, C, A, B>& rhs, bool left_only, bool both, bool right_only)
+{
+	const C comp = lhs.key_comp();
+	std::vector<std::reference_wrapper<const K>> keys;
+	keys.reserve((left_only ? lhs.size() : 0) + (right_only ? rhs.size() : 0) + (both ? std::min(lhs.size(), rhs.size()) : 0));
+	set_merge_range(lhs.begin(), lhs.end(), rhs.begin(), rhs.end(), comp, left_only, both, right_only, keys);
+
+	Set<K, C, A, B> result(comp, lhs.get_allocator());
+	result.assign(sorted_unique, keys.begin(), keys.end());
+	return result;
+}
+
+// Параллельное слияние: большее множество делится partition, те же диапазоны ключей меньшего — lower_bound.
+// Каждая часть сливается и строится в своей задаче, части склеиваются join — у красно-чёрного дерева
+// за O(log n) каждая. С пулом узлов (аллокатор не разделяется между потоками) — последовательно
+template<typename Exec, typename K, typename C, typename A, typename B>
+Set<K, C, A, B> set_merge(Exec&& exec, const Set<K, C, A, B>& lhs, const Set<K, C, A, B>& rhs, bool left_only, bool both, bool right_only)
+{
+	using SetType = Set<K, C, A, B>;
+	using const_iterator = typename SetType::const_iterator;
+
+	ThreadPool* pool = std::allocator_traits<A>::is_always_equal::value ? parallel::pool_of(exec) : nullptr;
+	const C comp = lhs.key_comp();
+	const bool lhs_large = lhs.size() >= rhs.size();
+	const SetType& large = lhs_large ? lhs : rhs;
+	const SetType& small = lhs_large ? rhs : lhs;
+
+	auto bounds = large.partition(pool ? 4 * pool->concurrency() : 1);
+	std::size_t parts = bounds.size() - 1;
+	std::vector<SetType> pieces(parts, SetType(comp, lhs.get_allocator()));
+	parallel::for_each_index(pool, parts, [&](std::size_t i)
+		{
+			const_iterator small_first = (i == 0) ? small.begin() : small.lower_bound(bounds[i]->first);
+			const_iterator small_last = (i + 1 == parts) ? small.end() : small.lower_bound(bounds[i + 1]->first);
+			std::vector<std::reference_wrapper<const K>> keys;
+			if (lhs_large)
+				set_merge_range(bounds[i], bounds[i + 1], small_first, small_last, comp, left_only, both, right_only, keys);
+			else
+				set_merge_range(small_first, small_last, bounds[i], bounds[i + 1], comp, left_only, both, right_only, keys);
+			pieces[i].assign(sorted_unique, keys.begin(), keys.end());
+		});
+
+	SetType result(comp, lhs.get_allocator());
+	for (auto& piece : pieces)
+		result = SetType::join(std::move(result), std::move(piece));
+	return result;
+}
+
+// Операции над множествами. Для сопоставимых размеров — линейное слияние в построение дерева за O(n + m).
+// Если одно множество намного меньше, копия большего (структурная, O(n)) режется по ключам меньшего
+// и склеивается операцией на месте (split/join, O(m log n)); результат пересечения или разности не больше
+// меньшего множества — тогда ключи меньшего ищутся в большем, и большее не копируется
+template<typename K, typename C, typename A, typename B>
+Set<K, C, A, B> set_union(const Set<K, C, A, B>& lhs, const Set<K, C, A, B>& rhs)
+{
+	const bool lhs_small = set_sizes_skewed(lhs.size(), rhs.size());
+	if (lhs_small || set_sizes_skewed(rhs.size(), lhs.size()))
+	{
+		Set<K, C, A, B> result(lhs_small ? rhs : lhs);
+		result |= (lhs_small ? lhs : rhs);
+		return result;
+	}
+	return set_merge(lhs, rhs, true, true, true);
+}
+
+template<typename K, typename C, typename A, typename B>
+Set<K, C, A, B> set_intersection(const Set<K, C, A, B>& lhs, const Set<K, C, A, B>& rhs)
+{
+	const bool lhs_small = set_sizes_skewed(lhs.size(), rhs.size());
+	if (lhs_small || set_sizes_skewed(rhs.size(), lhs.size()))
+	{
+		const Set<K, C, A, B>& small = lhs_small ? lhs : rhs;
+		const Set<K, C, A, B>& large = lhs_small ? rhs : lhs;
+		std::vector<std::reference_wrapper<const K>> keys;
+		for (const auto& value : small)
+		{
+			if (large.contains(value.first))
+				keys.push_back(std::cref(value.first));
+		}
+		Set<K, C, A, B> result(lhs.key_comp(), lhs.get_allocator());
+		result.assign(sorted_unique, keys.begin(), keys.end());
+		return result;
+	}
+	return set_merge(lhs, rhs, false, true, false);
+}
+
+// Параллельные объединение и пересечение (см. set_merge с исполнителем). При сильно разных размерах
+// работа и так O(m log n) или копирование большего — копирование тогда тоже параллельное
+template<parallel::executor Exec, typename K, typename C, typename A, typename B>
+Set<K, C, A, B> set_union(Exec&& exec, const Set<K, C, A, B>& lhs, const Set<K, C, A, B>& rhs)
+{
+	const bool lhs_small = set_sizes_skewed(lhs.size(), rhs.size());
+	if (lhs_small || set_sizes_skewed(rhs.size(), lhs.size()))
+	{
+		Set<K, C, A, B> result(exec, lhs_small ? rhs : lhs);
+		result |= (lhs_small ? lhs : rhs);
+		return result;
+	}
+	return set_merge(exec, lhs, rhs, true, true, true);
+}
+
+template<parallel::executor Exec, typename K, typename C, typename A, typename B>
+Set<K, C, A, B> set_intersection(Exec&& exec, const Set<K, C, A, B>& lhs, const Set<K, C, A, B>& rhs)
+{
+	if (set_sizes_skewed(lhs.size(), rhs.size()) || set_sizes_skewed(rhs.size(), lhs.size()))
+		return set_intersection(lhs, rhs);
+	return set_merge(exec, lhs, rhs, false, true, false);
+}
+
+template<typename K, typename C, typename A, typename B>
+Set<K, C, A, B> set_difference(const Set<K, C, A, B>& lhs, const Set<K, C, A, B>& rhs)
+{
+	if (set_sizes_skewed(rhs.size(), lhs.size()))
+	{
+		Set<K, C, A, B> result(lhs);
+		result -= rhs;
+		return result;
+	}
+	if (set_sizes_skewed(lhs.size(), rhs.size()))
+	{
+		std::vector<std::reference_wrapper<const K>> keys;
+		for (const auto& value : lhs)
+		{
+			if (!rhs.contains(value.first))
+				keys.push_back(std::cref(value.first));
+		}
+		Set<K, C, A, B> result(lhs.key_comp(), lhs.get_allocator());
+		result.assign(sorted_unique, keys.begin(), keys.end());
+		return result;
+	}
+	return set_merge(lhs, rhs, true, false, false);
+}
+
+template<typename K, typename C, typename A, typename B>
+Set<K, C, A, B> symmetric_difference(const Set<K, C, A, B>& lhs, const Set<K, C, A, B>& rhs)
+{
+	const bool lhs_small = set_sizes_skewed(lhs.size(), rhs.size());
+	if (lhs_small || set_sizes_skewed(rhs.size(), lhs.size()))
+	{
+		Set<K, C, A, B> result(lhs_small ? rhs : lhs);
+		result ^= (lhs_small ? lhs : rhs);
+		return result;
+	}
+	return set_merge(lhs, rhs, true, false, true);
+}
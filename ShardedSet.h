@@ -0,0 +1,446 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <shared_mutex>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#include "Epoch.h"
+#include "Set.h"
+
+// Упорядоченное множество для многопоточной записи: ключи разбиты по диапазонам на независимые шарды —
+// красно-чёрные деревья, у каждого свой reader-writer мьютекс. Потоки, пишущие в разные диапазоны,
+// не мешают друг другу. Границы диапазонов (Layout) неизменяемы: операция читает их без блокировок
+// под epoch::Guard, блокирует свой шард и проверяет, что границы за это время не сменились.
+// Когда один шард становится больше среднего вдвое, ключи перераспределяются поровну: под мьютексами
+// всех шардов деревья склеиваются join и режутся split по select — O(N log n) без копирования ключей.
+// Порядок ключей между шардами совпадает с порядком шардов, поэтому обход и lower_bound сохраняют
+// семантику Set. Итераторов нет: ключ может уйти в другой шард при перебалансировке, поэтому
+// поиск возвращает копию ключа, как у ConcurrentSet.
+// Монотонно растущие ключи всё равно попадают в последний шард: для такой нагрузки разбиение
+// по диапазонам не даёт параллельной записи
+template<typename Key, typename Compare = std::less<Key>, typename Allocator = std::allocator<Key>>
+class ShardedSet
+{
+public:
+	using key_type = Key;
+	using value_type = Key;
+	using size_type = std::size_t;
+	using key_compare = Compare;
+	using allocator_type = Allocator;
+	// Размеры поддеревьев нужны перебалансировке: select для границ за O(log n)
+	using shard_type = Set<Key, Compare, Allocator, OrderStatisticsBackend>;
+
+	// Пока ключей мало, все они в первом шарде; шарды заполняются при первой перебалансировке
+	explicit ShardedSet(size_type shards = default_shards(), const Compare& comp = Compare());
+	~ShardedSet();
+
+	ShardedSet(const ShardedSet&) = delete;
+	ShardedSet& operator=(const ShardedSet&) = delete;
+
+	key_compare key_comp() const;
+
+	// Число элементов на момент вызова; при конкурентной записи — приблизительное
+	size_type size() const noexcept;
+	bool empty() const noexcept;
+
+	size_type shard_count() const noexcept;
+	std::vector<size_type> shard_sizes() const;
+
+	bool contains(const Key& key) const;
+	std::optional<Key> find(const Key& key) const;
+	std::optional<Key> lower_bound(const Key& key) const;
+	std::optional<Key> upper_bound(const Key& key) const;
+
+	bool insert(const Key& key);
+	bool insert(Key&& key);
+	bool erase(const Key& key);
+	void clear();
+
+	// Обход по возрастанию; шард читается под своим мьютексом. Ключи, присутствующие всё время обхода,
+	// посещаются ровно один раз и по порядку, даже если во время обхода прошла перебалансировка.
+	// visit вызывается с удерживаемым мьютексом шарда, поэтому не должен обращаться к этому же ShardedSet:
+	// insert, erase, clear и rebalance из visit — взаимная блокировка, и повторный захват на чтение тоже
+	// может ждать писателя, ждущего этот шард. Изменения по итогам обхода собирают и применяют после него
+	template<typename Visitor>
+	void for_each(Visitor&& visit) const;
+
+	// Перераспределяет ключи поровну между шардами; при перекосе вызывается автоматически
+	void rebalance();
+
+private:
+	// Шард с наименьшим размером, при котором перекос запускает перебалансировку
+	static constexpr size_type rebalance_min = 1024;
+
+	struct Layout
+	{
+		// bounds[i] — первый ключ шарда i + 1; шарды за bounds.size() пусты
+		std::vector<Key> bounds;
+	};
+
+	struct LayoutDeleter
+	{
+		void operator()(const Layout* layout) const
+		{
+			delete layout;
+		}
+	};
+
+	struct alignas(64) Shard
+	{
+		mutable std::shared_mutex mutex;
+		shard_type set;
+		// Размер для size() и проверки перекоса без мьютекса; пишется под мьютексом шарда
+		std::atomic<size_type> size{ 0 };
+		// Размер, при котором вставка в шард в следующий раз проверит перекос
+		size_type next_check = rebalance_min;
+
+		explicit Shard(const Compare& comp)
+			: set(comp)
+		{
+		}
+	};
+
+	static size_type default_shards();
+
+	size_type shard_of(const Layout& layout, const Key& key) const;
+
+	// Блокирует шард ключа (на запись или чтение) в актуальном разбиении и вызывает op(shard, index)
+	template<bool Exclusive, typename Op>
+	decltype(auto) with_shard(const Key& key, Op&& op) const;
+
+	template<typename K>
+	bool insert_key(K&& key);
+	bool skewed(size_type shard_size) const;
+	// Перебалансировка после вставки: перекос проверяется заново под _rebalance_mutex —
+	// одновременно заметившие его вставки не перебалансируют одно и то же несколько раз подряд
+	void rebalance_if_skewed();
+	void rebalance_locked();
+	// Первый ключ не меньше (strict == false) или больше (strict == true) key, начиная с шарда ключа
+	std::optional<Key> next_key(const Key& key, bool strict) const;
+
+	std::vector<std::unique_ptr<Shard>> _shards;
+	std::atomic<const Layout*> _layout;
+	Compare _comp;
+
+	// Перебалансировки упорядочены между собой; под ним же — список отложенных разбиений
+	std::mutex _rebalance_mutex;
+	epoch::RetireList<const Layout, LayoutDeleter> _retired;
+};
+
+template<typename Key, typename Compare, typename Allocator>
+ShardedSet<Key, Compare, Allocator>::ShardedSet(size_type shards, const Compare& comp)
+	: _layout(new Layout())
+	, _comp(comp)
+{
+	_shards.reserve(std::max<size_type>(shards, 1));
+	for (size_type i = 0; i < std::max<size_type>(shards, 1); ++i)
+		_shards.push_back(std::make_unique<Shard>(comp));
+}
+
+template<typename Key, typename Compare, typename Allocator>
+ShardedSet<Key, Compare, Allocator>::~ShardedSet()
+{
+	delete _layout.load(std::memory_order_relaxed);
+}
+
+template<typename Key, typename Compare, typename Allocator>
+inline typename ShardedSet<Key, Compare, Allocator>::size_type ShardedSet<Key, Compare, Allocator>::default_shards()
+{
+	// Шардов больше, чем потоков: у пишущих в случайные ключи меньше шансов встретиться на одном
+	return 4 * std::max(1u, std::thread::hardware_concurrency());
+}
+
+template<typename Key, typename Compare, typename Allocator>
+inline typename ShardedSet<Key, Compare, Allocator>::key_compare ShardedSet<Key, Compare, Allocator>::key_comp() const
+{
+	return _comp;
+}
+
+template<typename Key, typename Compare, typename Allocator>
+typename ShardedSet<Key, Compare, Allocator>::size_type ShardedSet<Key, Compare, Allocator>::size() const noexcept
+{
+	size_type total = 0;
+	for (const auto& shard : _shards)
+		total += shard->size.load(std::memory_order_relaxed);
+	return total;
+}
+
+template<typename Key, typename Compare, typename Allocator>
+inline bool ShardedSet<Key, Compare, Allocator>::empty() const noexcept
+{
+	return size() == 0;
+}
+
+template<typename Key, typename Compare, typename Allocator>
+inline typename ShardedSet<Key, Compare, Allocator>::size_type ShardedSet<Key, Compare, Allocator>::shard_count() const noexcept
+{
+	return _shards.size();
+}
+
+template<typename Key, typename Compare, typename Allocator>
+std::vector<typename ShardedSet<Key, Compare, Allocator>::size_type> ShardedSet<Key, Compare, Allocator>::shard_sizes() const
+{
+	std::vector<size_type> sizes;
+	for (const auto& shard : _shards)
+		sizes.push_back(shard->size.load(std::memory_order_relaxed));
+	return sizes;
+}
+
+template<typename Key, typename Compare, typename Allocator>
+inline typename ShardedSet<Key, Compare, Allocator>::size_type ShardedSet<Key, Compare, Allocator>::shard_of(const Layout& layout, const Key& key) const
+{
+	return static_cast<size_type>(std::upper_bound(layout.bounds.begin(), layout.bounds.end(), key, _comp) - layout.bounds.begin());
+}
+
+template<typename Key, typename Compare, typename Allocator>
+template<bool Exclusive, typename Op>
+decltype(auto) ShardedSet<Key, Compare, Allocator>::with_shard(const Key& key, Op&& op) const
+{
+	epoch::Guard guard;
+	while (true)
+	{
+		const Layout* layout = _layout.load(std::memory_order_acquire);
+		size_type index = shard_of(*layout, key);
+		Shard& shard = *_shards[index];
+		using Lock = std::conditional_t<Exclusive, std::unique_lock<std::shared_mutex>, std::shared_lock<std::shared_mutex>>;
+		Lock lock(shard.mutex);
+		// Разбиение меняется только под мьютексами всех шардов: раз оно то же, ключ принадлежит этому шарду
+		if (_layout.load(std::memory_order_acquire) == layout)
+			return op(shard, index);
+	}
+}
+
+template<typename Key, typename Compare, typename Allocator>
+bool ShardedSet<Key, Compare, Allocator>::contains(const Key& key) const
+{
+	return with_shard<false>(key, [&](Shard& shard, size_type) { return shard.set.contains(key); });
+}
+
+template<typename Key, typename Compare, typename Allocator>
+std::optional<Key> ShardedSet<Key, Compare, Allocator>::find(const Key& key) const
+{
+	return with_shard<false>(key, [&](Shard& shard, size_type) -> std::optional<Key>
+		{
+			auto it = shard.set.find(key);
+			if (it == shard.set.end())
+				return std::nullopt;
+			return it->first;
+		});
+}
+
+template<typename Key, typename Compare, typename Allocator>
+inline std::optional<Key> ShardedSet<Key, Compare, Allocator>::lower_bound(const Key& key) const
+{
+	return next_key(key, false);
+}
+
+template<typename Key, typename Compare, typename Allocator>
+inline std::optional<Key> ShardedSet<Key, Compare, Allocator>::upper_bound(const Key& key) const
+{
+	return next_key(key, true);
+}
+
+template<typename Key, typename Compare, typename Allocator>
+std::optional<Key> ShardedSet<Key, Compare, Allocator>::next_key(const Key& key, bool strict) const
+{
+	epoch::Guard guard;
+	while (true)
+	{
+		// Если в шарде ключа ответа нет, он — первый ключ следующего непустого шарда
+		const Layout* layout = _layout.load(std::memory_order_acquire);
+		size_type index = shard_of(*layout, key);
+		for (; index < _shards.size(); ++index)
+		{
+			const Shard& shard = *_shards[index];
+			std::shared_lock<std::shared_mutex> lock(shard.mutex);
+			if (_layout.load(std::memory_order_acquire) != layout)
+				break;
+			auto it = strict ? shard.set.upper_bound(key) : shard.set.lower_bound(key);
+			if (it != shard.set.end())
+				return it->first;
+		}
+		if (index == _shards.size())
+			return std::nullopt;
+	}
+}
+
+template<typename Key, typename Compare, typename Allocator>
+inline bool ShardedSet<Key, Compare, Allocator>::insert(const Key& key)
+{
+	return insert_key(key);
+}
+
+template<typename Key, typename Compare, typename Allocator>
+inline bool ShardedSet<Key, Compare, Allocator>::insert(Key&& key)
+{
+	return insert_key(std::move(key));
+}
+
+template<typename Key, typename Compare, typename Allocator>
+template<typename K>
+bool ShardedSet<Key, Compare, Allocator>::insert_key(K&& key)
+{
+	bool check = false;
+	bool inserted = with_shard<true>(key, [&](Shard& shard, size_type)
+		{
+			if (!shard.set.insert(std::forward<K>(key)).second)
+				return false;
+			size_type size = shard.set.size();
+			shard.size.store(size, std::memory_order_relaxed);
+			// Перекос проверяется не на каждой вставке: сумма размеров — проход по всем шардам
+			if (size >= shard.next_check)
+			{
+				shard.next_check = size + std::max<size_type>(64, size / 8);
+				check = skewed(size);
+			}
+			return true;
+		});
+	if (check)
+		rebalance_if_skewed();
+	return inserted;
+}
+
+template<typename Key, typename Compare, typename Allocator>
+inline bool ShardedSet<Key, Compare, Allocator>::skewed(size_type shard_size) const
+{
+	return shard_size >= rebalance_min && shard_size > 2 * size() / _shards.size();
+}
+
+template<typename Key, typename Compare, typename Allocator>
+bool ShardedSet<Key, Compare, Allocator>::erase(const Key& key)
+{
+	return with_shard<true>(key, [&](Shard& shard, size_type)
+		{
+			if (shard.set.erase(key) == 0)
+				return false;
+			shard.size.store(shard.set.size(), std::memory_order_relaxed);
+			return true;
+		});
+}
+
+template<typename Key, typename Compare, typename Allocator>
+void ShardedSet<Key, Compare, Allocator>::clear()
+{
+	// Разбиение остаётся прежним: шарды очищаются по одному, вставки в уже очищенные не теряются
+	for (auto& shard : _shards)
+	{
+		std::unique_lock<std::shared_mutex> lock(shard->mutex);
+		shard->set.clear();
+		shard->size.store(0, std::memory_order_relaxed);
+		shard->next_check = rebalance_min;
+	}
+}
+
+template<typename Key, typename Compare, typename Allocator>
+template<typename Visitor>
+void ShardedSet<Key, Compare, Allocator>::for_each(Visitor&& visit) const
+{
+	// После смены разбиения обход продолжается с ключа, следующего за последним посещённым
+	epoch::Guard guard;
+	std::optional<Key> last;
+	while (true)
+	{
+		const Layout* layout = _layout.load(std::memory_order_acquire);
+		size_type index = last ? shard_of(*layout, *last) : 0;
+		for (; index < _shards.size(); ++index)
+		{
+			const Shard& shard = *_shards[index];
+			std::shared_lock<std::shared_mutex> lock(shard.mutex);
+			if (_layout.load(std::memory_order_acquire) != layout)
+				break;
+			auto it = last ? shard.set.upper_bound(*last) : shard.set.begin();
+			if (it == shard.set.end())
+				continue;
+			// visit под мьютексом шарда (см. объявление)
+			for (; it != shard.set.end(); ++it)
+				visit(static_cast<const Key&>(it->first));
+			last = std::prev(shard.set.end())->first;
+		}
+		if (index == _shards.size())
+			return;
+	}
+}
+
+template<typename Key, typename Compare, typename Allocator>
+void ShardedSet<Key, Compare, Allocator>::rebalance()
+{
+	std::lock_guard<std::mutex> rebalance_lock(_rebalance_mutex);
+	rebalance_locked();
+}
+
+template<typename Key, typename Compare, typename Allocator>
+void ShardedSet<Key, Compare, Allocator>::rebalance_if_skewed()
+{
+	std::lock_guard<std::mutex> rebalance_lock(_rebalance_mutex);
+	size_type largest = 0;
+	for (const auto& shard : _shards)
+		largest = std::max(largest, shard->size.load(std::memory_order_relaxed));
+	if (skewed(largest))
+		rebalance_locked();
+}
+
+template<typename Key, typename Compare, typename Allocator>
+void ShardedSet<Key, Compare, Allocator>::rebalance_locked()
+{
+	// Все шарды — по порядку индексов; другие операции держат не больше одного шарда, взаимной блокировки нет
+	std::vector<std::unique_lock<std::shared_mutex>> locks;
+	locks.reserve(_shards.size());
+	for (auto& shard : _shards)
+		locks.emplace_back(shard->mutex);
+
+	// Новые границы выбираются до того, как шарды тронуты: копирование ключа или аллокация могут бросить,
+	// а шарды должны соответствовать опубликованному разбиению. Граница i — ключ с рангом rank во всём
+	// множестве, select в шарде, куда этот ранг попадает. Пока ключей меньше, чем шардов, часть шардов остаётся пустой
+	size_type total = 0;
+	for (const auto& shard : _shards)
+		total += shard->set.size();
+	size_type parts = std::clamp<size_type>(total, 1, _shards.size());
+	auto layout = std::make_unique<Layout>();
+	layout->bounds.reserve(parts - 1);
+	size_type rank = 0;
+	size_type index = 0;
+	size_type offset = 0;  // ключей в шардах до index
+	for (size_type i = 0; i + 1 < parts; ++i)
+	{
+		rank += (total - rank) / (parts - i);
+		while (offset + _shards[index]->set.size() <= rank)
+			offset += _shards[index++]->set.size();
+		layout->bounds.push_back(_shards[index]->set.select(rank - offset)->first);
+	}
+
+	// Склейка всех шардов: ключи шарда i меньше ключей шарда i + 1, join за O(log n);
+	// затем нарезка по выбранным границам
+	shard_type all(_comp);
+	for (auto& shard : _shards)
+	{
+		shard_type taken(_comp);
+		swap(taken, shard->set);
+		all = shard_type::join(std::move(all), std::move(taken));
+	}
+	for (size_type i = 0; i + 1 < parts; ++i)
+	{
+		auto [left, right] = all.split(layout->bounds[i]);
+		swap(_shards[i]->set, left);
+		all = std::move(right);
+	}
+	swap(_shards[parts - 1]->set, all);
+
+	for (auto& shard : _shards)
+	{
+		size_type size = shard->set.size();
+		shard->size.store(size, std::memory_order_relaxed);
+		shard->next_check = std::max(rebalance_min, size + std::max<size_type>(64, size / 8));
+	}
+
+	// Старое разбиение могут ещё читать операции, не взявшие мьютекс шарда
+	const Layout* old = _layout.exchange(layout.release(), std::memory_order_acq_rel);
+	_retired.retire(old);
+}
@@ -0,0 +1,220 @@
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <functional>
+#include <type_traits>
+
+// Поиск в упорядоченном массиве целых ключей векторными сравнениями. Позиция lower_bound в
+// упорядоченном массиве — это число элементов, меньших ключа, поэтому узел целиком сравнивается
+// с ключом без ветвлений, а совпадения считаются. Для длинных массивов двоичный поиск сначала
+// сужает диапазон до блока в несколько кэш-линий.
+// AVX2 выбирается во время выполнения, без него — SSE2 (только 32-битные ключи) или скалярный цикл.
+// SET_NO_SIMD отключает векторные ветки целиком
+#if !defined(SET_NO_SIMD) && (defined(__x86_64__) || defined(__i386__)) && (defined(__GNUC__) || defined(__clang__))
+#define SIMD_SEARCH_X86 1
+#include <immintrin.h>
+#else
+#define SIMD_SEARCH_X86 0
+#endif
+
+namespace simd_search
+{
+    // Порядок компаратора: +1 — по возрастанию, -1 — по убыванию, 0 — векторный поиск неприменим
+    template<typename Compare, typename Key>
+    struct compare_order : std::integral_constant<int, 0> {};
+
+    template<typename Key>
+    struct compare_order<std::less<Key>, Key> : std::integral_constant<int, 1> {};
+
+    template<typename Key>
+    struct compare_order<std::less<>, Key> : std::integral_constant<int, 1> {};
+
+    template<typename Key>
+    struct compare_order<std::greater<Key>, Key> : std::integral_constant<int, -1> {};
+
+    template<typename Key>
+    struct compare_order<std::greater<>, Key> : std::integral_constant<int, -1> {};
+
+    template<typename Key, typename Compare>
+    inline constexpr bool enabled = std::is_integral<Key>::value && !std::is_same<Key, bool>::value
+        && (sizeof(Key) == 4 || sizeof(Key) == 8) && compare_order<Compare, Key>::value != 0;
+
+    namespace detail
+    {
+        // Что считать: элементы меньше ключа или больше ключа (по значению, не по компаратору)
+        enum class Count { less, greater };
+
+        template<Count What, typename Key>
+        inline std::size_t count_scalar(const Key* keys, std::size_t n, Key key)
+        {
+            std::size_t result = 0;
+            for (std::size_t i = 0; i < n; ++i)
+                result += (What == Count::less) ? (keys[i] < key) : (keys[i] > key);
+            return result;
+        }
+
+#if SIMD_SEARCH_X86
+        // Беззнаковые ключи сравниваются как знаковые после инверсии старшего бита
+        template<typename Key>
+        inline constexpr std::uint64_t sign_flip = std::is_signed<Key>::value ? 0 : (std::uint64_t(1) << (8 * sizeof(Key) - 1));
+
+        template<Count What, typename Key>
+        __attribute__((target("avx2"))) inline std::size_t count_avx2(const Key* keys, std::size_t n, Key key)
+        {
+            constexpr std::size_t lanes = 32 / sizeof(Key);
+            __m256i needle;
+            __m256i flip;
+            if constexpr (sizeof(Key) == 4)
+            {
+                flip = _mm256_set1_epi32(static_cast<int>(sign_flip<Key>));
+                needle = _mm256_xor_si256(_mm256_set1_epi32(static_cast<int>(key)), flip);
+            }
+            else
+            {
+                flip = _mm256_set1_epi64x(static_cast<long long>(sign_flip<Key>));
+                needle = _mm256_xor_si256(_mm256_set1_epi64x(static_cast<long long>(key)), flip);
+            }
+
+            // Маска сравнения — -1 в подходящих дорожках: вычитание накапливает счётчики без ветвлений
+            __m256i counts = _mm256_setzero_si256();
+            std::size_t i = 0;
+            for (; i + lanes <= n; i += lanes)
+            {
+                __m256i block = _mm256_xor_si256(_mm256_loadu_si256(reinterpret_cast<const __m256i*>(keys + i)), flip);
+                __m256i mask;
+                if constexpr (sizeof(Key) == 4)
+                    mask = (What == Count::less) ? _mm256_cmpgt_epi32(needle, block) : _mm256_cmpgt_epi32(block, needle);
+                else
+                    mask = (What == Count::less) ? _mm256_cmpgt_epi64(needle, block) : _mm256_cmpgt_epi64(block, needle);
+                counts = (sizeof(Key) == 4) ? _mm256_sub_epi32(counts, mask) : _mm256_sub_epi64(counts, mask);
+            }
+
+            alignas(32) std::int64_t lanes64[4];
+            std::size_t result = 0;
+            if constexpr (sizeof(Key) == 4)
+            {
+                // 32-битные счётчики расширяются до 64 бит перед сложением
+                __m256i wide = _mm256_add_epi64(_mm256_cvtepu32_epi64(_mm256_castsi256_si128(counts)),
+                    _mm256_cvtepu32_epi64(_mm256_extracti128_si256(counts, 1)));
+                _mm256_store_si256(reinterpret_cast<__m256i*>(lanes64), wide);
+            }
+            else
+            {
+                _mm256_store_si256(reinterpret_cast<__m256i*>(lanes64), counts);
+            }
+            result = static_cast<std::size_t>(lanes64[0] + lanes64[1] + lanes64[2] + lanes64[3]);
+            return result + count_scalar<What>(keys + i, n - i, key);
+        }
+
+        template<Count What, typename Key>
+        inline std::size_t count_sse2(const Key* keys, std::size_t n, Key key)
+        {
+            static_assert(sizeof(Key) == 4, "SSE2 has no 64-bit compare");
+            const __m128i flip = _mm_set1_epi32(static_cast<int>(sign_flip<Key>));
+            const __m128i needle = _mm_xor_si128(_mm_set1_epi32(static_cast<int>(key)), flip);
+
+            __m128i counts = _mm_setzero_si128();
+            std::size_t i = 0;
+            for (; i + 4 <= n; i += 4)
+            {
+                __m128i block = _mm_xor_si128(_mm_loadu_si128(reinterpret_cast<const __m128i*>(keys + i)), flip);
+                __m128i mask = (What == Count::less) ? _mm_cmpgt_epi32(needle, block) : _mm_cmpgt_epi32(block, needle);
+                counts = _mm_sub_epi32(counts, mask);
+            }
+
+            alignas(16) std::uint32_t lanes32[4];
+            _mm_store_si128(reinterpret_cast<__m128i*>(lanes32), counts);
+            std::size_t result = std::size_t(lanes32[0]) + lanes32[1] + lanes32[2] + lanes32[3];
+            return result + count_scalar<What>(keys + i, n - i, key);
+        }
+
+        inline const bool has_avx2 = []
+            {
+                __builtin_cpu_init();
+                return __builtin_cpu_supports("avx2") != 0;
+            }();
+#endif
+
+        template<Count What, typename Key>
+        inline std::size_t count(const Key* keys, std::size_t n, Key key)
+        {
+#if SIMD_SEARCH_X86
+#if defined(__AVX2__)
+            return count_avx2<What>(keys, n, key);
+#else
+            if (has_avx2)
+                return count_avx2<What>(keys, n, key);
+            if constexpr (sizeof(Key) == 4)
+                return count_sse2<What>(keys, n, key);
+#endif
+#endif
+            return count_scalar<What>(keys, n, key);
+        }
+
+        // Блок, который выгоднее сравнить целиком, чем делить дальше: четыре кэш-линии
+        template<typename Key>
+        inline constexpr std::size_t block_size = 256 / sizeof(Key);
+    }
+
+    // Число элементов keys[0, n), для которых comp(keys[i], key): позиция lower_bound
+    template<typename Key, typename Compare>
+    inline std::size_t count_before(const Key* keys, std::size_t n, const Key& key)
+    {
+        static_assert(enabled<Key, Compare>, "use std::lower_bound for this key and comparator");
+        constexpr detail::Count what = (compare_order<Compare, Key>::value > 0) ? detail::Count::less : detail::Count::greater;
+        return detail::count<what>(keys, n, key);
+    }
+
+    // Число элементов keys[0, n), для которых !comp(key, keys[i]): позиция upper_bound
+    template<typename Key, typename Compare>
+    inline std::size_t count_not_after(const Key* keys, std::size_t n, const Key& key)
+    {
+        static_assert(enabled<Key, Compare>, "use std::upper_bound for this key and comparator");
+        constexpr detail::Count after = (compare_order<Compare, Key>::value > 0) ? detail::Count::greater : detail::Count::less;
+        return n - detail::count<after>(keys, n, key);
+    }
+
+    // lower_bound по упорядоченному массиву любой длины
+    template<typename Key, typename Compare>
+    inline std::size_t lower_bound(const Key* keys, std::size_t n, const Key& key, const Compare& comp)
+    {
+        const Key* base = keys;
+        while (n > detail::block_size<Key>)
+        {
+            std::size_t half = n / 2;
+            if (comp(base[half], key))
+            {
+                base += half + 1;
+                n -= half + 1;
+            }
+            else
+            {
+                n = half;
+            }
+        }
+        return static_cast<std::size_t>(base - keys) + count_before<Key, Compare>(base, n, key);
+    }
+
+    template<typename Key, typename Compare>
+    inline std::size_t upper_bound(const Key* keys, std::size_t n, const Key& key, const Compare& comp)
+    {
+        const Key* base = keys;
+        while (n > detail::block_size<Key>)
+        {
+            std::size_t half = n / 2;
+            if (!comp(key, base[half]))
+            {
+                base += half + 1;
+                n -= half + 1;
+            }
+            else
+            {
+                n = half;
+            }
+        }
+        return static_cast<std::size_t>(base - keys) + count_not_after<Key, Compare>(base, n, key);
+    }
+}
@@ -0,0 +1,265 @@
+#pragma once
+
+#include <algorithm>
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <concepts>
+#include <exception>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+// Пул потоков для параллельных объёмных операций Set: построения, копирования, сравнения и слияния.
+// Задачи устроены как fork-join: поток, ждущий свою половину работы, не спит, а выполняет задачи
+// из очереди, поэтому fork внутри задачи не блокирует пул и не требует лишних потоков.
+// Рабочие потоки берут самые старые (крупные) задачи, ждущие — самые свежие.
+// Политики из <execution> подключаются отдельно, в ExecutionPolicy.h: с установленным TBB libstdc++
+// требует его при компоновке даже от программ, не вызывающих параллельных алгоритмов
+class ThreadPool
+{
+public:
+	// threads — рабочие потоки сверх вызывающего; при 0 всё выполняется в вызывающем потоке
+	explicit ThreadPool(unsigned threads = std::max(1u, std::thread::hardware_concurrency()) - 1)
+	{
+		_workers.reserve(threads);
+		for (unsigned i = 0; i < threads; ++i)
+			_workers.emplace_back([this] { work(); });
+	}
+
+	~ThreadPool()
+	{
+		{
+			std::lock_guard<std::mutex> lock(_mutex);
+			_stop = true;
+		}
+		_cv.notify_all();
+		for (auto& worker : _workers)
+			worker.join();
+	}
+
+	ThreadPool(const ThreadPool&) = delete;
+	ThreadPool& operator=(const ThreadPool&) = delete;
+
+	// Потоки, выполняющие задачи, вместе с вызывающим
+	unsigned concurrency() const noexcept
+	{
+		return static_cast<unsigned>(_workers.size()) + 1;
+	}
+
+	// Выполняет f и g, возможно одновременно, и возвращается, когда завершились обе.
+	// Исключение пробрасывается после завершения обеих задач; если бросили обе — исключение f
+	template<typename F, typename G>
+	void invoke(F&& f, G&& g)
+	{
+		if (_workers.empty())
+		{
+			f();
+			g();
+			return;
+		}
+
+		Job job;
+		job.run = [&g] { g(); };
+		{
+			std::lock_guard<std::mutex> lock(_mutex);
+			_queue.push_back(&job);
+		}
+		_cv.notify_one();
+
+		std::exception_ptr error;
+		try
+		{
+			f();
+		}
+		catch (...)
+		{
+			error = std::current_exception();
+		}
+		wait(job);
+
+		if (error)
+			std::rethrow_exception(error);
+		if (job.error)
+			std::rethrow_exception(job.error);
+	}
+
+	// f(i) для каждого i из [0, n): диапазон делится пополам, пока в частях больше одного индекса
+	template<typename F>
+	void for_each_index(std::size_t n, F&& f)
+	{
+		for_each_index(0, n, f);
+	}
+
+	// Общий пул процесса с потоком на каждое ядро
+	static ThreadPool& shared()
+	{
+		static ThreadPool pool;
+		return pool;
+	}
+
+private:
+	struct Job
+	{
+		std::function<void()> run;
+		std::exception_ptr error;
+		bool done = false;
+	};
+
+	template<typename F>
+	void for_each_index(std::size_t first, std::size_t last, F& f)
+	{
+		if (last - first > 1)
+		{
+			std::size_t middle = first + (last - first) / 2;
+			invoke([&] { for_each_index(first, middle, f); }, [&] { for_each_index(middle, last, f); });
+		}
+		else if (first != last)
+		{
+			f(first);
+		}
+	}
+
+	void execute(Job& job)
+	{
+		try
+		{
+			job.run();
+		}
+		catch (...)
+		{
+			job.error = std::current_exception();
+		}
+		{
+			std::lock_guard<std::mutex> lock(_mutex);
+			job.done = true;
+		}
+		_cv.notify_all();
+	}
+
+	// Ждёт job, выполняя тем временем задачи из очереди — в том числе, скорее всего, саму job
+	void wait(Job& job)
+	{
+		std::unique_lock<std::mutex> lock(_mutex);
+		while (!job.done)
+		{
+			if (_queue.empty())
+			{
+				_cv.wait(lock);
+				continue;
+			}
+			Job* next = _queue.back();
+			_queue.pop_back();
+			lock.unlock();
+			execute(*next);
+			lock.lock();
+		}
+	}
+
+	void work()
+	{
+		std::unique_lock<std::mutex> lock(_mutex);
+		while (true)
+		{
+			_cv.wait(lock, [this] { return _stop || !_queue.empty(); });
+			if (_queue.empty())
+				return;
+			Job* job = _queue.front();
+			_queue.pop_front();
+			lock.unlock();
+			execute(*job);
+			lock.lock();
+		}
+	}
+
+	std::vector<std::thread> _workers;
+	std::deque<Job*> _queue;
+	std::mutex _mutex;
+	std::condition_variable _cv;
+	bool _stop = false;
+};
+
+namespace parallel
+{
+	// Как исполнитель выполняет задачи: pool(exec) возвращает пул или nullptr — выполнять последовательно
+	// в вызывающем потоке. Политики из <execution> добавляет ExecutionPolicy.h
+	template<typename E>
+	struct executor_traits
+	{
+	};
+
+	template<>
+	struct executor_traits<ThreadPool>
+	{
+		static ThreadPool* pool(ThreadPool& exec) noexcept
+		{
+			return &exec;
+		}
+	};
+
+	// Исполнитель параллельных операций: ThreadPool или политика выполнения из ExecutionPolicy.h
+	template<typename E>
+	concept executor = requires(std::remove_cvref_t<E>& exec)
+	{
+		{ executor_traits<std::remove_cvref_t<E>>::pool(exec) } -> std::same_as<ThreadPool*>;
+	};
+
+	template<executor E>
+	ThreadPool* pool_of(E& exec)
+	{
+		return executor_traits<std::remove_cvref_t<E>>::pool(exec);
+	}
+
+	// fork(f, g) для RedBlackTree::assign_parallel: на пуле или по очереди, если пула нет
+	struct Fork
+	{
+		ThreadPool* pool;
+
+		template<typename F, typename G>
+		void operator()(F&& f, G&& g) const
+		{
+			if (pool)
+			{
+				pool->invoke(std::forward<F>(f), std::forward<G>(g));
+			}
+			else
+			{
+				f();
+				g();
+			}
+		}
+	};
+
+	// f(part) для частей делимого диапазона (RedBlackTree::Range): диапазон делится, пока is_divisible,
+	// половины обрабатываются в разных задачах
+	template<typename Range, typename F>
+	void for_range(ThreadPool* pool, Range range, F&& f)
+	{
+		if (pool && range.is_divisible())
+		{
+			Range right = range.split();
+			pool->invoke([&] { for_range(pool, std::move(range), f); }, [&] { for_range(pool, std::move(right), f); });
+		}
+		else
+		{
+			f(static_cast<const Range&>(range));
+		}
+	}
+
+	template<typename F>
+	void for_each_index(ThreadPool* pool, std::size_t n, F&& f)
+	{
+		if (pool)
+		{
+			pool->for_each_index(n, f);
+		}
+		else
+		{
+			for (std::size_t i = 0; i < n; ++i)
+				f(i);
+		}
+	}
+}
@@ -0,0 +1,1098 @@
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <limits>
+#include <memory>
+#include <numeric>
+#include <random>
+#include <set>
+#include <shared_mutex>
+#include <span>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "Set.h"
+#include "ExecutionPolicy.h"
+#include "NodePool.h"
+#include "BTree.h"
+#include "FlatSet.h"
+#include "FrozenSet.h"
+#include "ConcurrentSet.h"
+#include "PersistentSet.h"
+#include "ShardedSet.h"
+
+#ifdef SET_BENCH_WITH_ABSL
+#include <absl/container/btree_set.h>
+#endif
+
+// Запуск: set_bench [--filter=подстрока] [--max-size=N] [--repetitions=N]
+// Ключи и порядок операций фиксированы сидами, время — лучший из повторов
+
+namespace
+{
+	volatile std::size_t sink;
+
+	struct Options
+	{
+		std::string filter;
+		std::size_t max_size = 10'000'000;
+		int repetitions = 3;
+	};
+
+	Options options;
+
+	bool selected(const std::string& name)
+	{
+		return options.filter.empty() || name.find(options.filter) != std::string::npos;
+	}
+
+	// Группа выбрана, если фильтр попадает в её префикс или уточняет его
+	bool group_selected(const std::string& prefix)
+	{
+		return selected(prefix) || options.filter.compare(0, prefix.size(), prefix) == 0;
+	}
+
+	void report(const std::string& name, double ns_per_op, std::size_t ops)
+	{
+		std::printf("%-56s %12.2f ns %12zu ops\n", name.c_str(), ns_per_op, ops);
+	}
+
+	template<typename F>
+	void run_benchmark(const char* name, std::size_t ops, F&& body)
+	{
+		if (!selected(name))
+			return;
+		auto start = std::chrono::steady_clock::now();
+		body();
+		auto stop = std::chrono::steady_clock::now();
+		double ns = std::chrono::duration<double, std::nano>(stop - start).count();
+		report(name, ns / static_cast<double>(ops), ops);
+	}
+
+	// Повторяемый замер: setup готовит состояние вне замера, body получает его по ссылке
+	template<typename Setup, typename Body>
+	void run_case(const std::string& name, std::size_t ops, Setup&& setup, Body&& body)
+	{
+		if (!selected(name))
+			return;
+		double best = std::numeric_limits<double>::max();
+		for (int r = 0; r < options.repetitions; ++r)
+		{
+			auto state = setup();
+			auto start = std::chrono::steady_clock::now();
+			body(state);
+			auto stop = std::chrono::steady_clock::now();
+			best = std::min(best, std::chrono::duration<double, std::nano>(stop - start).count());
+		}
+		report(name, best / static_cast<double>(ops), ops);
+	}
+
+	std::vector<int> random_keys(std::size_t n, unsigned seed)
+	{
+		std::mt19937 gen(seed);
+		std::vector<int> keys(n);
+		for (auto& key : keys)
+			key = static_cast<int>(gen());
+		return keys;
+	}
+
+	// Число потоков для замеров масштабирования: 1, 2, 4... и само число ядер последней точкой,
+	// даже если оно не степень двойки; на одном ядре — 1 и 2
+	std::vector<unsigned> thread_counts()
+	{
+		const unsigned cores = std::max(2u, std::thread::hardware_concurrency());
+		std::vector<unsigned> counts;
+		for (unsigned threads = 1; threads < cores; threads *= 2)
+			counts.push_back(threads);
+		counts.push_back(cores);
+		return counts;
+	}
+
+	// Элементы Set и RedBlackTree — пары с ключом в first, у стандартных контейнеров — сами ключи
+	inline int key_of(int value)
+	{
+		return value;
+	}
+
+	template<typename Value>
+	int key_of(const Value& value)
+	{
+		return value.first;
+	}
+
+	template<typename C>
+	struct container_name;
+
+	template<>
+	struct container_name<Set<int>>
+	{
+		static constexpr const char* value = "Set";
+	};
+
+	template<>
+	struct container_name<Set<int, std::less<int>, std::allocator<int>, BTreeBackend<>>>
+	{
+		static constexpr const char* value = "Set<BTree>";
+	};
+
+	template<>
+	struct container_name<Set<int, std::less<int>, std::allocator<int>, OrderStatisticsBackend>>
+	{
+		static constexpr const char* value = "Set<OrderStatistics>";
+	};
+
+	template<>
+	struct container_name<std::set<int>>
+	{
+		static constexpr const char* value = "std::set";
+	};
+
+#ifdef SET_BENCH_WITH_ABSL
+	template<>
+	struct container_name<absl::btree_set<int>>
+	{
+		static constexpr const char* value = "absl::btree_set";
+	};
+#endif
+
+	// Общий набор сценариев для одного контейнера и одного размера.
+	// Ключи чётные, промахи — те же ключи с единицей в младшем бите
+	template<typename C>
+	void bench_suite(std::size_t n)
+	{
+		const std::string suffix = std::string("/") + container_name<C>::value + "/" + std::to_string(n);
+		auto name = [&](const char* scenario) { return std::string(scenario) + suffix; };
+
+		std::vector<int> keys = random_keys(n, 42);
+		for (int& key : keys)
+			key &= ~1;
+		std::vector<int> sorted = keys;
+		std::sort(sorted.begin(), sorted.end());
+		std::vector<int> shuffled = keys;
+		std::shuffle(shuffled.begin(), shuffled.end(), std::mt19937(7));
+
+		auto empty = [] { return C(); };
+		auto none = [] { return 0; };
+
+		run_case(name("insert/random"), n, empty, [&](C& c)
+			{
+				for (int key : keys)
+					c.insert(key);
+				sink = c.size();
+			});
+
+		run_case(name("insert/sorted"), n, empty, [&](C& c)
+			{
+				for (int key : sorted)
+					c.insert(key);
+				sink = c.size();
+			});
+
+		const C source(keys.begin(), keys.end());
+		const std::size_t lookups = std::min<std::size_t>(n, 1'000'000);
+
+		run_case(name("find/hit"), lookups, none, [&](int)
+			{
+				std::size_t found = 0;
+				for (std::size_t i = 0; i < lookups; ++i)
+					found += source.find(shuffled[i]) != source.end();
+				sink = found;
+			});
+
+		run_case(name("find/miss"), lookups, none, [&](int)
+			{
+				std::size_t found = 0;
+				for (std::size_t i = 0; i < lookups; ++i)
+					found += source.find(shuffled[i] | 1) != source.end();
+				sink = found;
+			});
+
+		// Пакетная проверка упорядоченных ключей: половина попаданий
+		if constexpr (requires { source.contains_many(std::span<const int>(), std::span<bool>()); })
+		{
+			std::vector<int> probes(shuffled.begin(), shuffled.begin() + lookups);
+			for (std::size_t i = 0; i < probes.size(); i += 2)
+				probes[i] |= 1;
+			std::sort(probes.begin(), probes.end());
+			std::unique_ptr<bool[]> found(new bool[probes.size()]);
+			run_case(name("contains_many/sorted"), lookups, none, [&](int)
+				{
+					source.contains_many(probes, std::span<bool>(found.get(), probes.size()));
+					sink = found[probes.size() / 2];
+				});
+		}
+
+		// Тот же поток случайных ключей, что и в find/hit, одним пакетом
+		if constexpr (requires { source.contains_batch(std::span<const int>(), std::span<bool>()); })
+		{
+			std::unique_ptr<bool[]> found(new bool[lookups]);
+			run_case(name("contains_batch/hit"), lookups, none, [&](int)
+				{
+					source.contains_batch(std::span<const int>(shuffled.data(), lookups), std::span<bool>(found.get(), lookups));
+					sink = found[lookups / 2];
+				});
+		}
+
+		run_case(name("erase/random"), n, [&] { return C(source); }, [&](C& c)
+			{
+				for (int key : shuffled)
+					c.erase(key);
+				sink = c.size();
+			});
+
+		run_case(name("iterate"), source.size(), none, [&](int)
+			{
+				std::size_t sum = 0;
+				for (const auto& value : source)
+					sum += static_cast<std::size_t>(key_of(value));
+				sink = sum;
+			});
+
+		run_case(name("copy"), source.size(), none, [&](int)
+			{
+				C copy(source);
+				sink = copy.size();
+			});
+
+		// Запрос диапазона: lower_bound и просмотр до 64 следующих элементов
+		run_case(name("range/lower_bound+64"), lookups, none, [&](int)
+			{
+				std::size_t sum = 0;
+				for (std::size_t i = 0; i < lookups; ++i)
+				{
+					auto it = source.lower_bound(shuffled[i] | 1);
+					for (int step = 0; step < 64 && it != source.end(); ++step, ++it)
+						sum += static_cast<std::size_t>(key_of(*it));
+				}
+				sink = sum;
+			});
+
+		// Смешанная нагрузка: половина поисков, четверть вставок новых ключей, четверть удалений
+		std::vector<unsigned> ops(lookups);
+		std::mt19937 gen(11);
+		for (auto& op : ops)
+			op = gen();
+		run_case(name("mixed/50find-25insert-25erase"), lookups, [&] { return C(source); }, [&](C& c)
+			{
+				std::size_t found = 0;
+				for (std::size_t i = 0; i < lookups; ++i)
+				{
+					int key = shuffled[(ops[i] >> 2) % n];
+					switch (ops[i] & 3)
+					{
+					case 0:
+					case 1:
+						found += c.find(key) != c.end();
+						break;
+					case 2:
+						c.insert(key | 1);
+						break;
+					default:
+						c.erase(key);
+						break;
+					}
+				}
+				sink = found + c.size();
+			});
+	}
+
+	// Операции над множествами: встроенные против std::set_* с поэлементной вставкой результата
+	template<typename SetType>
+	void bench_set_algebra(std::size_t n)
+	{
+		if (!group_selected("algebra/"))
+			return;
+
+		const std::string suffix = std::string("/") + container_name<SetType>::value + "/" + std::to_string(n);
+		auto name = [&](const char* scenario) { return std::string("algebra/") + scenario + suffix; };
+
+		const std::vector<int> lhs_keys = random_keys(n, 11);
+		const std::vector<int> rhs_keys = random_keys(n, 12);
+		const SetType lhs(lhs_keys.begin(), lhs_keys.end());
+		const SetType rhs(rhs_keys.begin(), rhs_keys.end());
+		const SetType few(rhs_keys.begin(), rhs_keys.begin() + std::max<std::size_t>(1, n / 1000));
+		auto none = [] { return 0; };
+		auto key_less = [](const auto& l, const auto& r) { return l.first < r.first; };
+		using value_type = typename SetType::const_iterator::value_type;
+
+		run_case(name("intersection/std"), 2 * n, none, [&](int)
+			{
+				std::vector<value_type> merged;
+				std::set_intersection(lhs.begin(), lhs.end(), rhs.begin(), rhs.end(), std::back_inserter(merged), key_less);
+				SetType result;
+				for (const auto& value : merged)
+					result.insert(value.first);
+				sink = result.size();
+			});
+
+		run_case(name("intersection/native"), 2 * n, none, [&](int)
+			{
+				sink = set_intersection(lhs, rhs).size();
+			});
+
+		run_case(name("union/std"), 2 * n, none, [&](int)
+			{
+				std::vector<value_type> merged;
+				std::set_union(lhs.begin(), lhs.end(), rhs.begin(), rhs.end(), std::back_inserter(merged), key_less);
+				SetType result;
+				for (const auto& value : merged)
+					result.insert(value.first);
+				sink = result.size();
+			});
+
+		run_case(name("union/native"), 2 * n, none, [&](int)
+			{
+				sink = set_union(lhs, rhs).size();
+			});
+
+		run_case(name("difference-few/native"), n, none, [&](int)
+			{
+				sink = set_difference(lhs, few).size();
+			});
+
+		run_case(name("intersect-in-place"), 2 * n, [&] { return lhs; }, [&](SetType& s)
+			{
+				s &= rhs;
+				sink = s.size();
+			});
+	}
+
+	// Разрезание по медиане и обратная склейка: у красно-чёрного дерева O(log n), у B-дерева — перестроение
+	template<typename SetType>
+	void bench_split_join(std::size_t n)
+	{
+		if (!group_selected("split-join/"))
+			return;
+
+		const std::string suffix = std::string("/") + container_name<SetType>::value + "/" + std::to_string(n);
+		const std::vector<int> keys = random_keys(n, 13);
+		const SetType source(keys.begin(), keys.end());
+		const int median = std::next(source.begin(), static_cast<std::ptrdiff_t>(source.size() / 2))->first;
+
+		run_case(std::string("split-join/split+join") + suffix, 1, [&] { return source; }, [&](SetType& s)
+			{
+				auto [left, right] = s.split(median);
+				s = SetType::join(std::move(left), std::move(right));
+				sink = s.empty();
+			});
+	}
+
+	// Перцентили и страницы: с размерами поддеревьев — O(log n), без них — проход итераторами
+	template<typename SetType>
+	void bench_order_statistics(std::size_t n)
+	{
+		if (!group_selected("order-stats/"))
+			return;
+
+		const std::string suffix = std::string("/") + container_name<SetType>::value + "/" + std::to_string(n);
+		auto name = [&](const char* scenario) { return std::string("order-stats/") + scenario + suffix; };
+
+		const std::vector<int> keys = random_keys(n, 17);
+		const SetType set(keys.begin(), keys.end());
+		std::vector<int> bounds = random_keys(2000, 18);
+		std::vector<std::size_t> positions(1000);
+		std::mt19937_64 rng(19);
+		for (std::size_t& position : positions)
+			position = static_cast<std::size_t>(rng() % set.size());
+		auto none = [] { return 0; };
+
+		run_case(name("rank"), bounds.size(), none, [&](int)
+			{
+				std::size_t sum = 0;
+				for (int key : bounds)
+					sum += set.rank(key);
+				sink = sum;
+			});
+
+		run_case(name("select"), positions.size(), none, [&](int)
+			{
+				std::size_t sum = 0;
+				for (std::size_t k : positions)
+					sum += static_cast<std::size_t>(set.select(k)->first);
+				sink = sum;
+			});
+
+		run_case(name("count-range"), bounds.size() / 2, none, [&](int)
+			{
+				std::size_t sum = 0;
+				for (std::size_t i = 0; i + 1 < bounds.size(); i += 2)
+					sum += set.count_range(std::min(bounds[i], bounds[i + 1]), std::max(bounds[i], bounds[i + 1]));
+				sink = sum;
+			});
+	}
+
+	struct KeySum
+	{
+		using summary_type = long long;
+
+		static long long identity() { return 0; }
+		template<typename Value>
+		static long long lift(const Value& value) { return value.first; }
+		static long long combine(long long left, long long right) { return left + right; }
+	};
+
+	// Сумма ключей в диапазоне: сводками поддеревьев против прохода итераторами от lower_bound
+	void bench_range_aggregate(std::size_t n)
+	{
+		if (!group_selected("aggregate/"))
+			return;
+
+		const std::string suffix = std::string("/") + std::to_string(n);
+		const std::vector<int> keys = random_keys(n, 17);
+		const Set<int> plain(keys.begin(), keys.end());
+		const Set<int, std::less<int>, std::allocator<int>, AugmentedBackend<KeySum>> summed(keys.begin(), keys.end());
+		const std::vector<int> bounds = random_keys(2000, 18);
+		auto none = [] { return 0; };
+
+		run_case(std::string("aggregate/range-sum/native") + suffix, bounds.size() / 2, none, [&](int)
+			{
+				long long sum = 0;
+				for (std::size_t i = 0; i + 1 < bounds.size(); i += 2)
+					sum += summed.aggregate(std::min(bounds[i], bounds[i + 1]), std::max(bounds[i], bounds[i + 1]));
+				sink = static_cast<std::size_t>(sum);
+			});
+
+		// Проход — O(длины диапазона): только на малых размерах
+		if (n > 100'000)
+			return;
+		run_case(std::string("aggregate/range-sum/walk") + suffix, bounds.size() / 2, none, [&](int)
+			{
+				long long sum = 0;
+				for (std::size_t i = 0; i + 1 < bounds.size(); i += 2)
+				{
+					auto last = plain.lower_bound(std::max(bounds[i], bounds[i + 1]));
+					for (auto it = plain.lower_bound(std::min(bounds[i], bounds[i + 1])); it != last; ++it)
+						sum += it->first;
+				}
+				sink = static_cast<std::size_t>(sum);
+			});
+	}
+
+	// Снимок для изоляции чтения: копия Set — O(n) аллокаций, снимок PersistentSet — O(1).
+	// Запись после снимка: Set меняет узлы на месте, PersistentSet копирует путь
+	void bench_snapshot(std::size_t n)
+	{
+		if (!group_selected("snapshot/"))
+			return;
+
+		const std::string suffix = std::string("/") + std::to_string(n);
+		std::vector<int> keys = random_keys(n, 23);
+		std::sort(keys.begin(), keys.end());
+		keys.erase(std::unique(keys.begin(), keys.end()), keys.end());
+		const Set<int> set(sorted_unique, keys.begin(), keys.end());
+		const PersistentSet<int> persistent(sorted_unique, keys.begin(), keys.end());
+		const std::vector<int> updates = random_keys(1000, 24);
+		auto none = [] { return 0; };
+
+		run_case(std::string("snapshot/take/Set-copy") + suffix, 1, none, [&](int)
+			{
+				Set<int> copy = set;
+				sink = copy.size();
+			});
+
+		run_case(std::string("snapshot/take/PersistentSet") + suffix, 1, none, [&](int)
+			{
+				PersistentSet<int> copy = persistent.snapshot();
+				sink = copy.size();
+			});
+
+		run_case(std::string("snapshot/insert+erase/Set") + suffix, 2 * updates.size(), [&] { return set; }, [&](Set<int>& s)
+			{
+				for (int key : updates)
+					s.insert(key);
+				for (int key : updates)
+					s.erase(key);
+				sink = s.size();
+			});
+
+		run_case(std::string("snapshot/insert+erase/PersistentSet") + suffix, 2 * updates.size(), [&] { return persistent.snapshot(); }, [&](PersistentSet<int>& s)
+			{
+				for (int key : updates)
+					s.insert(key);
+				for (int key : updates)
+					s.erase(key);
+				sink = s.size();
+			});
+	}
+
+	// Пачка случайных вставок и удалений в готовое множество: по одной против WriteBatch.
+	// Маленькая пачка применяется поиском от соседнего ключа, большая — слиянием с деревом
+	void bench_write_batch(std::size_t n)
+	{
+		if (!group_selected("write-batch/"))
+			return;
+
+		std::vector<int> keys = random_keys(n, 28);
+		const Set<int> base(keys.begin(), keys.end());
+		for (std::size_t burst : { n / 100, n })
+		{
+			const std::vector<int> writes = random_keys(std::max<std::size_t>(burst, 1), 29);
+			const std::string suffix = std::string("/") + std::to_string(n) + std::string("/") + std::to_string(writes.size());
+			auto setup = [&] { return base; };
+
+			run_case("write-batch/single" + suffix, writes.size(), setup, [&](Set<int>& s)
+				{
+					for (std::size_t i = 0; i < writes.size(); ++i)
+					{
+						if (i % 4 == 0)
+							s.erase(writes[i]);
+						else
+							s.insert(writes[i]);
+					}
+					sink = s.size();
+				});
+
+			run_case("write-batch/WriteBatch" + suffix, writes.size(), setup, [&](Set<int>& s)
+				{
+					auto batch = s.batch(writes.size());
+					for (std::size_t i = 0; i < writes.size(); ++i)
+					{
+						if (i % 4 == 0)
+							batch.erase(writes[i]);
+						else
+							batch.insert(writes[i]);
+					}
+					batch.flush();
+					sink = s.size();
+				});
+		}
+	}
+
+	// Объёмные операции последовательно и на общем пуле (поток на ядро); на одном ядре они совпадают
+	void bench_parallel(std::size_t n)
+	{
+		if (!group_selected("parallel/"))
+			return;
+
+		std::vector<int> keys = random_keys(n, 25);
+		std::sort(keys.begin(), keys.end());
+		keys.erase(std::unique(keys.begin(), keys.end()), keys.end());
+		std::vector<int> others = random_keys(n, 26);
+		std::sort(others.begin(), others.end());
+		others.erase(std::unique(others.begin(), others.end()), others.end());
+		const Set<int> set(sorted_unique, keys.begin(), keys.end());
+		const Set<int> same(sorted_unique, keys.begin(), keys.end());
+		const Set<int> other(sorted_unique, others.begin(), others.end());
+		auto none = [] { return 0; };
+
+		auto run = [&](const std::string& mode, auto&& exec)
+			{
+				const std::string suffix = "/" + mode + "/" + std::to_string(n);
+				run_case("parallel/build" + suffix, keys.size(), none, [&](int)
+					{
+						Set<int> built(exec, sorted_unique, keys.begin(), keys.end());
+						sink = built.size();
+					});
+				run_case("parallel/copy" + suffix, set.size(), none, [&](int)
+					{
+						Set<int> copy(exec, set);
+						sink = copy.size();
+					});
+				run_case("parallel/equal" + suffix, set.size(), none, [&](int)
+					{
+						sink = set.equal(exec, same);
+					});
+				run_case("parallel/for_each" + suffix, set.size(), none, [&](int)
+					{
+						std::atomic<std::size_t> odd{ 0 };
+						set.for_each(exec, [&](int key) { if (key & 1) odd.fetch_add(1, std::memory_order_relaxed); });
+						sink = odd.load();
+					});
+				run_case("parallel/union" + suffix, set.size() + other.size(), none, [&](int)
+					{
+						sink = set_union(exec, set, other).size();
+					});
+				run_case("parallel/intersection" + suffix, set.size() + other.size(), none, [&](int)
+					{
+						sink = set_intersection(exec, set, other).size();
+					});
+			};
+		run("seq", std::execution::seq);
+		run("par-" + std::to_string(ThreadPool::shared().concurrency()), std::execution::par);
+	}
+
+	// Set под reader-writer мьютексом — то, чем ConcurrentSet заменяет ручную обёртку
+	class LockedSet
+	{
+	public:
+		bool contains(int key) const
+		{
+			std::shared_lock<std::shared_mutex> lock(_mutex);
+			return _set.contains(key);
+		}
+
+		bool insert(int key)
+		{
+			std::unique_lock<std::shared_mutex> lock(_mutex);
+			return _set.insert(key).second;
+		}
+
+		bool erase(int key)
+		{
+			std::unique_lock<std::shared_mutex> lock(_mutex);
+			return _set.erase(key) != 0;
+		}
+
+		std::size_t size() const
+		{
+			std::shared_lock<std::shared_mutex> lock(_mutex);
+			return _set.size();
+		}
+
+	private:
+		Set<int> _set;
+		mutable std::shared_mutex _mutex;
+	};
+
+	// Масштабирование чтения: 1, 2, 4... читателей и число ядер, один писатель всё время вставляет
+	// и удаляет. Время — на один поиск по всем читателям вместе: при линейном масштабировании оно
+	// падает вдвое с каждым удвоением читателей
+	template<typename SetType>
+	void bench_concurrent_readers(const char* label, std::size_t n)
+	{
+		const std::string prefix = std::string("concurrent/readers/") + label + "/" + std::to_string(n) + "/";
+		if (!group_selected("concurrent/"))
+			return;
+
+		const std::vector<int> keys = random_keys(n, 21);
+		const std::size_t lookups = 500'000;
+		for (unsigned readers : thread_counts())
+		{
+			const std::string name = prefix + std::to_string(readers);
+			if (!selected(name))
+				continue;
+
+			SetType set;
+			for (int key : keys)
+				set.insert(key & ~1);
+
+			std::atomic<bool> stop{ false };
+			std::thread writer([&]
+				{
+					std::mt19937 gen(22);
+					while (!stop.load(std::memory_order_relaxed))
+					{
+						int key = static_cast<int>(gen()) | 1;
+						set.insert(key);
+						set.erase(key);
+					}
+				});
+
+			run_benchmark(name.c_str(), readers * lookups, [&]
+				{
+					std::vector<std::thread> threads;
+					for (unsigned r = 0; r < readers; ++r)
+					{
+						threads.emplace_back([&, r]
+							{
+								std::size_t found = 0;
+								std::size_t i = r * 7919;
+								for (std::size_t j = 0; j < lookups; ++j, i += 104729)
+									found += set.contains(keys[i % keys.size()]);
+								sink = found;
+							});
+					}
+					for (auto& thread : threads)
+						thread.join();
+				});
+
+			stop = true;
+			writer.join();
+		}
+	}
+
+	// Масштабирование записи: 1, 2, 4... потоков и число ядер вставляют поровну случайных ключей
+	// в пустое множество. Время — на одну вставку по всем потокам вместе
+	template<typename SetType>
+	void bench_concurrent_ingest(const char* label, std::size_t n)
+	{
+		const std::string prefix = std::string("sharded/ingest/") + label + "/" + std::to_string(n) + "/";
+		if (!group_selected("sharded/"))
+			return;
+
+		const std::vector<int> keys = random_keys(n, 27);
+		for (unsigned writers : thread_counts())
+		{
+			const std::string name = prefix + std::to_string(writers);
+			if (!selected(name))
+				continue;
+
+			run_benchmark(name.c_str(), keys.size(), [&]
+				{
+					SetType set;
+					std::vector<std::thread> threads;
+					for (unsigned w = 0; w < writers; ++w)
+					{
+						threads.emplace_back([&, w]
+							{
+								for (std::size_t i = w; i < keys.size(); i += writers)
+									set.insert(keys[i]);
+							});
+					}
+					for (auto& thread : threads)
+						thread.join();
+					sink = set.size();
+				});
+		}
+	}
+
+	// Собрали один раз — много раз ищем: дерево против замороженного отсортированного массива
+	void bench_read_mostly(std::size_t n)
+	{
+		if (!group_selected("read-mostly/"))
+			return;
+
+		const std::string suffix = std::string("/") + std::to_string(n);
+		auto name = [&](const char* scenario) { return std::string("read-mostly/") + scenario + suffix; };
+
+		std::vector<int> keys = random_keys(n, 42);
+		for (int& key : keys)
+			key &= ~1;
+		std::vector<int> shuffled = keys;
+		std::shuffle(shuffled.begin(), shuffled.end(), std::mt19937(7));
+		const std::size_t lookups = std::min<std::size_t>(n, 1'000'000);
+
+		const Set<int> set(keys.begin(), keys.end());
+		auto none = [] { return 0; };
+
+		run_case(name("freeze"), set.size(), none, [&](int)
+			{
+				FlatSet<int> flat(set);
+				sink = flat.size();
+			});
+
+		run_case(name("freeze/FrozenSet"), set.size(), none, [&](int)
+			{
+				FrozenSet<int> frozen(set);
+				sink = frozen.size();
+			});
+
+		run_case(name("batch-build"), keys.size(), none, [&](int)
+			{
+				FlatSet<int> flat;
+				flat.insert(keys.begin(), keys.end());
+				sink = flat.size();
+			});
+
+		const FlatSet<int> flat(set);
+		run_case(name("thaw"), flat.size(), none, [&](int)
+			{
+				sink = flat.to_set().size();
+			});
+
+		run_case(name("find-hit/Set"), lookups, none, [&](int)
+			{
+				std::size_t found = 0;
+				for (std::size_t i = 0; i < lookups; ++i)
+					found += set.contains(shuffled[i]);
+				sink = found;
+			});
+
+		run_case(name("find-hit/FlatSet"), lookups, none, [&](int)
+			{
+				std::size_t found = 0;
+				for (std::size_t i = 0; i < lookups; ++i)
+					found += flat.contains(shuffled[i]);
+				sink = found;
+			});
+
+		const FrozenSet<int> frozen(set);
+		run_case(name("find-hit/FrozenSet"), lookups, none, [&](int)
+			{
+				std::size_t found = 0;
+				for (std::size_t i = 0; i < lookups; ++i)
+					found += frozen.contains(shuffled[i]);
+				sink = found;
+			});
+
+		// Все ключи чётные: нечётный гарантированно отсутствует
+		run_case(name("find-miss/FlatSet"), lookups, none, [&](int)
+			{
+				std::size_t found = 0;
+				for (std::size_t i = 0; i < lookups; ++i)
+					found += flat.contains(shuffled[i] | 1);
+				sink = found;
+			});
+
+		run_case(name("find-miss/FrozenSet"), lookups, none, [&](int)
+			{
+				std::size_t found = 0;
+				for (std::size_t i = 0; i < lookups; ++i)
+					found += frozen.contains(shuffled[i] | 1);
+				sink = found;
+			});
+	}
+
+	// Удаление старого ключа и вставка нового на каждом шаге — типичная нагрузка на аллокатор
+	template<typename SetType>
+	void bench_churn(const char* name, std::size_t n, std::size_t rounds)
+	{
+		auto keys = random_keys(n + rounds, 1);
+		SetType s;
+		for (std::size_t i = 0; i < n; ++i)
+			s.insert(keys[i]);
+
+		run_benchmark(name, rounds, [&]
+			{
+				for (std::size_t i = 0; i < rounds; ++i)
+				{
+					s.erase(keys[i]);
+					s.insert(keys[n + i]);
+				}
+			});
+		sink = s.size();
+	}
+
+	// Заполнение и полная очистка
+	template<typename SetType>
+	void bench_fill_clear(const char* name, std::size_t n, std::size_t rounds)
+	{
+		auto keys = random_keys(n, 2);
+		SetType s;
+
+		run_benchmark(name, n * rounds, [&]
+			{
+				for (std::size_t r = 0; r < rounds; ++r)
+				{
+					for (int key : keys)
+						s.insert(key);
+					sink = s.size();
+					s.clear();
+				}
+			});
+	}
+
+	// Построение из упорядоченного снимка: поэлементная вставка против сборки за O(n)
+	void bench_sorted_build(std::size_t n)
+	{
+		std::vector<int> keys(n);
+		std::iota(keys.begin(), keys.end(), 0);
+
+		run_benchmark("build-sorted/insert-loop", n, [&]
+			{
+				Set<int> s;
+				for (int key : keys)
+					s.insert(key);
+				sink = s.size();
+			});
+
+		run_benchmark("build-sorted/range-ctor", n, [&]
+			{
+				Set<int> s(keys.begin(), keys.end());
+				sink = s.size();
+			});
+
+		Set<int> s(keys.begin(), keys.end());
+		run_benchmark("build-sorted/assign-reuse", n, [&]
+			{
+				s.assign(sorted_unique, keys.begin(), keys.end());
+				sink = s.size();
+			});
+	}
+
+	void bench_copy(std::size_t n)
+	{
+		auto keys = random_keys(n, 3);
+		Set<int> source(keys.begin(), keys.end());
+
+		run_benchmark("copy/construct", source.size(), [&]
+			{
+				Set<int> copy(source);
+				sink = copy.size();
+			});
+
+		Set<int> target(source);
+		run_benchmark("copy/assign-reuse", source.size(), [&]
+			{
+				target = source;
+				sink = target.size();
+			});
+	}
+
+	// Вставка в непустое множество упорядоченных и почти упорядоченных ключей
+	void bench_hinted_insert(const char* label, const std::vector<int>& keys)
+	{
+		std::string name = std::string("hint/") + label;
+
+		run_benchmark((name + "/no-hint").c_str(), keys.size(), [&]
+			{
+				Set<int> s = { -1 };
+				for (int key : keys)
+					s.insert(key);
+				sink = s.size();
+			});
+
+		run_benchmark((name + "/hint-end").c_str(), keys.size(), [&]
+			{
+				Set<int> s = { -1 };
+				for (int key : keys)
+					s.insert(s.end(), key);
+				sink = s.size();
+			});
+
+		run_benchmark((name + "/range").c_str(), keys.size(), [&]
+			{
+				Set<int> s = { -1 };
+				s.insert(keys.begin(), keys.end());
+				sink = s.size();
+			});
+	}
+
+	// Удаление на ходу: каждый второй элемент
+	void bench_erase_while_iterating(std::size_t n)
+	{
+		auto keys = random_keys(n, 5);
+		Set<int> source(keys.begin(), keys.end());
+
+		Set<int> by_key(source);
+		run_benchmark("erase-scan/by-key", source.size() / 2, [&]
+			{
+				bool odd = false;
+				for (auto it = by_key.begin(); it != by_key.end();)
+				{
+					auto current = it++;
+					if ((odd = !odd))
+						by_key.erase(current->first);
+				}
+			});
+
+		Set<int> by_iterator(source);
+		run_benchmark("erase-scan/by-iterator", source.size() / 2, [&]
+			{
+				bool odd = false;
+				for (auto it = by_iterator.begin(); it != by_iterator.end();)
+					it = (odd = !odd) ? by_iterator.erase(it) : std::next(it);
+			});
+		sink = by_key.size() + by_iterator.size();
+	}
+
+	// Полный обход: итераторы против посетителя с встроенным вызовом
+	void bench_full_scan(std::size_t n)
+	{
+		auto keys = random_keys(n, 6);
+		RedBlackTree<int> tree;
+		for (int key : keys)
+			tree.insert(key);
+
+		run_benchmark("scan/iterator", tree.size(), [&]
+			{
+				std::size_t sum = 0;
+				for (const auto& value : tree)
+					sum += static_cast<std::size_t>(value.first);
+				sink = sum;
+			});
+
+		run_benchmark("scan/inorder-visitor", tree.size(), [&]
+			{
+				std::size_t sum = 0;
+				tree.inorder([&](const auto& value) { sum += static_cast<std::size_t>(value.first); });
+				sink = sum;
+			});
+
+		run_benchmark("scan/levelorder-visitor", tree.size(), [&]
+			{
+				std::size_t sum = 0;
+				tree.levelorder([&](const auto& value) { sum += static_cast<std::size_t>(value.first); });
+				sink = sum;
+			});
+
+		run_benchmark("scan/height", tree.size(), [&]
+			{
+				sink = tree.height();
+			});
+	}
+}
+
+int main(int argc, char** argv)
+{
+	for (int i = 1; i < argc; ++i)
+	{
+		std::string arg = argv[i];
+		if (arg.rfind("--filter=", 0) == 0)
+			options.filter = arg.substr(9);
+		else if (arg.rfind("--max-size=", 0) == 0)
+			options.max_size = std::strtoull(arg.c_str() + 11, nullptr, 10);
+		else if (arg.rfind("--repetitions=", 0) == 0)
+			options.repetitions = std::max(1, std::atoi(arg.c_str() + 14));
+		else
+		{
+			std::fprintf(stderr, "usage: %s [--filter=substring] [--max-size=N] [--repetitions=N]\n", argv[0]);
+			return 1;
+		}
+	}
+
+	for (std::size_t n = 1'000; n <= options.max_size; n *= 10)
+	{
+		bench_suite<Set<int>>(n);
+		bench_suite<Set<int, std::less<int>, std::allocator<int>, BTreeBackend<>>>(n);
+		bench_suite<Set<int, std::less<int>, std::allocator<int>, OrderStatisticsBackend>>(n);
+		bench_suite<std::set<int>>(n);
+#ifdef SET_BENCH_WITH_ABSL
+		bench_suite<absl::btree_set<int>>(n);
+#endif
+		bench_read_mostly(n);
+		bench_set_algebra<Set<int>>(n);
+		bench_set_algebra<Set<int, std::less<int>, std::allocator<int>, BTreeBackend<>>>(n);
+		bench_split_join<Set<int>>(n);
+		bench_split_join<Set<int, std::less<int>, std::allocator<int>, BTreeBackend<>>>(n);
+		bench_order_statistics<Set<int, std::less<int>, std::allocator<int>, OrderStatisticsBackend>>(n);
+		// Без размеров поддеревьев каждый запрос — O(n): только на малых размерах
+		if (n <= 100'000)
+			bench_order_statistics<Set<int>>(n);
+		bench_range_aggregate(n);
+		bench_snapshot(n);
+		bench_parallel(n);
+		bench_write_batch(n);
+		bench_concurrent_readers<ConcurrentSet<int>>("ConcurrentSet", n);
+		bench_concurrent_readers<LockedSet>("Set+shared_mutex", n);
+		bench_concurrent_ingest<ShardedSet<int>>("ShardedSet", n);
+		bench_concurrent_ingest<ConcurrentSet<int>>("ConcurrentSet", n);
+		bench_concurrent_ingest<LockedSet>("Set+shared_mutex", n);
+	}
+
+	// Отдельные свойства дерева: пул, построение, подсказки, обходы
+	using HeapSet = Set<int>;
+	using PooledSet = Set<int, std::less<int>, PoolAllocator<int>>;
+
+	const std::size_t n = std::min<std::size_t>(options.max_size, 1'000'000);
+
+	if (group_selected("churn/"))
+	{
+		bench_churn<HeapSet>("churn/new-delete", n, n);
+		bench_churn<PooledSet>("churn/pool", n, n);
+	}
+
+	if (group_selected("fill+clear/"))
+	{
+		bench_fill_clear<HeapSet>("fill+clear/new-delete", n, 3);
+		bench_fill_clear<PooledSet>("fill+clear/pool", n, 3);
+	}
+
+	if (group_selected("build-sorted/"))
+		bench_sorted_build(n);
+	if (group_selected("copy/"))
+		bench_copy(n);
+
+	if (group_selected("hint/"))
+	{
+		std::vector<int> sorted(n);
+		std::iota(sorted.begin(), sorted.end(), 0);
+		bench_hinted_insert("sorted", sorted);
+
+		std::vector<int> nearly_sorted = sorted;
+		std::mt19937 gen(4);
+		for (std::size_t i = 0; i < n / 100; ++i)
+			std::swap(nearly_sorted[gen() % n], nearly_sorted[gen() % n]);
+		bench_hinted_insert("nearly-sorted", nearly_sorted);
+	}
+
+	if (group_selected("erase-scan/"))
+		bench_erase_while_iterating(n);
+	if (group_selected("scan/"))
+		bench_full_scan(n);
+
+	return 0;
+}
@@ -1,6 +1,93 @@
+#include <atomic>
 #include <cassert>
+#include <cstdint>
 #include <iostream>
+#include <memory>
+#include <numeric>
+#include <optional>
+#include <random>
+#include <set>
+#include <span>
+#include <stdexcept>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
 #include "Set.h"
+#include "ExecutionPolicy.h"
+#include "NodePool.h"
+#include "BTree.h"
+#include "FlatSet.h"
+#include "FrozenSet.h"
+#include "ConcurrentSet.h"
+#include "PersistentSet.h"
+#include "ShardedSet.h"
+#include "SimdSearch.h"
+
+std::size_t g_allocations = 0;
+
+template<typename T>
+struct CountingAllocator
+{
+	using value_type = T;
+
+	CountingAllocator() = default;
+
+	template<typename U>
+	CountingAllocator(const CountingAllocator<U>&) {}
+
+	T* allocate(std::size_t n)
+	{
+		++g_allocations;
+		return std::allocator<T>().allocate(n);
+	}
+
+	void deallocate(T* p, std::size_t n)
+	{
+		std::allocator<T>().deallocate(p, n);
+	}
+
+	template<typename U>
+	bool operator==(const CountingAllocator<U>&) const { return true; }
+
+	template<typename U>
+	bool operator!=(const CountingAllocator<U>&) const { return false; }
+};
+
+// ,      :    id  
+template<typename T>
+struct TaggedAllocator
+{
+	using value_type = T;
+	using propagate_on_container_move_assignment = std::false_type;
+	using is_always_equal = std::false_type;
+
+	int id = 0;
+
+	TaggedAllocator() = default;
+	explicit TaggedAllocator(int id) : id(id) {}
+
+	template<typename U>
+	TaggedAllocator(const TaggedAllocator<U>& other) : id(other.id) {}
+
+	T* allocate(std::size_t n)
+	{
+		++g_allocations;
+		return std::allocator<T>().allocate(n);
+	}
+
+	void deallocate(T* p, std::size_t n)
+	{
+		std::allocator<T>().deallocate(p, n);
+	}
+
+	template<typename U>
+	bool operator==(const TaggedAllocator<U>& other) const { return id == other.id; }
+
+	template<typename U>
+	bool operator!=(const TaggedAllocator<U>& other) const { return id != other.id; }
+};
 
 void test_insert_and_contains()
 {
@@ -81,6 +168,1667 @@ void test_equal_operator()
 	assert(a != c);
 }
 
+void test_pool_allocator()
+{
+	using PooledSet = Set<int, std::less<int>, PoolAllocator<int>>;
+	PooledSet s;
+	for (int i = 0; i < 1000; ++i)
+		s.insert(i);
+	for (int i = 0; i < 1000; i += 2)
+		s.erase(i);
+	for (int i = 0; i < 1000; i += 2)
+		s.insert(i);
+
+	assert(s.size() == 1000);
+	int expected = 0;
+	for (const auto& pair : s)
+		assert(pair.first == expected++);
+
+	PooledSet copy = s;
+	s.clear();
+	assert(s.empty());
+	assert(copy.size() == 1000);
+	assert(copy.contains(999));
+
+	s.insert(42);
+	assert(s.contains(42) && s.size() == 1);
+	assert(copy.get_allocator() != s.get_allocator());
+
+	//           
+	using Tree = RedBlackTree<std::string, int, std::less<std::string>, false, TaggedAllocator<KeyValuePair<const std::string, int>>>;
+	static_assert(std::is_nothrow_move_assignable<RedBlackTree<int, int>>::value);
+	static_assert(std::is_nothrow_move_assignable<Set<int, std::less<int>, PoolAllocator<int>>>::value);
+	static_assert(!std::is_nothrow_move_assignable<Tree>::value);
+	Tree source(std::less<std::string>(), TaggedAllocator<KeyValuePair<const std::string, int>>(1));
+	for (int i = 0; i < 100; ++i)
+		source.insert({ std::string("key") + std::to_string(1000 + i), i });
+	Tree target(std::less<std::string>(), TaggedAllocator<KeyValuePair<const std::string, int>>(2));
+	target.insert({ "old", 0 });
+	std::size_t before = g_allocations;
+	target = std::move(source);
+	assert(g_allocations == before + 100 && source.empty() && target.is_valid() && target.size() == 100);
+	assert(target.begin()->first == "key1000" && std::prev(target.end())->second == 99);
+	assert(target.get_allocator().id == 2);
+}
+
+void test_duplicate_insert_does_not_allocate()
+{
+	Set<int, std::less<int>, CountingAllocator<int>> s;
+	for (int i = 0; i < 100; ++i)
+		s.insert(i);
+
+	std::size_t before = g_allocations;
+	for (int i = 0; i < 100; ++i)
+	{
+		assert(!s.insert(i).second);
+		assert(!s.emplace(i).second);
+		assert(!s.try_emplace(i).second);
+	}
+	assert(g_allocations == before);
+
+	assert(s.emplace(100).second);
+	assert(g_allocations == before + 1);
+
+	Set<std::string, std::less<>> strings;
+	assert(strings.try_emplace("abc").second);
+	assert(!strings.try_emplace("abc").second);
+	assert(!strings.emplace("abc").second);
+	assert(strings.size() == 1);
+}
+
+void test_sorted_bulk_build()
+{
+	for (int n = 0; n < 70; ++n)
+	{
+		std::vector<int> keys(n);
+		std::iota(keys.begin(), keys.end(), 0);
+		RedBlackTree<int> tree(sorted_unique, keys.begin(), keys.end());
+		assert(tree.is_valid());
+		assert(tree.size() == static_cast<std::size_t>(n));
+	}
+
+	std::vector<int> keys(1000);
+	std::iota(keys.begin(), keys.end(), 0);
+
+	Set<int> detected(keys.begin(), keys.end());
+	Set<int> tagged(sorted_unique, keys.begin(), keys.end());
+	assert(detected.size() == 1000);
+	assert(detected == tagged);
+
+	tagged.insert(5000);
+	tagged.erase(10);
+	assert(tagged.contains(5000) && !tagged.contains(10) && tagged.contains(999));
+
+	std::istringstream input("1 3 5 7");
+	Set<int> streamed(sorted_unique, std::istream_iterator<int>(input), std::istream_iterator<int>());
+	assert(streamed == Set<int>({ 1, 3, 5, 7 }));
+
+	std::vector<int> unsorted = { 5, 1, 4, 1, 3 };
+	detected.assign(unsorted.begin(), unsorted.end());
+	assert(detected == Set<int>({ 1, 3, 4, 5 }));
+	detected.assign(keys.begin(), keys.begin() + 10);
+	assert(detected.size() == 10 && detected.contains(9) && !detected.contains(10));
+}
+
+void test_structural_copy()
+{
+	RedBlackTree<int> tree;
+	for (int i = 0; i < 1000; ++i)
+		tree.insert((i * 7919) % 1000);
+
+	RedBlackTree<int> copy(tree);
+	assert(copy.is_valid());
+	assert(copy == tree);
+	assert(copy.height() == tree.height());
+	assert(copy.levelorder() == tree.levelorder());
+
+	using CountingSet = Set<int, std::less<int>, CountingAllocator<int>>;
+	CountingSet source;
+	CountingSet target;
+	for (int i = 0; i < 1000; ++i)
+	{
+		source.insert(i);
+		target.insert(-i);
+	}
+
+	std::size_t before = g_allocations;
+	target = source;
+	assert(g_allocations == before);
+	assert(target == source);
+
+	CountingSet small = { 1, 2, 3 };
+	before = g_allocations;
+	small = source;
+	assert(g_allocations == before + 997);
+	assert(small == source);
+
+	small = CountingSet{ 42 };
+	assert(small.size() == 1 && small.contains(42));
+}
+
+void test_hinted_insert()
+{
+	Set<int> s;
+	for (int i = 0; i < 1000; ++i)
+		s.insert(s.end(), i);
+	assert(s.size() == 1000);
+
+	auto it = s.insert(s.find(500), 500);
+	assert(*it == *s.find(500));
+	assert(s.size() == 1000);
+
+	//     
+	s.insert(s.begin(), 2000);
+	s.emplace_hint(s.end(), -1);
+	assert(s.contains(2000) && s.contains(-1));
+	assert(s.begin()->first == -1);
+
+	std::vector<int> nearly_sorted;
+	for (int i = 0; i < 1000; ++i)
+		nearly_sorted.push_back(i % 10 == 0 ? 1000 - i : i + 3000);
+	Set<int> merged = { 3500, 3999 };
+	merged.insert(nearly_sorted.begin(), nearly_sorted.end());
+
+	RedBlackTree<int> tree({ 3500, 3999 });
+	tree.insert(nearly_sorted.begin(), nearly_sorted.end());
+	assert(tree.is_valid());
+	assert(merged.size() == tree.size());
+	int prev = -1;
+	for (const auto& pair : merged)
+	{
+		assert(pair.first > prev);
+		prev = pair.first;
+	}
+}
+
+void test_node_handles()
+{
+	using CountingSet = Set<std::string, std::less<std::string>, CountingAllocator<std::string>>;
+	CountingSet a = { "apple", "banana", "cherry" };
+	CountingSet b = { "banana", "date" };
+
+	std::size_t before = g_allocations;
+
+	auto node = a.extract("apple");
+	assert(node && node.key() == "apple");
+	assert(!a.contains("apple"));
+
+	node.key() = "avocado";
+	auto result = b.insert(std::move(node));
+	assert(result.inserted && !result.node);
+	assert(result.position->first == "avocado");
+
+	auto duplicate = b.insert(a.extract(a.find("banana")));
+	assert(!duplicate.inserted && duplicate.node);
+	assert(duplicate.node.key() == "banana");
+	a.insert(a.end(), std::move(duplicate.node));
+
+	assert(!a.extract("missing"));
+
+	a.merge(b);
+	assert(g_allocations == before);
+	assert(a == CountingSet({ "avocado", "banana", "cherry", "date" }));
+	assert(b == CountingSet({ "banana" }));
+
+	RedBlackTree<int> left;
+	RedBlackTree<int> right;
+	for (int i = 0; i < 500; ++i)
+		(i % 3 ? left : right).insert(i);
+	left.merge(right);
+	assert(left.is_valid() && right.is_valid());
+	assert(left.size() == 500 && right.empty());
+}
+
+void test_erase_by_iterator()
+{
+	Set<int> s;
+	for (int i = 0; i < 100; ++i)
+		s.insert(i);
+
+	//   ,     TTL
+	for (auto it = s.begin(); it != s.end();)
+	{
+		if (it->first % 2 == 0)
+			it = s.erase(it);
+		else
+			++it;
+	}
+	assert(s.size() == 50 && !s.contains(10) && s.contains(11));
+
+	auto next = s.erase(s.find(11), s.find(21));
+	assert(next->first == 21);
+	assert(s.size() == 45 && !s.contains(15));
+
+	for (int n : { 1, 2, 10, 100, 257 })
+	{
+		for (int from = 0; from <= n; from += 1 + n / 7)
+		{
+			for (int to = from; to <= n; to += 1 + n / 5)
+			{
+				RedBlackTree<int> tree;
+				for (int i = 0; i < n; ++i)
+					tree.insert(i);
+				auto result = tree.erase(tree.lower_bound(from), tree.lower_bound(to));
+				assert(tree.is_valid());
+				assert(tree.size() == static_cast<std::size_t>(n - (to - from)));
+				assert(result == tree.lower_bound(to));
+				assert(!tree.contains(from) || from == to);
+			}
+		}
+	}
+
+	s.erase(s.begin(), s.end());
+	assert(s.empty());
+}
+
+void test_compact_node_layout()
+{
+	//  +  :      ,     
+	static_assert(RedBlackTree<std::uint64_t>::node_size() == sizeof(std::uint64_t) + 3 * sizeof(void*));
+	static_assert(RedBlackTree<int>::node_size() <= RedBlackTree<std::uint64_t>::node_size());
+	static_assert(sizeof(RedBlackTree<int>::value_type) == sizeof(int));
+	static_assert(RedBlackTree<int, int>::node_size() == RedBlackTree<std::uint64_t>::node_size());
+
+	RedBlackTree<int> tree;
+	for (int i = 0; i < 2000; ++i)
+		tree.insert((i * 7919) % 2000);
+	for (int i = 0; i < 2000; i += 3)
+		tree.erase(i);
+	assert(tree.is_valid());
+	assert(tree.size() == 2000 - 667);
+
+	RedBlackTree<int, std::string> map;
+	map.insert(std::make_pair(2, std::string("two")));
+	map.emplace(std::piecewise_construct, std::forward_as_tuple(1), std::forward_as_tuple(3, 'a'));
+	map.insert({ 3, "three" });
+	assert(map.find(1)->second == "aaa");
+	assert(map.find(2)->second == "two");
+	std::pair<int, std::string> copy = *map.find(3);
+	assert(copy.first == 3 && copy.second == "three");
+}
+
+void test_iterative_traversals()
+{
+	std::vector<int> keys = { 1, 2, 3, 4, 5, 6, 7 };
+	RedBlackTree<int> tree(sorted_unique, keys.begin(), keys.end());
+
+	std::vector<int> order;
+	tree.inorder([&](const auto& value) { order.push_back(value.first); });
+	assert(order == keys);
+
+	order.clear();
+	tree.preorder([&](const auto& value) { order.push_back(value.first); });
+	assert(order == std::vector<int>({ 4, 2, 1, 3, 6, 5, 7 }));
+
+	order.clear();
+	tree.postorder([&](const auto& value) { order.push_back(value.first); });
+	assert(order == std::vector<int>({ 1, 3, 2, 5, 7, 6, 4 }));
+
+	order.clear();
+	tree.levelorder([&](const auto& value) { order.push_back(value.first); });
+	assert(order == std::vector<int>({ 4, 2, 6, 1, 3, 5, 7 }));
+	assert(tree.height() == 3);
+
+	//    ,     
+	RedBlackTree<int> big;
+	for (int i = 0; i < 10000; ++i)
+		big.insert((i * 7919) % 10007);
+	std::size_t pre = 0, post = 0, level = 0;
+	long sum = 0;
+	big.preorder([&](const auto&) { ++pre; });
+	big.postorder([&](const auto& value) { ++post; sum += value.first; });
+	big.levelorder([&](const auto&) { ++level; });
+	assert(pre == big.size() && post == big.size() && level == big.size());
+	assert(big.inorder().size() == big.size());
+	assert(sum == std::accumulate(big.begin(), big.end(), 0L, [](long acc, const auto& value) { return acc + value.first; }));
+	assert(big.height() >= 14 && big.height() <= 28);
+
+	// std::function -   
+	std::function<void(const RedBlackTree<int>::value_type&)> counter = [&](const auto&) { ++pre; };
+	big.inorder(counter);
+	assert(pre == 2 * big.size());
+
+	big.clear();
+	assert(big.empty() && big.height() == 0);
+	big.inorder([](const auto&) { assert(false); });
+}
+
+void test_btree_backend()
+{
+	//  ,        
+	using SmallTree = BTree<int, std::less<int>, std::allocator<int>, 64>;
+	SmallTree tree;
+	std::set<int> reference;
+	std::mt19937 gen(17);
+	for (int step = 0; step < 20000; ++step)
+	{
+		int key = static_cast<int>(gen() % 2000);
+		if (gen() % 3)
+			assert(tree.try_emplace(key).second == reference.insert(key).second);
+		else
+			assert(tree.erase(key) == reference.erase(key));
+		if (step % 500 == 0)
+			assert(tree.is_valid());
+	}
+	assert(tree.is_valid() && tree.size() == reference.size());
+	assert(std::equal(tree.begin(), tree.end(), reference.begin(), reference.end(),
+		[](const auto& value, int key) { return value.first == key; }));
+
+	for (int key : { -1, 0, 999, 1000, 1999, 2000 })
+	{
+		auto it = tree.lower_bound(key);
+		auto expected = reference.lower_bound(key);
+		assert(it == tree.end() ? expected == reference.end() : it->first == *expected);
+		assert(tree.contains(key) == (reference.count(key) == 1));
+	}
+
+	//     ,     
+	for (auto it = tree.begin(); it != tree.end();)
+		it = (it->first % 3 == 0) ? tree.erase(it) : std::next(it);
+	assert(tree.is_valid());
+	assert(std::all_of(tree.begin(), tree.end(), [](const auto& value) { return value.first % 3 != 0; }));
+
+	auto first = tree.lower_bound(500);
+	auto removed = std::distance(first, tree.lower_bound(1500));
+	std::size_t before = tree.size();
+	auto next = tree.erase(first, tree.lower_bound(1500));
+	assert(tree.is_valid() && tree.size() == before - static_cast<std::size_t>(removed));
+	assert(next == tree.end() || next->first >= 1500);
+
+	//    Set  B-
+	using BSet = Set<int, std::less<int>, std::allocator<int>, BTreeBackend<>>;
+	std::vector<int> keys(100000);
+	std::iota(keys.begin(), keys.end(), 0);
+	BSet s(keys.begin(), keys.end());
+	assert(s.size() == keys.size() && s.contains(99999) && !s.contains(100000));
+	assert(s.equal_range(42).first->first == 42 && s.equal_range(42).second->first == 43);
+	assert(s.upper_bound(99999) == s.end());
+	assert(std::prev(s.end())->first == 99999 && s.rbegin()->first == 99999);
+
+	BSet copy = s;
+	for (int key = 0; key < 100000; key += 2)
+		copy.erase(key);
+	assert(copy.size() == 50000 && s.size() == 100000);
+	copy.insert(copy.end(), 4);
+	assert(copy.contains(4) && copy != s);
+
+	BSet moved = std::move(copy);
+	assert(moved.size() == 50001 && copy.empty());
+	assert(BSet({ 3, 1, 2 }) == BSet({ 1, 2, 3 }));
+
+	//  B-     - 
+	BTree<std::uint64_t> wide;
+	std::mt19937_64 gen64(5);
+	for (int i = 0; i < 100000; ++i)
+		wide.try_emplace(gen64());
+	assert(wide.is_valid());
+	assert(wide.memory_usage() < wide.size() * RedBlackTree<std::uint64_t>::node_size() / 2);
+
+	std::vector<std::uint64_t> sorted(100000);
+	std::iota(sorted.begin(), sorted.end(), 0);
+	BTree<std::uint64_t> packed(sorted_unique, sorted.begin(), sorted.end());
+	assert(packed.is_valid() && packed.size() == sorted.size());
+	assert(packed.memory_usage() < packed.size() * RedBlackTree<std::uint64_t>::node_size() / 3);
+
+	using PooledBSet = Set<int, std::less<int>, PoolAllocator<int>, BTreeBackend<>>;
+	PooledBSet pooled;
+	for (int i = 0; i < 1000; ++i)
+		pooled.insert(i);
+	pooled.clear();
+	assert(pooled.empty() && pooled.get_allocator().in_use() == 0);
+}
+
+// ,   ,    g_copies_left (   )
+int g_copies_left = -1;
+
+struct ThrowingKey
+{
+	int value;
+
+	ThrowingKey(int value) : value(value) {}
+
+	ThrowingKey(const ThrowingKey& other) : value(other.value)
+	{
+		if (g_copies_left == 0)
+			throw std::runtime_error("copy");
+		if (g_copies_left > 0)
+			--g_copies_left;
+	}
+
+	ThrowingKey(ThrowingKey&&) noexcept = default;
+	ThrowingKey& operator=(const ThrowingKey&) = default;
+	ThrowingKey& operator=(ThrowingKey&&) noexcept = default;
+
+	bool operator<(const ThrowingKey& other) const { return value < other.value; }
+};
+
+//   :     
+struct DirectedLess
+{
+	bool descending = false;
+
+	bool operator()(int lhs, int rhs) const { return descending ? rhs < lhs : lhs < rhs; }
+};
+
+void test_flat_set()
+{
+	FlatSet<int> flat = { 5, 1, 3 };
+	assert(flat.size() == 3 && flat.begin()->first == 1);
+	assert(!flat.insert(3).second && flat.insert(4).second);
+
+	//           
+	std::vector<int> batch = { 9, 2, 4, 9, 0, 7 };
+	flat.insert(batch.begin(), batch.end());
+	std::vector<int> keys;
+	for (const auto& value : flat)
+		keys.push_back(value.first);
+	assert(keys == std::vector<int>({ 0, 1, 2, 3, 4, 5, 7, 9 }));
+
+	assert(flat.contains(7) && !flat.contains(6));
+	assert(flat.find(6) == flat.end() && flat.find(7)->first == 7);
+	assert(flat.lower_bound(6)->first == 7 && flat.upper_bound(7)->first == 9);
+	assert(flat.equal_range(6).first == flat.equal_range(6).second);
+	assert(std::distance(flat.equal_range(5).first, flat.equal_range(5).second) == 1);
+
+	assert(flat.erase(5) == 1 && flat.erase(5) == 0);
+	auto next = flat.erase(flat.find(0));
+	assert(next->first == 1);
+	assert(flat.insert(flat.end(), 10)->first == 10);
+	assert(flat.insert(flat.begin(), 8)->first == 8);
+
+	//  Set  ,   
+	Set<int> set;
+	for (int i = 0; i < 1000; ++i)
+		set.insert((i * 37) % 1000);
+	FlatSet<int> frozen(set);
+	assert(frozen.size() == set.size());
+	assert(std::equal(frozen.begin(), frozen.end(), set.begin(),
+		[](const auto& lhs, const auto& rhs) { return lhs.first == rhs.first; }));
+	assert(frozen.to_set() == set);
+
+	using BSet = Set<int, std::less<int>, std::allocator<int>, BTreeBackend<>>;
+	BSet bset(frozen.begin(), frozen.end());
+	assert(FlatSet<int>(bset) == frozen);
+	assert(frozen.to_set<BSet>() == bset);
+
+	FlatSet<int> other(sorted_unique, keys.begin(), keys.end());
+	assert(other != frozen && other.size() == keys.size());
+
+	//     :   ,  - 
+	FlatSet<ThrowingKey> fragile = { 2, 4, 6, 8 };
+	const std::vector<ThrowingKey> more = { 9, 1, 5, 3 };
+	g_copies_left = 2;
+	bool thrown = false;
+	try
+	{
+		fragile.insert(more.begin(), more.end());
+	}
+	catch (const std::runtime_error&)
+	{
+		thrown = true;
+	}
+	g_copies_left = -1;
+	assert(thrown && fragile.size() == 4);
+	assert(fragile.contains(2) && fragile.contains(8) && !fragile.contains(9) && !fragile.contains(1));
+	assert(fragile.lower_bound(5)->first.value == 6);
+
+	//    Set     
+	Set<int, DirectedLess> descending(DirectedLess{ true });
+	for (int i = 0; i < 100; ++i)
+		descending.insert(i);
+	FlatSet<int, DirectedLess> flat_descending(descending);
+	assert(flat_descending.begin()->first == 99 && flat_descending.contains(0) && flat_descending.contains(42));
+	assert(flat_descending.to_set() == descending);
+}
+
+void test_frozen_set()
+{
+	FrozenSet<int> empty;
+	assert(empty.empty() && empty.begin() == empty.end());
+	assert(!empty.contains(1) && empty.lower_bound(1) == empty.end());
+
+	//        :   lower_bound - 
+	for (int n = 1; n <= 70; ++n)
+	{
+		Set<int> set;
+		for (int i = 0; i < n; ++i)
+			set.insert(2 * i);
+		FrozenSet<int> frozen(set);
+		assert(frozen.size() == set.size());
+		assert(std::equal(frozen.begin(), frozen.end(), set.begin(), set.end(),
+			[](const auto& lhs, const auto& rhs) { return lhs.first == rhs.first; }));
+		assert(std::equal(frozen.rbegin(), frozen.rend(), set.rbegin(), set.rend(),
+			[](const auto& lhs, const auto& rhs) { return lhs.first == rhs.first; }));
+
+		for (int key = -1; key <= 2 * n; ++key)
+		{
+			auto expected = set.lower_bound(key);
+			auto actual = frozen.lower_bound(key);
+			assert((expected == set.end()) == (actual == frozen.end()));
+			assert(actual == frozen.end() || actual->first == expected->first);
+
+			auto expected_upper = set.upper_bound(key);
+			auto actual_upper = frozen.upper_bound(key);
+			assert((expected_upper == set.end()) == (actual_upper == frozen.end()));
+			assert(actual_upper == frozen.end() || actual_upper->first == expected_upper->first);
+
+			assert(frozen.contains(key) == set.contains(key));
+		}
+	}
+
+	//    ,   
+	std::vector<std::string> words = { "alpha", "beta", "delta", "gamma", "omega" };
+	FrozenSet<std::string> frozen(sorted_unique, words.begin(), words.end());
+	assert(frozen.contains("delta") && !frozen.contains("epsilon"));
+	assert(frozen.lower_bound("epsilon")->first == "gamma");
+	FrozenSet<std::string> copy = frozen;
+	assert(copy == frozen);
+	FrozenSet<std::string> moved = std::move(copy);
+	assert(moved == frozen && copy.empty());
+
+	std::istringstream input("1 3 5");
+	FrozenSet<int> streamed(sorted_unique, std::istream_iterator<int>(input), std::istream_iterator<int>());
+	assert(streamed.size() == 3 && streamed.contains(5) && !streamed.contains(4));
+
+	//    Set     
+	Set<int, DirectedLess> descending(DirectedLess{ true });
+	for (int i = 0; i < 100; ++i)
+		descending.insert(2 * i);
+	FrozenSet<int, DirectedLess> frozen_descending(descending);
+	assert(frozen_descending.contains(0) && frozen_descending.contains(198) && !frozen_descending.contains(99));
+	assert(frozen_descending.lower_bound(99)->first == 98);
+}
+
+template<typename Key, typename Compare>
+void check_simd_search(const std::vector<Key>& values)
+{
+	std::vector<Key> keys = values;
+	std::sort(keys.begin(), keys.end(), Compare());
+	keys.erase(std::unique(keys.begin(), keys.end()), keys.end());
+	Compare comp;
+	for (std::size_t n = 0; n <= keys.size(); n += (n < 80 ? 1 : 37))
+	{
+		for (const Key& key : values)
+		{
+			std::size_t lower = std::lower_bound(keys.begin(), keys.begin() + n, key, comp) - keys.begin();
+			std::size_t upper = std::upper_bound(keys.begin(), keys.begin() + n, key, comp) - keys.begin();
+			assert(simd_search::lower_bound(keys.data(), n, key, comp) == lower);
+			assert(simd_search::upper_bound(keys.data(), n, key, comp) == upper);
+		}
+	}
+}
+
+void test_simd_search()
+{
+	static_assert(simd_search::enabled<int, std::less<int>> && simd_search::enabled<std::uint64_t, std::greater<>>);
+	static_assert(!simd_search::enabled<short, std::less<short>> && !simd_search::enabled<std::string, std::less<std::string>>);
+
+	//    :      
+	std::mt19937 gen(3);
+	std::vector<std::int32_t> ints;
+	std::vector<std::uint32_t> uints;
+	std::vector<std::int64_t> longs;
+	std::vector<std::uint64_t> ulongs;
+	for (int i = 0; i < 300; ++i)
+	{
+		std::uint64_t bits = (std::uint64_t(gen()) << 32) | gen();
+		std::uint64_t near_sign = (i % 3 == 0) ? (std::uint64_t(1) << 63) + i - 150 : bits;
+		ints.push_back(static_cast<std::int32_t>(i % 3 == 0 ? std::uint32_t(0x80000000u + i - 150) : gen()));
+		uints.push_back(static_cast<std::uint32_t>(i % 3 == 0 ? std::uint32_t(0x80000000u + i - 150) : gen()));
+		longs.push_back(static_cast<std::int64_t>(near_sign));
+		ulongs.push_back(near_sign);
+	}
+	check_simd_search<std::int32_t, std::less<std::int32_t>>(ints);
+	check_simd_search<std::int32_t, std::greater<>>(ints);
+	check_simd_search<std::uint32_t, std::less<>>(uints);
+	check_simd_search<std::int64_t, std::less<std::int64_t>>(longs);
+	check_simd_search<std::uint64_t, std::greater<std::uint64_t>>(ulongs);
+
+	// B-  FlatSet        
+	using Desc = Set<unsigned, std::greater<unsigned>, std::allocator<unsigned>, BTreeBackend<>>;
+	Desc desc;
+	std::vector<unsigned> probes;
+	for (unsigned i = 0; i < 5000; ++i)
+	{
+		desc.insert(i * 3 + 0x7FFFF000u);
+		probes.push_back(i * 2 + 0x7FFFF000u);
+	}
+	assert(desc.begin()->first == 4999 * 3 + 0x7FFFF000u);
+	assert(desc.lower_bound(0x7FFFF001u)->first == 0x7FFFF000u);
+
+	std::vector<char> expected(probes.size());
+	for (std::size_t i = 0; i < probes.size(); ++i)
+		expected[i] = (probes[i] - 0x7FFFF000u) % 3 == 0;
+
+	bool found[5000];
+	desc.contains_many(probes, found);
+	assert(std::equal(probes.begin(), probes.end(), found, [&](unsigned key, bool hit) { return desc.contains(key) == hit; }));
+	assert(std::equal(expected.begin(), expected.end(), found));
+
+	Set<unsigned> tree(desc.begin(), desc.end());
+	FlatSet<unsigned> flat(tree);
+	bool tree_found[5000] = {};
+	bool flat_found[5000] = {};
+	tree.contains_many(probes, tree_found);
+	flat.contains_many(probes, flat_found);
+	assert(std::equal(expected.begin(), expected.end(), tree_found));
+	assert(std::equal(expected.begin(), expected.end(), flat_found));
+	assert(flat.upper_bound(0x7FFFF003u)->first == 0x7FFFF006u);
+}
+
+void test_batched_lookup()
+{
+	Set<int> set;
+	std::vector<int> probes;
+	for (int i = 0; i < 3000; ++i)
+	{
+		set.insert((i * 7919) % 6000);
+		probes.push_back((i * 104729) % 6500 - 100);
+	}
+
+	//   ,      
+	for (std::size_t size : { std::size_t(0), std::size_t(1), std::size_t(15), std::size_t(16), std::size_t(17), probes.size() })
+	{
+		std::span<const int> batch(probes.data(), size);
+		std::vector<Set<int>::iterator> found(size);
+		std::vector<Set<int>::const_iterator> const_found(size);
+		std::unique_ptr<bool[]> hits(new bool[size + 1]);
+		set.find_batch(batch, found);
+		std::as_const(set).find_batch(batch, const_found);
+		set.contains_batch(batch, std::span<bool>(hits.get(), size));
+		for (std::size_t i = 0; i < size; ++i)
+		{
+			assert(found[i] == set.find(probes[i]));
+			assert(const_found[i] == std::as_const(set).find(probes[i]));
+			assert(hits[i] == set.contains(probes[i]));
+		}
+	}
+
+	Set<int> empty;
+	bool hits[3] = { true, true, true };
+	int keys[3] = { 1, 2, 3 };
+	empty.contains_batch(keys, hits);
+	assert(!hits[0] && !hits[1] && !hits[2]);
+
+	// :    
+	RedBlackTree<int, int, std::less<int>, true> multi;
+	for (int i = 0; i < 100; ++i)
+		multi.insert({ i % 10, i });
+	RedBlackTree<int, int, std::less<int>, true>::const_iterator where[3];
+	int multi_keys[3] = { 3, 10, 0 };
+	std::as_const(multi).find_batch(multi_keys, where);
+	assert(where[0]->first == 3 && where[1] == multi.end() && where[2]->first == 0);
+
+	//  B-        API  
+	using BSet = Set<int, std::less<int>, std::allocator<int>, BTreeBackend<>>;
+	BSet bset(set.begin(), set.end());
+	std::vector<BSet::const_iterator> bfound(probes.size());
+	std::as_const(bset).find_batch(probes, bfound);
+	for (std::size_t i = 0; i < probes.size(); ++i)
+		assert(bfound[i] == bset.find(probes[i]));
+}
+
+template<typename SetType>
+void check_set_algebra(std::size_t lhs_size, std::size_t rhs_size, unsigned seed)
+{
+	std::mt19937 gen(seed);
+	const int range = static_cast<int>(2 * (lhs_size + rhs_size) + 1);
+	std::set<int> lhs_ref;
+	std::set<int> rhs_ref;
+	while (lhs_ref.size() < lhs_size)
+		lhs_ref.insert(static_cast<int>(gen() % range));
+	while (rhs_ref.size() < rhs_size)
+		rhs_ref.insert(static_cast<int>(gen() % range));
+	SetType lhs(lhs_ref.begin(), lhs_ref.end());
+	SetType rhs(rhs_ref.begin(), rhs_ref.end());
+
+	auto same = [](const SetType& actual, const std::vector<int>& expected)
+		{
+			return actual.size() == expected.size() && std::equal(actual.begin(), actual.end(), expected.begin(),
+				[](const auto& lhs, int rhs) { return lhs.first == rhs; });
+		};
+
+	std::vector<int> expected;
+	std::set_union(lhs_ref.begin(), lhs_ref.end(), rhs_ref.begin(), rhs_ref.end(), std::back_inserter(expected));
+	assert(same(set_union(lhs, rhs), expected));
+	SetType in_place = lhs;
+	in_place |= rhs;
+	assert(same(in_place, expected));
+	in_place = lhs;
+	in_place |= SetType(rhs);
+	assert(same(in_place, expected));
+
+	expected.clear();
+	std::set_intersection(lhs_ref.begin(), lhs_ref.end(), rhs_ref.begin(), rhs_ref.end(), std::back_inserter(expected));
+	assert(same(set_intersection(lhs, rhs), expected));
+	in_place = lhs;
+	in_place &= rhs;
+	assert(same(in_place, expected));
+
+	expected.clear();
+	std::set_difference(lhs_ref.begin(), lhs_ref.end(), rhs_ref.begin(), rhs_ref.end(), std::back_inserter(expected));
+	assert(same(set_difference(lhs, rhs), expected));
+	in_place = lhs;
+	in_place -= rhs;
+	assert(same(in_place, expected));
+
+	expected.clear();
+	std::set_symmetric_difference(lhs_ref.begin(), lhs_ref.end(), rhs_ref.begin(), rhs_ref.end(), std::back_inserter(expected));
+	assert(same(symmetric_difference(lhs, rhs), expected));
+	in_place = lhs;
+	in_place ^= rhs;
+	assert(same(in_place, expected));
+}
+
+void test_set_algebra()
+{
+	//   ()    (  )   
+	const std::size_t sizes[][2] = { { 0, 0 }, { 0, 50 }, { 50, 0 }, { 300, 250 }, { 3000, 20 }, { 20, 3000 }, { 1, 1 } };
+	for (const auto& size : sizes)
+	{
+		check_set_algebra<Set<int>>(size[0], size[1], static_cast<unsigned>(size[0] * 7 + size[1]));
+		check_set_algebra<Set<int, std::less<int>, std::allocator<int>, BTreeBackend<>>>(size[0], size[1], static_cast<unsigned>(size[0] + size[1]));
+		check_set_algebra<Set<int, std::less<int>, std::allocator<int>, OrderStatisticsBackend>>(size[0], size[1], static_cast<unsigned>(size[0] * 3 + size[1]));
+		//     :    
+		check_set_algebra<Set<int, std::less<int>, PoolAllocator<int>>>(size[0], size[1], static_cast<unsigned>(size[0] * 5 + size[1]));
+	}
+
+	//      :     ,   
+	using Counted = Set<int, std::less<int>, CountingAllocator<int>>;
+	Counted lhs;
+	Counted rhs;
+	for (int i = 0; i < 1000; ++i)
+	{
+		lhs.insert(2 * i);
+		rhs.insert(3 * i);
+	}
+	std::size_t before = g_allocations;
+	lhs &= rhs;
+	assert(lhs.size() == 334 && g_allocations == before);
+	lhs -= Counted({ 0, 6 });
+	before = g_allocations;
+	lhs |= std::move(rhs);
+	assert(lhs.size() == 1000 && g_allocations == before && rhs.empty());
+	lhs -= lhs;
+	assert(lhs.empty());
+
+	using Pooled = Set<int, std::less<int>, PoolAllocator<int>>;
+	Pooled pooled({ 1, 2 });
+	{
+		Pooled larger({ 2, 3, 4, 5 });
+		pooled |= std::move(larger);
+	}
+	assert(pooled == Pooled({ 1, 2, 3, 4, 5 }));
+
+	//         :      
+	Counted large;
+	for (int i = 0; i < 5000; ++i)
+		large.insert(2 * i);
+	const Counted small({ -1, 0, 4, 5, 9998, 10001 });
+	before = g_allocations;
+	large |= small;
+	assert(large.size() == 5003 && g_allocations == before + 3);
+	large -= small;
+	assert(large.size() == 4997 && !large.contains(4) && !large.contains(5) && g_allocations == before + 3);
+	large ^= small;
+	assert(large.size() == 5003 && large.contains(4) && large.contains(-1) && g_allocations == before + 9);
+	large &= small;
+	assert(large.size() == 6 && large == small && g_allocations == before + 9);
+}
+
+template<typename SetType>
+void check_split_join()
+{
+	SetType set;
+	for (int i = 0; i < 2000; ++i)
+		set.insert((i * 7919) % 4001);
+	const std::vector<int> keys = [&]
+		{
+			std::vector<int> result;
+			for (const auto& value : set)
+				result.push_back(value.first);
+			return result;
+		}();
+
+	for (int key : { -1, 0, 1, 2000, 2001, 4000, 5000 })
+	{
+		SetType copy = set;
+		auto [left, right] = copy.split(key);
+		assert(copy.empty());
+		std::size_t expected = std::lower_bound(keys.begin(), keys.end(), key) - keys.begin();
+		assert(left.size() == expected && right.size() == keys.size() - expected);
+		assert(left.empty() || std::prev(left.end())->first < key);
+		assert(right.empty() || right.begin()->first >= key);
+
+		SetType joined = SetType::join(std::move(left), std::move(right));
+		assert(joined == set && left.empty() && right.empty());
+	}
+
+	//         
+	auto [low, high] = SetType(set).split(1000);
+	high.erase(1000);
+	SetType joined = SetType::join(std::move(low), 1000, std::move(high));
+	SetType expected = set;
+	expected.insert(1000);
+	assert(joined == expected);
+	joined.insert(-7);
+	assert(joined.erase(1000) == 1 && joined.size() == expected.size());
+}
+
+void test_split_join()
+{
+	check_split_join<Set<int>>();
+	check_split_join<Set<int, std::less<int>, std::allocator<int>, BTreeBackend<>>>();
+
+	//    - ,   
+	using Tree = RedBlackTree<int, int>;
+	Tree tree;
+	for (int i = 0; i < 10000; ++i)
+		tree.insert({ (i * 37) % 10000, i });
+	auto [left, right] = tree.split(2500);
+	assert(left.is_valid() && right.is_valid());
+	assert(left.size() == 2500 && right.size() == 7500);
+
+	//    
+	Tree small;
+	small.insert({ 10000, 0 });
+	Tree joined = Tree::join(std::move(right), std::move(small));
+	assert(joined.is_valid() && joined.size() == 7501 && std::prev(joined.end())->first == 10000);
+	joined = Tree::join(std::move(left), std::move(joined));
+	assert(joined.is_valid() && joined.size() == 10001);
+
+	using Counted = Set<int, std::less<int>, CountingAllocator<int>>;
+	Counted counted;
+	for (int i = 0; i < 1000; ++i)
+		counted.insert(i);
+	std::size_t before = g_allocations;
+	auto [low, high] = counted.split(500);
+	Counted rejoined = Counted::join(std::move(low), std::move(high));
+	assert(rejoined.size() == 1000 && g_allocations == before);
+
+	//     PoolAllocator  :  right    left,   
+	using Pooled = Set<int, std::less<int>, PoolAllocator<int>>;
+	Pooled pooled_all;
+	{
+		Pooled pooled_low({ 1, 2, 3 });
+		Pooled pooled_high({ 7, 8, 9 });
+		Pooled pooled_left = Pooled::join(std::move(pooled_low), std::move(pooled_high));
+		Pooled pooled_right({ 20, 21 });
+		pooled_all = Pooled::join(std::move(pooled_left), 10, std::move(pooled_right));
+		assert(pooled_high.empty() && pooled_right.empty());
+	}
+	assert(pooled_all == Pooled({ 1, 2, 3, 7, 8, 9, 10, 20, 21 }));
+
+	//      size(),        
+	Tree shared;
+	for (int i = 0; i < 10000; ++i)
+		shared.insert({ i, i });
+	auto [shared_low, shared_high] = shared.split(3000);
+	const Tree& part = shared_low;
+	std::atomic<int> wrong_sizes = 0;
+	std::vector<std::thread> readers;
+	for (int r = 0; r < 4; ++r)
+		readers.emplace_back([&] { wrong_sizes += (part.size() != 3000) ? 1 : 0; });
+	for (auto& reader : readers)
+		reader.join();
+	assert(wrong_sizes == 0 && shared_high.size() == 7000);
+}
+
+template<typename SetType>
+void check_order_statistics()
+{
+	SetType s;
+	std::set<int> expected;
+	std::mt19937 rng(18);
+	for (int i = 0; i < 3000; ++i)
+	{
+		int key = static_cast<int>(rng() % 5000);
+		if (rng() % 3 == 0)
+		{
+			s.erase(key);
+			expected.erase(key);
+		}
+		else
+		{
+			s.insert(key);
+			expected.insert(key);
+		}
+	}
+
+	std::vector<int> sorted(expected.begin(), expected.end());
+	for (int key = -1; key <= 5001; key += 7)
+	{
+		std::size_t rank = static_cast<std::size_t>(std::lower_bound(sorted.begin(), sorted.end(), key) - sorted.begin());
+		assert(s.rank(key) == rank);
+		assert(s.count_range(key, key + 100) == static_cast<std::size_t>(std::lower_bound(sorted.begin(), sorted.end(), key + 100) - sorted.begin()) - rank);
+		assert(s.count_range(key + 100, key) == 0);
+	}
+	for (std::size_t k = 0; k < sorted.size(); k += 13)
+		assert(s.select(k)->first == sorted[k]);
+	assert(s.select(sorted.size()) == s.end());
+}
+
+void test_order_statistics()
+{
+	using OrderedSet = Set<int, std::less<int>, std::allocator<int>, OrderStatisticsBackend>;
+	check_order_statistics<OrderedSet>();
+	check_order_statistics<Set<int, std::less<int>, std::allocator<int>, BTreeBackend<>>>();
+
+	//    is_valid       
+	using Tree = RedBlackTree<int, EmptyStruct, std::less<int>, false, std::allocator<KeyValuePair<const int, EmptyStruct>>, SubtreeSize>;
+	static_assert(Tree::node_size() == RedBlackTree<int>::node_size() + sizeof(std::size_t));
+	std::vector<int> keys(1000);
+	std::iota(keys.begin(), keys.end(), 0);
+	Tree tree(sorted_unique, keys.begin(), keys.end());
+	assert(tree.is_valid() && tree.rank(500) == 500 && tree.select(999)->first == 999);
+
+	tree.erase(tree.lower_bound(100), tree.lower_bound(900));
+	assert(tree.is_valid() && tree.size() == 200 && tree.select(100)->first == 900);
+	tree.erase(tree.lower_bound(0), tree.lower_bound(50));
+	assert(tree.is_valid() && tree.size() == 150 && tree.rank(900) == 50);
+
+	Tree copy = tree;
+	assert(copy.is_valid() && copy.select(0)->first == 50);
+
+	auto [left, right] = tree.split(920);
+	assert(left.is_valid() && right.is_valid() && left.size() == 70 && right.size() == 80);
+	assert(right.select(0)->first == 920 && left.rank(920) == 70);
+	Tree joined = Tree::join(std::move(right), 5000, Tree());
+	joined = Tree::join(std::move(left), std::move(joined));
+	assert(joined.is_valid() && joined.size() == 151 && joined.select(150)->first == 5000);
+
+	Tree other;
+	for (int i = 0; i < 100; ++i)
+		other.insert(i * 3);
+	joined.merge(other);
+	assert(joined.is_valid() && other.is_valid() && joined.size() + other.size() == 251);
+
+	//    n    
+	OrderedSet s;
+	for (int i = 0; i < 1000; ++i)
+		s.insert(i * 2);
+	auto it = s.begin() + 10;
+	assert(it->first == 20);
+	it += 500;
+	assert(it->first == 1020 && it - s.begin() == 510);
+	it -= 505;
+	assert(it->first == 10);
+	assert(s.end() - it == 995 && (s.end() - 1)->first == 1998);
+	assert(it + 995 == s.end());
+	OrderedSet::const_iterator cit = s.cbegin() + 999;
+	assert(cit->first == 1998 && cit - s.cbegin() == 999);
+}
+
+//    mapped- 
+struct WeightSum
+{
+	using summary_type = long long;
+
+	static long long identity() { return 0; }
+	template<typename Value>
+	static long long lift(const Value& value) { return value.second; }
+	static long long combine(long long left, long long right) { return left + right; }
+};
+
+//    : ,   
+struct KeyHash
+{
+	struct summary_type
+	{
+		std::uint64_t hash = 0;
+		std::uint64_t power = 1;
+
+		bool operator==(const summary_type&) const = default;
+	};
+
+	static summary_type identity() { return {}; }
+	template<typename Value>
+	static summary_type lift(const Value& value) { return { static_cast<std::uint64_t>(value.first), 1'000'003 }; }
+	static summary_type combine(const summary_type& left, const summary_type& right)
+	{
+		return { left.hash * right.power + right.hash, left.power * right.power };
+	}
+};
+
+void test_range_aggregates()
+{
+	using Tree = RedBlackTree<int, long long, std::less<int>, false, std::allocator<KeyValuePair<const int, long long>>, WeightSum>;
+	Tree tree;
+	std::vector<long long> weights(2000, 0);
+	std::mt19937 rng(19);
+	for (int i = 0; i < 4000; ++i)
+	{
+		int key = static_cast<int>(rng() % 2000);
+		if (rng() % 4 == 0)
+		{
+			tree.erase(key);
+			weights[key] = 0;
+		}
+		else if (tree.insert({ key, key % 7 + 1 }).second)
+			weights[key] = key % 7 + 1;
+	}
+	assert(tree.is_valid());
+
+	auto expected = [&](int lo, int hi)
+		{
+			long long sum = 0;
+			for (int key = std::max(lo, 0); key < std::min(hi, 2000); ++key)
+				sum += weights[key];
+			return sum;
+		};
+	for (int lo = -10; lo < 2010; lo += 37)
+	{
+		assert(tree.aggregate(lo, lo + 150) == expected(lo, lo + 150));
+		assert(tree.aggregate(lo + 150, lo) == 0);
+	}
+	assert(tree.aggregate() == expected(0, 2000));
+
+	//        
+	auto it = tree.lower_bound(1000);
+	it->second += 100;
+	weights[it->first] += 100;
+	tree.update_summary(it);
+	assert(tree.is_valid() && tree.aggregate(900, 1100) == expected(900, 1100));
+
+	auto [left, right] = tree.split(1234);
+	assert(left.aggregate() == expected(0, 1234) && right.aggregate() == expected(1234, 2000));
+	Tree joined = Tree::join(std::move(left), std::move(right));
+	assert(joined.is_valid() && joined.aggregate() == expected(0, 2000));
+	assert(Tree().aggregate() == 0 && Tree().aggregate(0, 10) == 0);
+
+	//    :     ,  
+	using HashedSet = Set<int, std::less<int>, std::allocator<int>, AugmentedBackend<KeyHash>>;
+	HashedSet s;
+	for (int i = 0; i < 1000; ++i)
+		s.insert((i * 7919) % 1000);
+	for (int i = 0; i < 1000; i += 3)
+		s.erase(i);
+	for (int lo = 0; lo < 1000; lo += 41)
+	{
+		KeyHash::summary_type sequential;
+		for (auto pos = s.lower_bound(lo); pos != s.lower_bound(lo + 300); ++pos)
+			sequential = KeyHash::combine(sequential, KeyHash::lift(*pos));
+		assert(s.aggregate(lo, lo + 300) == sequential);
+	}
+	HashedSet copy = s;
+	assert(copy.aggregate() == s.aggregate());
+}
+
+void test_concurrent_set()
+{
+	ConcurrentSet<int> s{ 5, 1, 3 };
+	assert(s.size() == 3 && s.contains(3) && !s.contains(2));
+	assert(!s.insert(3) && s.erase(3) && !s.erase(3));
+	assert(*s.lower_bound(2) == 5 && *s.upper_bound(1) == 5 && !s.upper_bound(5) && *s.find(1) == 1);
+
+	std::set<int> expected{ 1, 5 };
+	std::mt19937 rng(20);
+	for (int i = 0; i < 20000; ++i)
+	{
+		int key = static_cast<int>(rng() % 3000);
+		if (rng() % 3 == 0)
+			assert(s.erase(key) == (expected.erase(key) == 1));
+		else
+			assert(s.insert(key) == expected.insert(key).second);
+	}
+	assert(s.size() == expected.size());
+	std::vector<int> visited;
+	s.for_each([&](int key) { visited.push_back(key); });
+	assert(std::equal(visited.begin(), visited.end(), expected.begin(), expected.end()));
+	for (int key = -1; key <= 3001; key += 11)
+	{
+		auto it = expected.lower_bound(key);
+		assert(s.lower_bound(key) == (it == expected.end() ? std::optional<int>() : std::optional<int>(*it)));
+	}
+	s.clear();
+	assert(s.empty() && s.size() == 0);
+
+	// ׸    :       ,
+	//      ,    
+	constexpr int range = 4096;
+	for (int key = 0; key <= range; key += 2)
+		s.insert(key);
+
+	std::atomic<bool> stop{ false };
+	std::atomic<int> failures{ 0 };
+	std::vector<std::thread> threads;
+	for (int w = 0; w < 2; ++w)
+	{
+		threads.emplace_back([&, w]
+			{
+				std::mt19937 gen(100 + w);
+				for (int i = 0; i < 50000; ++i)
+				{
+					int key = static_cast<int>(gen() % range) | 1;
+					if (gen() % 2)
+						s.insert(key);
+					else
+						s.erase(key);
+				}
+			});
+	}
+	for (int r = 0; r < 3; ++r)
+	{
+		threads.emplace_back([&, r]
+			{
+				std::mt19937 gen(200 + r);
+				while (!stop.load(std::memory_order_relaxed))
+				{
+					int key = static_cast<int>(gen() % range);
+					std::optional<int> bound = s.lower_bound(key);
+					if (!s.contains(key & ~1) || !bound || *bound < key || *bound > ((key + 1) & ~1))
+						failures.fetch_add(1);
+				}
+			});
+	}
+	threads[0].join();
+	threads[1].join();
+	stop = true;
+	for (std::size_t i = 2; i < threads.size(); ++i)
+		threads[i].join();
+	assert(failures == 0);
+
+	int count = 0;
+	int previous = -1;
+	s.for_each([&](int key)
+		{
+			assert(key > previous);
+			previous = key;
+			++count;
+		});
+	assert(static_cast<std::size_t>(count) == s.size() && count >= range / 2);
+}
+
+//   :  PersistentSet     
+struct CopyCountedKey
+{
+	int value;
+	static inline std::size_t copies = 0;
+
+	CopyCountedKey(int v) : value(v) {}
+	CopyCountedKey(const CopyCountedKey& other) : value(other.value) { ++copies; }
+	CopyCountedKey& operator=(const CopyCountedKey& other) { value = other.value; ++copies; return *this; }
+
+	bool operator<(const CopyCountedKey& other) const { return value < other.value; }
+};
+
+void test_persistent_set()
+{
+	PersistentSet<int> s;
+	std::set<int> expected;
+	std::vector<std::pair<PersistentSet<int>, std::set<int>>> versions;
+	std::mt19937 rng(21);
+	for (int i = 0; i < 20000; ++i)
+	{
+		int key = static_cast<int>(rng() % 3000);
+		if (rng() % 3 == 0)
+			assert(s.erase(key) == (expected.erase(key) == 1));
+		else
+			assert(s.insert(key) == expected.insert(key).second);
+		if (i % 1000 == 0)
+		{
+			assert(s.is_valid());
+			versions.emplace_back(s.snapshot(), expected);
+		}
+	}
+	assert(s.is_valid() && s.size() == expected.size());
+	assert(std::equal(s.begin(), s.end(), expected.begin(), expected.end(), [](const auto& lhs, int rhs) { return lhs.first == rhs; }));
+	assert(std::prev(s.end())->first == *expected.rbegin());
+
+	//    
+	for (const auto& [version, keys] : versions)
+	{
+		assert(version.is_valid() && version.size() == keys.size());
+		std::vector<int> visited;
+		version.for_each([&](const auto& value) { visited.push_back(value.first); });
+		assert(std::equal(visited.begin(), visited.end(), keys.begin(), keys.end()));
+	}
+
+	for (int key = -1; key <= 3001; key += 7)
+	{
+		auto it = expected.lower_bound(key);
+		auto found = s.lower_bound(key);
+		assert(it == expected.end() ? found == s.end() : found->first == *it);
+		auto upper = expected.upper_bound(key);
+		assert(upper == expected.end() ? s.upper_bound(key) == s.end() : s.upper_bound(key)->first == *upper);
+	}
+
+	std::vector<int> sorted(expected.begin(), expected.end());
+	PersistentSet<int> built(sorted_unique, sorted.begin(), sorted.end());
+	assert(built.is_valid() && built == s && !built.shares_root_with(s));
+	PersistentSet<int> snapshot = built.snapshot();
+	assert(snapshot.shares_root_with(built));
+	built.erase(sorted[sorted.size() / 2]);
+	assert(snapshot == s && built != s && snapshot.size() == built.size() + 1);
+
+	//  O(1),   O(log n) 
+	std::vector<int> many(1 << 16);
+	std::iota(many.begin(), many.end(), 0);
+	PersistentSet<CopyCountedKey> counted(sorted_unique, many.begin(), many.end());
+	CopyCountedKey::copies = 0;
+	PersistentSet<CopyCountedKey> frozen = counted.snapshot();
+	assert(CopyCountedKey::copies == 0);
+	for (int i = 0; i < 100; ++i)
+		counted.insert(CopyCountedKey(-1 - i * 7919 % 65536));
+	for (int i = 0; i < 100; ++i)
+		counted.erase(CopyCountedKey(i * 613));
+	assert(CopyCountedKey::copies < 200 * 3 * 17);
+	assert(counted.is_valid() && frozen.is_valid() && frozen.size() == many.size() && counted.size() == many.size());
+
+	//     ,    
+	PersistentSet<int> live(sorted_unique, many.begin(), many.end());
+	PersistentSet<int> reader_view = live.snapshot();
+	bool reader_ok = true;
+	std::thread reader([&]
+		{
+			for (int round = 0; round < 20; ++round)
+			{
+				std::size_t count = 0;
+				reader_view.for_each([&](const auto&) { ++count; });
+				reader_ok = reader_ok && count == many.size() && reader_view.contains(round * 1000);
+			}
+		});
+	for (int i = 0; i < 20000; ++i)
+		live.erase(i * 3);
+	reader.join();
+	assert(reader_ok && live.is_valid());
+}
+
+void test_parallel_bulk_operations()
+{
+	//  :            
+	ThreadPool pool(3);
+	std::vector<int> sorted(100000);
+	std::iota(sorted.begin(), sorted.end(), 0);
+
+	//            
+	RedBlackTree<int, EmptyStruct, std::less<int>, false, std::allocator<int>, SubtreeSize> tree;
+	tree.assign_parallel(sorted_unique, sorted.begin(), sorted.end(), parallel::Fork{ &pool });
+	assert(tree.is_valid() && tree.size() == sorted.size() && tree.rank(70000) == 70000);
+	RedBlackTree<int, EmptyStruct, std::less<int>, false, std::allocator<int>, SubtreeSize> copy;
+	copy.assign_parallel(tree, parallel::Fork{ &pool });
+	assert(copy.is_valid() && copy.size() == tree.size() && *copy.select(12345) == *tree.select(12345));
+
+	auto points = tree.split_points(8);
+	assert(points.size() == 7 && std::is_sorted(points.begin(), points.end(),
+		[](const auto& a, const auto& b) { return a->first < b->first; }));
+
+	Set<int> built(pool, sorted_unique, sorted.begin(), sorted.end());
+	Set<int> serial(sorted_unique, sorted.begin(), sorted.end());
+	assert(built == serial && built.equal(pool, serial) && built.equal(std::execution::seq, serial));
+	Set<int> copied(std::execution::par, built);
+	assert(copied == built);
+
+	std::atomic<long long> sum{ 0 };
+	std::atomic<std::size_t> visited{ 0 };
+	built.for_each(pool, [&](int key) { sum += key; ++visited; });
+	assert(visited == sorted.size() && sum == std::accumulate(sorted.begin(), sorted.end(), 0LL));
+
+	copied.erase(31337);
+	copied.insert(-1);
+	assert(!built.equal(pool, copied));
+
+	Set<int> thirds;
+	for (int i = 0; i < 150000; i += 3)
+		thirds.insert(i);
+	assert(set_union(pool, built, thirds) == set_union(built, thirds));
+	assert(set_intersection(pool, built, thirds) == set_intersection(built, thirds));
+	assert(set_intersection(pool, thirds, built) == set_intersection(built, thirds));
+
+	//    B-       
+	Set<int, std::less<int>, PoolAllocator<int>> pooled(pool, sorted_unique, sorted.begin(), sorted.end());
+	Set<int, std::less<int>, PoolAllocator<int>> pooled_copy(pool, pooled);
+	assert(pooled.equal(pool, pooled_copy) && set_union(pool, pooled, pooled_copy) == pooled);
+	Set<int, std::less<int>, std::allocator<int>, BTreeBackend<>> btree(pool, sorted_unique, sorted.begin(), sorted.end());
+	assert(btree.partition(16).size() == 2 && btree.equal(pool, Set<int, std::less<int>, std::allocator<int>, BTreeBackend<>>(pool, btree)));
+
+	//       
+	bool other_finished = false;
+	bool caught = false;
+	try
+	{
+		pool.invoke([] { throw std::runtime_error("fork"); }, [&] { other_finished = true; });
+	}
+	catch (const std::runtime_error&)
+	{
+		caught = true;
+	}
+	assert(caught && other_finished);
+}
+
+
+//     ;       
+template<typename Range>
+void split_to_leaves(Range range, std::vector<Range>& leaves)
+{
+	if (!range.is_divisible())
+	{
+		leaves.push_back(range);
+		return;
+	}
+	Range right(range, std::tuple<>());
+	assert(!range.empty() && !right.empty());
+	split_to_leaves(range, leaves);
+	split_to_leaves(right, leaves);
+}
+
+template<typename SetType>
+void check_splittable_range(const SetType& set, bool exact)
+{
+	std::vector<int> expected;
+	for (const auto& value : set)
+		expected.push_back(value.first);
+
+	//      :    ,     
+	auto whole = set.range();
+	auto right = whole.split();
+	std::size_t left_count = static_cast<std::size_t>(std::distance(whole.begin(), whole.end()));
+	std::size_t right_count = static_cast<std::size_t>(std::distance(right.begin(), right.end()));
+	assert(left_count + right_count == set.size() && whole.end() == right.begin());
+	assert(left_count >= set.size() / 4 && right_count >= set.size() / 4);
+	if (exact)
+		assert(left_count == whole.size() && right_count == right.size() && left_count == set.size() / 2);
+
+	std::vector<typename SetType::range_type> leaves;
+	split_to_leaves(set.range(), leaves);
+	//        ,     
+	assert(exact ? leaves.size() == set.size() : leaves.size() >= set.size() / 4);
+	std::vector<int> visited;
+	for (const auto& leaf : leaves)
+		for (const auto& value : leaf)
+			visited.push_back(value.first);
+	assert(visited == expected);
+
+	leaves.clear();
+	split_to_leaves(set.range(1000, 3000, 64), leaves);
+	visited.clear();
+	for (const auto& leaf : leaves)
+		for (const auto& value : leaf)
+			visited.push_back(value.first);
+	auto lo = std::lower_bound(expected.begin(), expected.end(), 1000);
+	auto hi = std::lower_bound(expected.begin(), expected.end(), 3000);
+	assert(visited == std::vector<int>(lo, hi) && leaves.size() > 1);
+	assert(set.range(3000, 1000).empty() && set.range(5, 5).empty());
+}
+
+void test_splittable_ranges()
+{
+	Set<int> set;
+	Set<int, std::less<int>, std::allocator<int>, OrderStatisticsBackend> ranked;
+	std::mt19937 rng(77);
+	for (int i = 0; i < 5000; ++i)
+	{
+		int key = static_cast<int>(rng() % 20000);
+		set.insert(key);
+		ranked.insert(key);
+	}
+	check_splittable_range(set, false);
+	check_splittable_range(ranked, true);
+
+	//            
+	RedBlackTree<int, int, std::less<int>, true> multi;
+	for (int i = 0; i < 300; ++i)
+		multi.insert({ i % 3, i });
+	std::vector<RedBlackTree<int, int, std::less<int>, true>::Range> leaves;
+	split_to_leaves(multi.range(), leaves);
+	assert(leaves.size() >= 300 / 4);
+	int previous_key = 0;
+	std::size_t count = 0;
+	for (const auto& leaf : leaves)
+	{
+		for (const auto& value : leaf)
+		{
+			assert(value.first >= previous_key);
+			previous_key = value.first;
+			++count;
+		}
+	}
+	assert(count == 300);
+
+	// B-   ,   
+	Set<int, std::less<int>, std::allocator<int>, BTreeBackend<>> btree(set.begin(), set.end());
+	auto serial = btree.range();
+	assert(!serial.is_divisible() && serial.size() == btree.size()
+		&& std::distance(serial.begin(), serial.end()) == static_cast<std::ptrdiff_t>(btree.size()));
+
+	//    :     
+	ThreadPool pool(3);
+	std::atomic<std::size_t> parts{ 0 };
+	std::atomic<long long> sum{ 0 };
+	parallel::for_range(&pool, set.range(set.size() / 16), [&](const Set<int>::range_type& part)
+		{
+			++parts;
+			for (const auto& value : part)
+				sum += value.first;
+		});
+	long long expected_sum = 0;
+	for (const auto& value : set)
+		expected_sum += value.first;
+	assert(sum == expected_sum && parts >= 16);
+}
+
+
+void test_sharded_set()
+{
+	ShardedSet<int> sharded(8);
+	std::set<int> reference;
+	std::mt19937 rng(91);
+	for (int i = 0; i < 40000; ++i)
+	{
+		int key = static_cast<int>(rng() % 100000);
+		if (rng() % 4 == 0)
+			assert(sharded.erase(key) == (reference.erase(key) == 1));
+		else
+			assert(sharded.insert(key) == reference.insert(key).second);
+	}
+	assert(sharded.size() == reference.size());
+
+	//   :           
+	auto sizes = sharded.shard_sizes();
+	assert(sizes.size() == 8 && *std::min_element(sizes.begin(), sizes.end()) > 0);
+	assert(*std::max_element(sizes.begin(), sizes.end()) <= 3 * sharded.size() / sizes.size());
+
+	//      ,     Set,        
+	std::vector<int> visited;
+	sharded.for_each([&](int key) { visited.push_back(key); });
+	assert(std::equal(visited.begin(), visited.end(), reference.begin(), reference.end()));
+	for (int probe = -5; probe < 100005; probe += 97)
+	{
+		auto lower = reference.lower_bound(probe);
+		auto upper = reference.upper_bound(probe);
+		assert(sharded.lower_bound(probe) == (lower == reference.end() ? std::nullopt : std::optional<int>(*lower)));
+		assert(sharded.upper_bound(probe) == (upper == reference.end() ? std::nullopt : std::optional<int>(*upper)));
+		assert(sharded.contains(probe) == reference.count(probe) && sharded.find(probe).has_value() == sharded.contains(probe));
+	}
+
+	sharded.rebalance();
+	sizes = sharded.shard_sizes();
+	assert(*std::max_element(sizes.begin(), sizes.end()) - *std::min_element(sizes.begin(), sizes.end()) <= 1);
+	sharded.clear();
+	assert(sharded.empty() && !sharded.lower_bound(0));
+
+	//            
+	ShardedSet<int> concurrent(16);
+	const int writers = 4;
+	const int per_writer = 20000;
+	std::atomic<bool> done{ false };
+	bool ordered = true;
+	std::thread reader([&]
+		{
+			while (!done.load())
+			{
+				int previous = -1;
+				concurrent.for_each([&](int key)
+					{
+						ordered = ordered && key > previous;
+						previous = key;
+					});
+			}
+		});
+	std::vector<std::thread> threads;
+	for (int w = 0; w < writers; ++w)
+	{
+		threads.emplace_back([&, w]
+			{
+				for (int i = 0; i < per_writer; ++i)
+					concurrent.insert(static_cast<int>((static_cast<unsigned>(i) * 2654435761u) % 1000000u) * writers + w);
+			});
+	}
+	for (auto& thread : threads)
+		thread.join();
+	done = true;
+	reader.join();
+	assert(ordered && concurrent.size() == static_cast<std::size_t>(writers * per_writer));
+	int previous = -1;
+	std::size_t count = 0;
+	concurrent.for_each([&](int key) { assert(key > previous); previous = key; ++count; });
+	assert(count == concurrent.size());
+}
+
+
+template<typename SetType>
+void check_write_batch(std::size_t initial, std::size_t batch_size, unsigned seed)
+{
+	SetType set;
+	std::set<int> reference;
+	std::mt19937 rng(seed);
+	for (std::size_t i = 0; i < initial; ++i)
+	{
+		int key = static_cast<int>(rng() % 50000);
+		set.insert(key);
+		reference.insert(key);
+	}
+
+	{
+		auto batch = set.batch();
+		for (std::size_t i = 0; i < batch_size; ++i)
+		{
+			int key = static_cast<int>(rng() % 50000);
+			if (rng() % 3 == 0)
+			{
+				batch.erase(key);
+				reference.erase(key);
+			}
+			else
+			{
+				batch.insert(key);
+				reference.insert(key);
+			}
+			//      
+			if (i % 97 == 0)
+				assert(batch.contains(key) == (reference.count(key) == 1));
+		}
+		assert(batch.pending() <= batch_size);
+	}
+	assert(set.size() == reference.size() && std::equal(set.begin(), set.end(), reference.begin(), reference.end(),
+		[](const auto& value, int key) { return value.first == key; }));
+}
+
+void test_write_batch()
+{
+	//      ,     
+	check_write_batch<Set<int>>(20000, 300, 1);
+	check_write_batch<Set<int>>(5000, 20000, 2);
+	check_write_batch<Set<int>>(0, 1000, 3);
+	check_write_batch<Set<int, std::less<int>, std::allocator<int>, OrderStatisticsBackend>>(20000, 300, 4);
+	check_write_batch<Set<int, std::less<int>, std::allocator<int>, OrderStatisticsBackend>>(5000, 20000, 5);
+	check_write_batch<Set<int, std::less<int>, std::allocator<int>, BTreeBackend<>>>(5000, 2000, 6);
+
+	//       ,     
+	RedBlackTree<int, EmptyStruct, std::less<int>, false, std::allocator<int>, SubtreeSize> tree;
+	for (int i = 0; i < 10000; i += 2)
+		tree.insert({ i, EmptyStruct() });
+	std::vector<std::pair<int, bool>> ops;
+	for (int i = 1; i < 200; i += 3)
+		ops.emplace_back(i, i % 2 == 1);
+	tree.apply_sorted(ops.begin(), ops.end());
+	assert(tree.is_valid() && tree.rank(200) == 100 + 34 - 33);
+	ops.clear();
+	for (int i = 0; i < 10000; ++i)
+		ops.emplace_back(i, i % 4 != 0);
+	tree.apply_sorted(ops.begin(), ops.end());
+	assert(tree.is_valid() && tree.size() == 7500 && tree.rank(4000) == 3000);
+
+	Set<int> set{ 1, 2, 3 };
+	{
+		auto batch = set.batch();
+		batch.insert(10);
+		batch.erase(10);
+		batch.erase(2);
+		batch.insert(2);
+		batch.erase(3);
+		assert(batch.contains(2) && !batch.contains(3) && !batch.contains(10) && batch.contains(1));
+		assert(set.contains(3) && set.size() == 3);
+		batch.flush();
+		assert(batch.pending() == 0 && set == Set<int>({ 1, 2 }));
+		batch.insert(7);
+		batch.discard();
+	}
+	assert(set == Set<int>({ 1, 2 }));
+
+	//  max_pending    
+	auto small = set.batch(4);
+	for (int i = 100; i < 110; ++i)
+		small.insert(i);
+	assert(small.pending() == 2 && set.size() == 10);
+
+	//   flush     :   ,   
+	struct FragileLess
+	{
+		const bool* broken;
+		bool operator()(int lhs, int rhs) const
+		{
+			if (*broken)
+				throw std::runtime_error("compare");
+			return lhs < rhs;
+		}
+	};
+	bool broken = false;
+	Set<int, FragileLess> fragile(FragileLess{ &broken });
+	for (int i = 1; i <= 3; ++i)
+		fragile.insert(i);
+	{
+		auto batch = fragile.batch();
+		batch.insert(4);
+		batch.erase(1);
+		broken = true;
+	}
+	broken = false;
+	assert(fragile.size() == 3 && fragile.contains(1) && !fragile.contains(4));
+
+	//       ,   :     
+	struct CountdownLess
+	{
+		int* calls_left;
+		bool operator()(int lhs, int rhs) const
+		{
+			if (*calls_left >= 0 && (*calls_left)-- == 0)
+				throw std::runtime_error("compare");
+			return lhs < rhs;
+		}
+	};
+	int calls_left = -1;
+	RedBlackTree<int, EmptyStruct, CountdownLess> counted(CountdownLess{ &calls_left });
+	for (int i = 0; i < 100; i += 2)
+		counted.insert({ i, EmptyStruct() });
+	ops.clear();
+	for (int i = 0; i < 100; ++i)
+		ops.emplace_back(i, i % 3 != 0);
+	calls_left = 60;
+	bool thrown = false;
+	try
+	{
+		counted.apply_sorted(ops.begin(), ops.end());
+	}
+	catch (const std::runtime_error&)
+	{
+		thrown = true;
+	}
+	calls_left = -1;
+	assert(thrown && counted.is_valid() && counted.size() == 50 && counted.contains(0) && !counted.contains(1));
+}
+
+
 int main() 
 {
 	test_insert_and_contains();
@@ -88,6 +1836,30 @@ int main()
 	test_iterators();
 	test_copy_and_move();
 	test_equal_operator();
+	test_pool_allocator();
+	test_duplicate_insert_does_not_allocate();
+	test_sorted_bulk_build();
+	test_structural_copy();
+	test_hinted_insert();
+	test_node_handles();
+	test_erase_by_iterator();
+	test_compact_node_layout();
+	test_iterative_traversals();
+	test_btree_backend();
+	test_flat_set();
+	test_frozen_set();
+	test_simd_search();
+	test_batched_lookup();
+	test_set_algebra();
+	test_split_join();
+	test_order_statistics();
+	test_range_aggregates();
+	test_concurrent_set();
+	test_persistent_set();
+	test_parallel_bulk_operations();
+	test_splittable_ranges();
+	test_sharded_set();
+	test_write_batch();
 
 	std::cout << "\n\n" << "All tests passed!\n";
 	return 0;